@@ -32,6 +32,8 @@ enum backing_store_flags {
 	BACKING_STORE_NONE = 0,
 	/** data is metadata */
 	BACKING_STORE_META = 1,
+	/** data is of a type likely to compress well */
+	BACKING_STORE_COMPRESSIBLE = 2,
 };
 
 /**
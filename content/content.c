@@ -748,6 +748,24 @@ bool content_is_shareable(struct content *c)
 }
 
 
+/* exported interface documented in content/content_protected.h */
+bool content_has_memory_size(const struct content *c)
+{
+	return c->handler->memory_size != NULL;
+}
+
+
+/* exported interface documented in content/content_protected.h */
+size_t content_get_memory_size(const struct content *c)
+{
+	if (c->handler->memory_size != NULL) {
+		return c->handler->memory_size(c);
+	}
+
+	return sizeof(struct content) + c->size;
+}
+
+
 /* exported interface documented in content/protected.h */
 void content_broadcast(struct content *c, content_msg msg,
 		       const union content_msg_data *data)
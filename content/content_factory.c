@@ -24,6 +24,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #include "utils/http.h"
 
@@ -32,21 +33,43 @@
 #include "content/content_protected.h"
 #include "content/llcache.h"
 
+/**
+ * Number of buckets in the exact MIME type index.
+ *
+ * Must be a power of two. There are a few dozen registered types in a
+ * typical build so this keeps chains to one or two entries.
+ */
+#define CONTENT_HANDLER_BUCKETS 64
+
 /**
  * Entry in list of content handlers
  */
 typedef struct content_handler_entry {
-	/** Next entry */
+	/** Next entry in registration list */
 	struct content_handler_entry *next;
+	/** Next entry in the same index bucket or family list */
+	struct content_handler_entry *bucket_next;
 
 	/** MIME type handled by handler */
 	lwc_string *mime_type;
+	/**
+	 * Length of major type prefix including the '/' for family
+	 * entries (e.g. 6 for "image/\*"), zero for exact entries.
+	 */
+	size_t family_len;
 	/** Content handler object */
 	const content_handler *handler;
 } content_handler_entry;
 
+/** List of all registered handlers, most recently registered first */
 static content_handler_entry *content_handlers;
 
+/** Exact MIME type index, keyed on the caseless hash of the type */
+static content_handler_entry *content_handler_index[CONTENT_HANDLER_BUCKETS];
+
+/** Family (type/\*) registrations, most recently registered first */
+static content_handler_entry *content_handler_families;
+
 /**
  * Clean up after the content factory
  */
@@ -66,6 +89,46 @@ void content_factory_fini(void)
 
 		free(victim);
 	}
+
+	memset(content_handler_index, 0, sizeof(content_handler_index));
+	content_handler_families = NULL;
+}
+
+/**
+ * Compute the length of the major type prefix of a family pattern
+ *
+ * \param mime_type  MIME type as registered
+ * \return Length of the prefix up to and including the '/' if
+ *         \a mime_type is of the form "type/\*", zero otherwise.
+ */
+static size_t content_factory_family_len(const char *mime_type)
+{
+	size_t len = strlen(mime_type);
+
+	if (len < 3 || mime_type[len - 1] != '*' || mime_type[len - 2] != '/')
+		return 0;
+
+	return len - 1;
+}
+
+/**
+ * Find the index bucket for a MIME type
+ *
+ * \param mime_type  MIME type to consider
+ * \param bucket     Updated to point at the bucket head on success
+ * \return NSERROR_OK on success, appropriate error otherwise
+ */
+static nserror
+content_factory_bucket(lwc_string *mime_type, content_handler_entry ***bucket)
+{
+	lwc_hash hash;
+
+	if (lwc_string_caseless_hash_value(mime_type, &hash) != lwc_error_ok)
+		return NSERROR_NOMEM;
+
+	*bucket = &content_handler_index[hash & (CONTENT_HANDLER_BUCKETS - 1)];
+
+	return NSERROR_OK;
 }
 
 /**
@@ -75,6 +138,9 @@ void content_factory_fini(void)
  * \param handler    Content handler for MIME type
  * \return NSERROR_OK on success, appropriate error otherwise
  *
+ * A MIME type of the form "type/\*" registers the handler for every
+ * subtype of "type" which has no exact registration of its own.
+ *
  * \note Latest registration for a MIME type wins
  */
 nserror content_factory_register_handler(const char *mime_type,
@@ -82,14 +148,26 @@ nserror content_factory_register_handler(const char *mime_type,
 {
 	lwc_string *imime_type;
 	lwc_error lerror;
+	content_handler_entry **bucket = &content_handler_families;
 	content_handler_entry *entry;
+	size_t family_len;
 	bool match;
+	nserror error;
 
 	lerror = lwc_intern_string(mime_type, strlen(mime_type), &imime_type);
 	if (lerror != lwc_error_ok)
 		return NSERROR_NOMEM;
 
-	for (entry = content_handlers; entry != NULL; entry = entry->next) {
+	family_len = content_factory_family_len(mime_type);
+	if (family_len == 0) {
+		error = content_factory_bucket(imime_type, &bucket);
+		if (error != NSERROR_OK) {
+			lwc_string_unref(imime_type);
+			return error;
+		}
+	}
+
+	for (entry = *bucket; entry != NULL; entry = entry->bucket_next) {
 		if (lwc_string_caseless_isequal(imime_type, entry->mime_type,
 				&match) == lwc_error_ok && match)
 			break;
@@ -97,13 +175,19 @@ nserror content_factory_register_handler(const char *mime_type,
 
 	if (entry == NULL) {
 		entry = malloc(sizeof(content_handler_entry));
-		if (entry == NULL)
+		if (entry == NULL) {
+			lwc_string_unref(imime_type);
 			return NSERROR_NOMEM;
+		}
 
 		entry->next = content_handlers;
 		content_handlers = entry;
 
+		entry->bucket_next = *bucket;
+		*bucket = entry;
+
 		entry->mime_type = imime_type;
+		entry->family_len = family_len;
 	} else {
 		lwc_string_unref(imime_type);
 	}
@@ -116,23 +200,43 @@ nserror content_factory_register_handler(const char *mime_type,
 /**
  * Find a handler for a MIME type.
  *
+ * Exact registrations are found through the caseless hash index;
+ * comparisons within a bucket are pointer comparisons of the interned
+ * lower case forms. Only if there is no exact match are the family
+ * registrations consulted.
+ *
  * \param mime_type  MIME type to search for
  * \return Associated handler, or NULL if none
  */
 static const content_handler *content_lookup(lwc_string *mime_type)
 {
+	content_handler_entry **bucket;
 	content_handler_entry *entry;
+	const char *data;
+	size_t len;
 	bool match;
 
-	for (entry = content_handlers; entry != NULL; entry = entry->next) {
+	if (content_factory_bucket(mime_type, &bucket) != NSERROR_OK)
+		return NULL;
+
+	for (entry = *bucket; entry != NULL; entry = entry->bucket_next) {
 		if (lwc_string_caseless_isequal(mime_type, entry->mime_type,
 					&match) == lwc_error_ok && match) {
-			break;
+			return entry->handler;
 		}
 	}
 
-	if (entry != NULL) {
-		return entry->handler;
+	data = lwc_string_data(mime_type);
+	len = lwc_string_length(mime_type);
+
+	for (entry = content_handler_families; entry != NULL;
+			entry = entry->bucket_next) {
+		if (len > entry->family_len &&
+				strncasecmp(data,
+					lwc_string_data(entry->mime_type),
+					entry->family_len) == 0) {
+			return entry->handler;
+		}
 	}
 
 	return NULL;
@@ -153,6 +153,18 @@ struct content_handler {
 	 */
 	bool (*is_opaque)(struct content *c);
 
+	/**
+	 * estimate the memory held by a content.
+	 *
+	 * Used to size contents retained by the high level cache once
+	 * they have no users. Contents whose handler does not provide
+	 * an estimate are never retained.
+	 *
+	 * \param c The content to measure
+	 * \return The estimated size in bytes
+	 */
+	size_t (*memory_size)(const struct content *c);
+
 	/**
 	 * There must be one content per user for this type.
 	 */
@@ -591,6 +603,22 @@ bool content_matches_quirks(struct content *c, bool quirks);
  */
 bool content_is_shareable(struct content *c);
 
+/**
+ * Determine if the memory held by a content can be estimated
+ *
+ * \param c  Content to consider
+ * \return true if the content handler provides a memory estimate
+ */
+bool content_has_memory_size(const struct content *c);
+
+/**
+ * Estimate the memory held by a content
+ *
+ * \param c  Content to consider
+ * \return The estimated size in bytes
+ */
+size_t content_get_memory_size(const struct content *c);
+
 /**
  * Retrieve the low-level cache handle for a content
  *
@@ -45,6 +45,7 @@
 #include "utils/nsoption.h"
 #include "utils/log.h"
 #include "utils/messages.h"
+#include "utils/metrics.h"
 #include "utils/nsurl.h"
 #include "utils/ring.h"
 #include "netsurf/misc.h"
@@ -94,9 +95,11 @@ struct fetch {
 	void *p;		/**< Private data for callback. */
 	lwc_string *host;	/**< Host part of URL, interned */
 	long http_code;		/**< HTTP response code, or 0. */
+	size_t transferred;	/**< Body bytes received, or 0. */
 	int fetcherd;           /**< Fetcher descriptor for this fetch */
 	void *fetcher_handle;	/**< The handle for the fetcher. */
 	bool fetch_is_active;	/**< This fetch is active. */
+	bool speculative;	/**< Only dispatch when otherwise idle. */
 	fetch_msg_type last_msg;/**< The last message sent for this fetch */
 	struct fetch *r_prev;	/**< Previous active fetch in ::fetch_ring. */
 	struct fetch *r_next;	/**< Next active fetch in ::fetch_ring. */
@@ -163,6 +166,32 @@ static bool fetch_dispatch_job(struct fetch *fetch)
 	}
 }
 
+/**
+ * Determine if a speculative fetch may be dispatched.
+ *
+ * Speculative fetches only use the network when nothing else does.
+ *
+ * \return true if no fetches are active and only speculative fetches
+ *         are queued.
+ */
+static bool fetch_speculative_idle(void)
+{
+	struct fetch *queueitem = queue_ring;
+
+	if (fetch_ring != NULL) {
+		return false;
+	}
+
+	do {
+		if (queueitem->speculative == false) {
+			return false;
+		}
+		queueitem = queueitem->r_next;
+	} while (queueitem != queue_ring);
+
+	return true;
+}
+
 /**
  * Choose and dispatch a single job. Return false if we failed to dispatch
  * anything.
@@ -180,6 +209,14 @@ static bool fetch_choose_and_dispatch(void)
 		 * fetch ring
 		 */
 		int countbyhost;
+
+		if (queueitem->speculative &&
+		    (fetch_speculative_idle() == false)) {
+			/* lowest priority; wait for everything else */
+			queueitem = queueitem->r_next;
+			continue;
+		}
+
 		RING_COUNTBYLWCHOST(struct fetch, fetch_ring, countbyhost,
 				    queueitem->host);
 		if (countbyhost < nsoption_int(max_fetchers_per_host)) {
@@ -223,6 +260,78 @@ static void dump_rings(void)
 	}
 }
 
+/**
+ * Generate a per host fetch count metric for a ring.
+ *
+ * Each host is reported once, from its first fetch in the ring, with
+ * the number of fetches in the ring for that host.
+ *
+ * \param ring The ring to report on.
+ * \param name The metric name to report the counts as.
+ * \param cb The metric enumeration callback.
+ * \param cbpw The context for \a cb
+ * \return NSERROR_OK or the error returned by \a cb
+ */
+static nserror
+fetch_metric_ring(struct fetch *ring,
+		  const char *name,
+		  nsmetric_enumerate_cb cb,
+		  void *cbpw)
+{
+	struct nsmetric_value value;
+	struct fetch *f;
+	struct fetch *p;
+	nserror res;
+
+	if (ring == NULL) {
+		return NSERROR_OK;
+	}
+
+	memset(&value, 0, sizeof(value));
+	value.name = name;
+	value.type = NSMETRIC_GAUGE;
+
+	f = ring;
+	do {
+		/* only report a host at its first occurrence */
+		for (p = ring; p != f; p = p->r_next) {
+			if (p->host == f->host) {
+				break;
+			}
+		}
+		if (p == f) {
+			value.label = (f->host != NULL) ?
+				lwc_string_data(f->host) : "";
+			RING_COUNTBYLWCHOST(struct fetch, ring,
+					    value.value, f->host);
+			value.count = value.max = value.value;
+
+			res = cb(&value, cbpw);
+			if (res != NSERROR_OK) {
+				return res;
+			}
+		}
+		f = f->r_next;
+	} while (f != ring);
+
+	return NSERROR_OK;
+}
+
+/**
+ * Metric source reporting active and queued fetches by host.
+ */
+static nserror
+fetch_metric_source(nsmetric_enumerate_cb cb, void *cbpw, void *pw)
+{
+	nserror res;
+
+	res = fetch_metric_ring(fetch_ring, "fetch.active", cb, cbpw);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+	return fetch_metric_ring(queue_ring, "fetch.queued", cb, cbpw);
+}
+
 /**
  * Dispatch as many jobs as we have room to dispatch.
  *
@@ -314,14 +423,20 @@ nserror fetcher_init(void)
 	}
 
 	ret = fetch_javascript_register();
+	if (ret != NSERROR_OK) {
+		return ret;
+	}
 
-	return ret;
+	return nsmetric_source_register(fetch_metric_source, NULL);
 }
 
 /* exported interface documented in content/fetchers.h */
 void fetcher_quit(void)
 {
 	int fetcherd; /* fetcher index */
+
+	nsmetric_source_unregister(fetch_metric_source, NULL);
+
 	for (fetcherd = 0; fetcherd < MAX_FETCHERS; fetcherd++) {
 		if (fetchers[fetcherd].refcount > 1) {
 			/* fetcher still has reference at quit. This
@@ -455,6 +570,7 @@ fetch_start(nsurl *url,
 	    const struct fetch_multipart_data *post_multipart,
 	    bool verifiable,
 	    bool downgrade_tls,
+	    bool speculative,
 	    const char *headers[],
 	    struct fetch **fetch_out)
 {
@@ -484,6 +600,7 @@ fetch_start(nsurl *url,
 	fetch->callback = callback;
 	fetch->url = nsurl_ref(url);
 	fetch->verifiable = verifiable;
+	fetch->speculative = speculative;
 	fetch->p = p;
 	fetch->host = nsurl_get_component(url, NSURL_HOST);
 
@@ -533,6 +650,23 @@ fetch_start(nsurl *url,
 	return NSERROR_OK;
 }
 
+/* exported interface documented in content/fetch.h */
+void fetch_promote(struct fetch *fetch)
+{
+	if (fetch->speculative == false) {
+		return;
+	}
+
+	NSLOG(fetch, DEBUG, "fetch %p, url '%s' no longer speculative",
+	      fetch, nsurl_access(fetch->url));
+
+	fetch->speculative = false;
+
+	if ((fetch->fetch_is_active == false) && fetch_dispatch_jobs()) {
+		guit->misc->schedule(SCHEDULE_TIME, fetcher_poll, NULL);
+	}
+}
+
 /* exported interface documented in content/fetch.h */
 void fetch_abort(struct fetch *f)
 {
@@ -598,6 +732,27 @@ bool fetch_can_fetch(const nsurl *url)
 	return fetchers[fetcherd].ops.acceptable(url);
 }
 
+/* exported interface documented in content/fetch.h */
+nserror fetch_preconnect(const nsurl *url)
+{
+	lwc_string *scheme;
+	int fetcherd;
+
+	if (nsoption_bool(preconnect) == false) {
+		return NSERROR_OK;
+	}
+
+	scheme = nsurl_get_component(url, NSURL_SCHEME);
+	fetcherd = get_fetcher_for_scheme(scheme);
+	lwc_string_unref(scheme);
+
+	if ((fetcherd == -1) || (fetchers[fetcherd].ops.preconnect == NULL)) {
+		return NSERROR_NOT_IMPLEMENTED;
+	}
+
+	return fetchers[fetcherd].ops.preconnect(url);
+}
+
 /* exported interface documented in content/fetch.h */
 void fetch_change_callback(struct fetch *fetch,
 			   fetch_callback callback,
@@ -614,6 +769,12 @@ long fetch_http_code(struct fetch *fetch)
 	return fetch->http_code;
 }
 
+/* exported interface documented in content/fetch.h */
+size_t fetch_transferred(struct fetch *fetch)
+{
+	return fetch->transferred;
+}
+
 
 /* exported interface documented in content/fetch.h */
 struct fetch_multipart_data *
@@ -799,6 +960,13 @@ void fetch_set_http_code(struct fetch *fetch, long http_code)
 }
 
 
+/* exported interface documented in content/fetch.h */
+void fetch_set_transferred(struct fetch *fetch, size_t transferred)
+{
+	fetch->transferred = transferred;
+}
+
+
 /* exported interface documented in content/fetch.h */
 void fetch_set_cookie(struct fetch *fetch, const char *data)
 {
@@ -42,6 +42,7 @@ typedef enum {
 	FETCH_CERTS,
 	FETCH_HEADER,
 	FETCH_DATA,
+	FETCH_DATA_ADOPT,
 	/* Anything after here is a completed fetch of some kind. */
 	FETCH_FINISHED,
 	FETCH_TIMEDOUT,
@@ -66,6 +67,15 @@ typedef enum {
  */
 #define FETCH__INTERNAL_ABORTED FETCH_ERROR
 
+/**
+ * Release callback for data passed with a FETCH_DATA_ADOPT message.
+ *
+ * \param buf The buffer originally passed in the message.
+ * \param len The length originally passed in the message.
+ * \param pw The private word originally passed in the message.
+ */
+typedef void (*fetch_data_release_fn)(const uint8_t *buf, size_t len, void *pw);
+
 /**
  * Fetcher message data
  */
@@ -80,6 +90,20 @@ typedef struct fetch_msg {
 			size_t len;
 		} header_or_data;
 
+		/**
+		 * Immutable data whose ownership passes to the recipient.
+		 *
+		 * The recipient must call release (if it is not NULL)
+		 * exactly once when it no longer requires the buffer.
+		 * The buffer must remain valid and unchanged until then.
+		 */
+		struct {
+			const uint8_t *buf;
+			size_t len;
+			fetch_data_release_fn release;
+			void *pw;
+		} adopt;
+
 		const char *error;
 
 		/** \todo Use nsurl */
@@ -125,6 +149,9 @@ typedef void (*fetch_callback)(const fetch_msg *msg, void *p);
  * FETCH_FINISHED. Alternatively, FETCH_ERROR indicates an error occurred:
  * data contains an error message. FETCH_REDIRECT may replace the FETCH_HEADER,
  * FETCH_DATA, FETCH_FINISHED sequence if the server sends a replacement URL.
+ * FETCH_DATA_ADOPT may be sent in place of FETCH_DATA when the fetcher
+ * can hand over an immutable buffer (e.g. a mapped file) without copying.
+ * The file fetcher only does this for files with no write permission.
  *
  * \param url URL to fetch
  * \param referer
@@ -135,6 +162,8 @@ typedef void (*fetch_callback)(const fetch_msg *msg, void *p);
  * \param post_multipart
  * \param verifiable
  * \param downgrade_tls
+ * \param speculative fetch at lowest priority, only while no other
+ *                    fetches are active.
  * \param headers
  * \param fetch_out ponter to recive new fetch object.
  * \return NSERROR_OK and fetch_out updated else appropriate error code
@@ -142,9 +171,18 @@ typedef void (*fetch_callback)(const fetch_msg *msg, void *p);
 nserror fetch_start(nsurl *url, nsurl *referer, fetch_callback callback,
 		    void *p, bool only_2xx, const char *post_urlenc,
 		    const struct fetch_multipart_data *post_multipart,
-		    bool verifiable, bool downgrade_tls,
+		    bool verifiable, bool downgrade_tls, bool speculative,
 		    const char *headers[], struct fetch **fetch_out);
 
+/**
+ * Raise a speculative fetch to normal priority.
+ *
+ * Used when the data being fetched speculatively is actually wanted.
+ *
+ * \param fetch The fetch to promote.
+ */
+void fetch_promote(struct fetch *fetch);
+
 /**
  * Abort a fetch.
  */
@@ -159,6 +197,20 @@ void fetch_abort(struct fetch *f);
  */
 bool fetch_can_fetch(const nsurl *url);
 
+/**
+ * Speculatively connect to the server of a URL.
+ *
+ * Name resolution and connection setup are performed ahead of a fetch
+ * of the URL which is likely to be made soon. Nothing is requested from
+ * the server.
+ *
+ * \param url The URL which may be fetched.
+ * \return NSERROR_OK on success or if there is nothing to do,
+ *         NSERROR_NOT_IMPLEMENTED if the URL scheme has no connections
+ *         to warm else appropriate error code.
+ */
+nserror fetch_preconnect(const nsurl *url);
+
 /**
  * Change the callback function for a fetch.
  */
@@ -169,6 +221,17 @@ void fetch_change_callback(struct fetch *fetch, fetch_callback callback, void *p
  */
 long fetch_http_code(struct fetch *fetch);
 
+/**
+ * Get the number of body bytes received over the network.
+ *
+ * This is smaller than the data delivered when the body was sent with a
+ * content encoding.
+ *
+ * \param fetch The fetch.
+ * \return The number of bytes or 0 if the fetcher did not report it.
+ */
+size_t fetch_transferred(struct fetch *fetch);
+
 
 /**
  * Free a linked list of fetch_multipart_data.
@@ -229,6 +292,11 @@ void fetch_free(struct fetch *f);
  */
 void fetch_set_http_code(struct fetch *fetch, long http_code);
 
+/**
+ * set the number of body bytes received over the network for a fetch
+ */
+void fetch_set_transferred(struct fetch *fetch, size_t transferred);
+
 /**
  * set cookie data on a fetch
  */
@@ -96,6 +96,17 @@ struct fetcher_operation_table {
 	int (*fdset)(lwc_string *scheme, fd_set *read_set, fd_set *write_set,
 		     fd_set *error_set);
 
+	/**
+	 * Speculatively connect to the server of a url.
+	 *
+	 * Optional; fetchers which have no connection setup to warm
+	 * leave this NULL.
+	 *
+	 * \param url the URL which may be fetched soon.
+	 * \return NSERROR_OK or appropriate error code.
+	 */
+	nserror (*preconnect)(const struct nsurl *url);
+
 	/**
 	 * Finalise the fetcher.
 	 */
@@ -52,7 +52,9 @@
 #include "chart.h"
 #include "choices.h"
 #include "imagecache.h"
+#include "log.h"
 #include "nscolours.h"
+#include "perf.h"
 #include "query.h"
 #include "query_auth.h"
 #include "query_fetcherror.h"
@@ -426,6 +428,22 @@ struct about_handlers about_handler_list[] = {
 		fetch_about_imagecache_handler,
 		true
 	},
+	{
+		/* recent log records */
+		"log",
+		SLEN("log"),
+		NULL,
+		fetch_about_log_handler,
+		true
+	},
+	{
+		/* performance metrics */
+		"perf",
+		SLEN("perf"),
+		NULL,
+		fetch_about_perf_handler,
+		true
+	},
 	{
 		/* The default blank page */
 		"blank",
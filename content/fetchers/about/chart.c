@@ -48,6 +48,7 @@
 enum chart_type {
 		 CHART_TYPE_UNKNOWN,
 		 CHART_TYPE_PIE,
+		 CHART_TYPE_LINE,
 };
 
 /* type of chart key */
@@ -318,6 +319,8 @@ process_query_section(const char *str, size_t len, struct chart_param *chart)
 	    (strncmp(str, "type=", 5) == 0)) {
 		if (strncmp(str + 5, "pie", len - 5) == 0) {
 			chart->type = CHART_TYPE_PIE;
+		} else if (strncmp(str + 5, "line", len - 5) == 0) {
+			chart->type = CHART_TYPE_LINE;
 		} else {
 			chart->type = CHART_TYPE_UNKNOWN;
 		}
@@ -397,8 +400,17 @@ chart_from_query(struct nsurl *url, struct chart_param *chart)
 }
 
 
+/**
+ * output a chart legend
+ *
+ * \param ctx The fetcher context.
+ * \param chart The chart parameters.
+ * \param label_count The number of labels to place in the legend.
+ */
 static nserror
-output_pie_legend(struct fetch_about_context *ctx, struct chart_param *chart)
+output_legend(struct fetch_about_context *ctx,
+	      struct chart_param *chart,
+	      unsigned int label_count)
 {
 	nserror res;
 	unsigned int lblidx;
@@ -414,9 +426,9 @@ output_pie_legend(struct fetch_about_context *ctx, struct chart_param *chart)
 		legend_width = chart->width - chart->area.width - chart->area.x;
 		legend_width -= 10; /* margin */
 		legend_height = chart->height;
-		vertical_spacing = legend_height / (chart->data.label_len + 1);
+		vertical_spacing = legend_height / (label_count + 1);
 
-		for(lblidx = 0; lblidx < chart->data.label_len ; lblidx++) {
+		for(lblidx = 0; lblidx < label_count ; lblidx++) {
 			res = fetch_about_ssenddataf(ctx,
 				"<rect  x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" fill=\"#%06x\" />",
 				chart->width - legend_width,
@@ -535,7 +547,7 @@ pie_chart(struct fetch_about_context *ctx, struct chart_param *chart)
 	}
 
 	/* generate the legend */
-	res = output_pie_legend(ctx, chart);
+	res = output_legend(ctx, chart, chart->data.label_len);
 	if (res != NSERROR_OK) {
 		goto aborted;
 	}
@@ -593,6 +605,148 @@ pie_chart(struct fetch_about_context *ctx, struct chart_param *chart)
 
 }
 
+/**
+ * render the data as a line chart svg
+ *
+ * Each series is drawn as a line with its values evenly spaced along
+ * the x axis and scaled so the largest value in any series reaches
+ * the top of the chart area.
+ */
+static bool
+line_chart(struct fetch_about_context *ctx, struct chart_param *chart)
+{
+	nserror res;
+	float ymax = 0;
+	unsigned int xcount = 0;
+	unsigned int curseries;
+	unsigned int curdata;
+	struct chart_series *series;
+
+	/* ensure there is data to render */
+	if (chart->data.series_len < 1) {
+		return false;
+	}
+
+	for (curseries = 0; curseries < chart->data.series_len; curseries++) {
+		series = &chart->data.series[curseries];
+		if (series->len > xcount) {
+			xcount = series->len;
+		}
+		for (curdata = 0; curdata < series->len; curdata++) {
+			if (series->value[curdata] > ymax) {
+				ymax = series->value[curdata];
+			}
+		}
+	}
+
+	if (xcount < 2) {
+		return false;
+	}
+
+	if (ymax <= 0) {
+		/* a flat line of zeros still needs a scale */
+		ymax = 1;
+	}
+
+	/* every series needs a label for the legend */
+	res = ensure_label_count(chart, chart->data.series_len);
+	if (res != NSERROR_OK) {
+		return false;
+	}
+
+	/*
+	 * line chart defaults to the left two thirds of the figure
+	 *  leaving the remainder for the key.
+	 */
+	if ((chart->area.width == 0) || (chart->area.height == 0)) {
+		chart->area.x = 5;
+		chart->area.y = 5;
+		chart->area.height = chart->height - 10;
+		if (chart->key == CHART_KEY_NONE) {
+			chart->area.width = chart->width - 10;
+		} else {
+			chart->area.width = ((chart->width * 2) / 3) - 10;
+		}
+	}
+
+	/* content is going to return ok */
+	fetch_about_set_http_code(ctx, 200);
+
+	/* content type */
+	if (fetch_about_send_header(ctx,
+			"Content-Type: image/svg; charset=utf-8")) {
+		goto aborted;
+	}
+
+	/* svg header */
+	res = fetch_about_ssenddataf(ctx,
+			"<svg width=\"%u\" height=\"%u\" "
+			"xmlns=\"http://www.w3.org/2000/svg\">\n",
+			chart->width, chart->height);
+	if (res != NSERROR_OK) {
+		goto aborted;
+	}
+
+	/* generate the legend */
+	res = output_legend(ctx, chart, chart->data.series_len);
+	if (res != NSERROR_OK) {
+		goto aborted;
+	}
+
+	/* chart area outline and scale */
+	res = fetch_about_ssenddataf(ctx,
+			"<rect x=\"%u\" y=\"%u\" width=\"%u\" height=\"%u\" "
+			"fill=\"none\" stroke=\"#777777\" />\n"
+			"<text x=\"%u\" y=\"%u\" fill=\"#777777\" "
+			"font-size=\"10\">%g</text>\n",
+			chart->area.x, chart->area.y,
+			chart->area.width, chart->area.height,
+			chart->area.x + 2, chart->area.y + 10, ymax);
+	if (res != NSERROR_OK) {
+		goto aborted;
+	}
+
+	/* plot each series as a polyline */
+	for (curseries = 0; curseries < chart->data.series_len; curseries++) {
+		series = &chart->data.series[curseries];
+
+		res = fetch_about_ssenddataf(ctx,
+				"<polyline fill=\"none\" stroke=\"#%06x\" "
+				"stroke-width=\"2\" points=\"",
+				chart->data.label[curseries].colour);
+		if (res != NSERROR_OK) {
+			goto aborted;
+		}
+
+		for (curdata = 0; curdata < series->len; curdata++) {
+			res = fetch_about_ssenddataf(ctx, "%g,%g ",
+				chart->area.x + ((float)(curdata * chart->area.width) / (xcount - 1)),
+				chart->area.y + chart->area.height - ((series->value[curdata] / ymax) * chart->area.height));
+			if (res != NSERROR_OK) {
+				goto aborted;
+			}
+		}
+
+		res = fetch_about_ssenddataf(ctx, "\" />\n");
+		if (res != NSERROR_OK) {
+			goto aborted;
+		}
+	}
+
+	res = fetch_about_ssenddataf(ctx, "</svg>\n");
+	if (res != NSERROR_OK) {
+		goto aborted;
+	}
+
+	fetch_about_send_finished(ctx);
+
+	return true;
+
+ aborted:
+
+	return false;
+}
+
 /**
  * Handler to generate about scheme chart page.
  *
@@ -616,6 +770,9 @@ bool fetch_about_chart_handler(struct fetch_about_context *ctx)
 	case CHART_TYPE_PIE:
 		return pie_chart(ctx, &chart);
 
+	case CHART_TYPE_LINE:
+		return line_chart(ctx, &chart);
+
 
 	default:
 		break;
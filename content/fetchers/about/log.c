@@ -0,0 +1,73 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * content generator for the about scheme log page
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "utils/errors.h"
+#include "utils/log.h"
+
+#include "private.h"
+#include "log.h"
+
+/** Maximum number of log records shown */
+#define LOG_MAX_RECORDS 4096
+
+
+/**
+ * send a log record on the about response
+ */
+static nserror log_record_cb(const char *line, size_t len, void *pw)
+{
+	struct fetch_about_context *ctx = pw;
+	nserror res;
+
+	res = fetch_about_senddata(ctx, (const uint8_t *)line, len);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+	return fetch_about_senddata(ctx, (const uint8_t *)"\n", 1);
+}
+
+
+/* exported interface documented in about/log.h */
+bool fetch_about_log_handler(struct fetch_about_context *ctx)
+{
+	/* content is going to return ok */
+	fetch_about_set_http_code(ctx, 200);
+
+	/* content type */
+	if (fetch_about_send_header(ctx, "Content-Type: text/plain; charset=utf-8"))
+		goto fetch_about_log_handler_aborted;
+
+	if (nslog_enumerate(LOG_MAX_RECORDS, log_record_cb, ctx) != NSERROR_OK)
+		goto fetch_about_log_handler_aborted;
+
+	fetch_about_send_finished(ctx);
+
+	return true;
+
+fetch_about_log_handler_aborted:
+	return false;
+}
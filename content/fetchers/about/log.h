@@ -0,0 +1,37 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * about scheme log handler interface
+ */
+
+#ifndef NETSURF_CONTENT_FETCHERS_ABOUT_LOG_H
+#define NETSURF_CONTENT_FETCHERS_ABOUT_LOG_H
+
+/**
+ * Handler to generate about scheme log page.
+ *
+ * Shows the most recent log records as plain text.
+ *
+ * \param ctx The fetcher context.
+ * \return true if handled false if aborted.
+ */
+bool fetch_about_log_handler(struct fetch_about_context *ctx);
+
+#endif
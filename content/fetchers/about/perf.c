@@ -0,0 +1,461 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * content generator for the about scheme perf page
+ *
+ * The page is built entirely from the performance metrics registry
+ * so anything a module publishes is shown in the full metric table
+ * even if it has no dedicated section.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "netsurf/inttypes.h"
+#include "utils/errors.h"
+#include "utils/metrics.h"
+
+#include "private.h"
+#include "perf.h"
+
+/** Size of the chart figures */
+#define PERF_CHART_WIDTH 450
+#define PERF_CHART_HEIGHT 120
+
+/**
+ * context for table generating metric enumeration
+ */
+struct perf_table_ctx {
+	struct fetch_about_context *ctx; /**< about fetch context */
+	unsigned int rows; /**< number of rows output */
+};
+
+static const char *perf_type_name[] = {
+	[NSMETRIC_COUNTER] = "counter",
+	[NSMETRIC_GAUGE] = "gauge",
+	[NSMETRIC_TIMING] = "timing",
+};
+
+
+/**
+ * get the current value of a metric or zero if it is not registered
+ */
+static int64_t perf_metric_value(const char *name)
+{
+	struct nsmetric_value value;
+
+	if (nsmetric_get(name, &value) != NSERROR_OK) {
+		return 0;
+	}
+	return value.value;
+}
+
+
+/**
+ * compute a bandwidth in bytes per second
+ */
+static int64_t perf_bandwidth(int64_t bytes, int64_t ms)
+{
+	if (ms <= 0) {
+		return 0;
+	}
+	return (bytes * 1000) / ms;
+}
+
+
+/**
+ * output a line chart of the history of some metrics
+ *
+ * Metrics which are not registered or have fewer than two samples are
+ * left out and nothing is output if no metric remains.
+ *
+ * \param ctx The fetcher context.
+ * \param names The metric names to chart.
+ * \param labels The legend label for each metric.
+ * \param count The number of metrics.
+ */
+static nserror
+perf_history_chart(struct fetch_about_context *ctx,
+		   const char **names,
+		   const char **labels,
+		   unsigned int count)
+{
+	struct nsmetric_value value[4];
+	unsigned int present[4];
+	unsigned int npresent = 0;
+	unsigned int idx;
+	unsigned int hidx;
+	nserror res;
+
+	for (idx = 0; (idx < count) && (npresent < 4); idx++) {
+		if ((nsmetric_get(names[idx], &value[npresent]) == NSERROR_OK) &&
+		    (value[npresent].history_len >= 2)) {
+			present[npresent++] = idx;
+		}
+	}
+	if (npresent == 0) {
+		return NSERROR_OK;
+	}
+
+	res = fetch_about_ssenddataf(ctx,
+			"<img width=%d height=%d src=\"about:chart?type=line"
+			"&width=%d&height=%d&labels=",
+			PERF_CHART_WIDTH, PERF_CHART_HEIGHT,
+			PERF_CHART_WIDTH, PERF_CHART_HEIGHT);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	for (idx = 0; idx < npresent; idx++) {
+		res = fetch_about_ssenddataf(ctx, "%s%s",
+				idx == 0 ? "" : ",", labels[present[idx]]);
+		if (res != NSERROR_OK) {
+			return res;
+		}
+	}
+
+	for (idx = 0; idx < npresent; idx++) {
+		for (hidx = 0; hidx < value[idx].history_len; hidx++) {
+			res = fetch_about_ssenddataf(ctx, "%s%"PRId64,
+					hidx == 0 ? "&values=" : ",",
+					value[idx].history[hidx]);
+			if (res != NSERROR_OK) {
+				return res;
+			}
+		}
+	}
+
+	return fetch_about_ssenddataf(ctx, "\" />\n");
+}
+
+
+/**
+ * output a table row for each per host fetch count
+ */
+static nserror
+perf_fetch_row_cb(const struct nsmetric_value *value, void *pw)
+{
+	struct perf_table_ctx *tctx = pw;
+
+	if (value->label == NULL) {
+		/* only per host values belong in this table */
+		return NSERROR_OK;
+	}
+
+	tctx->rows++;
+
+	return fetch_about_ssenddataf(tctx->ctx,
+			"<tr class=\"%s\">"
+			"<td class=\"ns-border\">%s</td>"
+			"<td class=\"ns-border\">%s</td>"
+			"<td class=\"ns-border\">%"PRId64"</td>"
+			"</tr>\n",
+			(tctx->rows & 1) ? "ns-odd-bg" : "ns-even-bg",
+			value->label,
+			strcmp(value->name, "fetch.active") == 0 ?
+					"active" : "queued",
+			value->value);
+}
+
+
+/**
+ * output a table row for any metric
+ */
+static nserror
+perf_metric_row_cb(const struct nsmetric_value *value, void *pw)
+{
+	struct perf_table_ctx *tctx = pw;
+	int64_t mean = 0;
+
+	tctx->rows++;
+
+	if ((value->type == NSMETRIC_TIMING) && (value->count > 0)) {
+		mean = value->total / (int64_t)value->count;
+	}
+
+	return fetch_about_ssenddataf(tctx->ctx,
+			"<tr class=\"%s\">"
+			"<td class=\"ns-border\">%s</td>"
+			"<td class=\"ns-border\">%s</td>"
+			"<td class=\"ns-border\">%s</td>"
+			"<td class=\"ns-border\">%"PRId64"</td>"
+			"<td class=\"ns-border\">%"PRIu64"</td>"
+			"<td class=\"ns-border\">%"PRId64"</td>"
+			"<td class=\"ns-border\">%"PRId64"</td>"
+			"</tr>\n",
+			(tctx->rows & 1) ? "ns-odd-bg" : "ns-even-bg",
+			value->name,
+			value->label != NULL ? value->label : "",
+			perf_type_name[value->type],
+			value->value,
+			value->count,
+			mean,
+			value->max);
+}
+
+
+/**
+ * output the fetch section
+ */
+static nserror perf_fetch_section(struct fetch_about_context *ctx)
+{
+	struct perf_table_ctx tctx = { ctx, 0 };
+	nserror res;
+
+	res = fetch_about_ssenddataf(ctx,
+			"<h2 class=\"ns-border\">Fetches</h2>\n"
+			"<table class=\"config\">\n"
+			"<tr><th>Host</th><th>State</th><th>Count</th></tr>\n");
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	res = nsmetric_enumerate("fetch.", perf_fetch_row_cb, &tctx);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	res = fetch_about_ssenddataf(ctx, "</table>\n");
+	if ((res == NSERROR_OK) && (tctx.rows == 0)) {
+		res = fetch_about_ssenddataf(ctx,
+				"<p>No fetches in progress</p>\n");
+	}
+	return res;
+}
+
+
+/**
+ * output the low level cache section
+ */
+static nserror perf_llcache_section(struct fetch_about_context *ctx)
+{
+	const char *size_names[] = { "llcache.size" };
+	const char *size_labels[] = { "size" };
+	struct nsmetric_value size;
+	int64_t hit, reval, miss, total;
+	nserror res;
+
+	if (nsmetric_get("llcache.size", &size) != NSERROR_OK) {
+		memset(&size, 0, sizeof(size));
+	}
+	hit = perf_metric_value("llcache.hit");
+	reval = perf_metric_value("llcache.revalidate");
+	miss = perf_metric_value("llcache.miss");
+	total = hit + reval + miss;
+
+	res = fetch_about_ssenddataf(ctx,
+			"<h2 class=\"ns-border\">Low level cache</h2>\n"
+			"<p>RAM in use %"PRId64" bytes (peak %"PRId64")</p>\n",
+			size.value, size.max);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	res = perf_history_chart(ctx, size_names, size_labels, 1);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	res = fetch_about_ssenddataf(ctx,
+			"<p>Retrieve total/hit/revalidate/miss "
+			"%"PRId64"/%"PRId64"/%"PRId64"/%"PRId64,
+			total, hit, reval, miss);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	if (total > 0) {
+		res = fetch_about_ssenddataf(ctx,
+				" (%"PRId64"%%/%"PRId64"%%/%"PRId64"%%)"
+				"<img width=200 height=100 src=\"about:chart?"
+				"type=pie&width=200&height=100"
+				"&labels=hit,revalidate,miss"
+				"&values=%"PRId64",%"PRId64",%"PRId64"\" />",
+				(hit * 100) / total,
+				(reval * 100) / total,
+				(miss * 100) / total,
+				hit, reval, miss);
+		if (res != NSERROR_OK) {
+			return res;
+		}
+	}
+
+	return fetch_about_ssenddataf(ctx, "</p>\n");
+}
+
+
+/**
+ * output the backing store section
+ */
+static nserror perf_store_section(struct fetch_about_context *ctx)
+{
+	int64_t written, write_ms, read, read_ms;
+
+	written = perf_metric_value("llcache.store.written");
+	write_ms = perf_metric_value("llcache.store.write_ms");
+	read = perf_metric_value("llcache.store.read");
+	read_ms = perf_metric_value("llcache.store.read_ms");
+
+	return fetch_about_ssenddataf(ctx,
+			"<h2 class=\"ns-border\">Backing store</h2>\n"
+			"<p>Wrote %"PRId64" bytes in %"PRId64"ms "
+			"(%"PRId64" bytes/second)</p>\n"
+			"<p>Read %"PRId64" bytes in %"PRId64"ms "
+			"(%"PRId64" bytes/second)</p>\n",
+			written, write_ms, perf_bandwidth(written, write_ms),
+			read, read_ms, perf_bandwidth(read, read_ms));
+}
+
+
+/**
+ * output the timing section
+ */
+static nserror perf_timing_section(struct fetch_about_context *ctx)
+{
+	const char *render_names[] = { "html.layout", "html.redraw" };
+	const char *render_labels[] = { "layout", "redraw" };
+	const char *js_names[] = { "js.exec" };
+	const char *js_labels[] = { "javascript" };
+	nserror res;
+
+	res = fetch_about_ssenddataf(ctx,
+			"<h2 class=\"ns-border\">Layout and redraw (ms)</h2>\n"
+			"<p>");
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	res = perf_history_chart(ctx, render_names, render_labels, 2);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	res = fetch_about_ssenddataf(ctx,
+			"</p>\n"
+			"<h2 class=\"ns-border\">JavaScript (ms)</h2>\n"
+			"<p>");
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	res = perf_history_chart(ctx, js_names, js_labels, 1);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	return fetch_about_ssenddataf(ctx, "</p>\n");
+}
+
+
+/**
+ * output a table of every metric
+ */
+static nserror perf_metric_section(struct fetch_about_context *ctx)
+{
+	struct perf_table_ctx tctx = { ctx, 0 };
+	nserror res;
+
+	res = fetch_about_ssenddataf(ctx,
+			"<h2 class=\"ns-border\">All metrics</h2>\n"
+			"<table class=\"config\">\n"
+			"<tr><th>Metric</th>"
+			"<th>Label</th>"
+			"<th>Type</th>"
+			"<th>Value</th>"
+			"<th>Updates</th>"
+			"<th>Mean</th>"
+			"<th>Max</th></tr>\n");
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	res = nsmetric_enumerate(NULL, perf_metric_row_cb, &tctx);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	return fetch_about_ssenddataf(ctx, "</table>\n");
+}
+
+
+/* exported interface documented in about/perf.h */
+bool fetch_about_perf_handler(struct fetch_about_context *ctx)
+{
+	nserror res;
+
+	/* content is going to return ok */
+	fetch_about_set_http_code(ctx, 200);
+
+	/* content type */
+	if (fetch_about_send_header(ctx, "Content-Type: text/html"))
+		goto fetch_about_perf_handler_aborted;
+
+	/* page head */
+	res = fetch_about_ssenddataf(ctx,
+		"<html>\n<head>\n"
+		"<title>Performance</title>\n"
+		"<link rel=\"stylesheet\" type=\"text/css\" "
+		"href=\"resource:internal.css\">\n"
+		"</head>\n"
+		"<body id =\"perf\" class=\"ns-even-bg ns-even-fg ns-border\">\n"
+		"<h1 class=\"ns-border\">Performance</h1>\n");
+	if (res != NSERROR_OK) {
+		goto fetch_about_perf_handler_aborted;
+	}
+
+	res = perf_fetch_section(ctx);
+	if (res != NSERROR_OK) {
+		goto fetch_about_perf_handler_aborted;
+	}
+
+	res = perf_llcache_section(ctx);
+	if (res != NSERROR_OK) {
+		goto fetch_about_perf_handler_aborted;
+	}
+
+	res = perf_store_section(ctx);
+	if (res != NSERROR_OK) {
+		goto fetch_about_perf_handler_aborted;
+	}
+
+	res = perf_timing_section(ctx);
+	if (res != NSERROR_OK) {
+		goto fetch_about_perf_handler_aborted;
+	}
+
+	res = perf_metric_section(ctx);
+	if (res != NSERROR_OK) {
+		goto fetch_about_perf_handler_aborted;
+	}
+
+	res = fetch_about_ssenddataf(ctx, "</body>\n</html>\n");
+	if (res != NSERROR_OK) {
+		goto fetch_about_perf_handler_aborted;
+	}
+
+	fetch_about_send_finished(ctx);
+
+	return true;
+
+fetch_about_perf_handler_aborted:
+	return false;
+}
@@ -44,6 +44,7 @@
 
 #include "utils/corestrings.h"
 #include "utils/hashmap.h"
+#include "utils/metrics.h"
 #include "utils/nsoption.h"
 #include "utils/log.h"
 #include "utils/messages.h"
@@ -66,6 +67,34 @@
  */
 #define UPDATES_PER_SECOND 2
 
+/**
+ * maximum number of speculative connections
+ */
+#define PRECONNECT_MAX 8
+
+/**
+ * maximum number of speculative connections to an origin
+ */
+#define PRECONNECT_PER_ORIGIN 1
+
+/**
+ * time in ms a speculative connection is kept for
+ */
+#define PRECONNECT_IDLE 10000
+
+/**
+ * time in ms between polls while speculative connections are made
+ */
+#define PRECONNECT_POLL 10
+
+/* feature bits absent from older cURL headers */
+#ifndef CURL_VERSION_BROTLI
+#define CURL_VERSION_BROTLI 0
+#endif
+#ifndef CURL_VERSION_ZSTD
+#define CURL_VERSION_ZSTD 0
+#endif
+
 /**
  * The ciphersuites the browser is prepared to use
  */
@@ -250,9 +279,41 @@ struct cache_handle {
 	struct cache_handle *r_next; /**< Next cached handle in ring. */
 };
 
+/** State of a speculative connection */
+enum curl_preconnect_state {
+	PRECONNECT_PENDING, /**< waiting to be added to the multi handle */
+	PRECONNECT_CONNECTING, /**< connection being made */
+	PRECONNECT_CONNECTED, /**< connection made and idle */
+};
+
+/** Speculative connection */
+struct curl_preconnect {
+	CURL *handle; /**< The cURL handle making the connection */
+	lwc_string *origin; /**< The scheme, host and port connected to */
+	enum curl_preconnect_state state; /**< connection state */
+	uint64_t expires; /**< time (ms) the connection is discarded */
+
+	struct curl_preconnect *next; /**< Next speculative connection */
+};
+
 /** Global cURL multi handle. */
 CURLM *fetch_curl_multi;
 
+/** Share handle for name resolution and TLS session caches */
+static CURLSH *fetch_curl_share;
+
+/** List of speculative connections */
+static struct curl_preconnect *curl_preconnect_list = NULL;
+
+/** speculative connections made */
+static struct nsmetric *curl_preconnect_metric = NULL;
+
+/** connections made for fetches */
+static struct nsmetric *curl_connect_metric = NULL;
+
+/** fetches made over an existing connection */
+static struct nsmetric *curl_reuse_metric = NULL;
+
 /** Curl handle with default options set; not used for transfers. */
 static CURL *fetch_blank_curl;
 
@@ -274,6 +335,8 @@ static char fetch_proxy_userpwd[100];
 /** Interlock to prevent initiation during callbacks */
 static bool inside_curl = false;
 
+static void fetch_curl_preconnect_tick(void *p);
+
 
 /**
  * Initialise a cURL fetcher.
@@ -287,6 +350,24 @@ static bool fetch_curl_initialise(lwc_string *scheme)
 }
 
 
+/**
+ * Discard a speculative connection.
+ *
+ * The caller must have removed it from the list.
+ *
+ * \param pc The speculative connection to discard.
+ */
+static void fetch_curl_preconnect_free(struct curl_preconnect *pc)
+{
+	if (pc->state == PRECONNECT_CONNECTING) {
+		curl_multi_remove_handle(fetch_curl_multi, pc->handle);
+	}
+	curl_easy_cleanup(pc->handle);
+	lwc_string_unref(pc->origin);
+	free(pc);
+}
+
+
 /**
  * Finalise a cURL fetcher.
  *
@@ -305,6 +386,13 @@ static void fetch_curl_finalise(lwc_string *scheme)
 		NSLOG(netsurf, INFO,
 		      "All cURL fetchers finalised, closing down cURL");
 
+		guit->misc->schedule(-1, fetch_curl_preconnect_tick, NULL);
+		while (curl_preconnect_list != NULL) {
+			struct curl_preconnect *pc = curl_preconnect_list;
+			curl_preconnect_list = pc->next;
+			fetch_curl_preconnect_free(pc);
+		}
+
 		curl_easy_cleanup(fetch_blank_curl);
 
 		codem = curl_multi_cleanup(fetch_curl_multi);
@@ -312,6 +400,10 @@ static void fetch_curl_finalise(lwc_string *scheme)
 			NSLOG(netsurf, INFO,
 			      "curl_multi_cleanup failed: ignoring");
 
+		if (curl_share_cleanup(fetch_curl_share) != CURLSHE_OK)
+			NSLOG(netsurf, INFO,
+			      "curl_share_cleanup failed: ignoring");
+
 		curl_global_cleanup();
 
 		NSLOG(netsurf, DEBUG, "Cleaning up SSL cert chain hashmap");
@@ -1027,6 +1119,75 @@ static CURL *fetch_curl_get_handle(lwc_string *host)
 }
 
 
+/**
+ * Get the origin a URL is fetched from.
+ *
+ * Connections are only shared between URLs with the same scheme, host
+ * and port.
+ *
+ * \param url The URL.
+ * \param origin Updated with the interned origin of the URL.
+ * \return NSERROR_OK on success else appropriate error code.
+ */
+static nserror fetch_curl_origin(const struct nsurl *url, lwc_string **origin)
+{
+	char *str;
+	size_t len;
+	nserror res;
+
+	res = nsurl_get(url, NSURL_SCHEME | NSURL_HOST | NSURL_PORT, &str, &len);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	if (lwc_intern_string(str, len, origin) != lwc_error_ok) {
+		res = NSERROR_NOMEM;
+	}
+	free(str);
+
+	return res;
+}
+
+
+/**
+ * Discard the idle speculative connections to an origin.
+ *
+ * cURL does not reuse a connect only connection for transfers so once a
+ * real fetch is made the speculative connection has served its purpose
+ * of warming the name resolution and TLS session caches and only holds
+ * a connection slot for the host.
+ *
+ * \param url The URL a fetch is being started for.
+ */
+static void fetch_curl_preconnect_release(const struct nsurl *url)
+{
+	struct curl_preconnect **link = &curl_preconnect_list;
+	struct curl_preconnect *pc;
+	lwc_string *origin;
+	bool match;
+
+	if ((curl_preconnect_list == NULL) ||
+	    (fetch_curl_origin(url, &origin) != NSERROR_OK)) {
+		return;
+	}
+
+	while ((pc = *link) != NULL) {
+		if ((pc->state == PRECONNECT_CONNECTED) &&
+		    (lwc_string_isequal(pc->origin,
+					origin,
+					&match) == lwc_error_ok) &&
+		    match) {
+			*link = pc->next;
+			fetch_curl_preconnect_free(pc);
+		} else {
+			link = &pc->next;
+		}
+	}
+
+	lwc_string_unref(origin);
+}
+
+
 /**
  * Dispatch a single job
  */
@@ -1037,6 +1198,7 @@ static bool fetch_curl_start(void *vfetch)
 		NSLOG(netsurf, DEBUG, "Deferring fetch because we're inside cURL");
 		return false;
 	}
+	fetch_curl_preconnect_release(fetch->url);
 	return fetch_curl_initiate_fetch(fetch,
 			fetch_curl_get_handle(fetch->host));
 }
@@ -1092,6 +1254,36 @@ static void fetch_curl_cache_handle(CURL *handle, lwc_string *host)
 }
 
 
+/**
+ * Report the body bytes received over the network for a fetch.
+ *
+ * Must be called before the cURL handle is released.
+ *
+ * \param f The fetch which has completed.
+ */
+static void fetch_curl_report_transferred(struct curl_fetch_info *f)
+{
+#if LIBCURL_VERSION_NUM >= 0x073700
+	/* 7.55.0 or later reports sizes as curl_off_t */
+	curl_off_t size;
+
+	if ((curl_easy_getinfo(f->curl_handle,
+			       CURLINFO_SIZE_DOWNLOAD_T,
+			       &size) == CURLE_OK) && (size > 0)) {
+		fetch_set_transferred(f->fetch_handle, size);
+	}
+#else
+	double size;
+
+	if ((curl_easy_getinfo(f->curl_handle,
+			       CURLINFO_SIZE_DOWNLOAD,
+			       &size) == CURLE_OK) && (size > 0)) {
+		fetch_set_transferred(f->fetch_handle, size);
+	}
+#endif
+}
+
+
 /**
  * Clean up the provided fetch object and free it.
  *
@@ -1177,6 +1369,27 @@ static void fetch_curl_free(void *vf)
 }
 
 
+/**
+ * Account for the connection a fetch was made over.
+ *
+ * \param f The fetch which has received its headers.
+ */
+static void fetch_curl_account_connection(struct curl_fetch_info *f)
+{
+	long connects;
+
+	if (curl_easy_getinfo(f->curl_handle,
+			      CURLINFO_NUM_CONNECTS,
+			      &connects) == CURLE_OK) {
+		if (connects == 0) {
+			nsmetric_add(curl_reuse_metric, 1);
+		} else {
+			nsmetric_add(curl_connect_metric, connects);
+		}
+	}
+}
+
+
 /**
  * Find the status code and content type and inform the caller.
  *
@@ -1197,6 +1410,7 @@ static bool fetch_curl_process_headers(struct curl_fetch_info *f)
 		assert(code == CURLE_OK);
 	}
 	http_code = f->http_code;
+	fetch_curl_account_connection(f);
 	NSLOG(netsurf, INFO, "HTTP status code %li", http_code);
 
 	if (http_code == 304 && !f->post_urlenc && !f->post_multipart) {
@@ -1308,6 +1522,10 @@ static void fetch_curl_done(CURL *curl_handle, CURLcode result)
 		error = true;
 	}
 
+	if (finished) {
+		fetch_curl_report_transferred(f);
+	}
+
 	fetch_curl_stop(f);
 
 	if (f->sent_ssl_chain == false) {
@@ -1349,6 +1567,49 @@ static void fetch_curl_done(CURL *curl_handle, CURLcode result)
 }
 
 
+/**
+ * Handle a completed speculative connection.
+ *
+ * \param curl_handle curl easy handle which completed
+ * \param result The result code of the connection.
+ * \return true if the handle was a speculative connection else false.
+ */
+static bool fetch_curl_preconnect_done(CURL *curl_handle, CURLcode result)
+{
+	struct curl_preconnect **link = &curl_preconnect_list;
+	struct curl_preconnect *pc;
+	uint64_t now;
+
+	while (((pc = *link) != NULL) && (pc->handle != curl_handle)) {
+		link = &pc->next;
+	}
+	if (pc == NULL) {
+		return false;
+	}
+
+	if (result != CURLE_OK) {
+		NSLOG(netsurf, DEBUG, "preconnect to %s failed: %s",
+		      lwc_string_data(pc->origin), curl_easy_strerror(result));
+		*link = pc->next;
+		fetch_curl_preconnect_free(pc);
+		return true;
+	}
+
+	curl_multi_remove_handle(fetch_curl_multi, curl_handle);
+
+	NSLOG(netsurf, DEBUG, "preconnected to %s", lwc_string_data(pc->origin));
+
+	/* the handle keeps the connection until it expires */
+	nsu_getmonotonic_ms(&now);
+	pc->state = PRECONNECT_CONNECTED;
+	pc->expires = now + PRECONNECT_IDLE;
+
+	nsmetric_add(curl_preconnect_metric, 1);
+
+	return true;
+}
+
+
 /**
  * Do some work on current fetches.
  *
@@ -1407,6 +1668,7 @@ static void fetch_curl_poll(lwc_string *scheme_ignored)
 			NSLOG(netsurf, WARNING,
 			      "curl_multi_perform: %i %s",
 			      codem, curl_multi_strerror(codem));
+			inside_curl = false;
 			return;
 		}
 	} while (codem == CURLM_CALL_MULTI_PERFORM);
@@ -1416,6 +1678,11 @@ static void fetch_curl_poll(lwc_string *scheme_ignored)
 	while (curl_msg) {
 		switch (curl_msg->msg) {
 			case CURLMSG_DONE:
+				if (fetch_curl_preconnect_done(
+					    curl_msg->easy_handle,
+					    curl_msg->data.result)) {
+					break;
+				}
 				fetch_curl_done(curl_msg->easy_handle,
 						curl_msg->data.result);
 				break;
@@ -1428,6 +1695,175 @@ static void fetch_curl_poll(lwc_string *scheme_ignored)
 }
 
 
+/**
+ * Make progress on speculative connections and discard expired ones.
+ *
+ * Speculative connections are made while no fetches may be active so
+ * they are polled from their own schedule.
+ *
+ * \param p unused
+ */
+static void fetch_curl_preconnect_tick(void *p)
+{
+	struct curl_preconnect **link = &curl_preconnect_list;
+	struct curl_preconnect *pc;
+	uint64_t now;
+	uint64_t next = UINT64_MAX;
+	bool connecting = false;
+	CURLMcode codem;
+
+	nsu_getmonotonic_ms(&now);
+
+	/* start pending connections */
+	for (pc = curl_preconnect_list; pc != NULL; pc = pc->next) {
+		if (pc->state == PRECONNECT_PENDING) {
+			codem = curl_multi_add_handle(fetch_curl_multi,
+						      pc->handle);
+			if (codem != CURLM_OK) {
+				/* leave it to expire */
+				pc->expires = now;
+				continue;
+			}
+			pc->state = PRECONNECT_CONNECTING;
+		}
+		if (pc->state == PRECONNECT_CONNECTING) {
+			connecting = true;
+		}
+	}
+
+	if (connecting) {
+		fetch_curl_poll(NULL);
+		connecting = false;
+	}
+
+	/* discard expired connections */
+	while ((pc = *link) != NULL) {
+		if (pc->expires <= now) {
+			*link = pc->next;
+			fetch_curl_preconnect_free(pc);
+			continue;
+		}
+		if (pc->state == PRECONNECT_CONNECTING) {
+			connecting = true;
+		}
+		if (pc->expires < next) {
+			next = pc->expires;
+		}
+		link = &pc->next;
+	}
+
+	if (connecting) {
+		guit->misc->schedule(PRECONNECT_POLL,
+				     fetch_curl_preconnect_tick, NULL);
+	} else if (next != UINT64_MAX) {
+		guit->misc->schedule(next - now,
+				     fetch_curl_preconnect_tick, NULL);
+	}
+}
+
+
+/**
+ * Speculatively connect to the server of a URL.
+ *
+ * A connect only handle performs name resolution and the TCP and TLS
+ * handshakes. The resolved address and TLS session are kept in the
+ * caches shared by every handle so the fetch which follows skips them.
+ *
+ * \param url The URL which may be fetched.
+ * \return NSERROR_OK or appropriate error code.
+ */
+static nserror fetch_curl_preconnect(const struct nsurl *url)
+{
+	struct curl_preconnect *pc;
+	lwc_string *origin;
+	unsigned int total = 0;
+	unsigned int count = 0;
+	uint64_t now;
+	bool match;
+	CURLcode code;
+	nserror res;
+
+	if (nsoption_bool(http_proxy)) {
+		/* connections are made to the proxy */
+		return NSERROR_OK;
+	}
+
+	res = fetch_curl_origin(url, &origin);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	for (pc = curl_preconnect_list; pc != NULL; pc = pc->next) {
+		total++;
+		if ((lwc_string_isequal(pc->origin,
+					origin,
+					&match) == lwc_error_ok) &&
+		    match) {
+			count++;
+		}
+	}
+	if ((total >= PRECONNECT_MAX) || (count >= PRECONNECT_PER_ORIGIN)) {
+		lwc_string_unref(origin);
+		return NSERROR_OK;
+	}
+
+	pc = calloc(1, sizeof(*pc));
+	if (pc == NULL) {
+		lwc_string_unref(origin);
+		return NSERROR_NOMEM;
+	}
+
+	pc->handle = curl_easy_duphandle(fetch_blank_curl);
+	if (pc->handle == NULL) {
+		lwc_string_unref(origin);
+		free(pc);
+		return NSERROR_NOMEM;
+	}
+
+#undef SETOPT
+#define SETOPT(option, value) { \
+	code = curl_easy_setopt(pc->handle, option, value);	\
+	if (code != CURLE_OK)					\
+		goto setopt_failed;				\
+	}
+
+	SETOPT(CURLOPT_URL, nsurl_access(url));
+	SETOPT(CURLOPT_CONNECT_ONLY, 1L);
+	SETOPT(CURLOPT_NOPROGRESS, 1L);
+	SETOPT(CURLOPT_SSL_SESSIONID_CACHE, 1L);
+
+#undef SETOPT
+
+	if (curl_preconnect_metric == NULL) {
+		nsmetric_register("fetch.curl.preconnects",
+				  NSMETRIC_COUNTER,
+				  &curl_preconnect_metric);
+	}
+
+	NSLOG(netsurf, DEBUG, "preconnecting to %s", lwc_string_data(origin));
+
+	/* the handle is added to the multi handle from the schedule as
+	 * this may be called from within a cURL callback
+	 */
+	nsu_getmonotonic_ms(&now);
+	pc->origin = origin;
+	pc->state = PRECONNECT_PENDING;
+	pc->expires = now + PRECONNECT_IDLE;
+	pc->next = curl_preconnect_list;
+	curl_preconnect_list = pc;
+
+	guit->misc->schedule(0, fetch_curl_preconnect_tick, NULL);
+
+	return NSERROR_OK;
+
+setopt_failed:
+	curl_easy_cleanup(pc->handle);
+	lwc_string_unref(origin);
+	free(pc);
+	return NSERROR_INIT_FAILED;
+}
+
+
 
 
 /**
@@ -1672,6 +2108,7 @@ nserror fetch_curl_register(void)
 		.free = fetch_curl_free,
 		.poll = fetch_curl_poll,
 		.fdset = fetch_curl_fdset,
+		.preconnect = fetch_curl_preconnect,
 		.finalise = fetch_curl_finalise
 	};
 
@@ -1720,6 +2157,18 @@ nserror fetch_curl_register(void)
 	}
 #endif
 
+	/* Share name resolution and TLS sessions between all handles so
+	 *  speculative connections warm them for the fetches which follow.
+	 */
+	fetch_curl_share = curl_share_init();
+	if (fetch_curl_share == NULL) {
+		NSLOG(netsurf, INFO, "curl_share_init failed.");
+		return NSERROR_INIT_FAILED;
+	}
+	curl_share_setopt(fetch_curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(fetch_curl_share, CURLSHOPT_SHARE,
+			  CURL_LOCK_DATA_SSL_SESSION);
+
 	/* Create a curl easy handle with the options that are common to all
 	 *  fetches.
 	 */
@@ -1736,6 +2185,7 @@ nserror fetch_curl_register(void)
 		goto curl_easy_setopt_failed;
 
 	SETOPT(CURLOPT_ERRORBUFFER, fetch_error_buffer);
+	SETOPT(CURLOPT_SHARE, fetch_curl_share);
 	SETOPT(CURLOPT_DEBUGFUNCTION, fetch_curl_debug);
 	if (nsoption_bool(suppress_curl_debug)) {
 		SETOPT(CURLOPT_VERBOSE, 0);
@@ -1751,7 +2201,14 @@ nserror fetch_curl_register(void)
 	SETOPT(CURLOPT_PROGRESSFUNCTION, fetch_curl_progress);
 	SETOPT(CURLOPT_NOPROGRESS, 0);
 	SETOPT(CURLOPT_USERAGENT, user_agent_string());
-	SETOPT(CURLOPT_ENCODING, "gzip");
+	/* body data is decoded by cURL as it arrives and passed on
+	 *  immediately; an empty list offers every supported encoding
+	 */
+	if (nsoption_charp(accept_encoding) != NULL) {
+		SETOPT(CURLOPT_ACCEPT_ENCODING, nsoption_charp(accept_encoding));
+	} else {
+		SETOPT(CURLOPT_ACCEPT_ENCODING, "");
+	}
 	SETOPT(CURLOPT_LOW_SPEED_LIMIT, 1L);
 	SETOPT(CURLOPT_LOW_SPEED_TIME, 180L);
 	SETOPT(CURLOPT_NOSIGNAL, 1L);
@@ -1795,6 +2252,18 @@ nserror fetch_curl_register(void)
 
 	data = curl_version_info(CURLVERSION_NOW);
 
+	NSLOG(netsurf, INFO, "cURL content encodings:%s%s%s",
+	      (data->features & CURL_VERSION_LIBZ) ? " gzip deflate" : "",
+	      (data->features & CURL_VERSION_BROTLI) ? " br" : "",
+	      (data->features & CURL_VERSION_ZSTD) ? " zstd" : "");
+
+	nsmetric_register("fetch.curl.connections",
+			  NSMETRIC_COUNTER,
+			  &curl_connect_metric);
+	nsmetric_register("fetch.curl.reused",
+			  NSMETRIC_COUNTER,
+			  &curl_reuse_metric);
+
 	curl_fetch_ssl_hashmap = hashmap_create(&curl_fetch_ssl_hashmap_parameters);
 	if (curl_fetch_ssl_hashmap == NULL) {
 		NSLOG(netsurf, CRITICAL, "Unable to initialise SSL certificate hashmap");
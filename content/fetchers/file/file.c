@@ -268,6 +268,16 @@ fetch_file_process_error_aborted:
 }
 
 
+#ifdef HAVE_MMAP
+/**
+ * Release a mapped file buffer adopted by the fetch recipient.
+ */
+static void fetch_file_release_mapping(const uint8_t *buf, size_t len, void *pw)
+{
+	munmap((void *)buf, len);
+}
+#endif
+
 /** Process object as a regular file */
 static void fetch_file_process_plain(struct fetch_file_context *ctx,
 				     struct stat *fdstat)
@@ -300,7 +310,7 @@ static void fetch_file_process_plain(struct fetch_file_context *ctx,
 
 	/* allocate the buffer storage */
 	if (buf_size > 0) {
-		buf = mmap(NULL, buf_size, PROT_READ, MAP_SHARED, fd, 0);
+		buf = mmap(NULL, buf_size, PROT_READ, MAP_PRIVATE, fd, 0);
 		if (buf == MAP_FAILED) {
 			msg.type = FETCH_ERROR;
 			msg.data.error = "Unable to map memory for file data buffer";
@@ -336,10 +346,31 @@ static void fetch_file_process_plain(struct fetch_file_context *ctx,
 		goto fetch_file_process_aborted;
 	}
 
-	msg.type = FETCH_DATA;
-	msg.data.header_or_data.buf = (const uint8_t *) buf;
-	msg.data.header_or_data.len = buf_size;
-	fetch_file_send_callback(&msg, ctx);
+	/* the mapping is only handed to the recipient, which releases
+	 * it once the data is no longer required, for files with no
+	 * write permission bits set. The data of any other file is
+	 * copied as before.
+	 *
+	 * This is a heuristic and not a guarantee: the owner (or root)
+	 * may still change the permissions and truncate a read-only
+	 * file while the mapping is held, after which reading the
+	 * cached data raises SIGBUS.
+	 */
+	if (buf != NULL) {
+		if ((fdstat->st_mode & (S_IWUSR | S_IWGRP | S_IWOTH)) == 0) {
+			msg.type = FETCH_DATA_ADOPT;
+			msg.data.adopt.buf = (const uint8_t *) buf;
+			msg.data.adopt.len = buf_size;
+			msg.data.adopt.release = fetch_file_release_mapping;
+			msg.data.adopt.pw = NULL;
+			buf = NULL;
+		} else {
+			msg.type = FETCH_DATA;
+			msg.data.header_or_data.buf = (const uint8_t *) buf;
+			msg.data.header_or_data.len = buf_size;
+		}
+		fetch_file_send_callback(&msg, ctx);
+	}
 
 	if (ctx->aborted == false) {
 		msg.type = FETCH_FINISHED;
@@ -41,6 +41,7 @@
 #include <errno.h>
 #include <time.h>
 #include <stdlib.h>
+#include <zlib.h>
 #include <nsutils/unistd.h>
 
 #include "netsurf/inttypes.h"
@@ -50,13 +51,14 @@
 #include "utils/log.h"
 #include "utils/messages.h"
 #include "utils/hashmap.h"
+#include "utils/metrics.h"
 #include "desktop/gui_internal.h"
 #include "netsurf/misc.h"
 
 #include "content/backing_store.h"
 
 /** Backing store file format version */
-#define CONTROL_VERSION 202
+#define CONTROL_VERSION 204
 
 /**
  * Number of milliseconds after a update before control data
@@ -88,6 +90,15 @@
 /** length in bytes of a block files use map */
 #define BLOCK_USE_MAP_SIZE (1 << (BLOCK_ENTRY_COUNT - 3))
 
+/** minimum length of data worth compressing */
+#define COMPRESS_MIN_SIZE 256
+
+/**
+ * log2 of the fraction of its length compressed data must save to be
+ * stored compressed (1/8)
+ */
+#define COMPRESS_MIN_SAVING 3
+
 /**
  * The type used to store index values referring to store entries. Care
  * must be taken with this type as it is used to build address to
@@ -133,6 +144,8 @@ enum store_entry_elem_flags {
 	ENTRY_ELEM_FLAG_MMAP = 0x2,
 	/** entry data allocation is in small object pool */
 	ENTRY_ELEM_FLAG_SMALL = 0x4,
+	/** entry data is stored deflate compressed */
+	ENTRY_ELEM_FLAG_COMPRESSED = 0x8,
 };
 
 
@@ -149,7 +162,7 @@ enum store_entry_flags {
  * An element keeps data about:
  *  - the current memory allocation
  *  - the number of outstanding references to the memory
- *  - the size of the element data
+ *  - the size of the element data on disc and in memory
  *  - flags controlling how the memory and element are handled
  *
  * @note Order is important to avoid excessive structure packing overhead.
@@ -157,6 +170,7 @@ enum store_entry_flags {
 struct store_entry_element {
 	uint8_t* data; /**< data allocated */
 	uint32_t size; /**< size of entry element on disc */
+	uint32_t len; /**< length of entry element data */
 	block_index_t block; /**< small object data block */
 	uint8_t ref; /**< element data reference count */
 	uint8_t flags; /**< entry flags */
@@ -231,6 +245,9 @@ struct store_state {
 	 */
 	bool blocks_opened;
 
+	/** compress element data likely to benefit */
+	bool compress;
+
 
 	/* stats */
 	uint64_t total_alloc; /**< total size of all allocated storage. */
@@ -239,6 +256,9 @@ struct store_state {
 	uint64_t hit_size; /**< size of storage served */
 	size_t miss_count; /**< number of cache misses */
 
+	uint64_t compress_in; /**< length of data stored compressed */
+	uint64_t compress_out; /**< size of compressed data stored */
+	size_t compress_raw; /**< compressible elements stored raw */
 };
 
 /**
@@ -249,6 +269,12 @@ struct store_state {
  */
 struct store_state *storestate;
 
+/** length of data stored compressed */
+static struct nsmetric *store_compress_in_metric = NULL;
+
+/** size of compressed data stored */
+static struct nsmetric *store_compress_out_metric = NULL;
+
 /* Entries hashmap parameters
  *
  * Our hashmap has nsurl keys and store_entry values
@@ -513,24 +539,25 @@ static int compar(const void *va, const void *vb)
 {
 	const struct store_entry *a = *(const struct store_entry **)va;
 	const struct store_entry *b = *(const struct store_entry **)vb;
+	const unsigned int alloc = ENTRY_ELEM_FLAG_HEAP | ENTRY_ELEM_FLAG_MMAP;
 
 	/* consider the allocation flags - if an entry has an
 	 * allocation it is considered more valuable as it cannot be
 	 * freed.
 	 */
-	if ((a->elem[ENTRY_ELEM_DATA].flags == ENTRY_ELEM_FLAG_NONE) &&
-	    (b->elem[ENTRY_ELEM_DATA].flags != ENTRY_ELEM_FLAG_NONE)) {
+	if (((a->elem[ENTRY_ELEM_DATA].flags & alloc) == 0) &&
+	    ((b->elem[ENTRY_ELEM_DATA].flags & alloc) != 0)) {
 		return -1;
-	} else if ((a->elem[ENTRY_ELEM_DATA].flags != ENTRY_ELEM_FLAG_NONE) &&
-		   (b->elem[ENTRY_ELEM_DATA].flags == ENTRY_ELEM_FLAG_NONE)) {
+	} else if (((a->elem[ENTRY_ELEM_DATA].flags & alloc) != 0) &&
+		   ((b->elem[ENTRY_ELEM_DATA].flags & alloc) == 0)) {
 		return 1;
 	}
 
-	if ((a->elem[ENTRY_ELEM_META].flags == ENTRY_ELEM_FLAG_NONE) &&
-	    (b->elem[ENTRY_ELEM_META].flags != ENTRY_ELEM_FLAG_NONE)) {
+	if (((a->elem[ENTRY_ELEM_META].flags & alloc) == 0) &&
+	    ((b->elem[ENTRY_ELEM_META].flags & alloc) != 0)) {
 		return -1;
-	} else if ((a->elem[ENTRY_ELEM_META].flags != ENTRY_ELEM_FLAG_NONE) &&
-		   (b->elem[ENTRY_ELEM_META].flags == ENTRY_ELEM_FLAG_NONE)) {
+	} else if (((a->elem[ENTRY_ELEM_META].flags & alloc) != 0) &&
+		   ((b->elem[ENTRY_ELEM_META].flags & alloc) == 0)) {
 		return 1;
 	}
 
@@ -975,6 +1002,7 @@ static block_index_t alloc_block(struct store_state *state, int elem_idx)
  * @param elem_idx The index of the entry element to use.
  * @param data The data to store
  * @param datalen The length of data in \a data
+ * @param disclen The size of the compressed data or 0 if uncompressed.
  * @param bse Pointer used to return value.
  * @return NSERROR_OK and \a bse updated on success or NSERROR_NOT_FOUND
  *         if no entry corresponds to the url.
@@ -985,6 +1013,7 @@ set_store_entry(struct store_state *state,
 		int elem_idx,
 		uint8_t *data,
 		const size_t datalen,
+		const size_t disclen,
 		struct store_entry **bse)
 {
 	struct store_entry *se;
@@ -1033,7 +1062,14 @@ set_store_entry(struct store_state *state,
 
 	/* account for size of entry element */
 	state->total_alloc -= elem->size;
-	elem->size = datalen;
+	elem->len = datalen;
+	if (disclen != 0) {
+		elem->flags |= ENTRY_ELEM_FLAG_COMPRESSED;
+		elem->size = disclen;
+	} else {
+		elem->flags &= ~ENTRY_ELEM_FLAG_COMPRESSED;
+		elem->size = datalen;
+	}
 	state->total_alloc += elem->size;
 
 	/* if the element will fit in a small block attempt to allocate one */
@@ -1454,6 +1490,16 @@ initialise(const struct llcache_store_parameters *parameters)
 	newstate->path = strdup(parameters->path);
 	newstate->limit = parameters->limit;
 	newstate->hysteresis = parameters->hysteresis;
+	newstate->compress = parameters->compress;
+
+	if (store_compress_in_metric == NULL) {
+		nsmetric_register("fs_store.compress.in",
+				  NSMETRIC_COUNTER,
+				  &store_compress_in_metric);
+		nsmetric_register("fs_store.compress.out",
+				  NSMETRIC_COUNTER,
+				  &store_compress_out_metric);
+	}
 
 	/* read store control and create new if required */
 	ret = read_control(newstate);
@@ -1566,6 +1612,15 @@ finalise(void)
 			      0);
 		}
 
+		if (storestate->compress_in > 0) {
+			NSLOG(netsurf, INFO,
+			      "Cache compressed %"PRIu64" bytes to %"PRIu64" (%"PRIu64"%%), %"PRIsizet" elements stored raw",
+			      storestate->compress_in,
+			      storestate->compress_out,
+			      (storestate->compress_out * 100) / storestate->compress_in,
+			      storestate->compress_raw);
+		}
+
 		hashmap_destroy(storestate->entries);
 		free(storestate->path);
 		free(storestate);
@@ -1581,11 +1636,13 @@ finalise(void)
  * \param state The backing store state to use.
  * \param bse The entry to store
  * \param elem_idx The element index within the entry.
+ * \param data The element data as stored on disc.
  * \return NSERROR_OK on success or error code.
  */
 static nserror store_write_block(struct store_state *state,
 			 struct store_entry *bse,
-			 int elem_idx)
+			 int elem_idx,
+			 const uint8_t *data)
 {
 	block_index_t bf = (bse->elem[elem_idx].block >> BLOCK_ENTRY_COUNT) &
 		((1 << BLOCK_FILE_COUNT) - 1); /* block file block resides in */
@@ -1609,7 +1666,7 @@ static nserror store_write_block(struct store_state *state,
 	offst = (unsigned int)bi << log2_block_size[elem_idx];
 
 	wr = nsu_pwrite(state->blocks[elem_idx][bf].fd,
-			bse->elem[elem_idx].data,
+			data,
 			bse->elem[elem_idx].size,
 			offst);
 	if (wr != (ssize_t)bse->elem[elem_idx].size) {
@@ -1617,7 +1674,7 @@ static nserror store_write_block(struct store_state *state,
 		      "Write failed %"PRIssizet" of %d bytes from %p at %"PRIsizet" block %d errno %d",
 		      wr,
 		      bse->elem[elem_idx].size,
-		      bse->elem[elem_idx].data,
+		      data,
 		      (size_t)offst,
 		      bse->elem[elem_idx].block,
 		      errno);
@@ -1626,7 +1683,7 @@ static nserror store_write_block(struct store_state *state,
 
 	NSLOG(netsurf, INFO,
 	      "Wrote %"PRIssizet" bytes from %p at %"PRIsizet" block %d", wr,
-	      bse->elem[elem_idx].data, (size_t)offst,
+	      data, (size_t)offst,
 	      bse->elem[elem_idx].block);
 
 	return NSERROR_OK;
@@ -1638,11 +1695,13 @@ static nserror store_write_block(struct store_state *state,
  * \param state The backing store state to use.
  * \param bse The entry to store
  * \param elem_idx The element index within the entry.
+ * \param data The element data as stored on disc.
  * \return NSERROR_OK on success or error code.
  */
 static nserror store_write_file(struct store_state *state,
 			 struct store_entry *bse,
-			 int elem_idx)
+			 int elem_idx,
+			 const uint8_t *data)
 {
 	ssize_t wr;
 	int fd;
@@ -1655,7 +1714,7 @@ static nserror store_write_file(struct store_state *state,
 		return NSERROR_SAVE_FAILED;
 	}
 
-	wr = write(fd, bse->elem[elem_idx].data, bse->elem[elem_idx].size);
+	wr = write(fd, data, bse->elem[elem_idx].size);
 	err = errno; /* close can change errno */
 
 	close(fd);
@@ -1664,7 +1723,7 @@ static nserror store_write_file(struct store_state *state,
 		      "Write failed %"PRIssizet" of %d bytes from %p errno %d",
 		      wr,
 		      bse->elem[elem_idx].size,
-		      bse->elem[elem_idx].data,
+		      data,
 		      err);
 
 		/** @todo Delete the file? */
@@ -1672,11 +1731,60 @@ static nserror store_write_file(struct store_state *state,
 	}
 
 	NSLOG(netsurf, VERBOSE, "Wrote %"PRIssizet" bytes from %p", wr,
-	      bse->elem[elem_idx].data);
+	      data);
 
 	return NSERROR_OK;
 }
 
+/**
+ * Compress element data for storage.
+ *
+ * Data which does not compress usefully is stored raw.
+ *
+ * \param state The backing store state to use.
+ * \param data The data to compress.
+ * \param datalen The length of \a data.
+ * \param disclen_out The size of the compressed data.
+ * \return The compressed data on heap or NULL if it is to be stored raw.
+ */
+static uint8_t *
+store_compress(struct store_state *state,
+	       const uint8_t *data,
+	       const size_t datalen,
+	       size_t *disclen_out)
+{
+	uint8_t *cdata;
+	uLongf clen;
+
+	if (datalen < COMPRESS_MIN_SIZE) {
+		return NULL;
+	}
+
+	clen = compressBound(datalen);
+	cdata = malloc(clen);
+	if (cdata == NULL) {
+		return NULL;
+	}
+
+	if ((compress2(cdata, &clen, data, datalen,
+		       Z_DEFAULT_COMPRESSION) != Z_OK) ||
+	    (clen > (datalen - (datalen >> COMPRESS_MIN_SAVING)))) {
+		free(cdata);
+		state->compress_raw++;
+		return NULL;
+	}
+
+	state->compress_in += datalen;
+	state->compress_out += clen;
+	nsmetric_add(store_compress_in_metric, datalen);
+	nsmetric_add(store_compress_out_metric, clen);
+
+	NSLOG(netsurf, DEBUG, "compressed %"PRIsizet" to %lu", datalen, clen);
+
+	*disclen_out = clen;
+	return cdata;
+}
+
 /**
  * Place an object in the backing store.
  *
@@ -1697,6 +1805,8 @@ store(nsurl *url,
 	nserror ret;
 	struct store_entry *bse;
 	int elem_idx;
+	uint8_t *cdata = NULL; /* compressed data */
+	size_t disclen = 0;
 
 	/* check backing store is initialised */
 	if (storestate == NULL) {
@@ -1710,21 +1820,35 @@ store(nsurl *url,
 		elem_idx = ENTRY_ELEM_DATA;
 	}
 
+	/* compress before the entry is set up so the compressed size
+	 * determines if a small block is used.
+	 */
+	if (storestate->compress &&
+	    ((bsflags & BACKING_STORE_COMPRESSIBLE) != 0)) {
+		cdata = store_compress(storestate, data, datalen, &disclen);
+	}
+
 	/* set the store entry up */
-	ret = set_store_entry(storestate, url, elem_idx, data, datalen, &bse);
+	ret = set_store_entry(storestate, url, elem_idx,
+			      data, datalen, disclen, &bse);
 	if (ret != NSERROR_OK) {
 		NSLOG(netsurf, ERROR, "store entry setting failed");
+		free(cdata);
 		return ret;
 	}
 
 	if (bse->elem[elem_idx].block != 0) {
 		/* small block storage */
-		ret = store_write_block(storestate, bse, elem_idx);
+		ret = store_write_block(storestate, bse, elem_idx,
+					cdata != NULL ? cdata : data);
 	} else {
 		/* separate file in backing store */
-		ret = store_write_file(storestate, bse, elem_idx);
+		ret = store_write_file(storestate, bse, elem_idx,
+				       cdata != NULL ? cdata : data);
 	}
 
+	free(cdata);
+
 	return ret;
 }
 
@@ -1751,11 +1875,13 @@ static nserror entry_release_alloc(struct store_entry_element *elem)
  * \param state The backing store state to use.
  * \param bse The entry to read.
  * \param elem_idx The element index within the entry.
+ * \param data The buffer to read the element data as stored on disc into.
  * \return NSERROR_OK on success or error code.
  */
 static nserror store_read_block(struct store_state *state,
 			 struct store_entry *bse,
-			 int elem_idx)
+			 int elem_idx,
+			 uint8_t *data)
 {
 	block_index_t bf = (bse->elem[elem_idx].block >> BLOCK_ENTRY_COUNT) &
 		((1 << BLOCK_FILE_COUNT) - 1); /* block file block resides in */
@@ -1779,7 +1905,7 @@ static nserror store_read_block(struct store_state *state,
 	offst = (unsigned int)bi << log2_block_size[elem_idx];
 
 	rd = nsu_pread(state->blocks[elem_idx][bf].fd,
-		       bse->elem[elem_idx].data,
+		       data,
 		       bse->elem[elem_idx].size,
 		       offst);
 	if (rd != (ssize_t)bse->elem[elem_idx].size) {
@@ -1787,7 +1913,7 @@ static nserror store_read_block(struct store_state *state,
 		      "Failed reading %"PRIssizet" of %d bytes into %p from %"PRIsizet" block %d errno %d",
 		      rd,
 		      bse->elem[elem_idx].size,
-		      bse->elem[elem_idx].data,
+		      data,
 		      (size_t)offst,
 		      bse->elem[elem_idx].block,
 		      errno);
@@ -1796,7 +1922,7 @@ static nserror store_read_block(struct store_state *state,
 
 	NSLOG(netsurf, DEEPDEBUG,
 	      "Read %"PRIssizet" bytes into %p from %"PRIsizet" block %d", rd,
-	      bse->elem[elem_idx].data, (size_t)offst,
+	      data, (size_t)offst,
 	      bse->elem[elem_idx].block);
 
 	return NSERROR_OK;
@@ -1808,11 +1934,13 @@ static nserror store_read_block(struct store_state *state,
  * \param state The backing store state to use.
  * \param bse The entry to read.
  * \param elem_idx The element index within the entry.
+ * \param data The buffer to read the element data as stored on disc into.
  * \return NSERROR_OK on success or error code.
  */
 static nserror store_read_file(struct store_state *state,
 			 struct store_entry *bse,
-			 int elem_idx)
+			 int elem_idx,
+			 uint8_t *data)
 {
 	int fd;
 	ssize_t rd; /* return from read */
@@ -1829,7 +1957,7 @@ static nserror store_read_file(struct store_state *state,
 
 	while (tot < bse->elem[elem_idx].size) {
 		rd = read(fd,
-			  bse->elem[elem_idx].data + tot,
+			  data + tot,
 			  bse->elem[elem_idx].size - tot);
 		if (rd <= 0) {
 			NSLOG(netsurf, ERROR,
@@ -1845,7 +1973,50 @@ static nserror store_read_file(struct store_state *state,
 	close(fd);
 
 	NSLOG(netsurf, DEEPDEBUG, "Read %"PRIsizet" bytes into %p", tot,
-	      bse->elem[elem_idx].data);
+	      data);
+
+	return ret;
+}
+
+/**
+ * Read a compressed element of an entry from the backing storage.
+ *
+ * \param state The backing store state to use.
+ * \param bse The entry to read.
+ * \param elem_idx The element index within the entry.
+ * \return NSERROR_OK on success or error code.
+ */
+static nserror store_read_compressed(struct store_state *state,
+			 struct store_entry *bse,
+			 int elem_idx)
+{
+	struct store_entry_element *elem = &bse->elem[elem_idx];
+	uint8_t *cdata;
+	uLongf len = elem->len;
+	nserror ret;
+
+	cdata = malloc(elem->size);
+	if (cdata == NULL) {
+		return NSERROR_NOMEM;
+	}
+
+	if (elem->block != 0) {
+		ret = store_read_block(state, bse, elem_idx, cdata);
+	} else {
+		ret = store_read_file(state, bse, elem_idx, cdata);
+	}
+
+	if (ret == NSERROR_OK) {
+		if ((uncompress(elem->data, &len, cdata, elem->size) != Z_OK) ||
+		    (len != elem->len)) {
+			NSLOG(netsurf, ERROR,
+			      "Failed to decompress %d bytes to %d",
+			      elem->size, elem->len);
+			ret = NSERROR_NOT_FOUND;
+		}
+	}
+
+	free(cdata);
 
 	return ret;
 }
@@ -1906,7 +2077,7 @@ fetch(nsurl *url,
 
 	} else {
 		/* allocate from the heap */
-		elem->data = malloc(elem->size);
+		elem->data = malloc(elem->len);
 		if (elem->data == NULL) {
 			NSLOG(netsurf, ERROR,
 			      "Failed to create new heap allocation");
@@ -1920,10 +2091,14 @@ fetch(nsurl *url,
 		elem->ref = 1;
 
 		/* fill the new block */
-		if (elem->block != 0) {
-			ret = store_read_block(storestate, bse, elem_idx);
+		if ((elem->flags & ENTRY_ELEM_FLAG_COMPRESSED) != 0) {
+			ret = store_read_compressed(storestate, bse, elem_idx);
+		} else if (elem->block != 0) {
+			ret = store_read_block(storestate, bse, elem_idx,
+					       elem->data);
 		} else {
-			ret = store_read_file(storestate, bse, elem_idx);
+			ret = store_read_file(storestate, bse, elem_idx,
+					      elem->data);
 		}
 	}
 
@@ -1932,10 +2107,10 @@ fetch(nsurl *url,
 		entry_release_alloc(elem);
 	} else {
 		/* update stats and setup return pointers */
-		storestate->hit_size += elem->size;
+		storestate->hit_size += elem->len;
 
 		*data_out = elem->data;
-		*datalen_out = elem->size;
+		*datalen_out = elem->len;
 	}
 
 	return ret;
@@ -90,6 +90,7 @@ static bool nscss_convert(struct content *c);
 static void nscss_destroy(struct content *c);
 static nserror nscss_clone(const struct content *old, struct content **newc);
 static bool nscss_matches_quirks(const struct content *c, bool quirks);
+static size_t nscss_memory_size(const struct content *c);
 static content_type nscss_content_type(void);
 
 static nserror nscss_create_css_data(struct content_css_data *c,
@@ -433,6 +434,42 @@ bool nscss_matches_quirks(const struct content *c, bool quirks)
 	return c->quirks == quirks;
 }
 
+/**
+ * Estimate the memory held by a CSS content
+ *
+ * Imported sheets are included as they are held for as long as the
+ * importing sheet.
+ *
+ * \param c  Content to measure
+ * \return The estimated size in bytes
+ */
+size_t nscss_memory_size(const struct content *c)
+{
+	const nscss_content *css = (const nscss_content *) c;
+	struct content *import;
+	size_t size = sizeof(nscss_content);
+	size_t sheet_size;
+	uint32_t i;
+
+	if ((css->data.sheet != NULL) &&
+	    (css_stylesheet_size(css->data.sheet, &sheet_size) == CSS_OK)) {
+		size += sheet_size;
+	}
+
+	size += css->data.import_count * sizeof(struct nscss_import);
+	for (i = 0; i < css->data.import_count; i++) {
+		if (css->data.imports[i].c != NULL) {
+			import = hlcache_handle_get_content(
+					css->data.imports[i].c);
+			if (import != NULL) {
+				size += content_get_memory_size(import);
+			}
+		}
+	}
+
+	return size;
+}
+
 /* exported interface documented in netsurf/css.h */
 css_stylesheet *nscss_get_stylesheet(struct hlcache_handle *h)
 {
@@ -808,6 +845,7 @@ static const content_handler css_content_handler = {
 	.destroy = nscss_destroy,
 	.clone = nscss_clone,
 	.matches_quirks = nscss_matches_quirks,
+	.memory_size = nscss_memory_size,
 	.type = nscss_content_type,
 	.no_share = false,
 };
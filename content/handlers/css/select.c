@@ -17,10 +17,13 @@
  */
 
 #include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 
 #include "utils/nsoption.h"
+#include "utils/ascii.h"
 #include "utils/corestrings.h"
 #include "utils/log.h"
 #include "utils/nsurl.h"
@@ -239,6 +242,722 @@ static void nscss_dom_user_data_handler(dom_node_operation operation,
 	}
 }
 
+/**
+ * Number of entries in a style sharing cache.
+ *
+ * Siblings are not always selected consecutively, the subtree of an
+ * element is converted before its next sibling, so a few entries are
+ * kept to allow for sharing to resume after a nested list.
+ */
+#define STYLE_SHARE_ENTRIES 8
+
+/**
+ * Style sharing cache entry
+ *
+ * Records the uncomposed selection results of an element whose style
+ * depended only on its name, class attribute and ancestors.
+ */
+struct nscss_style_share_entry {
+	dom_node *parent; /**< Parent node of the element */
+	const css_computed_style *parent_style; /**< Parent style */
+	dom_string *name; /**< Element name */
+	dom_string *class; /**< Class attribute or NULL if none */
+	css_select_results *partial; /**< Uncomposed selection results */
+};
+
+/**
+ * Style sharing cache
+ */
+struct nscss_style_share {
+	unsigned int next; /**< Next entry to replace */
+	unsigned int hits; /**< Number of elements which shared a style */
+	unsigned int misses; /**< Number of shareable elements selected */
+	unsigned int unshareable; /**< Number of elements never shareable */
+	struct nscss_style_share_entry entry[STYLE_SHARE_ENTRIES];
+};
+
+/**
+ * Element being selected for which the style may be shared.
+ *
+ * Selection callbacks which make the result depend on more than the
+ * name, class attribute and ancestors of this element mark it as
+ * tainted so its style is not cached.
+ */
+static dom_node *style_share_node;
+
+/** Whether the selection of style_share_node has been tainted */
+static bool style_share_tainted;
+
+/**
+ * Note a selection callback which depends on the node itself.
+ *
+ * \param node The node the callback was made for
+ */
+static inline void nscss_style_share_taint(void *node)
+{
+	if (node == style_share_node) {
+		style_share_tainted = true;
+	}
+}
+
+/**
+ * Release the references held by a sharing cache entry.
+ *
+ * \param entry The entry to release
+ */
+static void nscss_style_share_release(struct nscss_style_share_entry *entry)
+{
+	if (entry->parent != NULL) {
+		dom_node_unref(entry->parent);
+	}
+	if (entry->name != NULL) {
+		dom_string_unref(entry->name);
+	}
+	if (entry->class != NULL) {
+		dom_string_unref(entry->class);
+	}
+	if (entry->partial != NULL) {
+		css_select_results_destroy(entry->partial);
+	}
+	memset(entry, 0, sizeof(*entry));
+}
+
+/* exported interface documented in css/select.h */
+nserror nscss_style_share_create(struct nscss_style_share **share_out)
+{
+	struct nscss_style_share *share;
+
+	share = calloc(1, sizeof(*share));
+	if (share == NULL) {
+		return NSERROR_NOMEM;
+	}
+
+	*share_out = share;
+
+	return NSERROR_OK;
+}
+
+/* exported interface documented in css/select.h */
+void nscss_style_share_destroy(struct nscss_style_share *share)
+{
+	unsigned int idx;
+	unsigned int lookups;
+
+	if (share == NULL) {
+		return;
+	}
+
+	lookups = share->hits + share->misses;
+	NSLOG(layout, INFO,
+	      "Style sharing: %u hits from %u lookups (%u%%), %u elements unshareable",
+	      share->hits, lookups,
+	      (lookups == 0) ? 0 : (share->hits * 100) / lookups,
+	      share->unshareable);
+
+	for (idx = 0; idx < STYLE_SHARE_ENTRIES; idx++) {
+		nscss_style_share_release(&share->entry[idx]);
+	}
+	free(share);
+}
+
+/**
+ * Get the style sharing key for an element.
+ *
+ * Only elements with no attributes other than class may share styles.
+ * The caller owns the references in the returned key.
+ *
+ * \param n The element
+ * \param parent_style The parent element's computed style
+ * \param key The key to fill
+ * \return true if the element may share a style, false otherwise
+ */
+static bool
+nscss_style_share_key(dom_node *n,
+		      const css_computed_style *parent_style,
+		      struct nscss_style_share_entry *key)
+{
+	struct dom_namednodemap *attrs;
+	dom_exception err;
+	uint32_t nattrs = 0;
+
+	memset(key, 0, sizeof(*key));
+	key->parent_style = parent_style;
+
+	err = dom_node_get_attributes(n, &attrs);
+	if (err != DOM_NO_ERR) {
+		return false;
+	}
+	if (attrs != NULL) {
+		err = dom_namednodemap_get_length(attrs, &nattrs);
+		dom_namednodemap_unref(attrs);
+		if (err != DOM_NO_ERR) {
+			return false;
+		}
+	}
+
+	if (nattrs > 1) {
+		return false;
+	}
+
+	if (nattrs == 1) {
+		err = dom_element_get_attribute(n, corestring_dom_class,
+				&key->class);
+		if (err != DOM_NO_ERR || key->class == NULL) {
+			return false;
+		}
+	}
+
+	err = dom_node_get_parent_node(n, &key->parent);
+	if (err != DOM_NO_ERR || key->parent == NULL) {
+		nscss_style_share_release(key);
+		return false;
+	}
+
+	err = dom_node_get_node_name(n, &key->name);
+	if (err != DOM_NO_ERR || key->name == NULL) {
+		nscss_style_share_release(key);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Determine whether an element has element children.
+ *
+ * libcss keeps data on the nodes it selects for which is used to
+ * speed up selection of their descendants. Elements which share a
+ * style are never selected so sharing is limited to elements with no
+ * element children.
+ *
+ * \param n The element
+ * \return true if the element has no element children
+ */
+static bool nscss_style_share_is_leaf(dom_node *n)
+{
+	dom_node *child, *next;
+	dom_node_type type;
+	dom_exception err;
+
+	err = dom_node_get_first_child(n, &child);
+	if (err != DOM_NO_ERR) {
+		return false;
+	}
+
+	while (child != NULL) {
+		err = dom_node_get_node_type(child, &type);
+		if (err != DOM_NO_ERR || type == DOM_ELEMENT_NODE) {
+			dom_node_unref(child);
+			return false;
+		}
+
+		err = dom_node_get_next_sibling(child, &next);
+		dom_node_unref(child);
+		if (err != DOM_NO_ERR) {
+			return false;
+		}
+		child = next;
+	}
+
+	return true;
+}
+
+/**
+ * Find a matching sharing cache entry.
+ *
+ * \param share The sharing cache
+ * \param key The key of the element being selected
+ * \return The matching entry or NULL if there is none
+ */
+static struct nscss_style_share_entry *
+nscss_style_share_find(struct nscss_style_share *share,
+		       const struct nscss_style_share_entry *key)
+{
+	struct nscss_style_share_entry *entry;
+	unsigned int idx;
+
+	for (idx = 0; idx < STYLE_SHARE_ENTRIES; idx++) {
+		entry = &share->entry[idx];
+
+		if (entry->partial == NULL ||
+		    entry->parent != key->parent ||
+		    entry->parent_style != key->parent_style) {
+			continue;
+		}
+
+		if (dom_string_isequal(entry->name, key->name) == false) {
+			continue;
+		}
+
+		if (entry->class == NULL || key->class == NULL) {
+			if (entry->class != key->class) {
+				continue;
+			}
+		} else if (dom_string_isequal(entry->class,
+					      key->class) == false) {
+			continue;
+		}
+
+		return entry;
+	}
+
+	return NULL;
+}
+
+/**
+ * Compose uncomposed selection results with a parent style.
+ *
+ * The composed styles are interned by libcss so elements composed
+ * from the same partial results and parent share computed styles.
+ *
+ * \param parent_style The parent element's computed style
+ * \param partial The uncomposed selection results
+ * \param unit_len_ctx Unit length conversion context
+ * \return Composed selection results or NULL on failure
+ */
+static css_select_results *
+nscss_style_share_compose(const css_computed_style *parent_style,
+			  const css_select_results *partial,
+			  const css_unit_ctx *unit_len_ctx)
+{
+	css_select_results *styles;
+	int pseudo_element;
+	css_error error;
+
+	styles = calloc(1, sizeof(*styles));
+	if (styles == NULL) {
+		return NULL;
+	}
+
+	error = css_computed_style_compose(parent_style,
+			partial->styles[CSS_PSEUDO_ELEMENT_NONE],
+			unit_len_ctx,
+			&styles->styles[CSS_PSEUDO_ELEMENT_NONE]);
+	if (error != CSS_OK) {
+		free(styles);
+		return NULL;
+	}
+
+	for (pseudo_element = CSS_PSEUDO_ELEMENT_NONE + 1;
+			pseudo_element < CSS_PSEUDO_ELEMENT_COUNT;
+			pseudo_element++) {
+		if (partial->styles[pseudo_element] == NULL)
+			continue;
+
+		error = css_computed_style_compose(
+				styles->styles[CSS_PSEUDO_ELEMENT_NONE],
+				partial->styles[pseudo_element],
+				unit_len_ctx,
+				&styles->styles[pseudo_element]);
+		if (error != CSS_OK) {
+			css_select_results_destroy(styles);
+			return NULL;
+		}
+	}
+
+	return styles;
+}
+
+/**
+ * Select a style through a sharing cache.
+ *
+ * \param ctx CSS selection context with a sharing cache
+ * \param n Element to select for
+ * \param media Permitted media types
+ * \param unit_len_ctx Unit length conversion context
+ * \param selected Updated with uncomposed selection results when the
+ *                 element was selected but the result could not be
+ *                 cached, otherwise NULL
+ * \return Composed selection results or NULL if the element must be
+ *         composed or selected normally
+ */
+static css_select_results *
+nscss_get_shared_style(nscss_select_ctx *ctx,
+		       dom_node *n,
+		       const css_media *media,
+		       const css_unit_ctx *unit_len_ctx,
+		       css_select_results **selected)
+{
+	struct nscss_style_share *share = ctx->share;
+	struct nscss_style_share_entry key;
+	struct nscss_style_share_entry *entry;
+	css_select_results *partial;
+	css_select_results *styles;
+	css_error error;
+
+	*selected = NULL;
+
+	if (nscss_style_share_key(n, ctx->parent_style, &key) == false) {
+		share->unshareable++;
+		return NULL;
+	}
+
+	if (nscss_style_share_is_leaf(n)) {
+		entry = nscss_style_share_find(share, &key);
+		if (entry != NULL) {
+			styles = nscss_style_share_compose(ctx->parent_style,
+					entry->partial, unit_len_ctx);
+			if (styles != NULL) {
+				share->hits++;
+				nscss_style_share_release(&key);
+				return styles;
+			}
+		}
+	}
+	share->misses++;
+
+	/* Select, watching for anything that makes the style depend on
+	 * more than the key. */
+	style_share_node = n;
+	style_share_tainted = false;
+
+	error = css_select_style(ctx->ctx, n, unit_len_ctx, media, NULL,
+			&selection_handler, ctx, &partial);
+
+	style_share_node = NULL;
+
+	if (error != CSS_OK || partial == NULL) {
+		nscss_style_share_release(&key);
+		return NULL;
+	}
+
+	styles = NULL;
+	if (style_share_tainted == false &&
+	    partial->styles[CSS_PSEUDO_ELEMENT_FIRST_LETTER] == NULL &&
+	    partial->styles[CSS_PSEUDO_ELEMENT_FIRST_LINE] == NULL) {
+		styles = nscss_style_share_compose(ctx->parent_style,
+				partial, unit_len_ctx);
+	}
+
+	if (styles == NULL) {
+		/* not cacheable, the caller composes the selection */
+		*selected = partial;
+		nscss_style_share_release(&key);
+		return NULL;
+	}
+
+	/* cache the partial results */
+	entry = &share->entry[share->next];
+	share->next = (share->next + 1) % STYLE_SHARE_ENTRIES;
+
+	nscss_style_share_release(entry);
+	*entry = key;
+	entry->partial = partial;
+
+	return styles;
+}
+
+/**
+ * Number of counters in an ancestor filter, must be a power of two.
+ */
+#define ANCESTOR_FILTER_SIZE 1024
+
+/** Initial number of entries in an ancestor filter stack */
+#define ANCESTOR_FILTER_STACK 32
+
+/**
+ * Ancestor filter element entry
+ */
+struct nscss_ancestor_entry {
+	dom_node *node; /**< The element */
+	uint32_t hash; /**< Hash of the element name */
+};
+
+/**
+ * Ancestor filter
+ *
+ * A counting bloom filter of the names of the elements on a stack of
+ * ancestors. Counting allows the elements to be removed as the tree
+ * walk leaves them.
+ */
+struct nscss_ancestor_filter {
+	bool valid; /**< Whether the filter may be used to reject */
+	unsigned int depth; /**< Number of elements on the stack */
+	unsigned int size; /**< Allocated size of the stack */
+	struct nscss_ancestor_entry *stack; /**< Stack of ancestors */
+	unsigned int lookups; /**< Number of ancestor searches */
+	unsigned int rejects; /**< Number of searches rejected */
+	uint16_t count[ANCESTOR_FILTER_SIZE]; /**< Filter counters */
+};
+
+/**
+ * Hash an element name for the ancestor filter.
+ *
+ * Element names are compared caselessly so the hash is of the lower
+ * case name.
+ *
+ * \param data The name
+ * \param len The length of the name
+ * \return The hash value
+ */
+static uint32_t nscss_ancestor_hash(const char *data, size_t len)
+{
+	uint32_t hash = 0x811c9dc5;
+	size_t idx;
+
+	for (idx = 0; idx < len; idx++) {
+		hash ^= (uint8_t) ascii_to_lower(data[idx]);
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
+/**
+ * Adjust the ancestor filter counters for a hash.
+ *
+ * Counters which saturate are never decremented, so the filter may
+ * only err towards an element being present.
+ *
+ * \param filter The filter to adjust
+ * \param hash The hash to add or remove
+ * \param add true to add the hash, false to remove it
+ */
+static void
+nscss_ancestor_filter_count(struct nscss_ancestor_filter *filter,
+			    uint32_t hash,
+			    bool add)
+{
+	unsigned int idx[2];
+	unsigned int i;
+
+	idx[0] = hash & (ANCESTOR_FILTER_SIZE - 1);
+	idx[1] = (hash >> 16) & (ANCESTOR_FILTER_SIZE - 1);
+
+	for (i = 0; i < 2; i++) {
+		uint16_t *count = &filter->count[idx[i]];
+
+		if (*count == UINT16_MAX) {
+			continue;
+		}
+		if (add) {
+			(*count)++;
+		} else {
+			(*count)--;
+		}
+	}
+}
+
+/**
+ * Remove the top element from the ancestor filter stack.
+ *
+ * \param filter The filter to pop
+ */
+static void nscss_ancestor_filter_pop(struct nscss_ancestor_filter *filter)
+{
+	struct nscss_ancestor_entry *entry;
+
+	entry = &filter->stack[--filter->depth];
+	nscss_ancestor_filter_count(filter, entry->hash, false);
+	dom_node_unref(entry->node);
+}
+
+/* exported interface documented in css/select.h */
+nserror nscss_ancestor_filter_create(struct nscss_ancestor_filter **filter_out)
+{
+	struct nscss_ancestor_filter *filter;
+
+	filter = calloc(1, sizeof(*filter));
+	if (filter == NULL) {
+		return NSERROR_NOMEM;
+	}
+
+	filter->stack = malloc(ANCESTOR_FILTER_STACK * sizeof(*filter->stack));
+	if (filter->stack == NULL) {
+		free(filter);
+		return NSERROR_NOMEM;
+	}
+	filter->size = ANCESTOR_FILTER_STACK;
+
+	*filter_out = filter;
+
+	return NSERROR_OK;
+}
+
+/* exported interface documented in css/select.h */
+void nscss_ancestor_filter_destroy(struct nscss_ancestor_filter *filter)
+{
+	if (filter == NULL) {
+		return;
+	}
+
+	NSLOG(layout, INFO,
+	      "Ancestor filter rejected %u of %u ancestor searches",
+	      filter->rejects, filter->lookups);
+
+	while (filter->depth > 0) {
+		nscss_ancestor_filter_pop(filter);
+	}
+	free(filter->stack);
+	free(filter);
+}
+
+/* exported interface documented in css/select.h */
+nserror
+nscss_ancestor_filter_push(struct nscss_ancestor_filter *filter, dom_node *n)
+{
+	struct nscss_ancestor_entry *entry;
+	dom_string *name;
+	dom_exception err;
+
+	if (filter->depth == filter->size) {
+		struct nscss_ancestor_entry *stack;
+
+		stack = realloc(filter->stack,
+				filter->size * 2 * sizeof(*filter->stack));
+		if (stack == NULL) {
+			filter->valid = false;
+			return NSERROR_NOMEM;
+		}
+		filter->stack = stack;
+		filter->size *= 2;
+	}
+
+	err = dom_node_get_node_name(n, &name);
+	if (err != DOM_NO_ERR || name == NULL) {
+		filter->valid = false;
+		return NSERROR_DOM;
+	}
+
+	entry = &filter->stack[filter->depth++];
+	entry->node = dom_node_ref(n);
+	entry->hash = nscss_ancestor_hash(dom_string_data(name),
+			dom_string_byte_length(name));
+	dom_string_unref(name);
+
+	nscss_ancestor_filter_count(filter, entry->hash, true);
+
+	return NSERROR_OK;
+}
+
+/**
+ * Rebuild an ancestor filter from the tree.
+ *
+ * \param filter The empty filter to rebuild
+ * \param parent The parent of the element about to be selected, or NULL
+ * \return NSERROR_OK on success else error code
+ */
+static nserror
+nscss_ancestor_filter_rebuild(struct nscss_ancestor_filter *filter,
+			      dom_node *parent)
+{
+	dom_node *node;
+	dom_node *next;
+	dom_node_type type;
+	dom_exception err;
+	unsigned int count = 0;
+	unsigned int idx;
+	nserror res = NSERROR_OK;
+
+	/* collect the ancestors on the stack, nearest first */
+	node = (parent != NULL) ? dom_node_ref(parent) : NULL;
+	while (node != NULL) {
+		err = dom_node_get_node_type(node, &type);
+		if (err != DOM_NO_ERR || type != DOM_ELEMENT_NODE) {
+			dom_node_unref(node);
+			break;
+		}
+
+		res = nscss_ancestor_filter_push(filter, node);
+		if (res != NSERROR_OK) {
+			dom_node_unref(node);
+			return res;
+		}
+		count++;
+
+		err = dom_node_get_parent_node(node, &next);
+		dom_node_unref(node);
+		if (err != DOM_NO_ERR) {
+			return NSERROR_DOM;
+		}
+		node = next;
+	}
+
+	/* and reverse them so the root is at the bottom */
+	for (idx = 0; idx < count / 2; idx++) {
+		struct nscss_ancestor_entry tmp = filter->stack[idx];
+		filter->stack[idx] = filter->stack[count - idx - 1];
+		filter->stack[count - idx - 1] = tmp;
+	}
+
+	return res;
+}
+
+/* exported interface documented in css/select.h */
+nserror
+nscss_ancestor_filter_update(struct nscss_ancestor_filter *filter, dom_node *n)
+{
+	dom_node *parent;
+	dom_exception err;
+	nserror res;
+
+	err = dom_node_get_parent_node(n, &parent);
+	if (err != DOM_NO_ERR) {
+		filter->valid = false;
+		return NSERROR_DOM;
+	}
+
+	if (filter->valid) {
+		/* leave any elements which are not ancestors */
+		while (filter->depth > 0 &&
+		       filter->stack[filter->depth - 1].node != parent) {
+			nscss_ancestor_filter_pop(filter);
+		}
+
+		if (filter->depth > 0 || parent == NULL) {
+			if (parent != NULL) {
+				dom_node_unref(parent);
+			}
+			return NSERROR_OK;
+		}
+	}
+
+	/* the parent was not on the stack, start again from the tree */
+	while (filter->depth > 0) {
+		nscss_ancestor_filter_pop(filter);
+	}
+
+	res = nscss_ancestor_filter_rebuild(filter, parent);
+	if (parent != NULL) {
+		dom_node_unref(parent);
+	}
+
+	filter->valid = (res == NSERROR_OK);
+
+	return res;
+}
+
+/**
+ * Determine if an ancestor filter excludes an element name.
+ *
+ * \param filter The filter to search
+ * \param name The element name
+ * \return true if no ancestor has the name, false if one may have
+ */
+static bool
+nscss_ancestor_filter_reject(struct nscss_ancestor_filter *filter,
+			     lwc_string *name)
+{
+	uint32_t hash;
+
+	if (filter->valid == false) {
+		return false;
+	}
+
+	filter->lookups++;
+
+	hash = nscss_ancestor_hash(lwc_string_data(name),
+			lwc_string_length(name));
+
+	if (filter->count[hash & (ANCESTOR_FILTER_SIZE - 1)] == 0 ||
+	    filter->count[(hash >> 16) & (ANCESTOR_FILTER_SIZE - 1)] == 0) {
+		filter->rejects++;
+		return true;
+	}
+
+	return false;
+}
+
 /**
  * Get style selection results for an element
  *
@@ -256,17 +975,30 @@ css_select_results *nscss_get_style(nscss_select_ctx *ctx, dom_node *n,
 		const css_stylesheet *inline_style)
 {
 	css_computed_style *composed;
-	css_select_results *styles;
+	css_select_results *composed_styles;
+	css_select_results *styles = NULL;
 	int pseudo_element;
 	css_error error;
 
-	/* Select style for node */
-	error = css_select_style(ctx->ctx, n, unit_len_ctx, media, inline_style,
-			&selection_handler, ctx, &styles);
+	if (ctx->share != NULL &&
+	    inline_style == NULL &&
+	    ctx->parent_style != NULL) {
+		composed_styles = nscss_get_shared_style(ctx, n, media,
+				unit_len_ctx, &styles);
+		if (composed_styles != NULL) {
+			return composed_styles;
+		}
+	}
+
+	if (styles == NULL) {
+		/* Select style for node */
+		error = css_select_style(ctx->ctx, n, unit_len_ctx, media,
+				inline_style, &selection_handler, ctx, &styles);
 
-	if (error != CSS_OK || styles == NULL) {
-		/* Failed selecting partial style -- bail out */
-		return NULL;
+		if (error != CSS_OK || styles == NULL) {
+			/* Failed selecting partial style -- bail out */
+			return NULL;
+		}
 	}
 
 	/* If there's a parent style, compose with partial to obtain
@@ -471,6 +1203,17 @@ css_error node_id(void *pw, void *node, lwc_string **id)
 css_error named_ancestor_node(void *pw, void *node,
 		const css_qname *qname, void **ancestor)
 {
+	nscss_select_ctx *ctx = pw;
+
+	/* The filter holds the ancestors of the element being selected.
+	 * Any node this is asked about is that element, an ancestor or
+	 * a sibling of one, so its ancestors are all in the filter. */
+	if (ctx->ancestors != NULL &&
+	    nscss_ancestor_filter_reject(ctx->ancestors, qname->name)) {
+		*ancestor = NULL;
+		return CSS_OK;
+	}
+
 	dom_element_named_ancestor_node(node, qname->name,
 			(struct dom_element **)ancestor);
 	dom_node_unref(*ancestor);
@@ -517,6 +1260,8 @@ css_error named_sibling_node(void *pw, void *node,
 	dom_node *prev;
 	dom_exception err;
 
+	nscss_style_share_taint(node);
+
 	*sibling = NULL;
 
 	/* Find sibling element */
@@ -585,6 +1330,8 @@ css_error named_generic_sibling_node(void *pw, void *node,
 	dom_node *prev;
 	dom_exception err;
 
+	nscss_style_share_taint(node);
+
 	*sibling = NULL;
 
 	err = dom_node_get_previous_sibling(n, &n);
@@ -665,6 +1412,8 @@ css_error sibling_node(void *pw, void *node, void **sibling)
 	dom_node *prev;
 	dom_exception err;
 
+	nscss_style_share_taint(node);
+
 	*sibling = NULL;
 
 	/* Find sibling element */
@@ -818,6 +1567,8 @@ css_error node_has_attribute(void *pw, void *node,
 	dom_string *name;
 	dom_exception err;
 
+	nscss_style_share_taint(node);
+
 	err = dom_string_create_interned(
 			(const uint8_t *) lwc_string_data(qname->name),
 			lwc_string_length(qname->name), &name);
@@ -859,6 +1610,8 @@ css_error node_has_attribute_equal(void *pw, void *node,
 
 	size_t vlen = lwc_string_length(value);
 
+	nscss_style_share_taint(node);
+
 	if (vlen == 0) {
 		*match = false;
 		return CSS_OK;
@@ -911,6 +1664,8 @@ css_error node_has_attribute_dashmatch(void *pw, void *node,
 
 	size_t vlen = lwc_string_length(value);
 
+	nscss_style_share_taint(node);
+
 	if (vlen == 0) {
 		*match = false;
 		return CSS_OK;
@@ -978,6 +1733,8 @@ css_error node_has_attribute_includes(void *pw, void *node,
 	const char *start;
 	const char *end;
 
+	nscss_style_share_taint(node);
+
 	*match = false;
 
 	if (vlen == 0) {
@@ -1047,6 +1804,8 @@ css_error node_has_attribute_prefix(void *pw, void *node,
 
 	size_t vlen = lwc_string_length(value);
 
+	nscss_style_share_taint(node);
+
 	if (vlen == 0) {
 		*match = false;
 		return CSS_OK;
@@ -1111,6 +1870,8 @@ css_error node_has_attribute_suffix(void *pw, void *node,
 
 	size_t vlen = lwc_string_length(value);
 
+	nscss_style_share_taint(node);
+
 	if (vlen == 0) {
 		*match = false;
 		return CSS_OK;
@@ -1179,6 +1940,8 @@ css_error node_has_attribute_substring(void *pw, void *node,
 
 	size_t vlen = lwc_string_length(value);
 
+	nscss_style_share_taint(node);
+
 	if (vlen == 0) {
 		*match = false;
 		return CSS_OK;
@@ -1323,6 +2086,8 @@ css_error node_count_siblings(void *pw, void *n, bool same_name,
 	dom_exception exc;
 	dom_string *node_name = NULL;
 
+	nscss_style_share_taint(n);
+
 	if (same_name) {
 		dom_node *node = n;
 		exc = dom_node_get_node_name(node, &node_name);
@@ -1385,6 +2150,8 @@ css_error node_is_empty(void *pw, void *node, bool *match)
 	dom_node *n = node, *next;
 	dom_exception err;
 
+	nscss_style_share_taint(node);
+
 	*match = true;
 
 	err = dom_node_get_first_child(n, &n);
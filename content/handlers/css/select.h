@@ -25,8 +25,12 @@
 
 #include <libcss/libcss.h>
 
+#include "utils/errors.h"
+
 struct content;
 struct nsurl;
+struct nscss_style_share;
+struct nscss_ancestor_filter;
 
 /**
  * Selection context
@@ -39,8 +43,81 @@ typedef struct nscss_select_ctx
 	lwc_string *universal;
 	const css_computed_style *root_style;
 	const css_computed_style *parent_style;
+	/** Style sharing cache, or NULL to select every element */
+	struct nscss_style_share *share;
+	/** Filter of the selected element's ancestors, or NULL */
+	struct nscss_ancestor_filter *ancestors;
 } nscss_select_ctx;
 
+/**
+ * Create a style sharing cache
+ *
+ * Elements selected through the same cache with the same parent,
+ * name and class attribute, and no other attributes, share the
+ * result of a single selection when it did not depend on anything
+ * else about the element. The cache is intended to live for one box
+ * tree construction.
+ *
+ * \param share_out Updated with the new cache
+ * \return NSERROR_OK on success, or NSERROR_NOMEM
+ */
+nserror nscss_style_share_create(struct nscss_style_share **share_out);
+
+/**
+ * Destroy a style sharing cache
+ *
+ * The cache hit rate is logged.
+ *
+ * \param share The cache to destroy, may be NULL
+ */
+void nscss_style_share_destroy(struct nscss_style_share *share);
+
+/**
+ * Create an ancestor filter
+ *
+ * An ancestor filter tracks the names of the ancestors of the element
+ * being selected so a search for an ancestor which is not present can
+ * be rejected without walking the tree.
+ *
+ * \param filter_out Updated with the new filter
+ * \return NSERROR_OK on success, or NSERROR_NOMEM
+ */
+nserror nscss_ancestor_filter_create(struct nscss_ancestor_filter **filter_out);
+
+/**
+ * Destroy an ancestor filter
+ *
+ * \param filter The filter to destroy, may be NULL
+ */
+void nscss_ancestor_filter_destroy(struct nscss_ancestor_filter *filter);
+
+/**
+ * Update an ancestor filter for selection of an element
+ *
+ * On return the filter holds exactly the ancestors of the element.
+ * When elements are visited in document order, and each is pushed
+ * once selected, this is an incremental update, otherwise the
+ * ancestors are collected from the tree.
+ *
+ * \param filter The filter to update
+ * \param n The element about to be selected
+ * \return NSERROR_OK on success, else the filter must not be used
+ */
+nserror nscss_ancestor_filter_update(struct nscss_ancestor_filter *filter,
+		dom_node *n);
+
+/**
+ * Add an element to an ancestor filter
+ *
+ * Called after an element has been selected, before its children.
+ *
+ * \param filter The filter to update
+ * \param n The element just selected
+ * \return NSERROR_OK on success, else the filter must not be used
+ */
+nserror nscss_ancestor_filter_push(struct nscss_ancestor_filter *filter,
+		dom_node *n);
+
 css_stylesheet *nscss_create_inline_style(const uint8_t *data, size_t len,
 		const char *charset, const char *url, bool allow_quirks);
 
@@ -61,6 +61,10 @@ struct box_construct_ctx {
 	box_construct_complete_cb cb;	/**< Callback to invoke on completion */
 
 	int *bctx;			/**< talloc context */
+
+	struct nscss_style_share *share; /**< Style sharing cache */
+
+	struct nscss_ancestor_filter *ancestors; /**< Ancestor name filter */
 };
 
 /**
@@ -237,6 +241,8 @@ box_extract_properties(dom_node *n, struct box_construct_props *props)
  * Get the style for an element.
  *
  * \param  c               content of type CONTENT_HTML that is being processed
+ * \param  share           style sharing cache, or NULL
+ * \param  ancestors       filter of the element's ancestors, or NULL
  * \param  parent_style    style at this point in xml tree, or NULL for root
  * \param  root_style      root node's style, or NULL for root
  * \param  n               node in xml tree
@@ -244,6 +250,8 @@ box_extract_properties(dom_node *n, struct box_construct_props *props)
  */
 static css_select_results *
 box_get_style(html_content *c,
+	      struct nscss_style_share *share,
+	      struct nscss_ancestor_filter *ancestors,
 	      const css_computed_style *parent_style,
 	      const css_computed_style *root_style,
 	      dom_node *n)
@@ -280,6 +288,8 @@ box_get_style(html_content *c,
 	ctx.universal = c->universal;
 	ctx.root_style = root_style;
 	ctx.parent_style = parent_style;
+	ctx.share = share;
+	ctx.ancestors = ancestors;
 
 	/* Select style for element */
 	styles = nscss_get_style(&ctx, n, &c->media, &c->unit_len_ctx,
@@ -453,6 +463,7 @@ box_construct_element(struct box_construct_ctx *ctx, bool *convert_children)
 	lwc_string *id = NULL;
 	struct box *box = NULL, *old_box;
 	css_select_results *styles = NULL;
+	struct nscss_ancestor_filter *ancestors;
 	lwc_string *bgimage_uri;
 	dom_exception err;
 	struct box_construct_props props;
@@ -473,11 +484,20 @@ box_construct_element(struct box_construct_ctx *ctx, bool *convert_children)
 		root_style = ctx->root_box->style;
 	}
 
-	styles = box_get_style(ctx->content, props.parent_style, root_style,
-			ctx->n);
+	/* An incomplete filter is of no use, select without it */
+	ancestors = ctx->ancestors;
+	if (nscss_ancestor_filter_update(ancestors, ctx->n) != NSERROR_OK) {
+		ancestors = NULL;
+	}
+
+	styles = box_get_style(ctx->content, ctx->share, ancestors,
+			props.parent_style, root_style, ctx->n);
 	if (styles == NULL)
 		return false;
 
+	/* Descendants will be selected with this element as an ancestor */
+	nscss_ancestor_filter_push(ctx->ancestors, ctx->n);
+
 	/* Extract title attribute, if present */
 	err = dom_element_get_attribute(ctx->n, corestring_dom_title, &title0);
 	if (err != DOM_NO_ERR)
@@ -1205,6 +1225,8 @@ static void convert_xml_to_box(struct box_construct_ctx *ctx)
 		if (box_construct_element(ctx, &convert_children) == false) {
 			ctx->cb(ctx->content, false);
 			dom_node_unref(ctx->n);
+			nscss_style_share_destroy(ctx->share);
+			nscss_ancestor_filter_destroy(ctx->ancestors);
 			free(ctx);
 			return;
 		}
@@ -1219,6 +1241,8 @@ static void convert_xml_to_box(struct box_construct_ctx *ctx)
 			if (err != DOM_NO_ERR) {
 				ctx->cb(ctx->content, false);
 				dom_node_unref(next);
+				nscss_style_share_destroy(ctx->share);
+				nscss_ancestor_filter_destroy(ctx->ancestors);
 				free(ctx);
 				return;
 			}
@@ -1231,6 +1255,8 @@ static void convert_xml_to_box(struct box_construct_ctx *ctx)
 				if (box_construct_text(ctx) == false) {
 					ctx->cb(ctx->content, false);
 					dom_node_unref(ctx->n);
+					nscss_style_share_destroy(ctx->share);
+					nscss_ancestor_filter_destroy(ctx->ancestors);
 					free(ctx);
 					return;
 				}
@@ -1245,6 +1271,11 @@ static void convert_xml_to_box(struct box_construct_ctx *ctx)
 			/* Conversion complete */
 			struct box root;
 
+			nscss_style_share_destroy(ctx->share);
+			nscss_ancestor_filter_destroy(ctx->ancestors);
+			ctx->share = NULL;
+			ctx->ancestors = NULL;
+
 			memset(&root, 0, sizeof(root));
 
 			root.type = BOX_BLOCK;
@@ -1298,6 +1329,17 @@ dom_to_box(dom_node *n,
 		return NSERROR_NOMEM;
 	}
 
+	if (nscss_style_share_create(&ctx->share) != NSERROR_OK) {
+		free(ctx);
+		return NSERROR_NOMEM;
+	}
+
+	if (nscss_ancestor_filter_create(&ctx->ancestors) != NSERROR_OK) {
+		nscss_style_share_destroy(ctx->share);
+		free(ctx);
+		return NSERROR_NOMEM;
+	}
+
 	ctx->content = c;
 	ctx->n = dom_node_ref(n);
 	ctx->root_box = NULL;
@@ -1322,6 +1364,8 @@ nserror cancel_dom_to_box(void *box_conversion_context)
 	}
 
 	dom_node_unref(ctx->n);
+	nscss_style_share_destroy(ctx->share);
+	nscss_ancestor_filter_destroy(ctx->ancestors);
 	free(ctx);
 
 	return NSERROR_OK;
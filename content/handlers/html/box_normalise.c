@@ -189,6 +189,8 @@ box_normalise_table_row(struct box *row,
 			ctx.quirks = (c->quirks == DOM_DOCUMENT_QUIRKS_MODE_FULL);
 			ctx.base_url = c->base_url;
 			ctx.universal = c->universal;
+			ctx.share = NULL;
+			ctx.ancestors = NULL;
 
 			style = nscss_get_blank_style(&ctx, &c->unit_len_ctx,
 					row->style);
@@ -326,6 +328,8 @@ box_normalise_table_row_group(struct box *row_group,
 			ctx.quirks = (c->quirks == DOM_DOCUMENT_QUIRKS_MODE_FULL);
 			ctx.base_url = c->base_url;
 			ctx.universal = c->universal;
+			ctx.share = NULL;
+			ctx.ancestors = NULL;
 
 			style = nscss_get_blank_style(&ctx, &c->unit_len_ctx,
 					row_group->style);
@@ -403,6 +407,8 @@ box_normalise_table_row_group(struct box *row_group,
 		ctx.quirks = (c->quirks == DOM_DOCUMENT_QUIRKS_MODE_FULL);
 		ctx.base_url = c->base_url;
 		ctx.universal = c->universal;
+		ctx.share = NULL;
+		ctx.ancestors = NULL;
 
 		style = nscss_get_blank_style(&ctx, &c->unit_len_ctx,
 				row_group->style);
@@ -534,6 +540,8 @@ box_normalise_table_spans(struct box *table,
 						DOM_DOCUMENT_QUIRKS_MODE_FULL);
 					ctx.base_url = c->base_url;
 					ctx.universal = c->universal;
+					ctx.share = NULL;
+					ctx.ancestors = NULL;
 
 					style = nscss_get_blank_style(&ctx,
 							&c->unit_len_ctx,
@@ -660,6 +668,8 @@ box_normalise_table(struct box *table, const struct box *root, html_content * c)
 			ctx.quirks = (c->quirks == DOM_DOCUMENT_QUIRKS_MODE_FULL);
 			ctx.base_url = c->base_url;
 			ctx.universal = c->universal;
+			ctx.share = NULL;
+			ctx.ancestors = NULL;
 
 			style = nscss_get_blank_style(&ctx, &c->unit_len_ctx,
 					table->style);
@@ -748,6 +758,8 @@ box_normalise_table(struct box *table, const struct box *root, html_content * c)
 		ctx.quirks = (c->quirks == DOM_DOCUMENT_QUIRKS_MODE_FULL);
 		ctx.base_url = c->base_url;
 		ctx.universal = c->universal;
+		ctx.share = NULL;
+		ctx.ancestors = NULL;
 
 		style = nscss_get_blank_style(&ctx, &c->unit_len_ctx,
 				table->style);
@@ -954,6 +966,8 @@ box_normalise_block(struct box *block, const struct box *root, html_content *c)
 			ctx.quirks = (c->quirks == DOM_DOCUMENT_QUIRKS_MODE_FULL);
 			ctx.base_url = c->base_url;
 			ctx.universal = c->universal;
+			ctx.share = NULL;
+			ctx.ancestors = NULL;
 
 			style = nscss_get_blank_style(&ctx, &c->unit_len_ctx,
 					block->style);
@@ -32,6 +32,8 @@
 #include "utils/string.h"
 #include "utils/nsurl.h"
 #include "content/content.h"
+#include "content/fetch.h"
+#include "content/prefetch.h"
 #include "javascript/js.h"
 
 #include "netsurf/bitmap.h"
@@ -148,6 +150,34 @@ static bool html_process_inserted_img(html_content *htmlc, dom_node *node)
 }
 
 
+/**
+ * Check a link relation list for a link type
+ *
+ * \param rel The space separated list of link types
+ * \param type The link type to look for
+ * \return true if \a type is in the list
+ */
+static bool html_link_rel_has(lwc_string *rel, const char *type)
+{
+	const char *list = lwc_string_data(rel);
+	size_t len = strlen(type);
+
+	while (*list != '\0') {
+		while (ascii_is_space(*list)) {
+			list++;
+		}
+		if ((ascii_strings_count_equal_caseless(type, list) == len) &&
+		    ((list[len] == '\0') || ascii_is_space(list[len]))) {
+			return true;
+		}
+		while ((*list != '\0') && !ascii_is_space(*list)) {
+			list++;
+		}
+	}
+
+	return false;
+}
+
 /**
  * process a LINK element being inserted into the DOM
  *
@@ -199,6 +229,18 @@ static bool html_process_inserted_link(html_content *c, dom_node *node)
 		return false;
 	}
 
+	/* resource hints to warm the connection to a server */
+	if (html_link_rel_has(link.rel, "preconnect") ||
+	    html_link_rel_has(link.rel, "dns-prefetch")) {
+		(void)fetch_preconnect(link.href);
+	}
+
+	/* resource hint to fetch a likely next document */
+	if (nsoption_bool(prefetch) &&
+	    html_link_rel_has(link.rel, "prefetch")) {
+		(void)prefetch_url(link.href, c->base_url, c);
+	}
+
 	/* look for optional properties -- we don't care if internment fails */
 
 	exc = dom_element_get_attribute(node,
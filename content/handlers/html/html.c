@@ -36,6 +36,7 @@
 #include "utils/libdom.h"
 #include "utils/log.h"
 #include "utils/messages.h"
+#include "utils/metrics.h"
 #include "utils/talloc.h"
 #include "utils/utf8.h"
 #include "utils/nsoption.h"
@@ -50,6 +51,7 @@
 #include "content/hlcache.h"
 #include "content/content_factory.h"
 #include "content/textsearch.h"
+#include "content/prefetch.h"
 #include "desktop/selection.h"
 #include "desktop/scrollbar.h"
 #include "desktop/textarea.h"
@@ -1031,6 +1033,9 @@ static void html_stop(struct content *c)
 }
 
 
+/* exported interface documented in html/private.h */
+struct nsmetric *html_metric_layout = NULL;
+
 /**
  * Reformat a CONTENT_HTML to a new width.
  */
@@ -1078,6 +1083,8 @@ static void html_reformat(struct content *c, int width, int height)
 	/* calculate next reflow time at three times what it took to reflow */
 	nsu_getmonotonic_ms(&ms_after);
 
+	nsmetric_sample(html_metric_layout, ms_after - ms_before);
+
 	ms_interval = (ms_after - ms_before) * 3;
 	if (ms_interval < (nsoption_uint(min_reflow_period) * 10)) {
 		ms_interval = nsoption_uint(min_reflow_period) * 10;
@@ -1198,6 +1205,8 @@ static void html_destroy(struct content *c)
 		}
 	}
 
+	prefetch_cancel(html);
+
 	selection_destroy(html->sel);
 
 	/* Destroy forms */
@@ -1344,6 +1353,9 @@ static nserror html_close(struct content *c)
 	/* clear the html content reference to the browser window */
 	htmlc->bw = NULL;
 
+	/* the document is no longer shown so neither are its links */
+	prefetch_cancel(htmlc);
+
 	/* remove all object references from the html content */
 	html_object_close_objects(htmlc);
 
@@ -2010,6 +2022,21 @@ struct content_html_iframe *html_get_iframe(hlcache_handle *h)
 	return c->iframe;
 }
 
+/**
+ * Determine if an HTML document has a script thread
+ *
+ * \param h  Content to inspect
+ * \return true if the document has a script thread
+ */
+bool html_get_scripting(hlcache_handle *h)
+{
+	html_content *c = (html_content *) hlcache_handle_get_content(h);
+
+	assert(c != NULL);
+
+	return c->jsthread != NULL;
+}
+
 /**
  * Retrieve an HTML content's base URL
  *
@@ -2368,6 +2395,10 @@ nserror html_init(void)
 	if (error != NSERROR_OK)
 		goto error;
 
+	/* performance metrics are optional so failure is not fatal */
+	nsmetric_register("html.layout", NSMETRIC_TIMING, &html_metric_layout);
+	nsmetric_register("html.redraw", NSMETRIC_TIMING, &html_metric_redraw);
+
 	for (i = 0; i < NOF_ELEMENTS(html_types); i++) {
 		error = content_factory_register_handler(html_types[i],
 				&html_content_handler);
@@ -179,6 +179,13 @@ struct content_html_frames *html_get_frameset(struct hlcache_handle *h);
  */
 struct content_html_iframe *html_get_iframe(struct hlcache_handle *h);
 
+/**
+ * determine if html content has a script thread
+ *
+ * used by core browser
+ */
+bool html_get_scripting(struct hlcache_handle *h);
+
 /**
  * obtain html base target from handle
  *
@@ -42,6 +42,8 @@
 #include "netsurf/layout.h"
 #include "netsurf/keypress.h"
 #include "content/hlcache.h"
+#include "content/fetch.h"
+#include "content/prefetch.h"
 #include "content/textsearch.h"
 #include "desktop/frames.h"
 #include "desktop/scrollbar.h"
@@ -1130,6 +1132,25 @@ link_mouse_action(html_content *html,
 	mas->result.pointer = get_pointer_shape(mas->link.box,
 						mas->link.is_imagemap);
 
+	if (((mouse & (BROWSER_MOUSE_CLICK_1 | BROWSER_MOUSE_CLICK_2)) == 0) &&
+	    (is_javascript_navigate_url(mas->link.url) == false) &&
+	    (nsurl_compare(mas->link.url,
+			   content_get_url((struct content *)html),
+			   NSURL_SCHEME | NSURL_HOST | NSURL_PORT) == false)) {
+		/* pointing at a link to another server; warm the
+		 * connection to it in case the link is followed
+		 */
+		(void)fetch_preconnect(mas->link.url);
+	}
+
+	if ((mouse == BROWSER_MOUSE_HOVER) &&
+	    nsoption_bool(prefetch_hover) &&
+	    (is_javascript_navigate_url(mas->link.url) == false)) {
+		(void)prefetch_url(mas->link.url,
+				   content_get_url((struct content *)html),
+				   html);
+	}
+
 	if (mouse & BROWSER_MOUSE_CLICK_1 &&
 	    mouse & BROWSER_MOUSE_MOD_1) {
 		/* force download of link */
@@ -217,6 +217,18 @@ typedef struct html_content {
  */
 extern bool html_redraw_debug;
 
+struct nsmetric;
+
+/**
+ * Time taken by each layout in html_reformat() in ms.
+ */
+extern struct nsmetric *html_metric_layout;
+
+/**
+ * Time taken by each html_redraw() in ms.
+ */
+extern struct nsmetric *html_metric_redraw;
+
 
 /* in html/html.c */
 
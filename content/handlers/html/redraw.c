@@ -35,8 +35,10 @@
 #include <string.h>
 #include <math.h>
 #include <dom/dom.h>
+#include <nsutils/time.h>
 
 #include "utils/log.h"
+#include "utils/metrics.h"
 #include "utils/messages.h"
 #include "utils/utils.h"
 #include "utils/nsoption.h"
@@ -67,6 +69,9 @@
 
 bool html_redraw_debug = false;
 
+/* exported interface documented in html/private.h */
+struct nsmetric *html_metric_redraw = NULL;
+
 /**
  * Determine if a box has a background that needs drawing
  *
@@ -1952,6 +1957,10 @@ bool html_redraw(struct content *c, struct content_redraw_data *data,
 		.fill_type = PLOT_OP_TYPE_SOLID,
 		.fill_colour = data->background_colour,
 	};
+	uint64_t ms_before;
+	uint64_t ms_after;
+
+	nsu_getmonotonic_ms(&ms_before);
 
 	box = html->layout;
 	assert(box);
@@ -1996,6 +2005,9 @@ bool html_redraw(struct content *c, struct content_redraw_data *data,
 				data->scale, clip, ctx);
 	}
 
+	nsu_getmonotonic_ms(&ms_after);
+	nsmetric_sample(html_metric_redraw, ms_after - ms_before);
+
 	return result;
 
 }
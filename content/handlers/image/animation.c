@@ -0,0 +1,303 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Shared animation clock implementation.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <nsutils/time.h>
+
+#include "utils/errors.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+#include "netsurf/misc.h"
+#include "desktop/gui_internal.h"
+
+#include "image/animation.h"
+
+/**
+ * Clock tick interval in ms.
+ *
+ * Frames due within a tick of each other are advanced together.
+ */
+#define IMAGE_ANIMATION_TICK 20
+
+/**
+ * Time in ms a redraw request may remain unplotted before the animation
+ * is considered not visible.
+ */
+#define IMAGE_ANIMATION_GRACE 500
+
+/**
+ * Most frames advanced in one tick when catching up.
+ */
+#define IMAGE_ANIMATION_CATCHUP 64
+
+/**
+ * Read the system monotonic time.
+ *
+ * \return The current time in ms.
+ */
+static uint64_t image_animation_monotonic(void)
+{
+	uint64_t now;
+
+	nsu_getmonotonic_ms(&now);
+
+	return now;
+}
+
+/** Time source of the clock */
+static image_animation_clock_fn *image_animation_now = image_animation_monotonic;
+
+/** Animations advanced by the clock */
+static struct image_animation *image_animation_list = NULL;
+
+/** frames advanced */
+static struct nsmetric *image_animation_frames = NULL;
+
+/** animations paused as not visible */
+static struct nsmetric *image_animation_pauses = NULL;
+
+static void image_animation_tick(void *p);
+
+
+/**
+ * Schedule the clock for the earliest frame due.
+ *
+ * \param now The current time (ms).
+ */
+static void image_animation_schedule(uint64_t now)
+{
+	struct image_animation *anim;
+	uint64_t due = UINT64_MAX;
+
+	for (anim = image_animation_list; anim != NULL; anim = anim->next) {
+		if (anim->due < due) {
+			due = anim->due;
+		}
+	}
+
+	if (due == UINT64_MAX) {
+		guit->misc->schedule(-1, image_animation_tick, NULL);
+	} else if (due <= now) {
+		guit->misc->schedule(0, image_animation_tick, NULL);
+	} else {
+		guit->misc->schedule(due - now, image_animation_tick, NULL);
+	}
+}
+
+
+/**
+ * Remove an animation from the clocked list.
+ *
+ * \param anim The animation to remove.
+ */
+static void image_animation_unlink(struct image_animation *anim)
+{
+	struct image_animation **link = &image_animation_list;
+
+	while (*link != NULL) {
+		if (*link == anim) {
+			*link = anim->next;
+			break;
+		}
+		link = &(*link)->next;
+	}
+	anim->next = NULL;
+}
+
+
+/**
+ * Advance an animation which is due.
+ *
+ * \param anim The animation to advance.
+ * \param now The current time (ms).
+ * \return true if the animation is to continue.
+ */
+static bool image_animation_advance(struct image_animation *anim, uint64_t now)
+{
+	unsigned int frames = 0;
+	unsigned int delay;
+
+	do {
+		delay = anim->advance(anim->c);
+		frames++;
+		if (delay == 0) {
+			break;
+		}
+		anim->due += delay;
+	} while ((anim->due <= now) && (frames < IMAGE_ANIMATION_CATCHUP));
+
+	nsmetric_add(image_animation_frames, frames);
+
+	if ((delay != 0) && (anim->due <= now)) {
+		/* too far behind, drop the rest */
+		anim->due = now + delay;
+	}
+
+	if (anim->redraw(anim->c, frames) && (anim->pending == 0)) {
+		anim->pending = now;
+	}
+
+	return (delay != 0);
+}
+
+
+/**
+ * Clock callback advancing every animation which is due.
+ *
+ * \param p unused
+ */
+static void image_animation_tick(void *p)
+{
+	struct image_animation **link = &image_animation_list;
+	struct image_animation *anim;
+	uint64_t now;
+
+	now = image_animation_now();
+
+	while ((anim = *link) != NULL) {
+		if (anim->due > now + IMAGE_ANIMATION_TICK / 2) {
+			link = &anim->next;
+			continue;
+		}
+
+		if ((anim->pending != 0) &&
+		    (now - anim->pending > IMAGE_ANIMATION_GRACE)) {
+			/* not plotted since the last frame so not visible */
+			anim->paused = true;
+			nsmetric_add(image_animation_pauses, 1);
+		} else if (image_animation_advance(anim, now)) {
+			link = &anim->next;
+			continue;
+		} else {
+			anim->running = false;
+		}
+
+		*link = anim->next;
+		anim->next = NULL;
+	}
+
+	image_animation_schedule(now);
+}
+
+
+/* exported interface documented in image/animation.h */
+void
+image_animation_init(struct image_animation *anim,
+		     struct content *c,
+		     image_animation_advance_fn *advance,
+		     image_animation_redraw_fn *redraw)
+{
+	anim->c = c;
+	anim->advance = advance;
+	anim->redraw = redraw;
+	anim->due = 0;
+	anim->pending = 0;
+	anim->running = false;
+	anim->paused = false;
+	anim->next = NULL;
+
+	if (image_animation_frames == NULL) {
+		nsmetric_register("image.animation.frames",
+				  NSMETRIC_COUNTER,
+				  &image_animation_frames);
+		nsmetric_register("image.animation.pauses",
+				  NSMETRIC_COUNTER,
+				  &image_animation_pauses);
+	}
+}
+
+
+/* exported interface documented in image/animation.h */
+void image_animation_start(struct image_animation *anim, unsigned int delay)
+{
+	uint64_t now;
+
+	now = image_animation_now();
+
+	if ((anim->running == false) || anim->paused) {
+		anim->next = image_animation_list;
+		image_animation_list = anim;
+	}
+
+	anim->due = now + delay;
+	anim->pending = 0;
+	anim->running = true;
+	anim->paused = false;
+
+	image_animation_schedule(now);
+}
+
+
+/* exported interface documented in image/animation.h */
+void image_animation_stop(struct image_animation *anim)
+{
+	uint64_t now;
+
+	if (anim->running == false) {
+		return;
+	}
+
+	if (anim->paused == false) {
+		image_animation_unlink(anim);
+
+		now = image_animation_now();
+		image_animation_schedule(now);
+	}
+
+	anim->running = false;
+	anim->paused = false;
+}
+
+
+/* exported interface documented in image/animation.h */
+void image_animation_plotted(struct image_animation *anim)
+{
+	uint64_t now;
+
+	anim->pending = 0;
+
+	if (anim->paused == false) {
+		return;
+	}
+
+	NSLOG(netsurf, DEBUG, "resuming animation %p", anim);
+
+	/* the frames due while paused are caught up on the next tick */
+	anim->paused = false;
+	anim->next = image_animation_list;
+	image_animation_list = anim;
+
+	now = image_animation_now();
+	image_animation_schedule(now);
+}
+
+
+/* exported interface documented in image/animation.h */
+void image_animation_set_clock(image_animation_clock_fn *clock)
+{
+	if (clock == NULL) {
+		clock = image_animation_monotonic;
+	}
+	image_animation_now = clock;
+}
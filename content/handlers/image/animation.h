@@ -0,0 +1,129 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Shared animation clock for animated image contents.
+ *
+ * Every running animation is advanced from a single scheduled callback
+ * so frames falling due close together are shown in the same tick.
+ *
+ * An animation whose redraw requests are not followed by the content
+ * being plotted is considered not visible (off screen, clipped or in a
+ * background window) and is paused. It resumes when the content is next
+ * plotted, catching up on the frames due while it was paused.
+ */
+
+#ifndef NETSURF_IMAGE_ANIMATION_H
+#define NETSURF_IMAGE_ANIMATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct content;
+
+/**
+ * Advance an animation by a frame.
+ *
+ * \param c The content being animated.
+ * \return The time in ms until the following frame or 0 to stop.
+ */
+typedef unsigned int (image_animation_advance_fn)(struct content *c);
+
+/**
+ * Request a redraw of the frames an animation advanced.
+ *
+ * \param c The content being animated.
+ * \param frames The number of frames advanced since the last redraw.
+ * \return true if a redraw was requested, false if there was nothing to
+ *         show.
+ */
+typedef bool (image_animation_redraw_fn)(struct content *c, unsigned int frames);
+
+/**
+ * Get the current time for the animation clock.
+ *
+ * \return The current monotonic time in ms.
+ */
+typedef uint64_t (image_animation_clock_fn)(void);
+
+/**
+ * Animation state embedded in an animated content.
+ */
+struct image_animation {
+	struct content *c; /**< content being animated */
+	image_animation_advance_fn *advance; /**< frame advance */
+	image_animation_redraw_fn *redraw; /**< redraw request */
+
+	uint64_t due; /**< time the next frame is due (ms) */
+	uint64_t pending; /**< time of unplotted redraw request or 0 */
+	bool running; /**< animation has been started */
+	bool paused; /**< animation paused as not visible */
+
+	struct image_animation *next; /**< next clocked animation */
+};
+
+/**
+ * Initialise the animation state of a content.
+ *
+ * \param anim The animation state to initialise.
+ * \param c The content being animated.
+ * \param advance The frame advance callback.
+ * \param redraw The redraw request callback.
+ */
+void image_animation_init(struct image_animation *anim, struct content *c, image_animation_advance_fn *advance, image_animation_redraw_fn *redraw);
+
+/**
+ * Start an animation.
+ *
+ * If the animation is already running the time of the next frame is
+ * updated.
+ *
+ * \param anim The animation to start.
+ * \param delay The time in ms until the first frame advance.
+ */
+void image_animation_start(struct image_animation *anim, unsigned int delay);
+
+/**
+ * Stop an animation.
+ *
+ * \param anim The animation to stop.
+ */
+void image_animation_stop(struct image_animation *anim);
+
+/**
+ * Note an animated content has been plotted.
+ *
+ * Content redraw handlers call this so the clock knows the animation
+ * is visible, resuming it if it was paused.
+ *
+ * \param anim The animation of the plotted content.
+ */
+void image_animation_plotted(struct image_animation *anim);
+
+/**
+ * Replace the time source of the animation clock.
+ *
+ * The clock reads the system monotonic time unless replaced, which is
+ * only useful to drive the clock deterministically.
+ *
+ * \param clock The time source or NULL for the system monotonic time.
+ */
+void image_animation_set_clock(image_animation_clock_fn *clock);
+
+#endif
@@ -36,6 +36,7 @@
 #include "content/content_factory.h"
 #include "desktop/gui_internal.h"
 
+#include "image/image.h"
 #include "image/bmp.h"
 
 /** bmp context. */
@@ -217,6 +218,18 @@ static void nsbmp_destroy(struct content *c)
 }
 
 
+/**
+ * Estimate the memory held by a BMP content.
+ */
+static size_t nsbmp_memory_size(const struct content *c)
+{
+	const nsbmp_content *bmp = (const nsbmp_content *) c;
+
+	return sizeof(nsbmp_content) + sizeof(bmp_image) +
+		image_bitmap_memory_size(bmp->bitmap);
+}
+
+
 static nserror nsbmp_clone(const struct content *old, struct content **newc)
 {
 	nsbmp_content *new_bmp;
@@ -284,6 +297,7 @@ static const content_handler nsbmp_content_handler = {
 	.get_internal = nsbmp_get_internal,
 	.type = nsbmp_content_type,
 	.is_opaque = nsbmp_content_is_opaque,
+	.memory_size = nsbmp_memory_size,
 	.no_share = false,
 };
 
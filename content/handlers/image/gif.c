@@ -49,6 +49,7 @@
 #include "desktop/gui_internal.h"
 
 #include "image/image.h"
+#include "image/animation.h"
 #include "image/gif.h"
 
 typedef struct nsgif_content {
@@ -56,8 +57,24 @@ typedef struct nsgif_content {
 
 	struct gif_animation *gif; /**< GIF animation data */
 	int current_frame;   /**< current frame to display [0...(max-1)] */
+	struct image_coverage coverage; /**< coverage of the decoded frame */
+	struct image_coverage *frame_coverage; /**< coverage of each frame */
+	int frame_coverage_count; /**< number of entries in frame_coverage */
+	struct image_animation anim; /**< animation clock state */
 } nsgif_content;
 
+/**
+ * Coverage of the most recently decoded frame.
+ *
+ * libnsgif tests the opacity of a frame only the first time it is
+ * decoded, the coverage computed by that test is handed to the
+ * content here and kept for later decodes of the frame.
+ */
+static struct {
+	void *bitmap; /**< bitmap the coverage was computed for */
+	struct image_coverage coverage;
+} nsgif_frame_coverage;
+
 
 /**
  * Callback for libnsgif; forwards the call to bitmap_create()
@@ -72,6 +89,28 @@ static void *nsgif_bitmap_create(int width, int height)
 }
 
 
+/**
+ * Callback for libnsgif; tests the opacity of a decoded frame
+ *
+ * The pixel coverage of the frame is computed while testing and
+ * retained for the redraw.
+ *
+ * \param  bitmap  the frame bitmap
+ * \return true if every pixel of the frame is opaque
+ */
+static bool nsgif_bitmap_test_opaque(void *bitmap)
+{
+	nsgif_frame_coverage.bitmap = bitmap;
+	if (!image_coverage_bitmap(&nsgif_frame_coverage.coverage, bitmap)) {
+		return false;
+	}
+	return nsgif_frame_coverage.coverage.opaque;
+}
+
+
+static unsigned int nsgif_animate(struct content *c);
+static bool nsgif_animate_redraw(struct content *c, unsigned int frames);
+
 static nserror nsgif_create_gif_data(nsgif_content *c)
 {
 	gif_bitmap_callback_vt gif_bitmap_callbacks = {
@@ -79,7 +118,7 @@ static nserror nsgif_create_gif_data(nsgif_content *c)
 		.bitmap_destroy = guit->bitmap->destroy,
 		.bitmap_get_buffer = guit->bitmap->get_buffer,
 		.bitmap_set_opaque = guit->bitmap->set_opaque,
-		.bitmap_test_opaque = guit->bitmap->test_opaque,
+		.bitmap_test_opaque = nsgif_bitmap_test_opaque,
 		.bitmap_modified = guit->bitmap->modified
 	};
 
@@ -90,6 +129,10 @@ static nserror nsgif_create_gif_data(nsgif_content *c)
 		return NSERROR_NOMEM;
 	}
 	gif_create(c->gif, &gif_bitmap_callbacks);
+
+	image_animation_init(&c->anim, &c->base,
+			nsgif_animate, nsgif_animate_redraw);
+
 	return NSERROR_OK;
 }
 
@@ -126,16 +169,33 @@ static nserror nsgif_create(const content_handler *handler,
 }
 
 /**
- * Performs any necessary animation.
+ * Get the display time of a frame
  *
- * \param p  The content to animate
-*/
-static void nsgif_animate(void *p)
+ * \param gif The gif content
+ * \param frame The frame index
+ * \return The time in ms to display the frame for
+ */
+static unsigned int nsgif_frame_delay(nsgif_content *gif, int frame)
 {
-	nsgif_content *gif = p;
-	union content_msg_data data;
-	int delay;
-	int f;
+	int delay = gif->gif->frames[frame].frame_delay;
+
+	if (delay <= 1) {
+		/* Assuming too fast to be intended, set default. */
+		delay = 10;
+	}
+
+	return delay * 10;
+}
+
+/**
+ * Advances the animation by a frame.
+ *
+ * \param c  The content to animate
+ * \return The time in ms until the next frame or 0 when finished
+ */
+static unsigned int nsgif_animate(struct content *c)
+{
+	nsgif_content *gif = (nsgif_content *) c;
 
 	/* Advance by a frame, updating the loop count accordingly */
 	gif->current_frame++;
@@ -154,18 +214,29 @@ static void nsgif_animate(void *p)
 	}
 
 	/* Continue animating if we should */
-	if (gif->gif->loop_count >= 0) {
-		delay = gif->gif->frames[gif->current_frame].frame_delay;
-		if (delay <= 1) {
-			/* Assuming too fast to be intended, set default. */
-			delay = 10;
-		}
-		guit->misc->schedule(delay * 10, nsgif_animate, gif);
+	if (gif->gif->loop_count < 0) {
+		return 0;
 	}
 
+	return nsgif_frame_delay(gif, gif->current_frame);
+}
+
+/**
+ * Requests a redraw of the area changed by animation.
+ *
+ * \param c  The content being animated
+ * \param frames  The number of frames advanced
+ * \return true if a redraw was requested
+ */
+static bool nsgif_animate_redraw(struct content *c, unsigned int frames)
+{
+	nsgif_content *gif = (nsgif_content *) c;
+	union content_msg_data data;
+	int f;
+
 	if ((!nsoption_bool(animate_images)) ||
 	    (!gif->gif->frames[gif->current_frame].display)) {
-		return;
+		return false;
 	}
 
 	/* area within gif to redraw */
@@ -175,8 +246,15 @@ static void nsgif_animate(void *p)
 	data.redraw.width = gif->gif->frames[f].redraw_width;
 	data.redraw.height = gif->gif->frames[f].redraw_height;
 
-	/* redraw background (true) or plot on top (false) */
-	if (gif->current_frame > 0) {
+	if (frames > 1) {
+		/* several frames shown at once, redraw everything */
+		data.redraw.x = 0;
+		data.redraw.y = 0;
+		data.redraw.width = gif->gif->width;
+		data.redraw.height = gif->gif->height;
+
+	} else if (gif->current_frame > 0) {
+		/* redraw background (true) or plot on top (false) */
 		/* previous frame needed clearing: expand the redraw area to
 		 * cover it */
 		if (gif->gif->frames[f - 1].redraw_required) {
@@ -212,6 +290,8 @@ static void nsgif_animate(void *p)
 	}
 
 	content_broadcast(&gif->base, CONTENT_MSG_REDRAW, &data);
+
+	return true;
 }
 
 static bool nsgif_convert(struct content *c)
@@ -270,9 +350,7 @@ static bool nsgif_convert(struct content *c)
 	/* Schedule the animation if we have one */
 	gif->current_frame = 0;
 	if (gif->gif->frame_count_partial > 1)
-		guit->misc->schedule(gif->gif->frames[0].frame_delay * 10,
-					nsgif_animate,
-					c);
+		image_animation_start(&gif->anim, nsgif_frame_delay(gif, 0));
 
 	/* Exit as a success */
 	content_set_ready(c);
@@ -284,6 +362,41 @@ static bool nsgif_convert(struct content *c)
 }
 
 
+/**
+ * Retain the coverage computed for a frame
+ *
+ * \param gif The gif content
+ * \param frame The index of the frame the coverage was computed for
+ * \param cov The coverage of the frame
+ */
+static void
+nsgif_store_coverage(nsgif_content *gif,
+		     int frame,
+		     const struct image_coverage *cov)
+{
+	struct image_coverage *frame_coverage;
+	int count;
+
+	if (frame >= gif->frame_coverage_count) {
+		count = gif->gif->frame_count_partial;
+		if (count <= frame) {
+			count = frame + 1;
+		}
+		frame_coverage = realloc(gif->frame_coverage,
+				count * sizeof(*frame_coverage));
+		if (frame_coverage == NULL) {
+			return;
+		}
+		while (gif->frame_coverage_count < count) {
+			image_coverage_init(
+				&frame_coverage[gif->frame_coverage_count++]);
+		}
+		gif->frame_coverage = frame_coverage;
+	}
+
+	gif->frame_coverage[frame] = *cov;
+}
+
 /**
  * Updates the GIF bitmap to display the current frame
  *
@@ -307,7 +420,19 @@ static gif_result nsgif_get_frame(nsgif_content *gif)
 	}
 
 	for (frame = previous_frame; frame <= current_frame; frame++) {
+		nsgif_frame_coverage.bitmap = NULL;
 		res = gif_decode_frame(gif->gif, frame);
+		if ((res == GIF_OK) &&
+		    (nsgif_frame_coverage.bitmap == gif->gif->frame_image)) {
+			nsgif_store_coverage(gif, frame,
+					&nsgif_frame_coverage.coverage);
+		}
+	}
+
+	if ((res == GIF_OK) && (current_frame < gif->frame_coverage_count)) {
+		gif->coverage = gif->frame_coverage[current_frame];
+	} else {
+		image_coverage_init(&gif->coverage);
 	}
 
 	return res;
@@ -318,13 +443,16 @@ static bool nsgif_redraw(struct content *c, struct content_redraw_data *data,
 {
 	nsgif_content *gif = (nsgif_content *) c;
 
+	image_animation_plotted(&gif->anim);
+
 	if (gif->current_frame != gif->gif->decoded_frame) {
 		if (nsgif_get_frame(gif) != GIF_OK) {
 			return false;
 		}
 	}
 
-	return image_bitmap_plot(gif->gif->frame_image, data, clip, ctx);
+	return image_bitmap_plot(gif->gif->frame_image, &gif->coverage,
+				 data, clip, ctx);
 }
 
 
@@ -333,9 +461,33 @@ static void nsgif_destroy(struct content *c)
 	nsgif_content *gif = (nsgif_content *) c;
 
 	/* Free all the associated memory buffers */
-	guit->misc->schedule(-1, nsgif_animate, c);
+	image_animation_stop(&gif->anim);
 	gif_finalise(gif->gif);
 	free(gif->gif);
+	free(gif->frame_coverage);
+}
+
+
+/**
+ * Estimate the memory held by a GIF content.
+ *
+ * The frame bitmap is the full size of the image and is kept for the
+ * life of the content so it dominates the estimate.
+ */
+static size_t nsgif_memory_size(const struct content *c)
+{
+	const nsgif_content *gif = (const nsgif_content *) c;
+	size_t size = sizeof(nsgif_content);
+
+	size += gif->frame_coverage_count * sizeof(struct image_coverage);
+
+	if (gif->gif != NULL) {
+		size += sizeof(gif_animation);
+		size += gif->gif->frame_count_partial * sizeof(gif_frame);
+		size += image_bitmap_memory_size(gif->gif->frame_image);
+	}
+
+	return size;
 }
 
 
@@ -385,17 +537,19 @@ static void nsgif_add_user(struct content *c)
 	if (content_count_users(c) == 1) {
 		/* First user, and content already converted, so start the animation. */
 		if (gif->gif->frame_count_partial > 1) {
-			guit->misc->schedule(gif->gif->frames[0].frame_delay * 10,
-				nsgif_animate, c);
+			image_animation_start(&gif->anim,
+					nsgif_frame_delay(gif, 0));
 		}
 	}
 }
 
 static void nsgif_remove_user(struct content *c)
 {
+	nsgif_content *gif = (nsgif_content *) c;
+
 	if (content_count_users(c) == 1) {
 		/* Last user is about to be removed from this content, so stop the animation. */
-		guit->misc->schedule(-1, nsgif_animate, c);
+		image_animation_stop(&gif->anim);
 	}
 }
 
@@ -440,6 +594,7 @@ static const content_handler nsgif_content_handler = {
 	.get_internal = nsgif_get_internal,
 	.type = nsgif_content_type,
 	.is_opaque = nsgif_content_is_opaque,
+	.memory_size = nsgif_memory_size,
 	.no_share = false,
 };
 
@@ -199,7 +199,7 @@ static bool nsico_redraw(struct content *c, struct content_redraw_data *data,
 
 	}
 
-	return image_bitmap_plot(bmp->bitmap, data, clip, ctx);
+	return image_bitmap_plot(bmp->bitmap, NULL, data, clip, ctx);
 }
 
 
@@ -211,6 +211,26 @@ static void nsico_destroy(struct content *c)
 	free(ico->ico);
 }
 
+
+/**
+ * Estimate the memory held by an ICO content.
+ *
+ * Each image in the collection has its own bitmap.
+ */
+static size_t nsico_memory_size(const struct content *c)
+{
+	const nsico_content *ico = (const nsico_content *) c;
+	const struct ico_image *image;
+	size_t size = sizeof(nsico_content) + sizeof(struct ico_collection);
+
+	for (image = ico->ico->first; image != NULL; image = image->next) {
+		size += sizeof(struct ico_image);
+		size += image_bitmap_memory_size(image->bmp.bitmap);
+	}
+
+	return size;
+}
+
 static nserror nsico_clone(const struct content *old, struct content **newc)
 {
 	nsico_content *ico;
@@ -312,6 +332,7 @@ static const content_handler nsico_content_handler = {
 	.get_internal = nsico_get_internal,
 	.type = nsico_content_type,
 	.is_opaque = nsico_is_opaque,
+	.memory_size = nsico_memory_size,
 	.no_share = false,
 };
 
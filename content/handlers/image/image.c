@@ -18,6 +18,7 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include "utils/utils.h"
 #include "utils/log.h"
@@ -105,7 +106,186 @@ nserror image_init(void)
 }
 
 
+/* exported interface documented in image/image.h */
+void image_coverage_init(struct image_coverage *cov)
+{
+	cov->valid = false;
+	cov->opaque = true;
+	cov->rows = 0;
+	cov->bounds.x0 = INT_MAX;
+	cov->bounds.y0 = INT_MAX;
+	cov->bounds.x1 = 0;
+	cov->bounds.y1 = 0;
+}
+
+
+/* exported interface documented in image/image.h */
+void
+image_coverage_row(struct image_coverage *cov,
+		   int y,
+		   const uint8_t *row,
+		   int width)
+{
+	const uint8_t *alpha = row + 3;
+	int first;
+	int last;
+	int x;
+
+	cov->rows++;
+
+	/* find the first and last pixels which are not transparent */
+	for (first = 0; first < width; first++) {
+		if (alpha[first * 4] != 0) {
+			break;
+		}
+	}
+	if (first == width) {
+		cov->opaque = false;
+		return;
+	}
+	for (last = width - 1; alpha[last * 4] == 0; last--);
+
+	if (first < cov->bounds.x0) cov->bounds.x0 = first;
+	if (last + 1 > cov->bounds.x1) cov->bounds.x1 = last + 1;
+	if (y < cov->bounds.y0) cov->bounds.y0 = y;
+	if (y + 1 > cov->bounds.y1) cov->bounds.y1 = y + 1;
+
+	if (cov->opaque) {
+		if ((first != 0) || (last != width - 1)) {
+			cov->opaque = false;
+			return;
+		}
+		for (x = first; x <= last; x++) {
+			if (alpha[x * 4] != 0xff) {
+				cov->opaque = false;
+				break;
+			}
+		}
+	}
+}
+
+
+/* exported interface documented in image/image.h */
+bool image_coverage_complete(struct image_coverage *cov, int height)
+{
+	cov->valid = (cov->rows >= height);
+
+	return cov->valid;
+}
+
+
+/* exported interface documented in image/image.h */
+void image_coverage_opaque(struct image_coverage *cov, int width, int height)
+{
+	cov->valid = true;
+	cov->opaque = true;
+	cov->rows = height;
+	cov->bounds.x0 = 0;
+	cov->bounds.y0 = 0;
+	cov->bounds.x1 = width;
+	cov->bounds.y1 = height;
+}
+
+
+/* exported interface documented in image/image.h */
+bool image_coverage_bitmap(struct image_coverage *cov, struct bitmap *bitmap)
+{
+	const uint8_t *buffer;
+	size_t rowstride;
+	int width;
+	int height;
+	int y;
+
+	image_coverage_init(cov);
+
+	buffer = guit->bitmap->get_buffer(bitmap);
+	if (buffer == NULL) {
+		return false;
+	}
+
+	rowstride = guit->bitmap->get_rowstride(bitmap);
+	width = guit->bitmap->get_width(bitmap);
+	height = guit->bitmap->get_height(bitmap);
+
+	for (y = 0; y < height; y++) {
+		image_coverage_row(cov, y, buffer + (rowstride * y), width);
+	}
+
+	return image_coverage_complete(cov, height);
+}
+
+
+/* exported interface documented in image/image.h */
+size_t image_bitmap_memory_size(struct bitmap *bitmap)
+{
+	if (bitmap == NULL) {
+		return 0;
+	}
+
+	return guit->bitmap->get_rowstride(bitmap) *
+		guit->bitmap->get_height(bitmap);
+}
+
+
+/**
+ * Plot a bitmap clipped to the area it draws.
+ *
+ * \param bitmap The bitmap to plot.
+ * \param cov The valid coverage of the bitmap.
+ * \param data The content redraw data.
+ * \param clip The current clip rectangle.
+ * \param ctx The redraw context.
+ * \return true on success else false.
+ */
+static bool
+image_bitmap_plot_clipped(struct bitmap *bitmap,
+			  const struct image_coverage *cov,
+			  struct content_redraw_data *data,
+			  const struct rect *clip,
+			  const struct redraw_context *ctx)
+{
+	int bmwidth = guit->bitmap->get_width(bitmap);
+	int bmheight = guit->bitmap->get_height(bitmap);
+	struct rect area;
+	nserror res;
+
+	/* scale the bounds to the plot, allowing a pixel either side
+	 * for plotters which filter when scaling */
+	area.x0 = data->x + (cov->bounds.x0 * data->width) / bmwidth - 1;
+	area.y0 = data->y + (cov->bounds.y0 * data->height) / bmheight - 1;
+	area.x1 = data->x + (cov->bounds.x1 * data->width + bmwidth - 1) /
+		bmwidth + 1;
+	area.y1 = data->y + (cov->bounds.y1 * data->height + bmheight - 1) /
+		bmheight + 1;
+
+	if (area.x0 < clip->x0) area.x0 = clip->x0;
+	if (area.y0 < clip->y0) area.y0 = clip->y0;
+	if (area.x1 > clip->x1) area.x1 = clip->x1;
+	if (area.y1 > clip->y1) area.y1 = clip->y1;
+
+	if ((area.x0 >= area.x1) || (area.y0 >= area.y1)) {
+		/* nothing drawn within the clip */
+		return true;
+	}
+
+	res = ctx->plot->clip(ctx, &area);
+	if (res == NSERROR_OK) {
+		res = ctx->plot->bitmap(ctx,
+					bitmap,
+					data->x, data->y,
+					data->width, data->height,
+					data->background_colour,
+					BITMAPF_NONE);
+	}
+	ctx->plot->clip(ctx, clip);
+
+	return (res == NSERROR_OK);
+}
+
+
+/* exported interface documented in image/image.h */
 bool image_bitmap_plot(struct bitmap *bitmap,
+		       const struct image_coverage *cov,
 		       struct content_redraw_data *data,
 		       const struct rect *clip,
 		       const struct redraw_context *ctx)
@@ -118,6 +298,22 @@ bool image_bitmap_plot(struct bitmap *bitmap,
 	plot_style_t fill_style;
 	struct rect area;
 
+	if ((cov != NULL) && cov->valid) {
+		if (cov->bounds.x0 >= cov->bounds.x1) {
+			/* fully transparent, nothing to plot */
+			return true;
+		}
+
+		if ((cov->opaque == false) &&
+		    (data->repeat_x == false) &&
+		    (data->repeat_y == false) &&
+		    (data->width > 0) &&
+		    (data->height > 0)) {
+			return image_bitmap_plot_clipped(bitmap, cov,
+							 data, clip, ctx);
+		}
+	}
+
 	width = guit->bitmap->get_width(bitmap);
 	if (width == 1) {
 		height = guit->bitmap->get_height(bitmap);
@@ -126,7 +322,8 @@ bool image_bitmap_plot(struct bitmap *bitmap,
 			pixel = guit->bitmap->get_buffer(bitmap);
 			fill_style.fill_colour = pixel_to_colour(pixel);
 
-			if (guit->bitmap->get_opaque(bitmap) ||
+			if (((cov != NULL) && cov->valid && cov->opaque) ||
+			    guit->bitmap->get_opaque(bitmap) ||
 			    ((fill_style.fill_colour & 0xff000000) == 0xff000000)) {
 
 				area = *clip;
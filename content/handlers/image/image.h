@@ -23,21 +23,109 @@
 #ifndef NETSURF_IMAGE_IMAGE_H_
 #define NETSURF_IMAGE_IMAGE_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "utils/errors.h"
+#include "netsurf/types.h"
 
+struct bitmap;
 struct content_redraw_data;
 
+/**
+ * Pixel coverage of a decoded image.
+ *
+ * Decoders accumulate this as rows are decoded so the opacity of an
+ * image and the area it actually draws are known without scanning
+ * the bitmap afterwards.
+ */
+struct image_coverage {
+	bool valid; /**< every row has been accounted for */
+	bool opaque; /**< every pixel is fully opaque */
+	int rows; /**< number of rows accounted for */
+	/** bounds of the pixels which are not fully transparent,
+	 * empty (x0 >= x1) if there are none. */
+	struct rect bounds;
+};
+
 /** Initialise the content handlers for image types.
  */
 nserror image_init(void);
 
+/**
+ * Start accumulating the coverage of an image.
+ *
+ * \param cov The coverage to initialise.
+ */
+void image_coverage_init(struct image_coverage *cov);
+
+/**
+ * Account for a decoded row of an image.
+ *
+ * \param cov The coverage to update.
+ * \param y The index of the row.
+ * \param row The row pixel data in bitmap (RGBA) byte order.
+ * \param width The number of pixels in the row.
+ */
+void image_coverage_row(struct image_coverage *cov, int y, const uint8_t *row, int width);
+
+/**
+ * Complete the coverage of an image.
+ *
+ * \param cov The coverage to complete.
+ * \param height The height of the image.
+ * \return true if every row was accounted for and the coverage is valid.
+ */
+bool image_coverage_complete(struct image_coverage *cov, int height);
+
+/**
+ * Set the coverage of an image which is entirely opaque.
+ *
+ * \param cov The coverage to set.
+ * \param width The width of the image.
+ * \param height The height of the image.
+ */
+void image_coverage_opaque(struct image_coverage *cov, int width, int height);
+
+/**
+ * Compute the coverage of an image from its bitmap.
+ *
+ * Used when the decoder does not deliver rows in order.
+ *
+ * \param cov The coverage to compute.
+ * \param bitmap The decoded bitmap.
+ * \return true if the coverage is valid.
+ */
+bool image_coverage_bitmap(struct image_coverage *cov, struct bitmap *bitmap);
+
+/**
+ * Estimate the memory held by a decoded bitmap.
+ *
+ * \param bitmap The bitmap to measure or NULL.
+ * \return The size of the bitmap pixel data in bytes, zero if \a bitmap
+ *         is NULL.
+ */
+size_t image_bitmap_memory_size(struct bitmap *bitmap);
+
 /** Common image content handler bitmap plot call.
  *
  * This plots the specified bitmap controlled by the redraw context
  * and specific content redraw data. It is a helper specifically
  * provided for image content handlers redraw callback.
+ *
+ * When the coverage of the bitmap is known fully transparent bitmaps
+ * are not plotted at all and the plot of a partially transparent
+ * bitmap is clipped to the area it draws.
+ *
+ * \param bitmap The bitmap to plot.
+ * \param cov The coverage of the bitmap or NULL if unknown.
+ * \param data The content redraw data.
+ * \param clip The current clip rectangle.
+ * \param ctx The redraw context.
+ * \return true on success else false.
  */
 bool image_bitmap_plot(struct bitmap *bitmap,
+		       const struct image_coverage *cov,
 		       struct content_redraw_data *data, 
 		       const struct rect *clip,
 		       const struct redraw_context *ctx);
@@ -60,6 +60,8 @@ struct image_cache_entry_s {
 	struct bitmap *bitmap;
 	/** routine to convert content into bitmap */
 	image_cache_convert_fn *convert;
+	/** pixel coverage recorded by the decoder */
+	struct image_coverage coverage;
 
 	/* Statistics for replacement algorithm */
 
@@ -834,7 +836,8 @@ bool image_cache_redraw(struct content *c,
 	centry->redraw_count++;
 	centry->redraw_age = image_cache->current_age;
 
-	return image_bitmap_plot(centry->bitmap, data, clip, ctx);
+	return image_bitmap_plot(centry->bitmap, &centry->coverage,
+				 data, clip, ctx);
 }
 
 /* exported interface documented in image_cache.h */
@@ -858,10 +861,31 @@ void *image_cache_get_internal(const struct content *c, void *context)
 	return image_cache_get_bitmap(c);
 }
 
+/* exported interface documented in image_cache.h */
+void image_cache_set_coverage(struct content *content,
+			      const struct image_coverage *cov)
+{
+	struct image_cache_entry_s *centry;
+
+	centry = image_cache__find(content);
+	if ((centry != NULL) && cov->valid) {
+		centry->coverage = *cov;
+	}
+}
+
 /* exported interface documented in image_cache.h */
 bool image_cache_is_opaque(struct content *c)
 {
+	struct image_cache_entry_s *centry;
 	struct bitmap *bmp;
+
+	/* the recorded coverage remains valid when the bitmap has been
+	 * discarded so need not cause a conversion */
+	centry = image_cache__find(c);
+	if ((centry != NULL) && centry->coverage.valid) {
+		return centry->coverage.opaque;
+	}
+
 	bmp = image_cache_get_bitmap(c);
 	if (bmp != NULL) {
 		return guit->bitmap->get_opaque(bmp);
@@ -869,6 +893,12 @@ bool image_cache_is_opaque(struct content *c)
 	return false;
 }
 
+/* exported interface documented in image_cache.h */
+size_t image_cache_memory_size(const struct content *c)
+{
+	return sizeof(struct content) + sizeof(struct image_cache_entry_s);
+}
+
 /* exported interface documented in image_cache.h */
 content_type image_cache_content_type(void)
 {
@@ -43,6 +43,7 @@
 struct content;
 struct content_redraw_data;
 struct redraw_context;
+struct image_coverage;
 
 typedef struct bitmap * (image_cache_convert_fn) (struct content *content);
 
@@ -80,6 +81,18 @@ nserror image_cache_add(struct content *content,
 
 nserror image_cache_remove(struct content *content);
 
+/**
+ * Record the pixel coverage of a cached image.
+ *
+ * Decoders call this once an image has been decoded. The coverage is
+ * kept while the bitmap is discarded and regenerated so opacity is
+ * known without a conversion.
+ *
+ * \param content The content handle used as a key
+ * \param cov The coverage, ignored if not valid
+ */
+void image_cache_set_coverage(struct content *content, const struct image_coverage *cov);
+
 
 /** Obtain a bitmap from a content converting from source if neccessary. */
 struct bitmap *image_cache_get_bitmap(const struct content *c);
@@ -189,6 +202,14 @@ void *image_cache_get_internal(const struct content *c, void *context);
 
 bool image_cache_is_opaque(struct content *c);
 
+/**
+ * Generic content memory size callback
+ *
+ * The bitmap of a cached image is accounted for and discarded by the
+ * image cache so only the content itself is counted.
+ */
+size_t image_cache_memory_size(const struct content *c);
+
 content_type image_cache_content_type(void);
 
 #endif
@@ -38,6 +38,7 @@
 #include "content/content_factory.h"
 #include "desktop/gui_internal.h"
 
+#include "image/image.h"
 #include "image/image_cache.h"
 
 #define JPEG_INTERNAL_OPTIONS
@@ -317,6 +318,7 @@ static bool nsjpeg_convert(struct content *c)
 		nsjpeg_skip_input_data, jpeg_resync_to_restart,
 		nsjpeg_term_source };
 	union content_msg_data msg_data;
+	struct image_coverage coverage;
 	const uint8_t *data;
 	size_t size;
 	char *title;
@@ -356,6 +358,11 @@ static bool nsjpeg_convert(struct content *c)
 
 	image_cache_add(c, NULL, jpeg_cache_convert);
 
+	/* jpegs cannot be transparent so the coverage is known
+	 * without decoding */
+	image_coverage_opaque(&coverage, c->width, c->height);
+	image_cache_set_coverage(c, &coverage);
+
 	/* set title text */
 	title = messages_get_buff("JPEGTitle",
 			nsurl_access_leaf(llcache_handle_get_url(c->llcache)),
@@ -415,6 +422,7 @@ static const content_handler nsjpeg_content_handler = {
 	.get_internal = image_cache_get_internal,
 	.type = image_cache_content_type,
 	.is_opaque = image_cache_is_opaque,
+	.memory_size = image_cache_memory_size,
 	.no_share = false,
 };
 
@@ -33,6 +33,7 @@
 #include "content/content_factory.h"
 #include "desktop/gui_internal.h"
 
+#include "image/image.h"
 #include "image/image_cache.h"
 #include "image/png.h"
 
@@ -57,6 +58,7 @@ typedef struct nspng_content {
 	struct bitmap *bitmap;	/**< Created NetSurf bitmap */
 	size_t rowstride, bpp; /**< Bitmap rowstride and bpp */
 	size_t rowbytes; /**< Number of bytes per row */
+	struct image_coverage coverage; /**< Coverage of decoded rows */
 } nspng_content;
 
 static unsigned int interlace_start[8] = {0, 16, 0, 8, 0, 4, 0};
@@ -177,6 +179,8 @@ static void info_callback(png_structp png_s, png_infop info)
 	png_c->rowbytes = png_get_rowbytes(png_s, info);
 	png_c->interlace = (interlace == PNG_INTERLACE_ADAM7);
 
+	image_coverage_init(&png_c->coverage);
+
 	NSLOG(netsurf, INFO, "size %li * %li, rowbytes %"PRIsizet,
 	      (unsigned long)width, (unsigned long)height, png_c->rowbytes);
 }
@@ -230,6 +234,11 @@ static void row_callback(png_structp png_s, png_bytep new_row,
 	} else {
 		/* Do a fast memcpy of the row data */
 		memcpy(row, new_row, rowbytes);
+
+		/* rows arrive exactly once so coverage can be
+		 * accumulated as they do */
+		image_coverage_row(&png_c->coverage, row_num, row,
+				   png_c->base.width);
 	}
 }
 
@@ -437,6 +446,7 @@ png_cache_convert(struct content *c)
 	struct png_cache_read_data_s png_cache_read_data;
 	png_uint_32 width, height;
 	volatile png_bytep * volatile row_pointers = NULL;
+	struct image_coverage coverage;
 
 	png_cache_read_data.data = 
 		content__get_source_data(c, &png_cache_read_data.size);
@@ -493,6 +503,13 @@ png_cache_convert(struct content *c)
 
 	if (row_pointers != NULL) {
 		png_read_image(png_ptr, (png_bytep *) row_pointers);
+
+		/* libpng has no row callback for whole image reads */
+		if (image_coverage_bitmap(&coverage, (struct bitmap *)bitmap)) {
+			guit->bitmap->set_opaque((struct bitmap *)bitmap,
+						 coverage.opaque);
+			image_cache_set_coverage(c, &coverage);
+		}
 	} else {
 		guit->bitmap->destroy((struct bitmap *)bitmap);
 		bitmap = NULL;
@@ -535,12 +552,23 @@ static bool nspng_convert(struct content *c)
 	}
 
 	if (png_c->bitmap != NULL) {
-		guit->bitmap->set_opaque(png_c->bitmap, guit->bitmap->test_opaque(png_c->bitmap));
+		/* interlaced or truncated images did not account for
+		 * every row as it was decoded */
+		if (!image_coverage_complete(&png_c->coverage, c->height)) {
+			image_coverage_bitmap(&png_c->coverage, png_c->bitmap);
+		}
+		guit->bitmap->set_opaque(png_c->bitmap,
+					 png_c->coverage.valid &&
+					 png_c->coverage.opaque);
 		guit->bitmap->modified(png_c->bitmap);
 	}
 
 	image_cache_add(c, png_c->bitmap, png_cache_convert);
 
+	if (png_c->bitmap != NULL) {
+		image_cache_set_coverage(c, &png_c->coverage);
+	}
+
 	content_set_ready(c);
 	content_set_done(c);
 	content_set_status(c, "");
@@ -604,6 +632,7 @@ static const content_handler nspng_content_handler = {
 	.get_internal = image_cache_get_internal,
 	.type = image_cache_content_type,
 	.is_opaque = image_cache_is_opaque,
+	.memory_size = image_cache_memory_size,
 	.no_share = false,
 };
 
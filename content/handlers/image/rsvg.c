@@ -52,6 +52,7 @@
 #include "content/content_factory.h"
 #include "desktop/gui_internal.h"
 
+#include "image/image.h"
 #include "image/rsvg.h"
 
 typedef struct rsvg_content {
@@ -259,6 +260,25 @@ static void rsvg_destroy(struct content *c)
 	return;
 }
 
+/**
+ * Estimate the memory held by an SVG content rendered with librsvg.
+ *
+ * The cairo surface is built inside the bitmap. The document tree held
+ * by the rsvg handle is estimated from the length of its source.
+ */
+static size_t rsvg_memory_size(const struct content *c)
+{
+	const rsvg_content *d = (const rsvg_content *) c;
+	size_t size = 0;
+
+	if (d->rsvgh != NULL) {
+		llcache_handle_get_source_data(c->llcache, &size);
+	}
+
+	return sizeof(rsvg_content) + size +
+		image_bitmap_memory_size(d->bitmap);
+}
+
 static nserror rsvg_clone(const struct content *old, struct content **newc)
 {
 	rsvg_content *svg;
@@ -339,6 +359,7 @@ static const content_handler rsvg_content_handler = {
 	.get_internal = rsvg_get_internal,
 	.type = rsvg_content_type,
 	.is_opaque = rsvg_content_is_opaque,
+	.memory_size = rsvg_memory_size,
 	.no_share = false,
 };
 
@@ -308,6 +308,38 @@ static void svg_destroy(struct content *c)
 }
 
 
+/**
+ * Estimate the memory held by an SVG content.
+ *
+ * The diagram holds the parsed shapes with their paths and text.
+ */
+static size_t svg_memory_size(const struct content *c)
+{
+	const svg_content *svg = (const svg_content *) c;
+	const struct svgtiny_diagram *diagram = svg->diagram;
+	size_t size = sizeof(svg_content);
+	unsigned int i;
+
+	if (diagram == NULL) {
+		return size;
+	}
+
+	size += sizeof(*diagram);
+	for (i = 0; i != diagram->shape_count; i++) {
+		size += sizeof(diagram->shape[i]);
+		if (diagram->shape[i].path) {
+			size += diagram->shape[i].path_length *
+				sizeof(*diagram->shape[i].path);
+		}
+		if (diagram->shape[i].text) {
+			size += strlen(diagram->shape[i].text) + 1;
+		}
+	}
+
+	return size;
+}
+
+
 static nserror svg_clone(const struct content *old, struct content **newc)
 {
 	svg_content *svg;
@@ -356,6 +388,7 @@ static const content_handler svg_content_handler = {
 	.redraw = svg_redraw,
 	.clone = svg_clone,
 	.type = svg_content_type,
+	.memory_size = svg_memory_size,
 	.no_share = true
 };
 
@@ -39,6 +39,7 @@
 #include "content/content_factory.h"
 #include "desktop/gui_internal.h"
 
+#include "image/image.h"
 #include "image/image_cache.h"
 
 #include "webp.h"
@@ -97,6 +98,7 @@ webp_cache_convert(struct content *c)
 	uint8_t *decoded;
 	size_t rowstride;
 	struct bitmap *bitmap = NULL;
+	struct image_coverage coverage;
 
 	source_data = content__get_source_data(c, &source_size);
 
@@ -141,6 +143,15 @@ webp_cache_convert(struct content *c)
 		return NULL;
 	}
 
+	if (webpfeatures.has_alpha == 0) {
+		image_coverage_opaque(&coverage,
+				      webpfeatures.width,
+				      webpfeatures.height);
+	} else if (image_coverage_bitmap(&coverage, bitmap)) {
+		guit->bitmap->set_opaque(bitmap, coverage.opaque);
+	}
+	image_cache_set_coverage(c, &coverage);
+
 	guit->bitmap->modified(bitmap);
 
 	return bitmap;
@@ -226,6 +237,7 @@ static const content_handler webp_content_handler = {
 	.get_internal = image_cache_get_internal,
 	.type = image_cache_content_type,
 	.is_opaque = image_cache_is_opaque,
+	.memory_size = image_cache_memory_size,
 	.no_share = false,
 };
 
@@ -31,6 +31,7 @@
 #include "utils/utils.h"
 #include "utils/nsoption.h"
 #include "utils/log.h"
+#include "utils/metrics.h"
 #include "utils/corestrings.h"
 #include "content/content.h"
 
@@ -53,6 +54,9 @@
 #define GENERICS_MAGIC MAGIC(GENERICS_TABLE)
 #define THREAD_MAP MAGIC(THREAD_MAP)
 
+/** time spent executing scripts */
+static struct nsmetric *dukky_metric_exec = NULL;
+
 /**
  * dukky javascript heap
  */
@@ -582,6 +586,7 @@ void js_initialise(void)
 	/* Disabled force-on for forthcoming release */
 	/* nsoption_set_bool(enable_javascript, true);
 	 */
+	nsmetric_register("js.exec", NSMETRIC_TIMING, &dukky_metric_exec);
 	javascript_init();
 }
 
@@ -873,6 +878,20 @@ static void dukky_reset_start_time(duk_context *ctx)
 	(void) nsu_getmonotonic_ms(&heap->exec_start_time);
 }
 
+/**
+ * Record the time since execution was last started in the exec metric
+ */
+static void dukky_account_exec_time(duk_context *ctx)
+{
+	duk_memory_functions funcs;
+	jsheap *heap;
+	uint64_t now;
+	duk_get_memory_functions(ctx, &funcs);
+	heap = funcs.udata;
+	(void) nsu_getmonotonic_ms(&now);
+	nsmetric_sample(dukky_metric_exec, now - heap->exec_start_time);
+}
+
 duk_int_t dukky_pcall(duk_context *ctx, duk_size_t argc, bool reset_timeout)
 {
 	if (reset_timeout) {
@@ -880,6 +899,9 @@ duk_int_t dukky_pcall(duk_context *ctx, duk_size_t argc, bool reset_timeout)
 	}
 
 	duk_int_t ret = duk_pcall(ctx, argc);
+	if (reset_timeout) {
+		dukky_account_exec_time(ctx);
+	}
 	if (ret) {
 		/* Something went wrong calling this... */
 		dukky_dump_error(ctx);
@@ -967,6 +989,7 @@ js_exec(jsthread *thread, const uint8_t *txt, size_t txtlen, const char *name)
 handle_error:
 	dukky_dump_error(CTX);
 out:
+	dukky_account_exec_time(CTX);
 	dukky_leave_thread(thread);
 	return ret;
 }
@@ -24,10 +24,12 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <nsutils/time.h>
 
 #include "utils/http.h"
 #include "utils/log.h"
 #include "utils/messages.h"
+#include "utils/metrics.h"
 #include "utils/ring.h"
 #include "utils/utils.h"
 #include "netsurf/misc.h"
@@ -73,10 +75,23 @@ struct hlcache_handle {
 struct hlcache_entry {
 	struct content *content;	/**< Pointer to associated content */
 
+	uint64_t last_used;		/**< Time the content was last used (ms) */
+
+	bool indexed;			/**< Entry is in the shareable index */
+	uintptr_t object;		/**< Identity of low-level object */
+	unsigned int quirks;		/**< Quirks bucket of the content */
+	hlcache_entry *index_next;	/**< Next entry in index bucket */
+
 	hlcache_entry *next;		/**< Next sibling */
 	hlcache_entry *prev;		/**< Previous sibling */
 };
 
+/** Number of buckets in the shareable content index */
+#define HLCACHE_INDEX_SIZE 1024
+
+/** Quirks bucket for contents usable in any quirks mode */
+#define HLCACHE_QUIRKS_ANY 2
+
 /** Current state of the cache.
  *
  * Global state of the cache.
@@ -87,12 +102,23 @@ struct hlcache_s {
 	/** List of cached content objects */
 	hlcache_entry *content_list;
 
+	/** Shareable contents indexed by low-level object and quirks */
+	hlcache_entry *index[HLCACHE_INDEX_SIZE];
+
 	/** Ring of retrieval contexts */
 	hlcache_retrieval_ctx *retrieval_ctx_ring;
 
 	/* statistics */
 	unsigned int hit_count;
 	unsigned int miss_count;
+
+	/** Estimated memory of unused contents retained by the last clean */
+	size_t retained_size;
+	/** Number of retained contents evicted to fit the limit */
+	unsigned int evict_count;
+
+	struct nsmetric *metric_retained;
+	struct nsmetric *metric_evicted;
 };
 
 /** high level cache state */
@@ -104,13 +130,204 @@ static struct hlcache_s *hlcache = NULL;
  ******************************************************************************/
 
 
+/**
+ * Compute the shareable index bucket for a low-level object
+ *
+ * \param object The identity of the low-level object
+ * \param quirks The quirks bucket
+ * \return The index bucket
+ */
+static unsigned int hlcache_index_bucket(uintptr_t object, unsigned int quirks)
+{
+	uint64_t hash = ((uint64_t)object >> 4) ^ quirks;
+
+	hash *= 0x9e3779b97f4a7c15ULL;
+
+	return (unsigned int)(hash >> 32) % HLCACHE_INDEX_SIZE;
+}
+
+/**
+ * Add an entry to the shareable content index
+ *
+ * Contents which match either quirks mode are placed in their own
+ * bucket so a lookup never considers more than two buckets.
+ *
+ * \param entry  The entry to add, its content must be shareable
+ * \param quirks The quirks mode the content was created with
+ */
+static void hlcache_index_insert(hlcache_entry *entry, bool quirks)
+{
+	unsigned int bucket;
+
+	entry->object = llcache_handle_object_id(
+			content_get_llcache_handle(entry->content));
+
+	if (content_matches_quirks(entry->content, !quirks)) {
+		entry->quirks = HLCACHE_QUIRKS_ANY;
+	} else {
+		entry->quirks = quirks ? 1 : 0;
+	}
+
+	bucket = hlcache_index_bucket(entry->object, entry->quirks);
+
+	entry->index_next = hlcache->index[bucket];
+	hlcache->index[bucket] = entry;
+	entry->indexed = true;
+}
+
+/**
+ * Remove an entry from the shareable content index
+ *
+ * \param entry The entry to remove, may not be indexed
+ */
+static void hlcache_index_remove(hlcache_entry *entry)
+{
+	hlcache_entry **link;
+
+	if (entry->indexed == false)
+		return;
+
+	link = &hlcache->index[hlcache_index_bucket(entry->object,
+			entry->quirks)];
+	while (*link != entry) {
+		link = &(*link)->index_next;
+	}
+	*link = entry->index_next;
+
+	entry->index_next = NULL;
+	entry->indexed = false;
+}
+
+/**
+ * Search the shareable content index for a suitable content
+ *
+ * \param llcache The low-level handle the content must use
+ * \param quirks  The quirks mode the content must match
+ * \return The matching entry or NULL if there is none
+ */
+static hlcache_entry *
+hlcache_index_find(const llcache_handle *llcache, bool quirks)
+{
+	unsigned int buckets[2] = { quirks ? 1 : 0, HLCACHE_QUIRKS_ANY };
+	uintptr_t object = llcache_handle_object_id(llcache);
+	hlcache_entry *entry;
+	hlcache_entry *next;
+	unsigned int idx;
+
+	for (idx = 0; idx < 2; idx++) {
+		entry = hlcache->index[hlcache_index_bucket(object,
+				buckets[idx])];
+		for (; entry != NULL; entry = next) {
+			hlcache_handle entry_handle = { entry, NULL, NULL };
+
+			next = entry->index_next;
+
+			if (entry->object != object ||
+			    entry->quirks != buckets[idx])
+				continue;
+
+			/* Contents in the error state are never reused */
+			if (content_get_status(&entry_handle) ==
+					CONTENT_STATUS_ERROR) {
+				hlcache_index_remove(entry);
+				continue;
+			}
+
+			/* Ensure that content still uses same low-level
+			 * object as low-level handle */
+			if (llcache_handle_references_same_object(
+					content_get_llcache_handle(
+							entry->content),
+					llcache))
+				return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Remove an entry from the cache and destroy its content
+ *
+ * \param entry The entry to destroy
+ */
+static void hlcache_entry_destroy(hlcache_entry *entry)
+{
+	hlcache_index_remove(entry);
+
+	/* Remove entry from cache */
+	if (entry->prev == NULL)
+		hlcache->content_list = entry->next;
+	else
+		entry->prev->next = entry->next;
+
+	if (entry->next != NULL)
+		entry->next->prev = entry->prev;
+
+	/* Destroy content */
+	content_destroy(entry->content);
+
+	/* Destroy entry */
+	free(entry);
+}
+
+/**
+ * Determine if an unused content is worth retaining
+ *
+ * Only complete contents which can be shared by a later retrieval and
+ * whose source data is still fresh may be found again. Contents whose
+ * memory cannot be estimated are not retained.
+ *
+ * \param entry The entry to consider
+ * \return true if the content may be retained
+ */
+static bool hlcache_entry_retainable(hlcache_entry *entry)
+{
+	if (content__get_status(entry->content) != CONTENT_STATUS_DONE)
+		return false;
+
+	if (content_is_shareable(entry->content) == false)
+		return false;
+
+	/* without an estimate the budget cannot bound the content */
+	if (content_has_memory_size(entry->content) == false)
+		return false;
+
+	return llcache_handle_is_fresh(
+			content_get_llcache_handle(entry->content));
+}
+
+/**
+ * Order retained entries least recently used first
+ */
+static int hlcache_entry_lru_cmp(const void *a, const void *b)
+{
+	const hlcache_entry *ea = *(const hlcache_entry * const *)a;
+	const hlcache_entry *eb = *(const hlcache_entry * const *)b;
+
+	if (ea->last_used < eb->last_used)
+		return -1;
+	if (ea->last_used > eb->last_used)
+		return 1;
+	return 0;
+}
+
 /**
  * Attempt to clean the cache
+ *
+ * Unused contents are destroyed unless they are retainable, in which
+ * case the least recently used are destroyed until the estimated
+ * memory of those remaining fits within the retention limit.
  */
 static void hlcache_clean(void *force_clean_flag)
 {
 	hlcache_entry *entry, *next;
 	bool force_clean = (force_clean_flag != NULL);
+	hlcache_entry **retained = NULL;
+	size_t retained_count = 0;
+	size_t retained_alloc = 0;
+	size_t retained_size = 0;
+	size_t idx;
 
 	for (entry = hlcache->content_list; entry != NULL; entry = next) {
 		next = entry->next;
@@ -129,28 +346,49 @@ static void hlcache_clean(void *force_clean_flag)
 			content_set_error(entry->content);
 		}
 
-		/** \todo This is over-zealous: all unused contents
-		 * will be immediately destroyed. Ideally, we want to
-		 * purge all unused contents that are using stale
-		 * source data, and enough fresh contents such that
-		 * the cache fits in the configured cache size limit.
-		 */
-
-		/* Remove entry from cache */
-		if (entry->prev == NULL)
-			hlcache->content_list = entry->next;
-		else
-			entry->prev->next = entry->next;
-
-		if (entry->next != NULL)
-			entry->next->prev = entry->prev;
+		if ((hlcache->params.retain_limit > 0) &&
+		    hlcache_entry_retainable(entry)) {
+			if (retained_count == retained_alloc) {
+				hlcache_entry **r;
+				size_t alloc = (retained_alloc == 0) ?
+					32 : retained_alloc * 2;
+
+				r = realloc(retained, alloc * sizeof(*r));
+				if (r != NULL) {
+					retained = r;
+					retained_alloc = alloc;
+				}
+			}
+			if (retained_count < retained_alloc) {
+				retained[retained_count++] = entry;
+				retained_size += content_get_memory_size(
+						entry->content);
+				continue;
+			}
+		}
 
-		/* Destroy content */
-		content_destroy(entry->content);
+		hlcache_entry_destroy(entry);
+	}
 
-		/* Destroy entry */
-		free(entry);
+	/* evict least recently used contents until within the limit */
+	if (retained_size > hlcache->params.retain_limit) {
+		qsort(retained, retained_count, sizeof(*retained),
+		      hlcache_entry_lru_cmp);
+
+		for (idx = 0; (idx < retained_count) &&
+			     (retained_size > hlcache->params.retain_limit);
+		     idx++) {
+			retained_size -= content_get_memory_size(
+					retained[idx]->content);
+			hlcache_entry_destroy(retained[idx]);
+			hlcache->evict_count++;
+			nsmetric_add(hlcache->metric_evicted, 1);
+		}
 	}
+	free(retained);
+
+	hlcache->retained_size = retained_size;
+	nsmetric_set(hlcache->metric_retained, retained_size);
 
 	/* Attempt to clean the llcache */
 	llcache_clean(false);
@@ -200,6 +438,10 @@ static void hlcache_content_callback(struct content *c, content_msg msg,
 		event.data = *data;
 	}
 
+	/* A content in the error state can no longer be shared */
+	if (msg == CONTENT_MSG_ERROR && handle->entry != NULL)
+		hlcache_index_remove(handle->entry);
+
 	if (handle->cb != NULL)
 		error = handle->cb(handle, &event, handle->pw);
 
@@ -228,39 +470,12 @@ static nserror hlcache_find_content(hlcache_retrieval_ctx *ctx,
 	hlcache_event event;
 	nserror error = NSERROR_OK;
 
-	/* Search list of cached contents for a suitable one */
-	for (entry = hlcache->content_list; entry != NULL; entry = entry->next) {
-		hlcache_handle entry_handle = { entry, NULL, NULL };
-		const llcache_handle *entry_llcache;
-
-		if (entry->content == NULL)
-			continue;
-
-		/* Ignore contents in the error state */
-		if (content_get_status(&entry_handle) == CONTENT_STATUS_ERROR)
-			continue;
-
-		/* Ensure that content is shareable */
-		if (content_is_shareable(entry->content) == false)
-			continue;
-
-		/* Ensure that quirks mode is acceptable */
-		if (content_matches_quirks(entry->content,
-				ctx->child.quirks) == false)
-			continue;
-
-		/* Ensure that content uses same low-level object as
-		 * low-level handle */
-		entry_llcache = content_get_llcache_handle(entry->content);
-
-		if (llcache_handle_references_same_object(entry_llcache,
-				ctx->llcache))
-			break;
-	}
+	/* Search index of shareable contents for a suitable one */
+	entry = hlcache_index_find(ctx->llcache, ctx->child.quirks);
 
 	if (entry == NULL) {
 		/* No existing entry, so need to create one */
-		entry = malloc(sizeof(hlcache_entry));
+		entry = calloc(1, sizeof(hlcache_entry));
 		if (entry == NULL)
 			return NSERROR_NOMEM;
 
@@ -280,6 +495,9 @@ static nserror hlcache_find_content(hlcache_retrieval_ctx *ctx,
 			hlcache->content_list->prev = entry;
 		hlcache->content_list = entry;
 
+		if (content_is_shareable(entry->content))
+			hlcache_index_insert(entry, ctx->child.quirks);
+
 		/* Signal to caller that we created a content */
 		error = NSERROR_NEED_DATA;
 
@@ -290,6 +508,8 @@ static nserror hlcache_find_content(hlcache_retrieval_ctx *ctx,
 		hlcache->hit_count++;
 	}
 
+	nsu_getmonotonic_ms(&entry->last_used);
+
 	/* Associate handle with content */
 	if (content_add_user(entry->content,
 			hlcache_content_callback, ctx->handle) == false)
@@ -566,6 +786,11 @@ hlcache_initialise(const struct hlcache_parameters *hlcache_parameters)
 
 	hlcache->params = *hlcache_parameters;
 
+	nsmetric_register("hlcache.retained", NSMETRIC_GAUGE,
+			  &hlcache->metric_retained);
+	nsmetric_register("hlcache.evicted", NSMETRIC_COUNTER,
+			  &hlcache->metric_evicted);
+
 	/* Schedule the cache cleanup */
 	guit->misc->schedule(hlcache->params.bg_clean_time, hlcache_clean, NULL);
 
@@ -595,6 +820,9 @@ void hlcache_finalise(void)
 	NSLOG(netsurf, INFO, "%d contents remain before cache drain",
 	      num_contents);
 
+	/* nothing is retained while draining */
+	hlcache->params.retain_limit = 0;
+
 	/* Drain cache */
 	do {
 		prev_contents = num_contents;
@@ -659,8 +887,8 @@ void hlcache_finalise(void)
 		hlcache->retrieval_ctx_ring = NULL;
 	}
 
-	NSLOG(netsurf, INFO, "hit/miss %d/%d", hlcache->hit_count,
-	      hlcache->miss_count);
+	NSLOG(netsurf, INFO, "hit/miss %d/%d, %d retained contents evicted",
+	      hlcache->hit_count, hlcache->miss_count, hlcache->evict_count);
 
 	/* De-schedule ourselves */
 	guit->misc->schedule(-1, hlcache_clean, NULL);
@@ -687,6 +915,8 @@ hlcache_handle_retrieve(nsurl *url,
 	nserror error;
 
 	assert(cb != NULL);
+	/* speculative objects are never made into contents */
+	assert((flags & LLCACHE_RETRIEVE_SPECULATIVE) == 0);
 
 	ctx = calloc(1, sizeof(hlcache_retrieval_ctx));
 	if (ctx == NULL) {
@@ -740,6 +970,7 @@ nserror hlcache_handle_release(hlcache_handle *handle)
 	if (handle->entry != NULL) {
 		content_remove_user(handle->entry->content,
 				hlcache_content_callback, handle);
+		nsu_getmonotonic_ms(&handle->entry->last_used);
 	} else {
 		RING_ITERATE_START(struct hlcache_retrieval_ctx,
 				   hlcache->retrieval_ctx_ring,
@@ -839,6 +1070,7 @@ nserror hlcache_handle_abort(hlcache_handle *handle)
 		}
 
 		content_remove_user(c, hlcache_content_callback, handle);
+		nsu_getmonotonic_ms(&handle->entry->last_used);
 
 		entry->content = clone;
 		handle->entry = entry;
@@ -49,6 +49,9 @@ struct hlcache_parameters {
 	/** How frequently the background cache clean process is run (ms) */
 	unsigned int bg_clean_time;
 
+	/** Maximum estimated memory of unused contents to retain (bytes) */
+	size_t retain_limit;
+
 	struct llcache_parameters llcache;
 };
 
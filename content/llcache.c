@@ -43,6 +43,7 @@
 #include "utils/corestrings.h"
 #include "utils/log.h"
 #include "utils/messages.h"
+#include "utils/metrics.h"
 #include "utils/nsurl.h"
 #include "utils/utils.h"
 #include "utils/time.h"
@@ -176,6 +177,11 @@ struct llcache_object {
 	uint8_t *source_data;	     /**< Source data for object */
 	size_t source_len;	     /**< Byte length of source data */
 	size_t source_alloc;	     /**< Allocated size of source buffer */
+	bool source_adopted;	     /**< Source buffer was adopted from
+				      * the fetcher and is not heap allocated
+				      */
+	fetch_data_release_fn source_release; /**< Adopted buffer release */
+	void *source_release_pw;     /**< Adopted buffer release context */
 
 	struct cert_chain *chain;    /**< Certificate chain from the fetch */
 
@@ -261,6 +267,23 @@ struct llcache_s {
 	 */
 	uint64_t total_elapsed;
 
+	/**
+	 * Performance metrics published by the cache
+	 */
+	struct {
+		struct nsmetric *hit; /**< fresh object served from cache */
+		struct nsmetric *revalidate; /**< stale object revalidated */
+		struct nsmetric *miss; /**< object had to be fetched */
+		struct nsmetric *size; /**< RAM used by cached objects */
+		struct nsmetric *store_written; /**< bytes written to store */
+		struct nsmetric *store_write_ms; /**< ms spent writing */
+		struct nsmetric *store_read; /**< bytes read from store */
+		struct nsmetric *store_read_ms; /**< ms spent reading */
+		struct nsmetric *speculative; /**< speculative fetches */
+		struct nsmetric *speculative_hit; /**< speculative object used */
+		struct nsmetric *fetch_transferred; /**< bytes received */
+		struct nsmetric *fetch_decoded; /**< bytes of source fetched */
+	} metric;
 };
 
 /** low level cache state */
@@ -988,6 +1011,7 @@ static nserror llcache_object_refetch(llcache_object *object)
 			  multipart,
 			  object->fetch.flags & LLCACHE_RETRIEVE_VERIFIABLE,
 			  object->fetch.tried_with_tls_downgrade,
+			  object->fetch.flags & LLCACHE_RETRIEVE_SPECULATIVE,
 			  (const char **)headers,
 			  &object->fetch.fetch);
 
@@ -1042,9 +1066,62 @@ static nserror llcache_object_fetch(llcache_object *object, uint32_t flags,
 	object->fetch.retries_remaining = llcache->fetch_attempts;
 	object->fetch.hsts_in_use = hsts_in_use;
 
+	if ((flags & LLCACHE_RETRIEVE_SPECULATIVE) != 0) {
+		nsmetric_add(llcache->metric.speculative, 1);
+	}
+
 	return llcache_object_refetch(object);
 }
 
+/**
+ * Release an object's adopted source buffer back to its owner.
+ *
+ * \param object Object whose source data was adopted from a fetcher.
+ */
+static void llcache_object_release_adopted(llcache_object *object)
+{
+	if (object->source_release != NULL) {
+		object->source_release(object->source_data,
+				       object->source_alloc,
+				       object->source_release_pw);
+	}
+
+	object->source_adopted = false;
+	object->source_release = NULL;
+	object->source_release_pw = NULL;
+	object->source_data = NULL;
+	object->source_alloc = 0;
+}
+
+/**
+ * Replace an object's adopted source buffer with a heap copy.
+ *
+ * This is required before the source data can be altered or grown.
+ *
+ * \param object Object whose source data was adopted from a fetcher.
+ * \param extra Additional space to allocate beyond the current data.
+ * \return NSERROR_OK on success or NSERROR_NOMEM on allocation failure.
+ */
+static nserror
+llcache_object_unadopt_source(llcache_object *object, size_t extra)
+{
+	const size_t new_len = object->source_len + extra;
+	uint8_t *temp;
+
+	temp = malloc(new_len);
+	if (temp == NULL) {
+		return NSERROR_NOMEM;
+	}
+	memcpy(temp, object->source_data, object->source_len);
+
+	llcache_object_release_adopted(object);
+
+	object->source_data = temp;
+	object->source_alloc = new_len;
+
+	return NSERROR_OK;
+}
+
 /**
  * Destroy a low-level cache object
  *
@@ -1067,6 +1144,8 @@ static nserror llcache_object_destroy(llcache_object *object)
 	if (object->source_data != NULL) {
 		if (object->store_state == LLCACHE_STATE_DISC) {
 			guit->llcache->release(object->url, BACKING_STORE_NONE);
+		} else if (object->source_adopted) {
+			llcache_object_release_adopted(object);
 		} else {
 			free(object->source_data);
 		}
@@ -1289,6 +1368,9 @@ llcache_object_remove_from_list(llcache_object *object, llcache_object **list)
  */
 static nserror llcache_retrieve_persisted_data(llcache_object *object)
 {
+	uint64_t startms, endms;
+	nserror res;
+
 	/* ensure the source data is present if necessary */
 	if ((object->source_data != NULL) ||
 	    (object->store_state != LLCACHE_STATE_DISC)) {
@@ -1299,10 +1381,19 @@ static nserror llcache_retrieve_persisted_data(llcache_object *object)
 	}
 
 	/* Source data for the object may be in the persistent store */
-	return guit->llcache->fetch(object->url,
-				    BACKING_STORE_NONE,
-				    &object->source_data,
-				    &object->source_len);
+	nsu_getmonotonic_ms(&startms);
+	res = guit->llcache->fetch(object->url,
+				   BACKING_STORE_NONE,
+				   &object->source_data,
+				   &object->source_len);
+	nsu_getmonotonic_ms(&endms);
+
+	if (res == NSERROR_OK) {
+		nsmetric_add(llcache->metric.store_read, object->source_len);
+		nsmetric_add(llcache->metric.store_read_ms, endms - startms);
+	}
+
+	return res;
 }
 
 /**
@@ -1898,6 +1989,24 @@ llcache_object_fetch_persistent(llcache_object *object,
 	return NSERROR_OK;
 }
 
+/**
+ * Promote a speculatively fetched object to a normal one
+ *
+ * \param object The object which has been retrieved for use.
+ */
+static void llcache_object_promote(llcache_object *object)
+{
+	NSLOG(llcache, DEBUG, "Speculative object %p used", object);
+
+	object->fetch.flags &= ~LLCACHE_RETRIEVE_SPECULATIVE;
+
+	if (object->fetch.fetch != NULL) {
+		fetch_promote(object->fetch.fetch);
+	}
+
+	nsmetric_add(llcache->metric.speculative_hit, 1);
+}
+
 /**
  * Retrieve a potentially cached object
  *
@@ -1982,6 +2091,15 @@ llcache_object_retrieve_from_cache(nsurl *url,
 			/* source data was successfully retrieved from
 			 * persistent store
 			 */
+			nsmetric_add(llcache->metric.hit, 1);
+
+			if (((flags & LLCACHE_RETRIEVE_SPECULATIVE) == 0) &&
+			    ((newest->fetch.flags &
+			      LLCACHE_RETRIEVE_SPECULATIVE) != 0)) {
+				/* speculatively fetched object is wanted */
+				llcache_object_promote(newest);
+			}
+
 			*result = newest;
 
 			return NSERROR_OK;
@@ -2037,6 +2155,7 @@ llcache_object_retrieve_from_cache(nsurl *url,
 			/* Add new object to cache */
 			llcache_object_add_to_list(obj, &llcache->cached_objects);
 
+			nsmetric_add(llcache->metric.revalidate, 1);
 			*result = obj;
 
 			return NSERROR_OK;
@@ -2069,6 +2188,7 @@ llcache_object_retrieve_from_cache(nsurl *url,
 	/* Add new object to cache */
 	llcache_object_add_to_list(obj, &llcache->cached_objects);
 
+	nsmetric_add(llcache->metric.miss, 1);
 	*result = obj;
 
 	return NSERROR_OK;
@@ -2492,17 +2612,11 @@ static nserror llcache_fetch_notmodified(llcache_object *object,
 }
 
 /**
- * Process a chunk of fetched data
+ * Move an object into the data fetching state.
  *
  * \param object  Object being fetched
- * \param data	  Data to process
- * \param len	  Byte length of data
- * \return NSERROR_OK on success, appropriate error otherwise.
  */
-static nserror
-llcache_fetch_process_data(llcache_object *object,
-			   const uint8_t *data,
-			   size_t len)
+static void llcache_fetch_enter_data_state(llcache_object *object)
 {
 	if (object->fetch.state != LLCACHE_FETCH_DATA) {
 		/**
@@ -2537,6 +2651,31 @@ llcache_fetch_process_data(llcache_object *object,
 
 		object->fetch.state = LLCACHE_FETCH_DATA;
 	}
+}
+
+/**
+ * Process a chunk of fetched data
+ *
+ * \param object  Object being fetched
+ * \param data	  Data to process
+ * \param len	  Byte length of data
+ * \return NSERROR_OK on success, appropriate error otherwise.
+ */
+static nserror
+llcache_fetch_process_data(llcache_object *object,
+			   const uint8_t *data,
+			   size_t len)
+{
+	llcache_fetch_enter_data_state(object);
+
+	/* Adopted buffers are immutable so must be copied to grow */
+	if (object->source_adopted) {
+		nserror res;
+		res = llcache_object_unadopt_source(object, len + 64 * 1024);
+		if (res != NSERROR_OK) {
+			return res;
+		}
+	}
 
 	/* Resize source buffer if it's too small */
 	if (object->source_len + len >= object->source_alloc) {
@@ -2556,6 +2695,100 @@ llcache_fetch_process_data(llcache_object *object,
 	return NSERROR_OK;
 }
 
+/**
+ * Largest object which may be fetched speculatively
+ */
+#define SPECULATIVE_LIMIT (2 * 1024 * 1024)
+
+/**
+ * Stop a speculative fetch which has grown too large
+ *
+ * \param object  Object being fetched
+ * \return NSERROR_OK on success, appropriate error otherwise.
+ */
+static nserror llcache_fetch_speculative_limit(llcache_object *object)
+{
+	llcache_event event;
+
+	NSLOG(llcache, DEBUG, "Speculative fetch of %s too large",
+	      nsurl_access(object->url));
+
+	/* Abort fetch for this object */
+	fetch_abort(object->fetch.fetch);
+	object->fetch.fetch = NULL;
+
+	/* Release candidate, if any */
+	if (object->candidate != NULL) {
+		object->candidate->candidate_count--;
+		object->candidate = NULL;
+	}
+
+	/* The partial object must never be served from the cache */
+	llcache_invalidate_cache_control_data(object);
+
+	object->fetch.state = LLCACHE_FETCH_COMPLETE;
+
+	/* Inform client(s) that object fetch failed */
+	event.type = LLCACHE_EVENT_ERROR;
+	event.data.error.code = NSERROR_NOSPACE;
+	event.data.error.msg = messages_get("FetchFailed");
+
+	return llcache_send_event_to_users(object, &event);
+}
+
+/**
+ * Process fetched data whose ownership is passed to the cache
+ *
+ * If the object holds no source data yet the buffer becomes the
+ * object's source data directly, avoiding a copy. Otherwise the data
+ * is appended as for a normal data chunk and the buffer released.
+ *
+ * \param object   Object being fetched
+ * \param data	   Data to adopt
+ * \param len	   Byte length of data
+ * \param release  Callback to release the data, may be NULL
+ * \param pw       Private word for release callback
+ * \return NSERROR_OK on success, appropriate error otherwise.
+ */
+static nserror
+llcache_fetch_process_adopt(llcache_object *object,
+			    const uint8_t *data,
+			    size_t len,
+			    fetch_data_release_fn release,
+			    void *pw)
+{
+	nserror res;
+
+	if (object->source_len != 0) {
+		res = llcache_fetch_process_data(object, data, len);
+		if (release != NULL) {
+			release(data, len, pw);
+		}
+		return res;
+	}
+
+	llcache_fetch_enter_data_state(object);
+
+	/* discard any empty buffer left over from streaming */
+	if (object->source_adopted) {
+		llcache_object_release_adopted(object);
+	} else {
+		free(object->source_data);
+	}
+
+	object->source_data = (uint8_t *)data;
+	object->source_len = len;
+	object->source_alloc = len;
+	object->source_adopted = true;
+	object->source_release = release;
+	object->source_release_pw = pw;
+
+	NSLOG(llcache, DEBUG, "Adopted %"PRIsizet" bytes of source for %p",
+	      len, object);
+
+	return NSERROR_OK;
+}
+
 
 /**
  * Handle an authentication request
@@ -2792,11 +3025,14 @@ build_candidate_list(struct llcache_object ***lst_out, int *lst_len_out)
 
 		/* cacehable objects with no pending fetches, not
 		 * already on disc and with sufficient lifetime to
-		 * make disc cache worthwhile
+		 * make disc cache worthwhile. Adopted source buffers
+		 * cannot be handed to the backing store as it takes
+		 * ownership of the data.
 		 */
 		if ((object->candidate_count == 0) &&
 		    (object->fetch.fetch == NULL) &&
 		    (object->store_state == LLCACHE_STATE_RAM) &&
+		    (object->source_adopted == false) &&
 		    (remaining_lifetime > llcache->minimum_lifetime)) {
 			lst[lst_len] = object;
 			lst_len++;
@@ -2820,6 +3056,54 @@ build_candidate_list(struct llcache_object ***lst_out, int *lst_len_out)
 	return NSERROR_OK;
 }
 
+/**
+ * Content types whose source is likely to compress well.
+ */
+static const char *llcache_compressible_types[] = {
+	"text/",
+	"application/javascript",
+	"application/x-javascript",
+	"application/ecmascript",
+	"application/json",
+	"application/xml",
+	"application/xhtml+xml",
+	"image/svg+xml",
+	NULL
+};
+
+/**
+ * Determine if an object's source is likely to compress well.
+ *
+ * \param object The object to examine.
+ * \return true if the Content-Type is textual.
+ */
+static bool llcache_object_compressible(const llcache_object *object)
+{
+	const char *type = NULL;
+	size_t i;
+
+	for (i = 0; i < object->num_headers; i++) {
+		if (strcasecmp(object->headers[i].name, "Content-Type") == 0) {
+			type = object->headers[i].value;
+			break;
+		}
+	}
+
+	if (type == NULL) {
+		return false;
+	}
+
+	for (i = 0; llcache_compressible_types[i] != NULL; i++) {
+		if (strncasecmp(type,
+				llcache_compressible_types[i],
+				strlen(llcache_compressible_types[i])) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /**
  * Write an object to the backing store.
  *
@@ -2843,7 +3127,8 @@ write_backing_store(struct llcache_object *object,
 
 	/* put object data in backing store */
 	ret = guit->llcache->store(object->url,
-				   BACKING_STORE_NONE,
+				   llcache_object_compressible(object) ?
+				   BACKING_STORE_COMPRESSIBLE : BACKING_STORE_NONE,
 				   object->source_data,
 				   object->source_len);
 	if (ret != NSERROR_OK) {
@@ -3033,6 +3318,11 @@ static void llcache_persist(void *p)
 	llcache->total_written += total_written;
 	llcache->total_elapsed += total_elapsed;
 
+	if (total_written > 0) {
+		nsmetric_add(llcache->metric.store_written, total_written);
+		nsmetric_add(llcache->metric.store_write_ms, total_elapsed);
+	}
+
 	NSLOG(llcache, DEBUG,
 	      "writeout size:%"PRIssizet" time:%lu bandwidth:%lubytes/s",
 	      total_written, total_elapsed, total_bandwidth);
@@ -3095,26 +3385,66 @@ static void llcache_fetch_callback(const fetch_msg *msg, void *p)
 	/* Normal 2xx state machine */
 	case FETCH_DATA:
 		/* Received some data */
+		if (((object->fetch.flags & LLCACHE_RETRIEVE_SPECULATIVE) != 0) &&
+		    (object->source_len + msg->data.header_or_data.len >
+		     SPECULATIVE_LIMIT)) {
+			error = llcache_fetch_speculative_limit(object);
+			break;
+		}
+
 		error = llcache_fetch_process_data(object,
 				msg->data.header_or_data.buf,
 				msg->data.header_or_data.len);
 		break;
 
+	case FETCH_DATA_ADOPT:
+		/* Received data to take ownership of */
+		if (((object->fetch.flags & LLCACHE_RETRIEVE_SPECULATIVE) != 0) &&
+		    (object->source_len + msg->data.adopt.len >
+		     SPECULATIVE_LIMIT)) {
+			if (msg->data.adopt.release != NULL) {
+				msg->data.adopt.release(msg->data.adopt.buf,
+							msg->data.adopt.len,
+							msg->data.adopt.pw);
+			}
+			error = llcache_fetch_speculative_limit(object);
+			break;
+		}
+
+		error = llcache_fetch_process_adopt(object,
+				msg->data.adopt.buf,
+				msg->data.adopt.len,
+				msg->data.adopt.release,
+				msg->data.adopt.pw);
+		break;
+
 	case FETCH_FINISHED:
 		/* Finished fetching */
 	{
 		uint8_t *temp;
+		size_t transferred;
 
 		object->fetch.state = LLCACHE_FETCH_COMPLETE;
+
+		/* account for content encoding of the transfer */
+		transferred = fetch_transferred(object->fetch.fetch);
+		if (transferred == 0) {
+			transferred = object->source_len;
+		}
+		nsmetric_add(llcache->metric.fetch_transferred, transferred);
+		nsmetric_add(llcache->metric.fetch_decoded, object->source_len);
+
 		object->fetch.fetch = NULL;
 
 		/* Shrink source buffer to required size */
-		temp = realloc(object->source_data,
-				object->source_len);
-		/* If source_len is 0, then temp may be NULL */
-		if (temp != NULL || object->source_len == 0) {
-			object->source_data = temp;
-			object->source_alloc = object->source_len;
+		if (object->source_adopted == false) {
+			temp = realloc(object->source_data,
+				       object->source_len);
+			/* If source_len is 0, then temp may be NULL */
+			if (temp != NULL || object->source_len == 0) {
+				object->source_data = temp;
+				object->source_alloc = object->source_len;
+			}
 		}
 
 		llcache_object_cache_update(object);
@@ -3876,9 +4206,45 @@ void llcache_clean(bool purge)
 		}
 	}
 
+	nsmetric_set(llcache->metric.size, llcache_size);
+
 	NSLOG(llcache, DEBUG, "Size: %u (limit: %u)", llcache_size, limit);
 }
 
+/**
+ * Register the low level cache performance metrics.
+ *
+ * Failure to register a metric is not fatal, updates to it are
+ * simply discarded.
+ */
+static void llcache_metrics_register(void)
+{
+	nsmetric_register("llcache.hit", NSMETRIC_COUNTER,
+			  &llcache->metric.hit);
+	nsmetric_register("llcache.revalidate", NSMETRIC_COUNTER,
+			  &llcache->metric.revalidate);
+	nsmetric_register("llcache.miss", NSMETRIC_COUNTER,
+			  &llcache->metric.miss);
+	nsmetric_register("llcache.size", NSMETRIC_GAUGE,
+			  &llcache->metric.size);
+	nsmetric_register("llcache.store.written", NSMETRIC_COUNTER,
+			  &llcache->metric.store_written);
+	nsmetric_register("llcache.store.write_ms", NSMETRIC_COUNTER,
+			  &llcache->metric.store_write_ms);
+	nsmetric_register("llcache.store.read", NSMETRIC_COUNTER,
+			  &llcache->metric.store_read);
+	nsmetric_register("llcache.store.read_ms", NSMETRIC_COUNTER,
+			  &llcache->metric.store_read_ms);
+	nsmetric_register("llcache.speculative", NSMETRIC_COUNTER,
+			  &llcache->metric.speculative);
+	nsmetric_register("llcache.speculative.hit", NSMETRIC_COUNTER,
+			  &llcache->metric.speculative_hit);
+	nsmetric_register("llcache.fetch.transferred", NSMETRIC_COUNTER,
+			  &llcache->metric.fetch_transferred);
+	nsmetric_register("llcache.fetch.decoded", NSMETRIC_COUNTER,
+			  &llcache->metric.fetch_decoded);
+}
+
 /* Exported interface documented in content/llcache.h */
 nserror
 llcache_initialise(const struct llcache_parameters *prm)
@@ -3896,6 +4262,8 @@ llcache_initialise(const struct llcache_parameters *prm)
 	llcache->fetch_attempts = prm->fetch_attempts;
 	llcache->all_caught_up = true;
 
+	llcache_metrics_register();
+
 	NSLOG(llcache, INFO,
 	      "llcache initialising with a limit of %d bytes",
 	      llcache->limit);
@@ -4149,6 +4517,13 @@ nserror llcache_handle_abort(llcache_handle *handle)
 	return error;
 }
 
+/* See llcache.h for documentation */
+bool llcache_handle_is_speculative(const llcache_handle *handle)
+{
+	return (handle->object->fetch.flags &
+		LLCACHE_RETRIEVE_SPECULATIVE) != 0;
+}
+
 /* See llcache.h for documentation */
 nserror llcache_handle_force_stream(llcache_handle *handle)
 {
@@ -4224,3 +4599,15 @@ bool llcache_handle_references_same_object(const llcache_handle *a,
 {
 	return a->object == b->object;
 }
+
+/* See llcache.h for documentation */
+uintptr_t llcache_handle_object_id(const llcache_handle *handle)
+{
+	return (uintptr_t)handle->object;
+}
+
+/* See llcache.h for documentation */
+bool llcache_handle_is_fresh(const llcache_handle *handle)
+{
+	return llcache_object_is_fresh(handle->object);
+}
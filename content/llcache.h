@@ -60,7 +60,11 @@ enum llcache_retrieve_flag {
 	/**< No error pages */
 	LLCACHE_RETRIEVE_NO_ERROR_PAGES = (1 << 2),
 	/**< Stream data (implies that object is not cacheable) */
-	LLCACHE_RETRIEVE_STREAM_DATA    = (1 << 3)
+	LLCACHE_RETRIEVE_STREAM_DATA    = (1 << 3),
+	/**< Speculative fetch at lowest priority which is never made
+	 * into a content; the object is only wanted in the cache
+	 */
+	LLCACHE_RETRIEVE_SPECULATIVE    = (1 << 4)
 };
 
 /** Low-level cache event types */
@@ -121,6 +125,8 @@ struct llcache_store_parameters {
 
 	size_t limit; /**< The backing store upper bound target size */
 	size_t hysteresis; /**< The hysteresis around the target size */
+
+	bool compress; /**< Compress data which is likely to benefit */
 };
 
 /**
@@ -231,6 +237,16 @@ nserror llcache_handle_clone(llcache_handle *handle, llcache_handle **result);
  */
 nserror llcache_handle_abort(llcache_handle *handle);
 
+/**
+ * Determine if a handle's object is only wanted speculatively
+ *
+ * \param handle  Handle to consider
+ * \return true if the object was retrieved with
+ *         LLCACHE_RETRIEVE_SPECULATIVE and has not been retrieved by a
+ *         normal user since.
+ */
+bool llcache_handle_is_speculative(const llcache_handle *handle);
+
 /**
  * Force a low-level cache handle into streaming mode
  *
@@ -291,4 +307,20 @@ const char *llcache_handle_get_header(const llcache_handle *handle,
 bool llcache_handle_references_same_object(const llcache_handle *a,
 		const llcache_handle *b);
 
+/**
+ * Get the identity of the object referenced by a handle
+ *
+ * \param handle  Handle to consider
+ * \return Identity which is equal for handles referencing the same object
+ */
+uintptr_t llcache_handle_object_id(const llcache_handle *handle);
+
+/**
+ * Determine if the object referenced by a handle is still fresh
+ *
+ * \param handle  Handle to consider
+ * \return True if the object may be used without revalidation
+ */
+bool llcache_handle_is_fresh(const llcache_handle *handle);
+
 #endif
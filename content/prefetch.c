@@ -0,0 +1,245 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Speculative prefetch implementation.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "utils/errors.h"
+#include "utils/log.h"
+#include "utils/corestrings.h"
+#include "utils/nsurl.h"
+#include "content/llcache.h"
+
+#include "content/prefetch.h"
+
+/** Maximum number of outstanding prefetches */
+#define PREFETCH_MAX 4
+
+/** Number of recently prefetched URLs remembered */
+#define PREFETCH_RECENT 16
+
+/** An outstanding prefetch */
+struct prefetch {
+	llcache_handle *handle; /**< low level cache handle */
+	const void *owner; /**< requester */
+
+	struct prefetch *next; /**< next outstanding prefetch */
+};
+
+/** Outstanding prefetches */
+static struct prefetch *prefetch_list = NULL;
+
+/** Recently prefetched URLs */
+static nsurl *prefetch_recent[PREFETCH_RECENT];
+
+/** Next entry in the recently prefetched URLs to replace */
+static unsigned int prefetch_recent_next = 0;
+
+
+/**
+ * Remove and free an outstanding prefetch
+ *
+ * \param pf The prefetch to remove.
+ */
+static void prefetch_remove(struct prefetch *pf)
+{
+	struct prefetch **link = &prefetch_list;
+
+	while (*link != NULL) {
+		if (*link == pf) {
+			*link = pf->next;
+			break;
+		}
+		link = &(*link)->next;
+	}
+
+	llcache_handle_release(pf->handle);
+	free(pf);
+}
+
+
+/**
+ * Low level cache callback for a prefetch
+ *
+ * The object is only wanted in the cache so the prefetch is finished
+ * with once it is complete or has failed.
+ */
+static nserror
+prefetch_callback(llcache_handle *handle, const llcache_event *event, void *pw)
+{
+	struct prefetch *pf = pw;
+
+	switch (event->type) {
+	case LLCACHE_EVENT_DONE:
+		NSLOG(netsurf, DEBUG, "Prefetched %s",
+		      nsurl_access(llcache_handle_get_url(handle)));
+		prefetch_remove(pf);
+		break;
+
+	case LLCACHE_EVENT_ERROR:
+		NSLOG(netsurf, DEBUG, "Prefetch of %s failed: %s",
+		      nsurl_access(llcache_handle_get_url(handle)),
+		      event->data.error.msg);
+		prefetch_remove(pf);
+		break;
+
+	default:
+		break;
+	}
+
+	return NSERROR_OK;
+}
+
+
+/**
+ * Check if a URL was recently prefetched, remembering it if not
+ *
+ * \param url The URL to check.
+ * \return true if the URL was recently prefetched.
+ */
+static bool prefetch_is_recent(nsurl *url)
+{
+	unsigned int idx;
+
+	for (idx = 0; idx < PREFETCH_RECENT; idx++) {
+		if ((prefetch_recent[idx] != NULL) &&
+		    nsurl_compare(prefetch_recent[idx], url, NSURL_COMPLETE)) {
+			return true;
+		}
+	}
+
+	if (prefetch_recent[prefetch_recent_next] != NULL) {
+		nsurl_unref(prefetch_recent[prefetch_recent_next]);
+	}
+	prefetch_recent[prefetch_recent_next] = nsurl_ref(url);
+	prefetch_recent_next = (prefetch_recent_next + 1) % PREFETCH_RECENT;
+
+	return false;
+}
+
+
+/* exported interface documented in content/prefetch.h */
+nserror prefetch_url(nsurl *url, nsurl *referer, const void *owner)
+{
+	struct prefetch *pf;
+	unsigned int count = 0;
+	lwc_string *scheme;
+	bool match;
+	nserror res;
+
+	/* only http(s) has anything worth fetching ahead */
+	scheme = nsurl_get_component(url, NSURL_SCHEME);
+	if ((lwc_string_caseless_isequal(scheme, corestring_lwc_http,
+					 &match) != lwc_error_ok) ||
+	    (match == false)) {
+		if ((lwc_string_caseless_isequal(scheme, corestring_lwc_https,
+						 &match) != lwc_error_ok) ||
+		    (match == false)) {
+			lwc_string_unref(scheme);
+			return NSERROR_OK;
+		}
+	}
+	lwc_string_unref(scheme);
+
+	/* a link within the requesting document */
+	if ((referer != NULL) && nsurl_compare(url, referer, NSURL_COMPLETE)) {
+		return NSERROR_OK;
+	}
+
+	for (pf = prefetch_list; pf != NULL; pf = pf->next) {
+		count++;
+	}
+	if (count >= PREFETCH_MAX) {
+		return NSERROR_OK;
+	}
+
+	if (prefetch_is_recent(url)) {
+		return NSERROR_OK;
+	}
+
+	pf = calloc(1, sizeof(*pf));
+	if (pf == NULL) {
+		return NSERROR_NOMEM;
+	}
+
+	res = llcache_handle_retrieve(url,
+				      LLCACHE_RETRIEVE_SPECULATIVE |
+				      LLCACHE_RETRIEVE_VERIFIABLE,
+				      referer,
+				      NULL,
+				      prefetch_callback,
+				      pf,
+				      &pf->handle);
+	if (res != NSERROR_OK) {
+		free(pf);
+		return res;
+	}
+
+	NSLOG(netsurf, DEBUG, "Prefetching %s", nsurl_access(url));
+
+	pf->owner = owner;
+	pf->next = prefetch_list;
+	prefetch_list = pf;
+
+	return NSERROR_OK;
+}
+
+
+/* exported interface documented in content/prefetch.h */
+void prefetch_cancel(const void *owner)
+{
+	struct prefetch *pf;
+	struct prefetch *next;
+
+	for (pf = prefetch_list; pf != NULL; pf = next) {
+		next = pf->next;
+		if (pf->owner != owner) {
+			continue;
+		}
+
+		if (llcache_handle_is_speculative(pf->handle)) {
+			/* nobody else wants it; stop fetching */
+			llcache_handle_abort(pf->handle);
+		}
+		prefetch_remove(pf);
+	}
+}
+
+
+/* exported interface documented in content/prefetch.h */
+void prefetch_fini(void)
+{
+	unsigned int idx;
+
+	while (prefetch_list != NULL) {
+		llcache_handle_abort(prefetch_list->handle);
+		prefetch_remove(prefetch_list);
+	}
+
+	for (idx = 0; idx < PREFETCH_RECENT; idx++) {
+		if (prefetch_recent[idx] != NULL) {
+			nsurl_unref(prefetch_recent[idx]);
+			prefetch_recent[idx] = NULL;
+		}
+	}
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Speculative prefetch interface.
+ *
+ * Resources likely to be navigated to next are fetched into the low
+ * level cache at the lowest priority so the navigation, if it happens,
+ * is served from the cache. Prefetched objects are never made into
+ * contents so no parsing or scripting takes place.
+ */
+
+#ifndef NETSURF_CONTENT_PREFETCH_H
+#define NETSURF_CONTENT_PREFETCH_H
+
+#include "utils/errors.h"
+#include "utils/nsurl.h"
+
+/**
+ * Prefetch a URL into the low level cache.
+ *
+ * Requests for URLs already being, or recently, prefetched are ignored
+ * as are those beyond the limit of outstanding prefetches.
+ *
+ * \param url The URL to prefetch.
+ * \param referer The URL of the document requesting the prefetch.
+ * \param owner The requester, used to cancel its prefetches.
+ * \return NSERROR_OK on success else appropriate error code.
+ */
+nserror prefetch_url(nsurl *url, nsurl *referer, const void *owner);
+
+/**
+ * Cancel the outstanding prefetches of a requester.
+ *
+ * Fetches which are still only wanted speculatively are aborted.
+ *
+ * \param owner The requester.
+ */
+void prefetch_cancel(const void *owner);
+
+/**
+ * Finalise the prefetcher.
+ *
+ * Every outstanding prefetch is cancelled.
+ */
+void prefetch_fini(void);
+
+#endif
@@ -87,13 +87,23 @@
  * potential crashes.
  */
 
+#include "utils/config.h"
+
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <time.h>
+#ifdef HAVE_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #ifdef WITH_NSPSL
 #include <nspsl.h>
 #endif
@@ -193,6 +203,24 @@ struct url_internal_data {
 };
 
 
+/**
+ * Cached Cookie header for requests to a path
+ *
+ * The cookies which apply to a path can only change when a cookie is
+ * set or deleted on its host or a parent domain, or when one of them
+ * expires. Until then the header built for the path is reused.
+ */
+struct cookie_cache {
+	unsigned int generation; /**< Cookie generation when built */
+	time_t expires;		/**< Earliest expiry of the matched
+				 * cookies or -1 for none */
+	char *header;		/**< Header value or NULL if no cookies */
+	unsigned int count;	/**< Number of matched cookies */
+	/** Matched cookies, for updating their last use */
+	struct cookie_internal_data **cookies;
+};
+
+
 /**
  * data entry for url
  */
@@ -225,6 +253,23 @@ struct path_data {
 	struct path_data *parent; /**< Parent path segment */
 	struct path_data *children; /**< Child path segments */
 	struct path_data *last; /**< Last child */
+
+	size_t segment_len;	/**< Length of segment */
+	uint32_t segment_hash;	/**< Hash of segment */
+	struct path_data *hash_next; /**< Next in parent's child index bucket */
+	unsigned int child_count; /**< Number of child path segments */
+	unsigned int child_index_size; /**< Buckets in child_index */
+	/**
+	 * Child path segments indexed by segment hash. Only present once
+	 * the number of children reaches URLDB_PATH_INDEX_THRESHOLD.
+	 */
+	struct path_data **child_index;
+
+	/**
+	 * Cookie headers for requests to this path, indexed by whether
+	 * HttpOnly cookies are included.
+	 */
+	struct cookie_cache *cookie_cache[2];
 };
 
 struct hsts_data {
@@ -261,6 +306,61 @@ struct host_part {
 	struct host_part *prev;	/**< Previous sibling */
 	struct host_part *parent; /**< Parent host part */
 	struct host_part *children; /**< Child host parts */
+
+	/**
+	 * Index of the first URL record in the loaded snapshot whose
+	 * paths have not yet been added to this host.
+	 */
+	uint32_t snapshot_first;
+	/** Number of URL records in the snapshot still to be added */
+	uint32_t snapshot_count;
+
+	/**
+	 * Cookie generation at which cookies stored on this host last
+	 * changed.
+	 */
+	unsigned int cookie_generation;
+};
+
+
+/**
+ * A URL entry as held in a database file
+ */
+struct urldb_entry {
+	const char *scheme;	/**< URL scheme */
+	unsigned int port;	/**< Port number or 0 for the scheme default */
+	const char *path;	/**< Path and query */
+	unsigned int visits;	/**< Visit count */
+	time_t last_visit;	/**< Last visit time */
+	content_type type;	/**< Type of resource */
+	const char *title;	/**< Resource title or NULL */
+	uint32_t hash;		/**< nsurl hash of the URL */
+};
+
+/**
+ * Callback for each URL entry written to a database file
+ *
+ * \param entry The entry to write
+ * \param ctx The writer context
+ * \return true to continue, false to stop
+ */
+typedef bool (*urldb_entry_cb)(const struct urldb_entry *entry, void *ctx);
+
+
+/**
+ * A loaded database snapshot
+ *
+ * The file is either mapped or read into memory as a whole and the
+ * records are decoded from it in place.
+ */
+struct urldb_snapshot {
+	uint8_t *data;		/**< Snapshot file contents */
+	size_t size;		/**< Size of data */
+	bool mapped;		/**< data is mapped rather than allocated */
+	const uint8_t *strings;	/**< String table */
+	uint32_t strings_len;	/**< Length of string table */
+	const uint8_t *section[2]; /**< Record sections */
+	uint32_t count[2];	/**< Number of records in each section */
 };
 
 
@@ -299,6 +399,15 @@ static struct search_node *search_trees[NUM_SEARCH_TREES] = {
 /** loaded cookie file version */
 static int loaded_cookie_file_version;
 
+/**
+ * Cookie generation counter.
+ *
+ * Incremented whenever cookies change, the host they are stored on
+ * records the new value so cached cookie headers built before it can
+ * be detected.
+ */
+static unsigned int cookie_generation;
+
 /** Minimum URL database file version */
 #define MIN_URL_FILE_VERSION 106
 /** Current URL database file version */
@@ -321,6 +430,107 @@ static struct bloom_filter *url_bloom;
  */
 #define BLOOM_SIZE (1024 * 32)
 
+/**
+ * Number of children a path node must have before its children are
+ * indexed by segment hash. Below this a walk of the sibling list is as
+ * quick as hashing the segment.
+ */
+#define URLDB_PATH_INDEX_THRESHOLD 8
+
+/**
+ * Database snapshot format
+ *
+ * The URL and cookie databases are saved as binary snapshots which can
+ * be loaded without parsing. All values are little endian and strings
+ * are referenced by their offset in a table of NUL terminated strings.
+ *
+ * Header, URLDB_SNAPSHOT_HEADER_SIZE bytes:
+ *  - 8 byte identifier (URLDB_SNAPSHOT_MAGIC or COOKIE_SNAPSHOT_MAGIC)
+ *  - format version
+ *  - string table offset and length
+ *  - record count and offset of section 0
+ *  - record count and offset of section 1
+ *  - nsurl hash of URLDB_SNAPSHOT_HASH_PROBE
+ *
+ * The nsurl hash in the header identifies the hash algorithm used for
+ * the URL records; the recorded hashes are only used if it matches.
+ *
+ * The URL database has host records in section 0, each referencing a
+ * contiguous run of URL records in section 1. The cookie database has
+ * only cookie records in section 0.
+ *
+ * Host record, URLDB_SNAPSHOT_HOST_SIZE bytes:
+ *  - host name string
+ *  - flags (bit 0 set if HSTS includes sub domains)
+ *  - HSTS expiry time (64 bit)
+ *  - index of first URL record
+ *  - number of URL records
+ *
+ * URL record, URLDB_SNAPSHOT_URL_SIZE bytes:
+ *  - scheme string
+ *  - port
+ *  - path and query string
+ *  - title string
+ *  - visit count
+ *  - content type
+ *  - nsurl hash
+ *  - reserved
+ *  - last visit time (64 bit)
+ *
+ * Cookie record, URLDB_SNAPSHOT_COOKIE_SIZE bytes:
+ *  - cookie version
+ *  - flags (URLDB_SNAPSHOT_COOKIE_*)
+ *  - expiry time (64 bit)
+ *  - last used time (64 bit)
+ *  - domain, path, name, value, scheme, url and comment strings
+ *  - reserved
+ */
+
+/** URL database snapshot identifier */
+#define URLDB_SNAPSHOT_MAGIC "NSURLDB"
+/** Cookie database snapshot identifier */
+#define COOKIE_SNAPSHOT_MAGIC "NSCOOKS"
+/** Current snapshot format version */
+#define URLDB_SNAPSHOT_VERSION 1
+/** Size of snapshot header */
+#define URLDB_SNAPSHOT_HEADER_SIZE 40
+/** Size of a snapshot host record */
+#define URLDB_SNAPSHOT_HOST_SIZE 24
+/** Size of a snapshot URL record */
+#define URLDB_SNAPSHOT_URL_SIZE 40
+/** Size of a snapshot cookie record */
+#define URLDB_SNAPSHOT_COOKIE_SIZE 56
+/** URL whose hash identifies the nsurl hash algorithm */
+#define URLDB_SNAPSHOT_HASH_PROBE "http://www.netsurf-browser.org/"
+/** String offset of an absent string */
+#define URLDB_SNAPSHOT_NONE UINT32_MAX
+
+/** Snapshot host record flag for HSTS including sub domains */
+#define URLDB_SNAPSHOT_HOST_HSTS_SUBDOMAINS (1 << 0)
+
+/** Snapshot cookie record flags */
+#define URLDB_SNAPSHOT_COOKIE_DOMAIN_FROM_SET (1 << 0)
+#define URLDB_SNAPSHOT_COOKIE_PATH_FROM_SET (1 << 1)
+#define URLDB_SNAPSHOT_COOKIE_SECURE (1 << 2)
+#define URLDB_SNAPSHOT_COOKIE_HTTP_ONLY (1 << 3)
+#define URLDB_SNAPSHOT_COOKIE_NO_DESTROY (1 << 4)
+#define URLDB_SNAPSHOT_COOKIE_VALUE_QUOTED (1 << 5)
+
+/**
+ * URL snapshot from which hosts paths are added on first use
+ */
+static struct urldb_snapshot url_snapshot;
+
+/**
+ * Number of hosts with paths still to be added from url_snapshot.
+ * The snapshot is released once this reaches zero.
+ */
+static unsigned int url_snapshot_pending;
+
+
+/* hosts loaded from a snapshot have their paths added on first use */
+static bool urldb_host_materialise(const struct host_part *host);
+
 
 /**
  * write a time_t to a file portably
@@ -344,56 +554,541 @@ static nserror urldb_write_timet(FILE *fp, time_t val)
 }
 
 /**
- * Write paths associated with a host
+ * read a little endian 32 bit value from a snapshot
  *
- * \param parent Root of (sub)tree to write
- * \param host Current host name
- * \param fp File to write to
- * \param path Current path string
- * \param path_alloc Allocated size of path
- * \param path_used Used size of path
- * \param expiry Expiry time of URLs
+ * \param p The location of the value
+ * \return The value
+ */
+static inline uint32_t urldb_snapshot_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] |
+		((uint32_t)p[1] << 8) |
+		((uint32_t)p[2] << 16) |
+		((uint32_t)p[3] << 24);
+}
+
+
+/**
+ * read a little endian 64 bit signed value from a snapshot
+ *
+ * \param p The location of the value
+ * \return The value
+ */
+static inline int64_t urldb_snapshot_s64(const uint8_t *p)
+{
+	return (int64_t)((uint64_t)urldb_snapshot_u32(p) |
+			 ((uint64_t)urldb_snapshot_u32(p + 4) << 32));
+}
+
+
+/**
+ * get a string from a snapshot string table
+ *
+ * The string table is checked to be NUL terminated when the snapshot
+ * is opened so any offset within it yields a terminated string.
+ *
+ * \param snap The snapshot
+ * \param offset The offset of the string in the string table
+ * \return The string or NULL if absent or invalid
+ */
+static inline const char *
+urldb_snapshot_string(const struct urldb_snapshot *snap, uint32_t offset)
+{
+	if (offset >= snap->strings_len) {
+		return NULL;
+	}
+	return (const char *)snap->strings + offset;
+}
+
+
+/**
+ * release a snapshot
+ *
+ * \param snap The snapshot to release
+ */
+static void urldb_snapshot_close(struct urldb_snapshot *snap)
+{
+	if (snap->data == NULL) {
+		return;
+	}
+
+#ifdef HAVE_MMAP
+	if (snap->mapped) {
+		munmap(snap->data, snap->size);
+		memset(snap, 0, sizeof(*snap));
+		return;
+	}
+#endif
+
+	free(snap->data);
+	memset(snap, 0, sizeof(*snap));
+}
+
+
+/**
+ * open a snapshot file
+ *
+ * The file is mapped where possible, otherwise it is read into
+ * memory. The header is validated and the section locations set up.
+ *
+ * \param filename The file to open
+ * \param magic The expected snapshot identifier
+ * \param record_size The size of records in each section
+ * \param snap The snapshot to fill
+ * \return NSERROR_OK on success, NSERROR_NOT_FOUND if the file could
+ *          not be opened or NSERROR_INVALID if it is not a valid snapshot.
+ */
+static nserror
+urldb_snapshot_open(const char *filename,
+		    const char *magic,
+		    const size_t record_size[2],
+		    struct urldb_snapshot *snap)
+{
+	uint8_t *data;
+	size_t size;
+	uint32_t offset;
+	unsigned int sec;
+#ifdef HAVE_MMAP
+	struct stat sb;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return NSERROR_NOT_FOUND;
+	}
+
+	if ((fstat(fd, &sb) != 0) ||
+	    (sb.st_size < URLDB_SNAPSHOT_HEADER_SIZE)) {
+		close(fd);
+		return NSERROR_INVALID;
+	}
+	size = sb.st_size;
+
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return NSERROR_NOMEM;
+	}
+
+	snap->mapped = true;
+#else
+	uint8_t header[URLDB_SNAPSHOT_HEADER_SIZE];
+	FILE *fp;
+	long len;
+
+	fp = fopen(filename, "rb");
+	if (fp == NULL) {
+		return NSERROR_NOT_FOUND;
+	}
+
+	/* check the identifier before reading the whole file */
+	if ((fread(header, sizeof(header), 1, fp) != 1) ||
+	    (memcmp(header, magic, 8) != 0) ||
+	    (fseek(fp, 0, SEEK_END) != 0) ||
+	    ((len = ftell(fp)) < URLDB_SNAPSHOT_HEADER_SIZE) ||
+	    (fseek(fp, 0, SEEK_SET) != 0)) {
+		fclose(fp);
+		return NSERROR_INVALID;
+	}
+	size = len;
+
+	data = malloc(size);
+	if (data == NULL) {
+		fclose(fp);
+		return NSERROR_NOMEM;
+	}
+
+	if (fread(data, size, 1, fp) != 1) {
+		free(data);
+		fclose(fp);
+		return NSERROR_INVALID;
+	}
+	fclose(fp);
+
+	snap->mapped = false;
+#endif
+
+	snap->data = data;
+	snap->size = size;
+
+	if ((memcmp(data, magic, 8) != 0) ||
+	    (urldb_snapshot_u32(data + 8) != URLDB_SNAPSHOT_VERSION)) {
+		goto invalid;
+	}
+
+	offset = urldb_snapshot_u32(data + 12);
+	snap->strings_len = urldb_snapshot_u32(data + 16);
+	if ((snap->strings_len == 0) ||
+	    (((uint64_t)offset + snap->strings_len) > size) ||
+	    (data[offset + snap->strings_len - 1] != '\0')) {
+		goto invalid;
+	}
+	snap->strings = data + offset;
+
+	for (sec = 0; sec < 2; sec++) {
+		snap->count[sec] = urldb_snapshot_u32(data + 20 + (sec * 8));
+		offset = urldb_snapshot_u32(data + 24 + (sec * 8));
+		if (((uint64_t)offset +
+		     ((uint64_t)snap->count[sec] * record_size[sec])) > size) {
+			goto invalid;
+		}
+		snap->section[sec] = data + offset;
+	}
+
+	return NSERROR_OK;
+
+invalid:
+	NSLOG(netsurf, INFO, "Invalid snapshot '%s'", filename);
+	urldb_snapshot_close(snap);
+	return NSERROR_INVALID;
+}
+
+
+/**
+ * Compute the nsurl hash identifying the hash algorithm in use
+ *
+ * \return The hash of URLDB_SNAPSHOT_HASH_PROBE or 0 on error
+ */
+static uint32_t urldb_snapshot_hash_probe(void)
+{
+	nsurl *url;
+	uint32_t hash;
+
+	if (nsurl_create(URLDB_SNAPSHOT_HASH_PROBE, &url) != NSERROR_OK) {
+		return 0;
+	}
+	hash = nsurl_hash(url);
+	nsurl_unref(url);
+
+	return hash;
+}
+
+
+/**
+ * decode a URL record from the URL snapshot
+ *
+ * \param idx The index of the URL record
+ * \param entry The entry to fill
+ * \return true on success, false if the record is invalid
+ */
+static bool urldb_snapshot_url_entry(uint32_t idx, struct urldb_entry *entry)
+{
+	const uint8_t *rec;
+
+	rec = url_snapshot.section[1] + ((size_t)idx * URLDB_SNAPSHOT_URL_SIZE);
+
+	entry->scheme = urldb_snapshot_string(&url_snapshot,
+					      urldb_snapshot_u32(rec));
+	entry->port = urldb_snapshot_u32(rec + 4);
+	entry->path = urldb_snapshot_string(&url_snapshot,
+					    urldb_snapshot_u32(rec + 8));
+	entry->title = urldb_snapshot_string(&url_snapshot,
+					     urldb_snapshot_u32(rec + 12));
+	entry->visits = urldb_snapshot_u32(rec + 16);
+	entry->type = (content_type)urldb_snapshot_u32(rec + 20);
+	entry->hash = urldb_snapshot_u32(rec + 24);
+	entry->last_visit = (time_t)urldb_snapshot_s64(rec + 32);
+
+	return (entry->scheme != NULL) && (entry->path != NULL);
+}
+
+
+/**
+ * A growable snapshot output buffer
+ */
+struct urldb_snapshot_buffer {
+	uint8_t *data;	/**< Buffer contents */
+	size_t len;	/**< Used length of data */
+	size_t alloc;	/**< Allocated size of data */
+};
+
+
+/**
+ * Snapshot writer state
+ */
+struct urldb_snapshot_writer {
+	struct urldb_snapshot_buffer strings; /**< String table */
+	struct urldb_snapshot_buffer section[2]; /**< Record sections */
+	uint32_t count[2];	/**< Number of records in each section */
+	bool failed;		/**< An allocation failed */
+	const char *last_scheme; /**< Most recently written scheme */
+	uint32_t last_scheme_offset; /**< String offset of last_scheme */
+};
+
+
+/**
+ * append data to a snapshot output buffer
+ *
+ * Failure is recorded in the writer so callers need only check once
+ * all output has been generated.
+ *
+ * \param w The snapshot writer
+ * \param buf The buffer to append to
+ * \param data The data to append
+ * \param len The length of data
  */
 static void
-urldb_write_paths(const struct path_data *parent,
-		  const char *host,
-		  FILE *fp,
-		  char **path,
-		  int *path_alloc,
-		  int *path_used,
-		  time_t expiry)
+urldb_snapshot_append(struct urldb_snapshot_writer *w,
+		      struct urldb_snapshot_buffer *buf,
+		      const void *data,
+		      size_t len)
+{
+	if (w->failed) {
+		return;
+	}
+
+	if ((buf->len + len) > buf->alloc) {
+		size_t alloc = (buf->alloc < 4096) ? 4096 : buf->alloc;
+		uint8_t *temp;
+
+		while (alloc < (buf->len + len)) {
+			alloc *= 2;
+		}
+
+		temp = realloc(buf->data, alloc);
+		if (temp == NULL) {
+			w->failed = true;
+			return;
+		}
+		buf->data = temp;
+		buf->alloc = alloc;
+	}
+
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+}
+
+
+/**
+ * append a little endian 32 bit value to a snapshot output buffer
+ */
+static void
+urldb_snapshot_put_u32(struct urldb_snapshot_writer *w,
+		       struct urldb_snapshot_buffer *buf,
+		       uint32_t val)
+{
+	uint8_t b[4];
+
+	b[0] = val;
+	b[1] = val >> 8;
+	b[2] = val >> 16;
+	b[3] = val >> 24;
+
+	urldb_snapshot_append(w, buf, b, sizeof(b));
+}
+
+
+/**
+ * append a little endian 64 bit signed value to a snapshot output buffer
+ */
+static void
+urldb_snapshot_put_s64(struct urldb_snapshot_writer *w,
+		       struct urldb_snapshot_buffer *buf,
+		       int64_t val)
+{
+	urldb_snapshot_put_u32(w, buf, (uint64_t)val);
+	urldb_snapshot_put_u32(w, buf, (uint64_t)val >> 32);
+}
+
+
+/**
+ * add a string to the snapshot string table
+ *
+ * \param w The snapshot writer
+ * \param str The string to add or NULL
+ * \return The string offset or URLDB_SNAPSHOT_NONE
+ */
+static uint32_t
+urldb_snapshot_put_string(struct urldb_snapshot_writer *w, const char *str)
+{
+	size_t len;
+	uint32_t offset;
+
+	if (str == NULL) {
+		return URLDB_SNAPSHOT_NONE;
+	}
+
+	len = strlen(str) + 1;
+	if ((w->strings.len + len) >= URLDB_SNAPSHOT_NONE) {
+		w->failed = true;
+		return URLDB_SNAPSHOT_NONE;
+	}
+
+	offset = w->strings.len;
+	urldb_snapshot_append(w, &w->strings, str, len);
+
+	return offset;
+}
+
+
+/**
+ * free the output buffers of a snapshot writer
+ *
+ * \param w The snapshot writer
+ */
+static void urldb_snapshot_writer_fini(struct urldb_snapshot_writer *w)
+{
+	free(w->strings.data);
+	free(w->section[0].data);
+	free(w->section[1].data);
+}
+
+
+/**
+ * write a snapshot file
+ *
+ * The snapshot is written to a temporary file which then replaces the
+ * destination so an interrupted save never leaves a truncated database.
+ *
+ * \param filename The file to write
+ * \param magic The snapshot identifier
+ * \param w The snapshot writer holding the output
+ * \return NSERROR_OK on success else error code
+ */
+static nserror
+urldb_snapshot_write(const char *filename,
+		     const char *magic,
+		     struct urldb_snapshot_writer *w)
+{
+	struct urldb_snapshot_buffer header = { NULL, 0, 0 };
+	size_t offset;
+	unsigned int sec;
+	char *tname;
+	FILE *fp;
+	bool ok;
+
+	/* the string table is never empty */
+	if (w->strings.len == 0) {
+		urldb_snapshot_put_string(w, "");
+	}
+
+	urldb_snapshot_append(w, &header, magic, 8);
+	urldb_snapshot_put_u32(w, &header, URLDB_SNAPSHOT_VERSION);
+
+	offset = URLDB_SNAPSHOT_HEADER_SIZE +
+		w->section[0].len + w->section[1].len;
+	urldb_snapshot_put_u32(w, &header, offset);
+	urldb_snapshot_put_u32(w, &header, w->strings.len);
+
+	offset = URLDB_SNAPSHOT_HEADER_SIZE;
+	for (sec = 0; sec < 2; sec++) {
+		urldb_snapshot_put_u32(w, &header, w->count[sec]);
+		urldb_snapshot_put_u32(w, &header, offset);
+		offset += w->section[sec].len;
+	}
+	urldb_snapshot_put_u32(w, &header, urldb_snapshot_hash_probe());
+
+	if (w->failed || (offset + w->strings.len) > UINT32_MAX) {
+		free(header.data);
+		return NSERROR_NOMEM;
+	}
+
+	tname = malloc(strlen(filename) + 5);
+	if (tname == NULL) {
+		free(header.data);
+		return NSERROR_NOMEM;
+	}
+	sprintf(tname, "%s.new", filename);
+
+	fp = fopen(tname, "wb");
+	if (fp == NULL) {
+		NSLOG(netsurf, INFO, "Failed to open file '%s' for writing",
+		      tname);
+		free(header.data);
+		free(tname);
+		return NSERROR_SAVE_FAILED;
+	}
+
+	ok = (fwrite(header.data, header.len, 1, fp) == 1);
+	for (sec = 0; sec < 2; sec++) {
+		if (ok && (w->section[sec].len > 0)) {
+			ok = (fwrite(w->section[sec].data,
+				     w->section[sec].len, 1, fp) == 1);
+		}
+	}
+	if (ok) {
+		ok = (fwrite(w->strings.data, w->strings.len, 1, fp) == 1);
+	}
+	if (fclose(fp) != 0) {
+		ok = false;
+	}
+	free(header.data);
+
+	if (ok && (rename(tname, filename) != 0)) {
+		/* non-POSIX rename() implementations will not replace
+		 * an existing file.
+		 */
+		(void)remove(filename);
+		ok = (rename(tname, filename) == 0);
+	}
+
+	if (!ok) {
+		NSLOG(netsurf, INFO, "Failed to write snapshot '%s'", filename);
+		(void)remove(tname);
+	}
+	free(tname);
+
+	return ok ? NSERROR_OK : NSERROR_SAVE_FAILED;
+}
+
+
+/**
+ * Enumerate the URL entries of a host's path tree which should be saved
+ *
+ * \param parent Root of (sub)tree to enumerate
+ * \param expiry Expiry time of URLs
+ * \param cb Callback for each entry
+ * \param ctx Context passed to \a cb
+ * \return true on success, false if \a cb stopped the enumeration or
+ *          on memory exhaustion
+ */
+static bool
+urldb_enumerate_paths(const struct path_data *parent,
+		      time_t expiry,
+		      urldb_entry_cb cb,
+		      void *ctx)
 {
 	const struct path_data *p = parent;
-	int i;
+	struct urldb_entry entry;
+	char *path;
+	int path_alloc = 64;
+	int path_used = 1;
+
+	path = malloc(path_alloc);
+	if (!path)
+		return false;
+
+	path[0] = '\0';
 
 	do {
 		int seglen = p->segment != NULL ? strlen(p->segment) : 0;
-		int len = *path_used + seglen + 1;
+		int len = path_used + seglen + 1;
 
-		if (*path_alloc < len) {
+		if (path_alloc < len) {
 			char *temp;
-			temp = realloc(*path,
-				       (len > 64) ? len : *path_alloc + 64);
+			temp = realloc(path,
+				       (len > 64) ? len : path_alloc + 64);
 			if (!temp) {
-				return;
+				free(path);
+				return false;
 			}
-			*path = temp;
-			*path_alloc = (len > 64) ? len : *path_alloc + 64;
+			path = temp;
+			path_alloc = (len > 64) ? len : path_alloc + 64;
 		}
 
 		if (p->segment != NULL) {
-			memcpy(*path + *path_used - 1, p->segment, seglen);
+			memcpy(path + path_used - 1, p->segment, seglen);
 		}
 
 		if (p->children != NULL) {
-			(*path)[*path_used + seglen - 1] = '/';
-			(*path)[*path_used + seglen] = '\0';
+			path[path_used + seglen - 1] = '/';
+			path[path_used + seglen] = '\0';
 		} else {
-			(*path)[*path_used + seglen - 1] = '\0';
+			path[path_used + seglen - 1] = '\0';
 			len -= 1;
 		}
 
-		*path_used = len;
+		path_used = len;
 
 		if (p->children != NULL) {
 			/* Drill down into children */
@@ -403,41 +1098,19 @@ urldb_write_paths(const struct path_data *parent,
 			if (p->persistent ||
 			    ((p->urld.last_visit > expiry) &&
 			     (p->urld.visits > 0))) {
-				fprintf(fp, "%s\n", lwc_string_data(p->scheme));
-
-				if (p->port) {
-					fprintf(fp,"%d\n", p->port);
-				} else {
-					fprintf(fp, "\n");
-				}
-
-				fprintf(fp, "%s\n", *path);
-
-				/** \todo handle fragments? */
-
-				/* number of visits */
-				fprintf(fp, "%i\n", p->urld.visits);
-
-				/* time entry was last used */
-				urldb_write_timet(fp, p->urld.last_visit);
-
-				/* entry type */
-				fprintf(fp, "%i\n", (int)p->urld.type);
-
-				fprintf(fp, "\n");
-
-				if (p->urld.title) {
-					uint8_t *s = (uint8_t *) p->urld.title;
-
-					for (i = 0; s[i] != '\0'; i++)
-						if (s[i] < 32)
-							s[i] = ' ';
-					for (--i; ((i > 0) && (s[i] == ' '));
-					     i--)
-						s[i] = '\0';
-					fprintf(fp, "%s\n", p->urld.title);
-				} else {
-					fprintf(fp, "\n");
+				entry.scheme = lwc_string_data(p->scheme);
+				entry.port = p->port;
+				entry.path = path;
+				entry.visits = p->urld.visits;
+				entry.last_visit = p->urld.last_visit;
+				entry.type = p->urld.type;
+				entry.title = p->urld.title;
+				entry.hash = (p->url != NULL) ?
+					nsurl_hash(p->url) : 0;
+
+				if (!cb(&entry, ctx)) {
+					free(path);
+					return false;
 				}
 			}
 
@@ -447,8 +1120,8 @@ urldb_write_paths(const struct path_data *parent,
 					? strlen(p->segment) : 0;
 
 				/* Remove our segment from the path */
-				*path_used -= seglen;
-				(*path)[*path_used - 1] = '\0';
+				path_used -= seglen;
+				path[path_used - 1] = '\0';
 
 				if (p->next != NULL) {
 					/* Have a sibling, process that */
@@ -457,123 +1130,288 @@ urldb_write_paths(const struct path_data *parent,
 				}
 
 				/* Going up, so remove '/' */
-				*path_used -= 1;
-				(*path)[*path_used - 1] = '\0';
+				path_used -= 1;
+				path[path_used - 1] = '\0';
 
 				/* Ascend tree */
 				p = p->parent;
 			}
 		}
 	} while (p != parent);
+
+	free(path);
+
+	return true;
 }
 
 
 /**
- * Count number of URLs associated with a host
+ * Enumerate the URL entries of a host which should be saved
+ *
+ * A host whose paths are still held in the URL snapshot has no path
+ * tree, its entries are taken directly from the snapshot records.
  *
- * \param root Root of path data tree
- * \param expiry Expiry time for URLs
- * \param count Pointer to count
+ * \param h The host
+ * \param expiry Expiry time of URLs
+ * \param cb Callback for each entry
+ * \param ctx Context passed to \a cb
+ * \return true on success, false if \a cb stopped the enumeration or
+ *          on memory exhaustion
  */
-static void
-urldb_count_urls(const struct path_data *root,
-		 time_t expiry,
-		 unsigned int *count)
+static bool
+urldb_enumerate_host(const struct host_part *h,
+		     time_t expiry,
+		     urldb_entry_cb cb,
+		     void *ctx)
 {
-	const struct path_data *p = root;
+	struct urldb_entry entry;
+	uint32_t idx;
 
-	do {
-		if (p->children != NULL) {
-			/* Drill down into children */
-			p = p->children;
-		} else {
-			/* No more children, increment count if required */
-			if (p->persistent ||
-			    ((p->urld.last_visit > expiry) &&
-			     (p->urld.visits > 0))) {
-				(*count)++;
-			}
+	if (h->snapshot_count == 0) {
+		return urldb_enumerate_paths(&h->paths, expiry, cb, ctx);
+	}
 
-			/* Now, find next node to process. */
-			while (p != root) {
-				if (p->next != NULL) {
-					/* Have a sibling, process that */
-					p = p->next;
-					break;
-				}
+	for (idx = h->snapshot_first;
+	     idx < (h->snapshot_first + h->snapshot_count);
+	     idx++) {
+		if (!urldb_snapshot_url_entry(idx, &entry)) {
+			continue;
+		}
 
-				/* Ascend tree */
-				p = p->parent;
+		if ((entry.last_visit > expiry) && (entry.visits > 0)) {
+			if (!cb(&entry, ctx)) {
+				return false;
 			}
 		}
-	} while (p != root);
+	}
+
+	return true;
 }
 
 
 /**
- * Save a search (sub)tree
+ * Generate the full host name of a host tree node
+ *
+ * \param h The host tree leaf node
+ * \param host The buffer to place the host name in
+ * \param size The size of \a host
+ * \return true on success, false on error
+ */
+static bool
+urldb_host_name(const struct host_part *h, char *host, size_t size)
+{
+	char *p = host;
+	char *end = host + size;
+
+	host[0] = '\0';
+
+	for (; h && h != &db_root && p < end; h = h->parent) {
+		int written = snprintf(p, end - p, "%s%s", h->part,
+				       (h->parent && h->parent->parent) ? "." : "");
+		if (written < 0) {
+			return false;
+		}
+		p += written;
+	}
+
+	return true;
+}
+
+
+/**
+ * count URL entries
+ */
+static bool urldb_count_entry(const struct urldb_entry *entry, void *ctx)
+{
+	unsigned int *count = ctx;
+
+	(*count)++;
+
+	return true;
+}
+
+
+/**
+ * write a URL entry to a text database file
+ */
+static bool urldb_write_entry(const struct urldb_entry *entry, void *ctx)
+{
+	FILE *fp = ctx;
+
+	fprintf(fp, "%s\n", entry->scheme);
+
+	if (entry->port) {
+		fprintf(fp,"%d\n", entry->port);
+	} else {
+		fprintf(fp, "\n");
+	}
+
+	fprintf(fp, "%s\n", entry->path);
+
+	/** \todo handle fragments? */
+
+	/* number of visits */
+	fprintf(fp, "%i\n", entry->visits);
+
+	/* time entry was last used */
+	urldb_write_timet(fp, entry->last_visit);
+
+	/* entry type */
+	fprintf(fp, "%i\n", (int)entry->type);
+
+	fprintf(fp, "\n");
+
+	if (entry->title) {
+		const uint8_t *s = (const uint8_t *)entry->title;
+		int len = strlen(entry->title);
+		int i;
+
+		/* control characters are written as spaces and trailing
+		 * spaces are dropped.
+		 */
+		while ((len > 1) && ((s[len - 1] == ' ') || (s[len - 1] < 32))) {
+			len--;
+		}
+		for (i = 0; i < len; i++) {
+			fputc((s[i] < 32) ? ' ' : s[i], fp);
+		}
+	}
+	fprintf(fp, "\n");
+
+	return true;
+}
+
+
+/**
+ * Export a search (sub)tree in the text format
  *
  * \param parent root node of search tree to save.
  * \param fp File to write to
+ * \param expiry Expiry time of URLs
  */
-static void urldb_save_search_tree(struct search_node *parent, FILE *fp)
+static void
+urldb_export_search_tree(struct search_node *parent, FILE *fp, time_t expiry)
 {
 	char host[256];
 	const struct host_part *h;
 	unsigned int path_count = 0;
-	char *path, *p, *end;
-	int path_alloc = 64, path_used = 1;
-	time_t expiry, hsts_expiry = 0;
+	time_t hsts_expiry = 0;
 	int hsts_include_subdomains = 0;
 
-	expiry = time(NULL) - ((60 * 60 * 24) * nsoption_int(expire_url));
-
 	if (parent == &empty)
 		return;
 
-	urldb_save_search_tree(parent->left, fp);
+	urldb_export_search_tree(parent->left, fp, expiry);
 
-	path = malloc(path_alloc);
-	if (!path)
-		return;
+	h = parent->data;
+	if (urldb_host_name(h, host, sizeof host)) {
+		if (h->hsts.expires > expiry) {
+			hsts_expiry = h->hsts.expires;
+			hsts_include_subdomains = h->hsts.include_sub_domains;
+		}
 
-	path[0] = '\0';
+		urldb_enumerate_host(h, expiry, urldb_count_entry, &path_count);
 
-	for (h = parent->data, p = host, end = host + sizeof host;
-	     h && h != &db_root && p < end; h = h->parent) {
-		int written = snprintf(p, end - p, "%s%s", h->part,
-				       (h->parent && h->parent->parent) ? "." : "");
-		if (written < 0) {
-			free(path);
-			return;
+		if (path_count > 0) {
+			fprintf(fp, "%s %i ", host, hsts_include_subdomains);
+			urldb_write_timet(fp, hsts_expiry);
+			fprintf(fp, "%i\n", path_count);
+
+			urldb_enumerate_host(h, expiry, urldb_write_entry, fp);
+		} else if (hsts_expiry) {
+			fprintf(fp, "%s %i ", host, hsts_include_subdomains);
+			urldb_write_timet(fp, hsts_expiry);
+			fprintf(fp, "0\n");
 		}
-		p += written;
 	}
 
-	h = parent->data;
-	if (h && h->hsts.expires > expiry) {
-		hsts_expiry = h->hsts.expires;
-		hsts_include_subdomains = h->hsts.include_sub_domains;
+	urldb_export_search_tree(parent->right, fp, expiry);
+}
+
+
+/**
+ * add a URL entry to a snapshot
+ */
+static bool urldb_snapshot_entry(const struct urldb_entry *entry, void *ctx)
+{
+	struct urldb_snapshot_writer *w = ctx;
+	struct urldb_snapshot_buffer *buf = &w->section[1];
+	uint32_t scheme;
+
+	/* almost every entry shares its scheme with the previous one */
+	if ((w->last_scheme != NULL) &&
+	    (strcmp(w->last_scheme, entry->scheme) == 0)) {
+		scheme = w->last_scheme_offset;
+	} else {
+		scheme = urldb_snapshot_put_string(w, entry->scheme);
+		w->last_scheme = entry->scheme;
+		w->last_scheme_offset = scheme;
 	}
 
-	urldb_count_urls(&parent->data->paths, expiry, &path_count);
+	urldb_snapshot_put_u32(w, buf, scheme);
+	urldb_snapshot_put_u32(w, buf, entry->port);
+	urldb_snapshot_put_u32(w, buf, urldb_snapshot_put_string(w, entry->path));
+	urldb_snapshot_put_u32(w, buf, urldb_snapshot_put_string(w, entry->title));
+	urldb_snapshot_put_u32(w, buf, entry->visits);
+	urldb_snapshot_put_u32(w, buf, entry->type);
+	urldb_snapshot_put_u32(w, buf, entry->hash);
+	urldb_snapshot_put_u32(w, buf, 0);
+	urldb_snapshot_put_s64(w, buf, entry->last_visit);
+	w->count[1]++;
+
+	return !w->failed;
+}
 
-	if (path_count > 0) {
-		fprintf(fp, "%s %i ", host, hsts_include_subdomains);
-		urldb_write_timet(fp, hsts_expiry);
-		fprintf(fp, "%i\n", path_count);
 
-		urldb_write_paths(&parent->data->paths, host, fp,
-				  &path, &path_alloc, &path_used, expiry);
-	} else if (hsts_expiry) {
-		fprintf(fp, "%s %i ", host, hsts_include_subdomains);
-		urldb_write_timet(fp, hsts_expiry);
-		fprintf(fp, "0\n");
-	}
+/**
+ * Add a search (sub)tree to a snapshot
+ *
+ * \param parent root node of search tree to save.
+ * \param w The snapshot writer
+ * \param expiry Expiry time of URLs
+ */
+static void
+urldb_snapshot_search_tree(struct search_node *parent,
+			   struct urldb_snapshot_writer *w,
+			   time_t expiry)
+{
+	char host[256];
+	const struct host_part *h;
+	uint32_t first;
+	time_t hsts_expiry = 0;
+	uint32_t flags = 0;
 
-	free(path);
+	if ((parent == &empty) || w->failed)
+		return;
+
+	urldb_snapshot_search_tree(parent->left, w, expiry);
+
+	h = parent->data;
+	if (urldb_host_name(h, host, sizeof host)) {
+		if (h->hsts.expires > expiry) {
+			hsts_expiry = h->hsts.expires;
+			if (h->hsts.include_sub_domains) {
+				flags |= URLDB_SNAPSHOT_HOST_HSTS_SUBDOMAINS;
+			}
+		}
+
+		first = w->count[1];
+		urldb_enumerate_host(h, expiry, urldb_snapshot_entry, w);
+
+		if ((w->count[1] > first) || hsts_expiry) {
+			struct urldb_snapshot_buffer *buf = &w->section[0];
 
-	urldb_save_search_tree(parent->right, fp);
+			urldb_snapshot_put_u32(w, buf,
+					urldb_snapshot_put_string(w, host));
+			urldb_snapshot_put_u32(w, buf, flags);
+			urldb_snapshot_put_s64(w, buf, hsts_expiry);
+			urldb_snapshot_put_u32(w, buf, first);
+			urldb_snapshot_put_u32(w, buf, w->count[1] - first);
+			w->count[0]++;
+		}
+	}
+
+	urldb_snapshot_search_tree(parent->right, w, expiry);
 }
 
 
@@ -849,6 +1687,8 @@ urldb_iterate_partial_host(struct search_node *root,
 			return false;
 		}
 
+		urldb_host_materialise(root->data);
+
 		if (root->data->paths.children) {
 			/* and extract all paths attached to this host */
 			if (!urldb_iterate_entries_path(&root->data->paths,
@@ -979,6 +1819,10 @@ urldb_iterate_entries_host(struct search_node *parent,
 		return false;
 	}
 
+	if (url_callback) {
+		urldb_host_materialise(parent->data);
+	}
+
 	if ((parent->data->paths.children) ||
 	    ((cookie_callback) &&
 	     (parent->data->paths.cookies))) {
@@ -1095,6 +1939,147 @@ urldb_add_path_fragment(struct path_data *segment, lwc_string *fragment)
 }
 
 
+/**
+ * Hash a path segment
+ *
+ * Fowler Noll Vo 1a, segments are short so this is cheap.
+ *
+ * \param segment The segment data, need not be NUL terminated
+ * \param len The length of the segment
+ * \return The segment hash
+ */
+static inline uint32_t urldb_segment_hash(const char *segment, size_t len)
+{
+	uint32_t z = 0x811c9dc5;
+
+	while (len-- > 0) {
+		z ^= (uint8_t)*segment++;
+		z *= 0x01000193;
+	}
+
+	return z;
+}
+
+
+/**
+ * (Re)build the child index of a path node
+ *
+ * \param parent The path node to index the children of
+ * \param size The number of buckets, must be a power of two
+ * \return true on success, false on memory exhaustion (the node is left
+ *         with its previous index, if any)
+ */
+static bool urldb_path_index_build(struct path_data *parent, unsigned int size)
+{
+	struct path_data **index;
+	struct path_data *e;
+	unsigned int bucket;
+
+	index = calloc(size, sizeof(struct path_data *));
+	if (index == NULL) {
+		return false;
+	}
+
+	for (e = parent->children; e != NULL; e = e->next) {
+		bucket = e->segment_hash & (size - 1);
+		e->hash_next = index[bucket];
+		index[bucket] = e;
+	}
+
+	free(parent->child_index);
+	parent->child_index = index;
+	parent->child_index_size = size;
+
+	return true;
+}
+
+
+/**
+ * Account for a new child in its parent's child index
+ *
+ * Builds the index when the child count reaches the threshold and
+ * doubles it when the load factor exceeds one. Failure to allocate an
+ * index is not fatal; lookups fall back to the sibling list.
+ *
+ * \param parent The parent path node
+ * \param child The newly linked child
+ */
+static void
+urldb_path_index_insert(struct path_data *parent, struct path_data *child)
+{
+	unsigned int bucket;
+
+	parent->child_count++;
+
+	if (parent->child_index == NULL) {
+		if (parent->child_count >= URLDB_PATH_INDEX_THRESHOLD) {
+			urldb_path_index_build(parent,
+					URLDB_PATH_INDEX_THRESHOLD * 2);
+		}
+		return;
+	}
+
+	if (parent->child_count > parent->child_index_size) {
+		if (urldb_path_index_build(parent,
+				parent->child_index_size * 2)) {
+			return;
+		}
+	}
+
+	bucket = child->segment_hash & (parent->child_index_size - 1);
+	child->hash_next = parent->child_index[bucket];
+	parent->child_index[bucket] = child;
+}
+
+
+/**
+ * Find a child of a path node
+ *
+ * \param parent The path node to search the children of
+ * \param segment The segment to find, need not be NUL terminated
+ * \param len The length of the segment
+ * \param scheme The URL scheme associated with the path
+ * \param port The port associated with the path
+ * \return The matching child or NULL if not found
+ */
+static struct path_data *
+urldb_find_child(const struct path_data *parent,
+		 const char *segment,
+		 size_t len,
+		 lwc_string *scheme,
+		 unsigned int port)
+{
+	struct path_data *e;
+	uint32_t hash;
+
+	if (parent->child_index != NULL) {
+		hash = urldb_segment_hash(segment, len);
+		e = parent->child_index[hash & (parent->child_index_size - 1)];
+		for (; e != NULL; e = e->hash_next) {
+			if (e->segment_hash == hash &&
+			    e->segment_len == len &&
+			    e->scheme == scheme &&
+			    e->port == port &&
+			    memcmp(e->segment, segment, len) == 0) {
+				return e;
+			}
+		}
+		return NULL;
+	}
+
+	for (e = parent->children; e != NULL; e = e->next) {
+		if (e->segment_len == len &&
+		    e->scheme == scheme &&
+		    e->port == port &&
+		    memcmp(e->segment, segment, len) == 0) {
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+
 /**
  * Add a path node to the tree
  *
@@ -1130,6 +2115,8 @@ urldb_add_path_node(lwc_string *scheme,
 		free(d);
 		return NULL;
 	}
+	d->segment_len = strlen(segment);
+	d->segment_hash = urldb_segment_hash(segment, d->segment_len);
 
 	if (fragment) {
 		if (!urldb_add_path_fragment(d, fragment)) {
@@ -1164,6 +2151,8 @@ urldb_add_path_node(lwc_string *scheme,
 	}
 	d->parent = parent;
 
+	urldb_path_index_insert(parent, d);
+
 	return d;
 }
 
@@ -1298,7 +2287,8 @@ urldb_search_find(struct search_node *root, const char *host)
  * Match a path string
  *
  * \param parent Path (sub)tree to look in
- * \param path The path to search for
+ * \param path The path to search for, need not be NUL terminated
+ * \param path_len The length of the path
  * \param scheme The URL scheme associated with the path
  * \param port The port associated with the path
  * \return Pointer to path data or NULL if not found.
@@ -1306,51 +2296,42 @@ urldb_search_find(struct search_node *root, const char *host)
 static struct path_data *
 urldb_match_path(const struct path_data *parent,
 		 const char *path,
+		 size_t path_len,
 		 lwc_string *scheme,
 		 unsigned short port)
 {
-	const struct path_data *p;
+	const struct path_data *p = parent;
+	const char *end = path + path_len;
+	const char *segment;
 	const char *slash;
-	bool match;
 
 	assert(parent != NULL);
 	assert(parent->segment == NULL);
 
-	if (path[0] != '/') {
-		NSLOG(netsurf, INFO, "path is %s", path);
+	if ((path_len == 0) || (path[0] != '/')) {
+		NSLOG(netsurf, INFO, "path is %.*s", (int)path_len, path);
+		return NULL;
 	}
 
-	assert(path[0] == '/');
-
-	/* Start with children, as parent has no segment */
-	p = parent->children;
-
-	while (p != NULL) {
-		slash = strchr(path + 1, '/');
-		if (!slash) {
-			slash = path + strlen(path);
-		}
-
-		if (strncmp(p->segment, path + 1, slash - path - 1) == 0 &&
-		    lwc_string_isequal(p->scheme, scheme, &match) == lwc_error_ok &&
-		    match == true &&
-		    p->port == port) {
-			if (*slash == '\0') {
-				/* Complete match */
-				return (struct path_data *) p;
-			}
-
-			/* Match so far, go down tree */
-			p = p->children;
+	/* Start with children, as parent has no segment */
+	do {
+		segment = path + 1;
+		slash = memchr(segment, '/', end - segment);
+		if (slash == NULL) {
+			slash = end;
+		}
 
-			path = slash;
-		} else {
-			/* No match, try next sibling */
-			p = p->next;
+		p = urldb_find_child(p, segment, slash - segment, scheme, port);
+		if (p == NULL) {
+			return NULL;
 		}
-	}
 
-	return NULL;
+		/* Match so far, go down tree */
+		path = slash;
+	} while (path < end);
+
+	/* Complete match */
+	return (struct path_data *) p;
 }
 
 
@@ -1363,14 +2344,12 @@ urldb_match_path(const struct path_data *parent,
 static struct path_data *urldb_find_url(nsurl *url)
 {
 	const struct host_part *h;
-	struct path_data *p;
 	struct search_node *tree;
-	char *plq;
+	const char *plq;
 	const char *host_str;
 	lwc_string *scheme, *host, *port;
 	size_t len = 0;
 	unsigned int port_int;
-	bool match;
 
 	assert(url);
 
@@ -1380,58 +2359,52 @@ static struct path_data *urldb_find_url(nsurl *url)
 		}
 	}
 
-	scheme = nsurl_get_component(url, NSURL_SCHEME);
+	/* The components are only peeked at as the caller holds a
+	 * reference to the URL for the duration of the lookup.
+	 */
+	scheme = nsurl_peek_component(url, NSURL_SCHEME);
 	if (scheme == NULL)
 		return NULL;
 
-	if (lwc_string_isequal(scheme, corestring_lwc_mailto, &match) ==
-	    lwc_error_ok && match == true) {
-		lwc_string_unref(scheme);
+	if (nsurl_get_scheme_type(url) == NSURL_SCHEME_MAILTO) {
 		return NULL;
 	}
 
-	host = nsurl_get_component(url, NSURL_HOST);
+	host = nsurl_peek_component(url, NSURL_HOST);
 	if (host != NULL) {
 		host_str = lwc_string_data(host);
-		lwc_string_unref(host);
 
-	} else if (lwc_string_isequal(scheme, corestring_lwc_file, &match) ==
-		   lwc_error_ok && match == true) {
+	} else if (nsurl_get_scheme_type(url) == NSURL_SCHEME_FILE) {
 		host_str = "localhost";
 
 	} else {
-		lwc_string_unref(scheme);
 		return NULL;
 	}
 
 	tree = urldb_get_search_tree(host_str);
 	h = urldb_search_find(tree, host_str);
 	if (!h) {
-		lwc_string_unref(scheme);
 		return NULL;
 	}
 
-	/* generate plq (path, leaf, query) */
-	if (nsurl_get(url, NSURL_PATH | NSURL_QUERY, &plq, &len) != NSERROR_OK) {
-		lwc_string_unref(scheme);
+	if (!urldb_host_materialise(h)) {
+		return NULL;
+	}
+
+	/* plq (path, leaf, query) directly from the URL string */
+	if (nsurl_access_path_query(url, &plq, &len) != NSERROR_OK) {
 		return NULL;
 	}
 
 	/* Get port */
-	port = nsurl_get_component(url, NSURL_PORT);
+	port = nsurl_peek_component(url, NSURL_PORT);
 	if (port != NULL) {
 		port_int = atoi(lwc_string_data(port));
-		lwc_string_unref(port);
 	} else {
 		port_int = 0;
 	}
 
-	p = urldb_match_path(&h->paths, plq, scheme, port_int);
-
-	free(plq);
-	lwc_string_unref(scheme);
-
-	return p;
+	return urldb_match_path(&h->paths, plq, len, scheme, port_int);
 }
 
 
@@ -2095,10 +3068,14 @@ urldb_add_path(lwc_string *scheme,
 	struct path_data *d, *e;
 	char *buf = path_query;
 	char *segment, *slash;
-	bool match;
 
 	assert(scheme && host && url);
 
+	if (!urldb_host_materialise(host)) {
+		free(path_query);
+		return NULL;
+	}
+
 	d = (struct path_data *) &host->paths;
 
 	/* skip leading '/' */
@@ -2112,14 +3089,8 @@ urldb_add_path(lwc_string *scheme,
 		if (!slash) {
 			/* last segment */
 			/* look for existing entry */
-			for (e = d->children; e; e = e->next)
-				if (strcmp(segment, e->segment) == 0 &&
-				    lwc_string_isequal(scheme,
-						       e->scheme, &match) ==
-				    lwc_error_ok &&
-				    match == true &&
-				    e->port == port)
-					break;
+			e = urldb_find_child(d, segment, strlen(segment),
+					     scheme, port);
 
 			d = e ? urldb_add_path_fragment(e, fragment) :
 				urldb_add_path_node(scheme, port,
@@ -2130,13 +3101,7 @@ urldb_add_path(lwc_string *scheme,
 		*slash = '\0';
 
 		/* look for existing entry */
-		for (e = d->children; e; e = e->next)
-			if (strcmp(segment, e->segment) == 0 &&
-			    lwc_string_isequal(scheme, e->scheme,
-					       &match) == lwc_error_ok &&
-			    match == true &&
-			    e->port == port)
-				break;
+		e = urldb_find_child(d, segment, strlen(segment), scheme, port);
 
 		d = e ? e : urldb_add_path_node(scheme, port, segment, NULL, d);
 		if (!d)
@@ -2247,6 +3212,135 @@ static struct host_part *urldb_add_host(const char *host)
 }
 
 
+/**
+ * Note that the cookies stored on a host have changed
+ *
+ * Any cached cookie header built from cookies on the host is no
+ * longer valid.
+ *
+ * \param h The host the cookies are stored on
+ */
+static void urldb_cookies_changed(const struct host_part *h)
+{
+	((struct host_part *)h)->cookie_generation = ++cookie_generation;
+}
+
+
+/**
+ * Destroy a cached cookie header
+ *
+ * \param cache The cache entry to destroy
+ */
+static void urldb_destroy_cookie_cache(struct cookie_cache *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+	free(cache->header);
+	free(cache->cookies);
+	free(cache);
+}
+
+
+/**
+ * Find a valid cached cookie header for a path
+ *
+ * The cache is valid if no cookie has changed on the host the path
+ * belongs to, or any of its parent domains, since it was built and
+ * none of the matched cookies has expired.
+ *
+ * \param p The path to find the cached header for
+ * \param include_http_only Whether HttpOnly cookies are included
+ * \param now The current time
+ * \return The cached header or NULL if there is no valid entry
+ */
+static struct cookie_cache *
+urldb_get_cookie_cache(const struct path_data *p,
+		       bool include_http_only,
+		       time_t now)
+{
+	struct cookie_cache *cache = p->cookie_cache[include_http_only];
+	const struct host_part *h;
+	const struct path_data *root;
+
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	if (cache->expires != -1 && cache->expires < now) {
+		return NULL;
+	}
+
+	for (root = p; root->parent != NULL; root = root->parent)
+		;
+
+	for (h = (const struct host_part *)root;
+	     h != NULL && h != &db_root;
+	     h = h->parent) {
+		if (h->cookie_generation > cache->generation) {
+			return NULL;
+		}
+	}
+
+	return cache;
+}
+
+
+/**
+ * Store a cookie header in the cache for a path
+ *
+ * On success the cache takes ownership of the matched cookie array.
+ *
+ * \param p The path the header was built for
+ * \param include_http_only Whether HttpOnly cookies are included
+ * \param header The header value or NULL if no cookies matched
+ * \param cookies The matched cookies
+ * \param count The number of matched cookies
+ * \return true on success, false on memory exhaustion
+ */
+static bool
+urldb_set_cookie_cache(const struct path_data *p,
+		       bool include_http_only,
+		       const char *header,
+		       struct cookie_internal_data **cookies,
+		       unsigned int count)
+{
+	struct cookie_cache *cache;
+	unsigned int i;
+
+	cache = malloc(sizeof(*cache));
+	if (cache == NULL) {
+		return false;
+	}
+
+	cache->header = NULL;
+	if (header != NULL) {
+		cache->header = strdup(header);
+		if (cache->header == NULL) {
+			free(cache);
+			return false;
+		}
+	}
+
+	cache->generation = cookie_generation;
+	cache->expires = -1;
+	for (i = 0; i < count; i++) {
+		if (cookies[i]->expires != -1 &&
+		    (cache->expires == -1 ||
+		     cookies[i]->expires < cache->expires)) {
+			cache->expires = cookies[i]->expires;
+		}
+	}
+	cache->count = count;
+	cache->cookies = cookies;
+
+	urldb_destroy_cookie_cache(p->cookie_cache[include_http_only]);
+	((struct path_data *)p)->cookie_cache[include_http_only] = cache;
+
+	return true;
+}
+
+
 /**
  * Insert a cookie into the database
  *
@@ -2360,6 +3454,8 @@ urldb_insert_cookie(struct cookie_internal_data *c,
 		cookie_manager_add((struct cookie_data *)c);
 	}
 
+	urldb_cookies_changed(h);
+
 	return true;
 }
 
@@ -2566,6 +3662,11 @@ urldb_delete_cookie_paths(const char *domain,
 
 				urldb_free_cookie(c);
 
+				/* the host paths are the first member of
+				 * struct host_part */
+				urldb_cookies_changed(
+					(struct host_part *)parent);
+
 				return;
 			}
 		}
@@ -2612,17 +3713,33 @@ urldb_delete_cookie_hosts(const char *domain,
 
 
 /**
- * Save a path subtree's cookies
+ * Callback for each cookie to be saved
+ *
+ * \param c The cookie
+ * \param p The path the cookie is associated with
+ * \param ctx The writer context
+ */
+typedef void (*urldb_cookie_cb)(const struct cookie_internal_data *c,
+				const struct path_data *p,
+				void *ctx);
+
+
+/**
+ * Enumerate a path subtree's cookies which should be saved
  *
- * \param fp File pointer to write to
  * \param parent Parent path
+ * \param cb Callback for each cookie
+ * \param ctx Context passed to \a cb
  */
-static void urldb_save_cookie_paths(FILE *fp, struct path_data *parent)
+static void
+urldb_enumerate_cookie_paths(const struct path_data *parent,
+			     urldb_cookie_cb cb,
+			     void *ctx)
 {
-	struct path_data *p = parent;
+	const struct path_data *p = parent;
 	time_t now = time(NULL);
 
-	assert(fp && parent);
+	assert(parent);
 
 	do {
 		if (p->cookies != NULL) {
@@ -2634,21 +3751,7 @@ static void urldb_save_cookie_paths(FILE *fp, struct path_data *parent)
 					continue;
 				}
 
-				fprintf(fp,
-					"%d\t%s\t%d\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t"
-					"%s\t%s\t%d\t%s\t%s\t%s\n",
-					c->version, c->domain,
-					c->domain_from_set, c->path,
-					c->path_from_set, c->secure,
-					c->http_only,
-					(int)c->expires, (int)c->last_used,
-					c->no_destroy, c->name, c->value,
-					c->value_was_quoted,
-					p->scheme ? lwc_string_data(p->scheme) :
-					"unused",
-					p->url ? nsurl_access(p->url) :
-					"unused",
-					c->comment ? c->comment : "");
+				cb(c, p, ctx);
 			}
 		}
 
@@ -2669,20 +3772,95 @@ static void urldb_save_cookie_paths(FILE *fp, struct path_data *parent)
 
 
 /**
- * Save a host subtree's cookies
+ * Enumerate a host subtree's cookies which should be saved
  *
- * \param fp File pointer to write to
  * \param parent Parent host
+ * \param cb Callback for each cookie
+ * \param ctx Context passed to \a cb
  */
-static void urldb_save_cookie_hosts(FILE *fp, struct host_part *parent)
+static void
+urldb_enumerate_cookie_hosts(const struct host_part *parent,
+			     urldb_cookie_cb cb,
+			     void *ctx)
 {
-	struct host_part *h;
-	assert(fp && parent);
+	const struct host_part *h;
+	assert(parent);
 
-	urldb_save_cookie_paths(fp, &parent->paths);
+	urldb_enumerate_cookie_paths(&parent->paths, cb, ctx);
 
 	for (h = parent->children; h; h = h->next)
-		urldb_save_cookie_hosts(fp, h);
+		urldb_enumerate_cookie_hosts(h, cb, ctx);
+}
+
+
+/**
+ * write a cookie to a text cookie file
+ */
+static void
+urldb_write_cookie(const struct cookie_internal_data *c,
+		   const struct path_data *p,
+		   void *ctx)
+{
+	FILE *fp = ctx;
+
+	fprintf(fp,
+		"%d\t%s\t%d\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t"
+		"%s\t%s\t%d\t%s\t%s\t%s\n",
+		c->version, c->domain,
+		c->domain_from_set, c->path,
+		c->path_from_set, c->secure,
+		c->http_only,
+		(int)c->expires, (int)c->last_used,
+		c->no_destroy, c->name, c->value,
+		c->value_was_quoted,
+		p->scheme ? lwc_string_data(p->scheme) :
+		"unused",
+		p->url ? nsurl_access(p->url) :
+		"unused",
+		c->comment ? c->comment : "");
+}
+
+
+/**
+ * add a cookie to a snapshot
+ */
+static void
+urldb_snapshot_cookie(const struct cookie_internal_data *c,
+		      const struct path_data *p,
+		      void *ctx)
+{
+	struct urldb_snapshot_writer *w = ctx;
+	struct urldb_snapshot_buffer *buf = &w->section[0];
+	uint32_t flags = 0;
+
+	if (c->domain_from_set)
+		flags |= URLDB_SNAPSHOT_COOKIE_DOMAIN_FROM_SET;
+	if (c->path_from_set)
+		flags |= URLDB_SNAPSHOT_COOKIE_PATH_FROM_SET;
+	if (c->secure)
+		flags |= URLDB_SNAPSHOT_COOKIE_SECURE;
+	if (c->http_only)
+		flags |= URLDB_SNAPSHOT_COOKIE_HTTP_ONLY;
+	if (c->no_destroy)
+		flags |= URLDB_SNAPSHOT_COOKIE_NO_DESTROY;
+	if (c->value_was_quoted)
+		flags |= URLDB_SNAPSHOT_COOKIE_VALUE_QUOTED;
+
+	urldb_snapshot_put_u32(w, buf, c->version);
+	urldb_snapshot_put_u32(w, buf, flags);
+	urldb_snapshot_put_s64(w, buf, c->expires);
+	urldb_snapshot_put_s64(w, buf, c->last_used);
+	urldb_snapshot_put_u32(w, buf, urldb_snapshot_put_string(w, c->domain));
+	urldb_snapshot_put_u32(w, buf, urldb_snapshot_put_string(w, c->path));
+	urldb_snapshot_put_u32(w, buf, urldb_snapshot_put_string(w, c->name));
+	urldb_snapshot_put_u32(w, buf, urldb_snapshot_put_string(w, c->value));
+	urldb_snapshot_put_u32(w, buf, urldb_snapshot_put_string(w,
+			p->scheme ? lwc_string_data(p->scheme) : NULL));
+	urldb_snapshot_put_u32(w, buf, urldb_snapshot_put_string(w,
+			p->url ? nsurl_access(p->url) : NULL));
+	urldb_snapshot_put_u32(w, buf, urldb_snapshot_put_string(w, c->comment));
+	urldb_snapshot_put_u32(w, buf, 0);
+	w->count[0]++;
 }
 
 
@@ -2726,8 +3904,13 @@ static void urldb_destroy_path_node_content(struct path_data *node)
 		free(node->fragment[i]);
 	free(node->fragment);
 
+	free(node->child_index);
+
 	free(node->urld.title);
 
+	urldb_destroy_cookie_cache(node->cookie_cache[0]);
+	urldb_destroy_cookie_cache(node->cookie_cache[1]);
+
 	for (a = node->cookies; a; a = b) {
 		b = a->next;
 		urldb_destroy_cookie(a);
@@ -2818,64 +4001,329 @@ static void urldb_destroy_host_tree(struct host_part *root)
 		urldb_destroy_prot_space(s);
 	}
 
-	/* And ourselves */
-	free(root->part);
-	free(root);
+	/* And ourselves */
+	free(root->part);
+	free(root);
+}
+
+
+/**
+ * Destroy a search tree
+ *
+ * \param root Root node of tree to destroy
+ */
+static void urldb_destroy_search_tree(struct search_node *root)
+{
+	/* Destroy children */
+	if (root->left != &empty)
+		urldb_destroy_search_tree(root->left);
+	if (root->right != &empty)
+		urldb_destroy_search_tree(root->right);
+
+	/* And destroy ourselves */
+	free(root);
+}
+
+
+/*************** External interface ***************/
+
+
+/* exported interface documented in content/urldb.h */
+void urldb_destroy(void)
+{
+	struct host_part *a, *b;
+	int i;
+
+	/* Clean up search trees */
+	for (i = 0; i < NUM_SEARCH_TREES; i++) {
+		if (search_trees[i] != &empty) {
+			urldb_destroy_search_tree(search_trees[i]);
+			search_trees[i] = &empty;
+		}
+	}
+
+	/* And database */
+	for (a = db_root.children; a; a = b) {
+		b = a->next;
+		urldb_destroy_host_tree(a);
+	}
+	memset(&db_root, 0, sizeof(db_root));
+
+	/* And the bloom filter */
+	if (url_bloom != NULL) {
+		bloom_destroy(url_bloom);
+		url_bloom = NULL;
+	}
+
+	/* And any snapshot */
+	urldb_snapshot_close(&url_snapshot);
+	url_snapshot_pending = 0;
+}
+
+
+/**
+ * Add a URL entry read from a database file to a host
+ *
+ * \param h The host to add the entry to
+ * \param host The host name
+ * \param entry The entry to add
+ * \return NSERROR_OK on success else error code
+ */
+static nserror
+urldb_add_entry(struct host_part *h,
+		const char *host,
+		const struct urldb_entry *entry)
+{
+	char url[64 + 3 + 256 + 6 + 4096 + 1 + 1];
+	struct path_data *p;
+	bool is_file = false;
+	nsurl *nsurl;
+	lwc_string *scheme_lwc, *fragment_lwc;
+	char *path_query;
+	size_t len;
+
+	if (!strcasecmp(host, "localhost") &&
+	    !strcasecmp(entry->scheme, "file"))
+		is_file = true;
+
+	if (entry->port) {
+		snprintf(url, sizeof url, "%s://%s:%u%s",
+			 entry->scheme,
+			 /* file URLs have no host */
+			 (is_file ? "" : host),
+			 entry->port,
+			 entry->path);
+	} else {
+		snprintf(url, sizeof url, "%s://%s%s",
+			 entry->scheme,
+			 (is_file ? "" : host),
+			 entry->path);
+	}
+
+	/* TODO: store URLs in pre-parsed state, and make
+	 *       a nsurl_load to generate the nsurl more
+	 *       swiftly.
+	 *       Need a nsurl_save too.
+	 */
+	if (nsurl_create(url, &nsurl) != NSERROR_OK) {
+		NSLOG(netsurf, INFO, "Failed inserting '%s'", url);
+		return NSERROR_NOMEM;
+	}
+
+	if (url_bloom != NULL) {
+		uint32_t hash = nsurl_hash(nsurl);
+		bloom_insert_hash(url_bloom, hash);
+	}
+
+	/* Copy and merge path/query strings */
+	if (nsurl_get(nsurl, NSURL_PATH | NSURL_QUERY,
+		      &path_query, &len) != NSERROR_OK) {
+		NSLOG(netsurf, INFO, "Failed inserting '%s'", url);
+		nsurl_unref(nsurl);
+		return NSERROR_NOMEM;
+	}
+
+	scheme_lwc = nsurl_get_component(nsurl, NSURL_SCHEME);
+	fragment_lwc = nsurl_get_component(nsurl, NSURL_FRAGMENT);
+	p = urldb_add_path(scheme_lwc, entry->port, h, path_query,
+			   fragment_lwc, nsurl);
+	nsurl_unref(nsurl);
+	lwc_string_unref(scheme_lwc);
+	if (fragment_lwc != NULL)
+		lwc_string_unref(fragment_lwc);
+
+	if (!p) {
+		NSLOG(netsurf, INFO, "Failed inserting '%s'", url);
+		return NSERROR_NOMEM;
+	}
+
+	p->urld.visits = entry->visits;
+	p->urld.last_visit = entry->last_visit;
+	p->urld.type = entry->type;
+
+	if ((entry->title != NULL) && (entry->title[0] != '\0')) {
+		free(p->urld.title);
+		p->urld.title = strdup(entry->title);
+	}
+
+	return NSERROR_OK;
+}
+
+
+/**
+ * Add the paths of a host which are held in the URL snapshot
+ *
+ * Hosts loaded from a snapshot have their paths added when they are
+ * first used. Once every host has been completed the snapshot is
+ * released.
+ *
+ * \param host The host to add paths to
+ * \return true on success, false on memory exhaustion
+ */
+static bool urldb_host_materialise(const struct host_part *host)
+{
+	/* The search trees only hold const references to hosts */
+	struct host_part *h = (struct host_part *)host;
+	struct urldb_entry entry;
+	char name[256];
+	uint32_t idx;
+	uint32_t end;
+	bool ret = true;
+
+	if (h->snapshot_count == 0) {
+		return true;
+	}
+
+	idx = h->snapshot_first;
+	end = idx + h->snapshot_count;
+
+	/* cleared first as adding the paths comes back through here */
+	h->snapshot_count = 0;
+
+	if (urldb_host_name(h, name, sizeof name)) {
+		for (; idx < end; idx++) {
+			if (!urldb_snapshot_url_entry(idx, &entry)) {
+				continue;
+			}
+			if (urldb_add_entry(h, name, &entry) != NSERROR_OK) {
+				ret = false;
+				break;
+			}
+		}
+	} else {
+		ret = false;
+	}
+
+	url_snapshot_pending--;
+	if (url_snapshot_pending == 0) {
+		urldb_snapshot_close(&url_snapshot);
+	}
+
+	return ret;
+}
+
+
+/**
+ * Add the paths of all hosts in a search (sub)tree held in the URL snapshot
+ *
+ * \param root root node of search tree
+ */
+static void urldb_materialise_search_tree(struct search_node *root)
+{
+	if (root == &empty)
+		return;
+
+	urldb_materialise_search_tree(root->left);
+	urldb_host_materialise(root->data);
+	urldb_materialise_search_tree(root->right);
 }
 
 
 /**
- * Destroy a search tree
+ * Load the hosts of the URL snapshot
  *
- * \param root Root node of tree to destroy
+ * Only the host tree is built, the URL records are added to the bloom
+ * filter and left in the snapshot until their host is used.
+ *
+ * If the snapshot was written with a different nsurl hash algorithm
+ * its recorded hashes cannot seed the bloom filter so every host is
+ * built immediately instead.
+ *
+ * \return NSERROR_OK on success else error code
  */
-static void urldb_destroy_search_tree(struct search_node *root)
+static nserror urldb_load_snapshot(void)
 {
-	/* Destroy children */
-	if (root->left != &empty)
-		urldb_destroy_search_tree(root->left);
-	if (root->right != &empty)
-		urldb_destroy_search_tree(root->right);
+	const uint8_t *rec;
+	struct host_part *h;
+	const char *host;
+	uint32_t idx;
+	uint32_t url;
+	uint32_t first;
+	uint32_t count;
+	uint32_t probe;
+	bool defer;
+	nserror res = NSERROR_OK;
+
+	NSLOG(netsurf, INFO, "Loading %u hosts and %u URLs from snapshot",
+	      url_snapshot.count[0], url_snapshot.count[1]);
+
+	probe = urldb_snapshot_hash_probe();
+	defer = (probe != 0) && (urldb_snapshot_u32(url_snapshot.data + 36) == probe);
+	if (!defer) {
+		NSLOG(netsurf, INFO, "Snapshot URL hashes do not match, loading all URLs");
+	}
 
-	/* And destroy ourselves */
-	free(root);
-}
+	/* keep the snapshot while hosts are added */
+	url_snapshot_pending++;
 
+	for (idx = 0; idx < url_snapshot.count[0]; idx++) {
+		rec = url_snapshot.section[0] +
+			((size_t)idx * URLDB_SNAPSHOT_HOST_SIZE);
 
-/*************** External interface ***************/
+		host = urldb_snapshot_string(&url_snapshot,
+					     urldb_snapshot_u32(rec));
+		first = urldb_snapshot_u32(rec + 16);
+		count = urldb_snapshot_u32(rec + 20);
 
+		if ((host == NULL) ||
+		    (host[0] == '\0') ||
+		    (((uint64_t)first + count) > url_snapshot.count[1])) {
+			NSLOG(netsurf, INFO, "Skipping invalid host %u", idx);
+			continue;
+		}
 
-/* exported interface documented in content/urldb.h */
-void urldb_destroy(void)
-{
-	struct host_part *a, *b;
-	int i;
+		h = urldb_add_host(host);
+		if (!h) {
+			NSLOG(netsurf, INFO, "Failed adding host: '%s'", host);
+			res = NSERROR_NOMEM;
+			break;
+		}
+		h->hsts.expires = (time_t)urldb_snapshot_s64(rec + 8);
+		h->hsts.include_sub_domains = (urldb_snapshot_u32(rec + 4) &
+				URLDB_SNAPSHOT_HOST_HSTS_SUBDOMAINS) != 0;
 
-	/* Clean up search trees */
-	for (i = 0; i < NUM_SEARCH_TREES; i++) {
-		if (search_trees[i] != &empty) {
-			urldb_destroy_search_tree(search_trees[i]);
-			search_trees[i] = &empty;
+		if (count == 0) {
+			continue;
 		}
-	}
 
-	/* And database */
-	for (a = db_root.children; a; a = b) {
-		b = a->next;
-		urldb_destroy_host_tree(a);
+		if (defer && (url_bloom != NULL)) {
+			for (url = first; url < (first + count); url++) {
+				bloom_insert_hash(url_bloom, urldb_snapshot_u32(
+					url_snapshot.section[1] +
+					((size_t)url * URLDB_SNAPSHOT_URL_SIZE) +
+					24));
+			}
+		}
+
+		/* complete any earlier record for the same host */
+		urldb_host_materialise(h);
+
+		h->snapshot_first = first;
+		h->snapshot_count = count;
+		url_snapshot_pending++;
+
+		/* paths can only be deferred for hosts which have none */
+		if (!defer || (h->paths.children != NULL)) {
+			urldb_host_materialise(h);
+		}
 	}
-	memset(&db_root, 0, sizeof(db_root));
 
-	/* And the bloom filter */
-	if (url_bloom != NULL) {
-		bloom_destroy(url_bloom);
-		url_bloom = NULL;
+	url_snapshot_pending--;
+	if (url_snapshot_pending == 0) {
+		urldb_snapshot_close(&url_snapshot);
 	}
+
+	return res;
 }
 
 
-/* exported interface documented in netsurf/url_db.h */
-nserror urldb_load(const char *filename)
+/**
+ * Import a URL database from a text file
+ *
+ * \param filename Name of file containing data
+ * \return NSERROR_OK on success else error code
+ */
+static nserror urldb_load_text(const char *filename)
 {
 #define MAXIMUM_URL_LENGTH 4096
 	char s[MAXIMUM_URL_LENGTH];
@@ -2887,13 +4335,6 @@ nserror urldb_load(const char *filename)
 	int length;
 	FILE *fp;
 
-	assert(filename);
-
-	NSLOG(netsurf, INFO, "Loading URL file %s", filename);
-
-	if (url_bloom == NULL)
-		url_bloom = bloom_create(BLOOM_SIZE);
-
 	fp = fopen(filename, "r");
 	if (!fp) {
 		NSLOG(netsurf, INFO, "Failed to open file '%s' for reading",
@@ -2971,15 +4412,12 @@ nserror urldb_load(const char *filename)
 
 		/* load the non-corrupt data */
 		for (i = 0; i < urls; i++) {
-			struct path_data *p = NULL;
+			struct urldb_entry entry;
 			char scheme[64], ports[10];
-			char url[64 + 3 + 256 + 6 + 4096 + 1 + 1];
-			unsigned int port;
-			bool is_file = false;
-			nsurl *nsurl;
-			lwc_string *scheme_lwc, *fragment_lwc;
-			char *path_query;
-			size_t len;
+			char path[MAXIMUM_URL_LENGTH];
+			nserror res;
+
+			memset(&entry, 0, sizeof(entry));
 
 			if (!fgets(scheme, sizeof scheme, fp))
 				break;
@@ -2988,99 +4426,45 @@ nserror urldb_load(const char *filename)
 
 			if (!fgets(ports, sizeof ports, fp))
 				break;
-			length = strlen(ports) - 1;
-			ports[length] = '\0';
-			port = atoi(ports);
+			entry.port = atoi(ports);
 
-			if (!fgets(s, MAXIMUM_URL_LENGTH, fp))
+			if (!fgets(path, sizeof path, fp))
 				break;
-			length = strlen(s) - 1;
-			s[length] = '\0';
-
-			if (!strcasecmp(host, "localhost") &&
-			    !strcasecmp(scheme, "file"))
-				is_file = true;
-
-			snprintf(url, sizeof url, "%s://%s%s%s%s",
-				 scheme,
-				 /* file URLs have no host */
-				 (is_file ? "" : host),
-				 (port ? ":" : ""),
-				 (port ? ports : ""),
-				 s);
-
-			/* TODO: store URLs in pre-parsed state, and make
-			 *       a nsurl_load to generate the nsurl more
-			 *       swiftly.
-			 *       Need a nsurl_save too.
-			 */
-			if (nsurl_create(url, &nsurl) != NSERROR_OK) {
-				NSLOG(netsurf, INFO, "Failed inserting '%s'",
-				      url);
-				fclose(fp);
-				return NSERROR_NOMEM;
-			}
-
-			if (url_bloom != NULL) {
-				uint32_t hash = nsurl_hash(nsurl);
-				bloom_insert_hash(url_bloom, hash);
-			}
-
-			/* Copy and merge path/query strings */
-			if (nsurl_get(nsurl, NSURL_PATH | NSURL_QUERY,
-				      &path_query, &len) != NSERROR_OK) {
-				NSLOG(netsurf, INFO, "Failed inserting '%s'",
-				      url);
-				fclose(fp);
-				return NSERROR_NOMEM;
-			}
-
-			scheme_lwc = nsurl_get_component(nsurl, NSURL_SCHEME);
-			fragment_lwc = nsurl_get_component(nsurl,
-							   NSURL_FRAGMENT);
-			p = urldb_add_path(scheme_lwc, port, h, path_query,
-					   fragment_lwc, nsurl);
-			if (!p) {
-				NSLOG(netsurf, INFO, "Failed inserting '%s'",
-				      url);
-				fclose(fp);
-				return NSERROR_NOMEM;
-			}
-			nsurl_unref(nsurl);
-			lwc_string_unref(scheme_lwc);
-			if (fragment_lwc != NULL)
-				lwc_string_unref(fragment_lwc);
+			length = strlen(path) - 1;
+			path[length] = '\0';
 
+			/* number of visits */
 			if (!fgets(s, MAXIMUM_URL_LENGTH, fp))
 				break;
-			if (p)
-				p->urld.visits = (unsigned int)atoi(s);
+			entry.visits = (unsigned int)atoi(s);
 
 			/* entry last use time */
-			if (!fgets(s, MAXIMUM_URL_LENGTH, fp)) {
+			if (!fgets(s, MAXIMUM_URL_LENGTH, fp))
 				break;
-			}
-			if (p) {
-				nsc_snptimet(s, strlen(s) - 1, &p->urld.last_visit);
-			}
+			nsc_snptimet(s, strlen(s) - 1, &entry.last_visit);
 
+			/* entry type */
 			if (!fgets(s, MAXIMUM_URL_LENGTH, fp))
 				break;
-			if (p)
-				p->urld.type = (content_type)atoi(s);
+			entry.type = (content_type)atoi(s);
 
 			if (!fgets(s, MAXIMUM_URL_LENGTH, fp))
 				break;
 
-
+			/* title */
 			if (!fgets(s, MAXIMUM_URL_LENGTH, fp))
 				break;
 			length = strlen(s) - 1;
-			if (p && length > 0) {
-				s[length] = '\0';
-				p->urld.title = malloc(length + 1);
-				if (p->urld.title)
-					memcpy(p->urld.title, s, length + 1);
+			s[length] = '\0';
+
+			entry.scheme = scheme;
+			entry.path = path;
+			entry.title = (length > 0) ? s : NULL;
+
+			res = urldb_add_entry(h, host, &entry);
+			if (res != NSERROR_OK) {
+				fclose(fp);
+				return res;
 			}
 		}
 	}
@@ -3092,10 +4476,73 @@ nserror urldb_load(const char *filename)
 	return NSERROR_OK;
 }
 
+
+/* exported interface documented in netsurf/url_db.h */
+nserror urldb_load(const char *filename)
+{
+	static const size_t record_size[2] = {
+		URLDB_SNAPSHOT_HOST_SIZE,
+		URLDB_SNAPSHOT_URL_SIZE
+	};
+	int i;
+
+	assert(filename);
+
+	NSLOG(netsurf, INFO, "Loading URL file %s", filename);
+
+	if (url_bloom == NULL)
+		url_bloom = bloom_create(BLOOM_SIZE);
+
+	/* hosts still referencing a previous snapshot must be completed */
+	if (url_snapshot_pending != 0) {
+		for (i = 0; i < NUM_SEARCH_TREES; i++) {
+			urldb_materialise_search_tree(search_trees[i]);
+		}
+	}
+
+	if (urldb_snapshot_open(filename,
+				URLDB_SNAPSHOT_MAGIC,
+				record_size,
+				&url_snapshot) == NSERROR_OK) {
+		return urldb_load_snapshot();
+	}
+
+	/* not a snapshot, import the text format */
+	return urldb_load_text(filename);
+}
+
+
 /* exported interface documented in netsurf/url_db.h */
 nserror urldb_save(const char *filename)
+{
+	struct urldb_snapshot_writer w;
+	time_t expiry;
+	nserror res;
+	int i;
+
+	assert(filename);
+
+	expiry = time(NULL) - ((60 * 60 * 24) * nsoption_int(expire_url));
+
+	memset(&w, 0, sizeof(w));
+
+	for (i = 0; i != NUM_SEARCH_TREES; i++) {
+		urldb_snapshot_search_tree(search_trees[i], &w, expiry);
+	}
+
+	res = urldb_snapshot_write(filename, URLDB_SNAPSHOT_MAGIC, &w);
+
+	urldb_snapshot_writer_fini(&w);
+
+	return res;
+}
+
+
+/* exported interface documented in netsurf/url_db.h */
+nserror urldb_export(const char *filename)
 {
 	FILE *fp;
+	time_t expiry;
 	int i;
 
 	assert(filename);
@@ -3107,11 +4554,13 @@ nserror urldb_save(const char *filename)
 		return NSERROR_SAVE_FAILED;
 	}
 
+	expiry = time(NULL) - ((60 * 60 * 24) * nsoption_int(expire_url));
+
 	/* file format version number */
 	fprintf(fp, "%d\n", URL_FILE_VERSION);
 
 	for (i = 0; i != NUM_SEARCH_TREES; i++) {
-		urldb_save_search_tree(search_trees[i], fp);
+		urldb_export_search_tree(search_trees[i], fp, expiry);
 	}
 
 	fclose(fp);
@@ -3674,6 +5123,8 @@ urldb_iterate_partial(const char *prefix,
 				return;
 		}
 
+		urldb_host_materialise(h);
+
 		if (h->paths.children) {
 			/* Have paths, iterate them */
 			urldb_iterate_partial_path(&h->paths, slash + 1,
@@ -3998,10 +5449,11 @@ error:
 /* exported interface documented in content/urldb.h */
 char *urldb_get_cookie(nsurl *url, bool include_http_only)
 {
-	const struct path_data *p, *q;
+	const struct path_data *p, *q, *node;
 	const struct host_part *h;
 	lwc_string *path_lwc;
 	struct cookie_internal_data *c;
+	struct cookie_cache *cache;
 	int count = 0, version = COOKIE_RFC2965;
 	struct cookie_internal_data **matched_cookies;
 	int matched_cookies_size = 20;
@@ -4018,12 +5470,36 @@ char *urldb_get_cookie(nsurl *url, bool include_http_only)
 	/* The URL must exist in the db in order to find relevant cookies, since
 	 * we search up the tree from the URL node, and cookies from further
 	 * up also apply. */
-	urldb_add_url(url);
-
 	p = urldb_find_url(url);
-	if (!p)
-		return NULL;
+	if (!p) {
+		urldb_add_url(url);
+
+		p = urldb_find_url(url);
+		if (!p)
+			return NULL;
+	}
+
+	now = time(NULL);
+
+	cache = urldb_get_cookie_cache(p, include_http_only, now);
+	if (cache != NULL) {
+		/* Cookies which apply are unchanged, only their last
+		 * use needs updating. */
+		for (i = 0; i < (int)cache->count; i++) {
+			c = cache->cookies[i];
+			if (c->last_used != now) {
+				c->last_used = now;
+				cookie_manager_add((struct cookie_data *)c);
+			}
+		}
+
+		if (cache->header == NULL)
+			return NULL;
+
+		return strdup(cache->header);
+	}
 
+	node = p;
 	scheme = p->scheme;
 
 	matched_cookies = malloc(matched_cookies_size *
@@ -4067,8 +5543,6 @@ char *urldb_get_cookie(nsurl *url, bool include_http_only)
 	path = lwc_string_data(path_lwc);
 	lwc_string_unref(path_lwc);
 
-	now = time(NULL);
-
 	if (*(p->segment) != '\0') {
 		/* Match exact path, unless directory, when prefix matching
 		 * will handle this case for us. */
@@ -4226,7 +5700,9 @@ char *urldb_get_cookie(nsurl *url, bool include_http_only)
 	if (count == 0) {
 		/* No cookies found */
 		free(ret);
-		free(matched_cookies);
+		if (!urldb_set_cookie_cache(node, include_http_only,
+					    NULL, matched_cookies, 0))
+			free(matched_cookies);
 		return NULL;
 	}
 
@@ -4263,7 +5739,10 @@ char *urldb_get_cookie(nsurl *url, bool include_http_only)
 		ret = temp;
 	}
 
-	free(matched_cookies);
+	/* Failing to cache the header only costs building it again */
+	if (!urldb_set_cookie_cache(node, include_http_only,
+				    ret, matched_cookies, count))
+		free(matched_cookies);
 
 	return ret;
 
@@ -4279,14 +5758,157 @@ void urldb_delete_cookie(const char *domain, const char *path,
 }
 
 
-/* exported interface documented in content/urldb.h */
-void urldb_load_cookies(const char *filename)
+/**
+ * Restore a cookie read from a cookie file to the database
+ *
+ * \param src The cookie as read, its strings are copied
+ * \param scheme Scheme of the URL the cookie is associated with
+ * \param url The URL the cookie is associated with
+ * \return true on success, false on error
+ */
+static bool
+urldb_restore_cookie(const struct cookie_internal_data *src,
+		     const char *scheme,
+		     const char *url)
+{
+	struct cookie_internal_data *c;
+
+	c = malloc(sizeof(struct cookie_internal_data));
+	if (!c)
+		return false;
+
+	c->name = strdup(src->name);
+	c->value = strdup(src->value);
+	c->value_was_quoted = src->value_was_quoted;
+	c->comment = strdup(src->comment);
+	c->domain_from_set = src->domain_from_set;
+	c->domain = strdup(src->domain);
+	c->path_from_set = src->path_from_set;
+	c->path = strdup(src->path);
+	c->expires = src->expires;
+	c->last_used = src->last_used;
+	c->secure = src->secure;
+	c->http_only = src->http_only;
+	c->version = src->version;
+	c->no_destroy = src->no_destroy;
+
+	if (!(c->name && c->value && c->comment &&
+	      c->domain && c->path)) {
+		urldb_free_cookie(c);
+		return false;
+	}
+
+	if (c->domain[0] != '.') {
+		lwc_string *scheme_lwc = NULL;
+		nsurl *url_nsurl = NULL;
+
+		assert(scheme[0] != 'u');
+
+		if (nsurl_create(url, &url_nsurl) != NSERROR_OK) {
+			urldb_free_cookie(c);
+			return false;
+		}
+		scheme_lwc = nsurl_get_component(url_nsurl, NSURL_SCHEME);
+
+		/* And insert it into database */
+		if (!urldb_insert_cookie(c, scheme_lwc, url_nsurl)) {
+			/* Cookie freed for us */
+			nsurl_unref(url_nsurl);
+			lwc_string_unref(scheme_lwc);
+			return false;
+		}
+		nsurl_unref(url_nsurl);
+		lwc_string_unref(scheme_lwc);
+
+	} else {
+		if (!urldb_insert_cookie(c, NULL, NULL)) {
+			/* Cookie freed for us */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/**
+ * Load the cookies of a cookie snapshot
+ *
+ * \param snap The cookie snapshot
+ */
+static void urldb_load_cookie_snapshot(const struct urldb_snapshot *snap)
+{
+	struct cookie_internal_data cookie;
+	const uint8_t *rec;
+	const char *scheme;
+	const char *url;
+	uint32_t flags;
+	uint32_t idx;
+
+	for (idx = 0; idx < snap->count[0]; idx++) {
+		rec = snap->section[0] + ((size_t)idx * URLDB_SNAPSHOT_COOKIE_SIZE);
+
+		memset(&cookie, 0, sizeof(cookie));
+
+		flags = urldb_snapshot_u32(rec + 4);
+
+		cookie.version = urldb_snapshot_u32(rec);
+		cookie.domain_from_set =
+			(flags & URLDB_SNAPSHOT_COOKIE_DOMAIN_FROM_SET) != 0;
+		cookie.path_from_set =
+			(flags & URLDB_SNAPSHOT_COOKIE_PATH_FROM_SET) != 0;
+		cookie.secure = (flags & URLDB_SNAPSHOT_COOKIE_SECURE) != 0;
+		cookie.http_only = (flags & URLDB_SNAPSHOT_COOKIE_HTTP_ONLY) != 0;
+		cookie.no_destroy = (flags & URLDB_SNAPSHOT_COOKIE_NO_DESTROY) != 0;
+		cookie.value_was_quoted =
+			(flags & URLDB_SNAPSHOT_COOKIE_VALUE_QUOTED) != 0;
+		cookie.expires = (time_t)urldb_snapshot_s64(rec + 8);
+		cookie.last_used = (time_t)urldb_snapshot_s64(rec + 16);
+
+		/* the strings are only read from */
+		cookie.domain = (char *)urldb_snapshot_string(snap,
+				urldb_snapshot_u32(rec + 24));
+		cookie.path = (char *)urldb_snapshot_string(snap,
+				urldb_snapshot_u32(rec + 28));
+		cookie.name = (char *)urldb_snapshot_string(snap,
+				urldb_snapshot_u32(rec + 32));
+		cookie.value = (char *)urldb_snapshot_string(snap,
+				urldb_snapshot_u32(rec + 36));
+		scheme = urldb_snapshot_string(snap, urldb_snapshot_u32(rec + 40));
+		url = urldb_snapshot_string(snap, urldb_snapshot_u32(rec + 44));
+		cookie.comment = (char *)urldb_snapshot_string(snap,
+				urldb_snapshot_u32(rec + 48));
+		if (cookie.comment == NULL) {
+			cookie.comment = (char *)"";
+		}
+
+		if ((cookie.domain == NULL) ||
+		    (cookie.path == NULL) ||
+		    (cookie.name == NULL) ||
+		    (cookie.value == NULL) ||
+		    ((cookie.domain[0] != '.') &&
+		     ((scheme == NULL) || (url == NULL)))) {
+			NSLOG(netsurf, INFO, "Skipping invalid cookie %u", idx);
+			continue;
+		}
+
+		if (!urldb_restore_cookie(&cookie, scheme, url)) {
+			break;
+		}
+	}
+}
+
+
+/**
+ * Import a cookie text file into the database
+ *
+ * \param filename File to load
+ */
+static void urldb_load_cookies_text(const char *filename)
 {
 	FILE *fp;
 	char s[16*1024];
 
-	assert(filename);
-
 	fp = fopen(filename, "r");
 	if (!fp)
 		return;
@@ -4317,7 +5939,7 @@ void urldb_load_cookies(const char *filename)
 		int version, domain_specified, path_specified,
 			secure, http_only, no_destroy, value_quoted;
 		time_t expires, last_used;
-		struct cookie_internal_data *c;
+		struct cookie_internal_data cookie;
 
 		if(s[0] == 0 || s[0] == '#')
 			/* Skip blank lines or comments */
@@ -4382,61 +6004,25 @@ void urldb_load_cookies(const char *filename)
 
 		assert(p <= end);
 
-		/* Now create cookie */
-		c = malloc(sizeof(struct cookie_internal_data));
-		if (!c)
-			break;
-
-		c->name = strdup(name);
-		c->value = strdup(value);
-		c->value_was_quoted = value_quoted;
-		c->comment = strdup(comment);
-		c->domain_from_set = domain_specified;
-		c->domain = strdup(domain);
-		c->path_from_set = path_specified;
-		c->path = strdup(path);
-		c->expires = expires;
-		c->last_used = last_used;
-		c->secure = secure;
-		c->http_only = http_only;
-		c->version = version;
-		c->no_destroy = no_destroy;
-
-		if (!(c->name && c->value && c->comment &&
-		      c->domain && c->path)) {
-			urldb_free_cookie(c);
+		/* Now restore cookie */
+		cookie.name = name;
+		cookie.value = value;
+		cookie.value_was_quoted = value_quoted;
+		cookie.comment = comment;
+		cookie.domain_from_set = domain_specified;
+		cookie.domain = domain;
+		cookie.path_from_set = path_specified;
+		cookie.path = path;
+		cookie.expires = expires;
+		cookie.last_used = last_used;
+		cookie.secure = secure;
+		cookie.http_only = http_only;
+		cookie.version = version;
+		cookie.no_destroy = no_destroy;
+
+		if (!urldb_restore_cookie(&cookie, scheme, url)) {
 			break;
 		}
-
-		if (c->domain[0] != '.') {
-			lwc_string *scheme_lwc = NULL;
-			nsurl *url_nsurl = NULL;
-
-			assert(scheme[0] != 'u');
-
-			if (nsurl_create(url, &url_nsurl) != NSERROR_OK) {
-				urldb_free_cookie(c);
-				break;
-			}
-			scheme_lwc = nsurl_get_component(url_nsurl,
-							 NSURL_SCHEME);
-
-			/* And insert it into database */
-			if (!urldb_insert_cookie(c, scheme_lwc, url_nsurl)) {
-				/* Cookie freed for us */
-				nsurl_unref(url_nsurl);
-				lwc_string_unref(scheme_lwc);
-				break;
-			}
-			nsurl_unref(url_nsurl);
-			lwc_string_unref(scheme_lwc);
-
-		} else {
-			if (!urldb_insert_cookie(c, NULL, NULL)) {
-				/* Cookie freed for us */
-				break;
-			}
-		}
 	}
 
 #undef SKIP_T
@@ -4446,8 +6032,52 @@ void urldb_load_cookies(const char *filename)
 }
 
 
+/* exported interface documented in content/urldb.h */
+void urldb_load_cookies(const char *filename)
+{
+	static const size_t record_size[2] = {
+		URLDB_SNAPSHOT_COOKIE_SIZE,
+		0
+	};
+	struct urldb_snapshot snap;
+
+	assert(filename);
+
+	memset(&snap, 0, sizeof(snap));
+
+	if (urldb_snapshot_open(filename,
+				COOKIE_SNAPSHOT_MAGIC,
+				record_size,
+				&snap) == NSERROR_OK) {
+		urldb_load_cookie_snapshot(&snap);
+		urldb_snapshot_close(&snap);
+		return;
+	}
+
+	/* not a snapshot, import the text format */
+	urldb_load_cookies_text(filename);
+}
+
+
 /* exported interface documented in content/urldb.h */
 void urldb_save_cookies(const char *filename)
+{
+	struct urldb_snapshot_writer w;
+
+	assert(filename);
+
+	memset(&w, 0, sizeof(w));
+
+	urldb_enumerate_cookie_hosts(&db_root, urldb_snapshot_cookie, &w);
+
+	urldb_snapshot_write(filename, COOKIE_SNAPSHOT_MAGIC, &w);
+
+	urldb_snapshot_writer_fini(&w);
+}
+
+
+/* exported interface documented in content/urldb.h */
+void urldb_export_cookies(const char *filename)
 {
 	FILE *fp;
 	int cookie_file_version = max(loaded_cookie_file_version,
@@ -4473,7 +6103,7 @@ void urldb_save_cookies(const char *filename)
 		cookie_file_version);
 	fprintf(fp, "Version:\t%d\n", cookie_file_version);
 
-	urldb_save_cookie_hosts(fp, &db_root);
+	urldb_enumerate_cookie_hosts(&db_root, urldb_write_cookie, fp);
 
 	fclose(fp);
 }
@@ -30,7 +30,9 @@
 
 #include "utils/log.h"
 #include "utils/utils.h"
+#include "utils/nsoption.h"
 #include "netsurf/layout.h"
+#include "netsurf/misc.h"
 #include "netsurf/content.h"
 #include "netsurf/window.h"
 #include "netsurf/browser_window.h"
@@ -44,6 +46,293 @@
 #include "desktop/local_history_private.h"
 #include "desktop/browser_history.h"
 
+/**
+ * Time the current page must be shown for before its thumbnail is
+ * rendered (ms)
+ */
+#define HISTORY_THUMBNAIL_DELAY 1000
+
+/** Thumbnails in the order they were rendered, oldest first */
+static struct history_thumbnail *thumbnail_list_head = NULL;
+static struct history_thumbnail *thumbnail_list_tail = NULL;
+
+/** Total size of thumbnail bitmap data */
+static size_t thumbnail_total_size = 0;
+
+
+/**
+ * Remove a thumbnail from the rendered list
+ *
+ * \param thumb The thumbnail to remove
+ */
+static void browser_window_history__thumbnail_unlink(struct history_thumbnail *thumb)
+{
+	if (thumb->prev == NULL) {
+		thumbnail_list_head = thumb->next;
+	} else {
+		thumb->prev->next = thumb->next;
+	}
+	if (thumb->next == NULL) {
+		thumbnail_list_tail = thumb->prev;
+	} else {
+		thumb->next->prev = thumb->prev;
+	}
+	thumb->prev = thumb->next = NULL;
+}
+
+
+/**
+ * Discard the bitmap of a thumbnail
+ *
+ * \param thumb The thumbnail
+ */
+static void browser_window_history__thumbnail_discard(struct history_thumbnail *thumb)
+{
+	if (thumb->bitmap == NULL) {
+		return;
+	}
+
+	browser_window_history__thumbnail_unlink(thumb);
+	guit->bitmap->destroy(thumb->bitmap);
+	thumb->bitmap = NULL;
+	thumbnail_total_size -= thumb->size;
+	thumb->size = 0;
+}
+
+
+/**
+ * Release a reference to a thumbnail
+ *
+ * \param thumb The thumbnail, may be NULL
+ */
+static void browser_window_history__thumbnail_unref(struct history_thumbnail *thumb)
+{
+	if (thumb == NULL) {
+		return;
+	}
+
+	if (--thumb->refcnt == 0) {
+		browser_window_history__thumbnail_discard(thumb);
+		free(thumb);
+	}
+}
+
+
+/**
+ * Create a thumbnail with a cleared full resolution bitmap
+ *
+ * \return The new thumbnail or NULL on error
+ */
+static struct history_thumbnail *browser_window_history__thumbnail_create(void)
+{
+	struct history_thumbnail *thumb;
+
+	thumb = calloc(1, sizeof(*thumb));
+	if (thumb == NULL) {
+		return NULL;
+	}
+
+	thumb->bitmap = guit->bitmap->create(
+			LOCAL_HISTORY_WIDTH, LOCAL_HISTORY_HEIGHT,
+			BITMAP_NEW | BITMAP_CLEAR_MEMORY | BITMAP_OPAQUE);
+	if (thumb->bitmap == NULL) {
+		free(thumb);
+		return NULL;
+	}
+
+	thumb->refcnt = 1;
+	thumb->size = guit->bitmap->get_rowstride(thumb->bitmap) *
+		guit->bitmap->get_height(thumb->bitmap);
+	thumbnail_total_size += thumb->size;
+
+	/* newest rendered */
+	thumb->prev = thumbnail_list_tail;
+	if (thumbnail_list_tail == NULL) {
+		thumbnail_list_head = thumb;
+	} else {
+		thumbnail_list_tail->next = thumb;
+	}
+	thumbnail_list_tail = thumb;
+
+	return thumb;
+}
+
+
+/**
+ * Replace a thumbnail bitmap with one of half the resolution
+ *
+ * \param thumb The thumbnail to reduce
+ * \return true if the thumbnail was reduced
+ */
+static bool browser_window_history__thumbnail_reduce(struct history_thumbnail *thumb)
+{
+	struct bitmap *reduced;
+	unsigned char *src, *dst;
+	size_t src_stride, dst_stride;
+	int width, height;
+	int x, y, c;
+
+	width = guit->bitmap->get_width(thumb->bitmap) / 2;
+	height = guit->bitmap->get_height(thumb->bitmap) / 2;
+	if ((width == 0) || (height == 0)) {
+		return false;
+	}
+
+	reduced = guit->bitmap->create(width, height,
+			BITMAP_NEW | BITMAP_OPAQUE);
+	if (reduced == NULL) {
+		return false;
+	}
+
+	src = guit->bitmap->get_buffer(thumb->bitmap);
+	dst = guit->bitmap->get_buffer(reduced);
+	src_stride = guit->bitmap->get_rowstride(thumb->bitmap);
+	dst_stride = guit->bitmap->get_rowstride(reduced);
+
+	/* average each 2x2 block of four byte pixels, channel order does
+	 * not matter */
+	for (y = 0; y < height; y++) {
+		const unsigned char *s0 = src + (y * 2) * src_stride;
+		const unsigned char *s1 = s0 + src_stride;
+		unsigned char *d = dst + y * dst_stride;
+
+		for (x = 0; x < width * 4; x += 4) {
+			for (c = 0; c < 4; c++) {
+				d[x + c] = (s0[x * 2 + c] + s0[x * 2 + 4 + c] +
+					    s1[x * 2 + c] + s1[x * 2 + 4 + c] +
+					    2) / 4;
+			}
+		}
+	}
+	guit->bitmap->modified(reduced);
+
+	guit->bitmap->destroy(thumb->bitmap);
+	thumb->bitmap = reduced;
+	thumbnail_total_size -= thumb->size;
+	thumb->size = dst_stride * height;
+	thumbnail_total_size += thumb->size;
+	thumb->reduced = true;
+
+	return true;
+}
+
+
+/**
+ * Keep the thumbnails within the configured size
+ *
+ * The oldest thumbnails are reduced to a lower resolution and then
+ * discarded until the total size is below the limit. The most recently
+ * rendered thumbnail is always kept.
+ */
+static void browser_window_history__thumbnail_limit(void)
+{
+	size_t limit = nsoption_uint(history_thumbnail_size);
+	struct history_thumbnail *thumb;
+	struct history_thumbnail *next;
+
+	for (thumb = thumbnail_list_head;
+	     (thumb != NULL) && (thumb != thumbnail_list_tail) &&
+		     (thumbnail_total_size > limit);
+	     thumb = next) {
+		next = thumb->next;
+		if (!thumb->reduced &&
+		    browser_window_history__thumbnail_reduce(thumb)) {
+			continue;
+		}
+		browser_window_history__thumbnail_discard(thumb);
+	}
+
+	/* anything still over the limit is discarded, oldest first */
+	while ((thumbnail_list_head != thumbnail_list_tail) &&
+	       (thumbnail_total_size > limit)) {
+		browser_window_history__thumbnail_discard(thumbnail_list_head);
+	}
+}
+
+
+/* exported interface documented in desktop/browser_history.h */
+void browser_window_history_render_thumbnail(struct browser_window *bw)
+{
+	struct history *history = bw->history;
+	struct history_entry *entry;
+	struct history_thumbnail *thumb;
+	nserror ret;
+
+	if ((history == NULL) ||
+	    (history->thumbnail_pending == false) ||
+	    (history->current == NULL) ||
+	    (bw->current_content == NULL)) {
+		return;
+	}
+	history->thumbnail_pending = false;
+	entry = history->current;
+
+	/* the content may not yet be the current entry's page */
+	if (!nsurl_compare(hlcache_handle_get_url(bw->current_content),
+			   entry->page.url,
+			   NSURL_COMPLETE)) {
+		return;
+	}
+
+	NSLOG(netsurf, DEBUG,
+	      "Creating thumbnail for %s", nsurl_access(entry->page.url));
+
+	thumb = entry->page.thumbnail;
+	if ((thumb == NULL) || (thumb->refcnt > 1) || (thumb->bitmap == NULL) ||
+	    thumb->reduced) {
+		/* never render into a thumbnail shared with a clone */
+		thumb = browser_window_history__thumbnail_create();
+		if (thumb == NULL) {
+			return;
+		}
+		browser_window_history__thumbnail_unref(entry->page.thumbnail);
+		entry->page.thumbnail = thumb;
+	} else {
+		/* re-rendered, now newest */
+		browser_window_history__thumbnail_unlink(thumb);
+		thumb->prev = thumbnail_list_tail;
+		if (thumbnail_list_tail == NULL) {
+			thumbnail_list_head = thumb;
+		} else {
+			thumbnail_list_tail->next = thumb;
+		}
+		thumbnail_list_tail = thumb;
+	}
+
+	ret = guit->bitmap->render(thumb->bitmap, bw->current_content);
+	if (ret != NSERROR_OK) {
+		/* Thumbnail render failed */
+		NSLOG(netsurf, WARNING, "Thumbnail render failed");
+	}
+
+	browser_window_history__thumbnail_limit();
+}
+
+
+/**
+ * Scheduled callback to render a thumbnail once a page has been shown
+ *
+ * \param p The browser window
+ */
+static void browser_window_history__thumbnail_callback(void *p)
+{
+	browser_window_history_render_thumbnail(p);
+}
+
+
+/**
+ * Mark the current entry thumbnail as needing rendering
+ *
+ * \param bw The browser window
+ */
+static void browser_window_history__thumbnail_defer(struct browser_window *bw)
+{
+	bw->history->thumbnail_pending = true;
+	guit->misc->schedule(HISTORY_THUMBNAIL_DELAY,
+			     browser_window_history__thumbnail_callback,
+			     bw);
+}
+
 /**
  * Clone a history entry
  *
@@ -95,26 +384,10 @@ browser_window_history__clone_entry(struct history *history,
 		}
 	}
 
-	if (entry->page.bitmap == NULL) {
-		new_entry->page.bitmap = NULL;
-	} else {
-		/* create a new bitmap and copy original into it */
-		unsigned char *bmsrc_data;
-		unsigned char *bmdst_data;
-		size_t bmsize;
-
-		new_entry->page.bitmap = guit->bitmap->create(
-				LOCAL_HISTORY_WIDTH,
-				LOCAL_HISTORY_HEIGHT,
-				BITMAP_NEW | BITMAP_OPAQUE);
-
-		if (new_entry->page.bitmap != NULL) {
-			bmsrc_data = guit->bitmap->get_buffer(entry->page.bitmap);
-			bmdst_data = guit->bitmap->get_buffer(new_entry->page.bitmap);
-			bmsize = guit->bitmap->get_rowstride(new_entry->page.bitmap) *
-				guit->bitmap->get_height(new_entry->page.bitmap);
-			memcpy(bmdst_data, bmsrc_data, bmsize);
-		}
+	/* share the thumbnail */
+	new_entry->page.thumbnail = entry->page.thumbnail;
+	if (new_entry->page.thumbnail != NULL) {
+		new_entry->page.thumbnail->refcnt++;
 	}
 
 	/* copy tree values */
@@ -133,9 +406,8 @@ browser_window_history__clone_entry(struct history *history,
 				lwc_string_unref(new_entry->page.frag_id);
 			}
 			free(new_entry->page.title);
-			if (entry->page.bitmap != NULL) {
-				guit->bitmap->destroy(entry->page.bitmap);
-			}
+			browser_window_history__thumbnail_unref(
+					new_entry->page.thumbnail);
 			free(new_entry);
 			return NULL;
 		}
@@ -176,9 +448,7 @@ static void browser_window_history__free_entry(struct history_entry *entry)
 			lwc_string_unref(entry->page.frag_id);
 		}
 		free(entry->page.title);
-		if (entry->page.bitmap != NULL) {
-			guit->bitmap->destroy(entry->page.bitmap);
-		}
+		browser_window_history__thumbnail_unref(entry->page.thumbnail);
 		free(entry);
 	}
 }
@@ -333,6 +603,7 @@ nserror browser_window_history_clone(const struct browser_window *existing,
 
 	clone->history = new_history;
 	memcpy(new_history, existing->history, sizeof *new_history);
+	new_history->thumbnail_pending = false;
 
 	new_history->start = browser_window_history__clone_entry(new_history,
 			new_history->start);
@@ -356,7 +627,6 @@ browser_window_history_add(struct browser_window *bw,
 	struct history *history;
 	struct history_entry *entry;
 	char *title;
-	nserror ret;
 
 	assert(bw);
 	assert(bw->history);
@@ -382,20 +652,8 @@ browser_window_history_add(struct browser_window *bw,
 	entry->page.scroll_x = 0.0f;
 	entry->page.scroll_y = 0.0f;
 
-	/* create thumbnail for localhistory view */
-	NSLOG(netsurf, DEBUG,
-	      "Creating thumbnail for %s", nsurl_access(entry->page.url));
-
-	entry->page.bitmap = guit->bitmap->create(
-			LOCAL_HISTORY_WIDTH, LOCAL_HISTORY_HEIGHT,
-			BITMAP_NEW | BITMAP_CLEAR_MEMORY | BITMAP_OPAQUE);
-	if (entry->page.bitmap != NULL) {
-		ret = guit->bitmap->render(entry->page.bitmap, content);
-		if (ret != NSERROR_OK) {
-			/* Thumbnail render failed */
-			NSLOG(netsurf, WARNING, "Thumbnail render failed");
-		}
-	}
+	/* thumbnail for localhistory view is rendered once shown */
+	entry->page.thumbnail = NULL;
 
 	/* insert into tree */
 	entry->back = history->current;
@@ -416,6 +674,9 @@ browser_window_history_add(struct browser_window *bw,
 		history->start = entry;
 	}
 	history->current = entry;
+	bw->history_entry = entry;
+
+	browser_window_history__thumbnail_defer(bw);
 
 	browser_window_history__layout(history);
 
@@ -450,9 +711,7 @@ nserror browser_window_history_update(struct browser_window *bw,
 	free(history->current->page.title);
 	history->current->page.title = title;
 
-	if (history->current->page.bitmap != NULL) {
-		guit->bitmap->render(history->current->page.bitmap, content);
-	}
+	browser_window_history__thumbnail_defer(bw);
 
 	if ((bw->window != NULL) &&
 	    guit->window->get_scroll(bw->window, &sx, &sy)) {
@@ -506,6 +765,8 @@ void browser_window_history_destroy(struct browser_window *bw)
 	if (bw->history == NULL)
 		return;
 
+	guit->misc->schedule(-1, browser_window_history__thumbnail_callback, bw);
+
 	browser_window_history__free_entry(bw->history->start);
 	free(bw->history);
 
@@ -584,10 +845,13 @@ browser_window_history_get_thumbnail(struct browser_window *bw,
 		return NSERROR_INVALID;
 	}
 
-	if (bw->history->current->page.bitmap == NULL) {
+	browser_window_history_render_thumbnail(bw);
+
+	if ((bw->history->current->page.thumbnail == NULL) ||
+	    (bw->history->current->page.thumbnail->bitmap == NULL)) {
 		bitmap = content_get_bitmap(bw->current_content);
 	} else {
-		bitmap = bw->history->current->page.bitmap;
+		bitmap = bw->history->current->page.thumbnail->bitmap;
 	}
 
 	*bitmap_out = bitmap;
@@ -630,9 +894,12 @@ nserror browser_window_history_go(struct browser_window *bw,
 			browser_window_history_update(bw, bw->current_content);
 		}
 		history->current = entry;
-		error = browser_window_navigate(bw, url, NULL,
-				BW_NAVIGATE_NO_TERMINAL_HISTORY_UPDATE,
-				NULL, NULL, NULL);
+		error = browser_window__restore_page(bw);
+		if (error == NSERROR_NOT_FOUND) {
+			error = browser_window_navigate(bw, url, NULL,
+					BW_NAVIGATE_NO_TERMINAL_HISTORY_UPDATE,
+					NULL, NULL, NULL);
+		}
 	}
 
 	nsurl_unref(url);
@@ -85,6 +85,17 @@ bool browser_window_history_forward_available(struct browser_window *bw);
  */
 nserror browser_window_history_get_thumbnail(struct browser_window *bw, struct bitmap **bitmap_out);
 
+/**
+ * Render any pending thumbnail for the current history entry
+ *
+ * Thumbnails are rendered a while after a page is shown, this renders
+ * the current one immediately, for example when the history is about
+ * to be displayed.
+ *
+ * \param bw The browser window
+ */
+void browser_window_history_render_thumbnail(struct browser_window *bw);
+
 /**
  * Callback function type for history enumeration
  *
@@ -34,6 +34,21 @@ struct gui_window;
 struct selection;
 struct nsurl;
 
+/**
+ * local history thumbnail
+ *
+ * Thumbnails are shared between the entries of cloned histories and
+ * replaced rather than rendered into while shared.
+ */
+struct history_thumbnail {
+	struct bitmap *bitmap; /**< Thumbnail bitmap, or NULL if discarded. */
+	unsigned int refcnt; /**< Number of history entries using it */
+	size_t size; /**< Size of bitmap data in bytes */
+	bool reduced; /**< Bitmap is stored at reduced resolution */
+	struct history_thumbnail *prev; /**< Previous thumbnail rendered */
+	struct history_thumbnail *next; /**< Next thumbnail rendered */
+};
+
 /**
  * history entry page information
  */
@@ -41,7 +56,7 @@ struct history_page {
 	struct nsurl *url;    /**< Page URL, never NULL. */
 	lwc_string *frag_id; /** Fragment identifier, or NULL. */
 	char *title;  /**< Page title, never NULL. */
-	struct bitmap *bitmap;  /**< Thumbnail bitmap, or NULL. */
+	struct history_thumbnail *thumbnail;  /**< Thumbnail, or NULL. */
 	float scroll_x; /**< Scroll X offset when visited */
 	float scroll_y; /**< Scroll Y offset when visited */
 };
@@ -74,6 +89,8 @@ struct history {
 	int width;
 	/** Height of layout. */
 	int height;
+	/** Thumbnail of current entry is to be rendered. */
+	bool thumbnail_pending;
 };
 
 /**
@@ -150,6 +167,8 @@ struct browser_window {
 
 	/** local history handle. */
 	struct history *history;
+	/** History entry current_content was shown for. */
+	struct history_entry *history_entry;
 
 	/**
 	 * Platform specific window data only valid at top level.
@@ -417,4 +436,20 @@ typedef nserror (*browser_window_query_callback)(bool proceed, void *pw);
  */
 nserror browser_window__reload_current_parameters(struct browser_window *bw);
 
+/**
+ * Free the stored fetch parameters
+ *
+ * \param params The fetch parameters to free
+ */
+void browser_window__free_fetch_parameters(struct browser_fetch_parameters *params);
+
+/**
+ * Show the page cached for the current history entry
+ *
+ * \param bw The browser window whose history has been moved
+ * \return NSERROR_OK if the cached page is shown, NSERROR_NOT_FOUND if
+ *         there is none or appropriate error code.
+ */
+nserror browser_window__restore_page(struct browser_window *bw);
+
 #endif
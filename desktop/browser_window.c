@@ -62,6 +62,7 @@
 #include "desktop/hotlist.h"
 #include "desktop/knockout.h"
 #include "desktop/browser_history.h"
+#include "desktop/page_cache.h"
 
 /**
  * smallest scale that can be applied to a browser window
@@ -104,12 +105,8 @@ static void browser_window_destroy_children(struct browser_window *bw)
 }
 
 
-/**
- * Free the stored fetch parameters
- *
- * \param bw The browser window
- */
-static void
+/* exported interface documented in desktop/browser_private.h */
+void
 browser_window__free_fetch_parameters(struct browser_fetch_parameters *params)
 {
 	if (params->url != NULL) {
@@ -811,6 +808,44 @@ static void browser_window_update(struct browser_window *bw, bool scroll_to_top)
 }
 
 
+/**
+ * Move the current content of a browser window into the page cache
+ *
+ * The content is only cached when it is being replaced by a navigation
+ * to another history entry, never when it is reloaded.
+ *
+ * \param bw The browser window whose current content is closed
+ * \return true if the content was cached
+ */
+static bool browser_window_cache_page(struct browser_window *bw)
+{
+	if ((bw->parent != NULL) ||
+	    bw->internal_nav ||
+	    (bw->history == NULL) ||
+	    (bw->history_entry == NULL)) {
+		return false;
+	}
+
+	if (!bw->history_add && (bw->history->current == bw->history_entry)) {
+		/* reloading the same entry */
+		return false;
+	}
+
+	if (!page_cache_store(bw,
+			      bw->history_entry,
+			      bw->current_content,
+			      &bw->current_parameters,
+			      bw->current_cert_chain)) {
+		return false;
+	}
+
+	bw->current_cert_chain = NULL;
+	bw->history_entry = NULL;
+
+	return true;
+}
+
+
 /**
  * handle message for content ready on browser window
  */
@@ -819,10 +854,12 @@ static nserror browser_window_content_ready(struct browser_window *bw)
 	int width, height;
 	nserror res = NSERROR_OK;
 
-	/* close and release the current window content */
+	/* close and release or cache the current window content */
 	if (bw->current_content != NULL) {
 		content_close(bw->current_content);
-		hlcache_handle_release(bw->current_content);
+		if (!browser_window_cache_page(bw)) {
+			hlcache_handle_release(bw->current_content);
+		}
 	}
 
 	bw->current_content = bw->loading_content;
@@ -885,6 +922,10 @@ static nserror browser_window_content_ready(struct browser_window *bw)
 		browser_window_history_add(bw, bw->current_content, bw->frag_id);
 	}
 
+	if (bw->history != NULL && !bw->internal_nav) {
+		bw->history_entry = bw->history->current;
+	}
+
 	browser_window_remove_caret(bw, false);
 
 	if (bw->window != NULL) {
@@ -1803,6 +1844,69 @@ browser_window_callback(hlcache_handle *c, const hlcache_event *event, void *pw)
 }
 
 
+/* exported interface documented in desktop/browser_private.h */
+nserror browser_window__restore_page(struct browser_window *bw)
+{
+	struct history_entry *entry;
+	struct browser_fetch_parameters params;
+	struct cert_chain *chain;
+	hlcache_handle *c;
+	nserror res;
+
+	if ((bw->history == NULL) || (bw->history->current == NULL)) {
+		return NSERROR_NOT_FOUND;
+	}
+	entry = bw->history->current;
+
+	c = page_cache_take(bw, entry, &params, &chain);
+	if (c == NULL) {
+		return NSERROR_NOT_FOUND;
+	}
+
+	NSLOG(netsurf, INFO, "bw %p, restoring %s", bw,
+	      nsurl_access(hlcache_handle_get_url(c)));
+
+	browser_window_stop(bw);
+	browser_window_remove_caret(bw, false);
+	browser_window_destroy_children(bw);
+	browser_window_destroy_iframes(bw);
+
+	res = hlcache_handle_replace_callback(c, browser_window_callback, bw);
+	if (res != NSERROR_OK) {
+		hlcache_handle_release(c);
+		browser_window__free_fetch_parameters(&params);
+		cert_chain_free(chain);
+		return res;
+	}
+
+	if (bw->frag_id != NULL) {
+		lwc_string_unref(bw->frag_id);
+	}
+	bw->frag_id = NULL;
+	if (entry->page.frag_id != NULL) {
+		bw->frag_id = lwc_string_ref(entry->page.frag_id);
+	}
+
+	/* the cached page becomes current as if it had just loaded */
+	bw->internal_nav = false;
+	bw->history_add = false;
+	browser_window__free_fetch_parameters(&bw->loading_parameters);
+	bw->loading_parameters = params;
+	cert_chain_free(bw->loading_cert_chain);
+	bw->loading_cert_chain = chain;
+	bw->loading_content = c;
+
+	res = browser_window_content_ready(bw);
+	if (res == NSERROR_OK) {
+		res = browser_window_content_done(bw);
+	}
+
+	nsu_getmonotonic_ms(&bw->last_action);
+
+	return res;
+}
+
+
 /**
  * internal scheduled reformat callback.
  *
@@ -1904,6 +2008,7 @@ nserror browser_window_destroy_internal(struct browser_window *bw)
 		lwc_string_unref(bw->frag_id);
 	}
 
+	page_cache_discard(bw);
 	browser_window_history_destroy(bw);
 
 	cert_chain_free(bw->current_cert_chain);
@@ -64,12 +64,16 @@
  */
 
 #include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#include "netsurf/inttypes.h"
 #include "utils/utils.h"
 #include "utils/log.h"
 #include "utils/errors.h"
+#include "utils/metrics.h"
 #include "netsurf/bitmap.h"
 #include "content/content.h"
 #include "netsurf/plotters.h"
@@ -80,9 +84,20 @@
 /* Define to enable knockout debug */
 #undef KNOCKOUT_DEBUG
 
-#define KNOCKOUT_ENTRIES 3072	/* 40 bytes each */
-#define KNOCKOUT_BOXES 768	/* 28 bytes each */
-#define KNOCKOUT_POLYGONS 3072	/* 4 bytes each */
+/** Initial number of plot entries, the buffer doubles as required */
+#define KNOCKOUT_ENTRIES 256
+
+/** Size of the arena blocks holding boxes, grid cells and polygons */
+#define KNOCKOUT_BLOCK_SIZE 16384
+
+/** log2 of the size in pixels of a spatial grid cell */
+#define KNOCKOUT_GRID_SHIFT 6
+
+/** Number of spatial grid buckets, must be a power of two */
+#define KNOCKOUT_GRID_SIZE 256
+
+/** Largest number of cells a box is entered into the grid for */
+#define KNOCKOUT_GRID_SPAN 16
 
 struct knockout_box;
 struct knockout_entry;
@@ -105,11 +120,35 @@ typedef enum {
 struct knockout_box {
 	struct rect bbox;
 	bool deleted;			/* box has been deleted, ignore */
+	unsigned int visit;		/* last knockout pass to consider box */
 	struct knockout_box *child;
 	struct knockout_box *next;
 };
 
 
+/**
+ * Spatial grid cell entry for a top level box
+ */
+struct knockout_cell {
+	struct knockout_box *box;
+	struct knockout_cell *next;
+};
+
+
+/**
+ * Block of knockout arena memory
+ */
+struct knockout_block {
+	struct knockout_block *next;
+	size_t size;			/* size of the block data */
+	union {
+		void *p;
+		double d;
+		long l;
+	} data[];
+};
+
+
 struct knockout_entry {
 	knockout_type type;
 	struct knockout_box *box;	/* relating series of knockout clips */
@@ -169,19 +208,259 @@ struct knockout_entry {
 };
 
 
-static struct knockout_entry knockout_entries[KNOCKOUT_ENTRIES];
-static struct knockout_box knockout_boxes[KNOCKOUT_BOXES];
-static int knockout_polygons[KNOCKOUT_POLYGONS];
+static struct knockout_entry knockout_entry_initial[KNOCKOUT_ENTRIES];
+static struct knockout_entry *knockout_entries = knockout_entry_initial;
+static int knockout_entry_size = KNOCKOUT_ENTRIES;
 static int knockout_entry_cur = 0;
-static int knockout_box_cur = 0;
-static int knockout_polygon_cur = 0;
-static struct knockout_box *knockout_list = NULL;
+
+/* arena blocks are retained and reused once the buffers are flushed */
+static struct knockout_block *knockout_blocks = NULL;
+static struct knockout_block *knockout_block_cur = NULL;
+static size_t knockout_block_used = 0;
+
+/* top level boxes indexed by the grid cells they cover */
+static struct knockout_cell *knockout_grid[KNOCKOUT_GRID_SIZE];
+/* top level boxes too large to enter into the grid */
+static struct knockout_box *knockout_large = NULL;
+static unsigned int knockout_visit = 0;
+
+/* plots and pixels knocked out in the current frame */
+static int knockout_frame_plots = 0;
+static int64_t knockout_frame_pixels = 0;
+static struct nsmetric *knockout_metric_plots;
+static struct nsmetric *knockout_metric_pixels;
 
 static struct plotter_table real_plot;
 
 static struct rect clip_cur;
 static int nested_depth = 0;
 
+static nserror knockout_plot_flush(const struct redraw_context *ctx);
+
+
+/**
+ * Allocate memory from the knockout arena
+ *
+ * The memory remains valid until the buffers are flushed.
+ *
+ * \param size The number of bytes required
+ * \return pointer to the memory or NULL on memory exhaustion
+ */
+static void *knockout_alloc(size_t size)
+{
+	struct knockout_block *block = knockout_block_cur;
+	struct knockout_block **link;
+	size_t align = sizeof(block->data[0]);
+	size_t block_size;
+	void *ptr;
+
+	size = (size + align - 1) & ~(align - 1);
+
+	if ((block == NULL) || (knockout_block_used + size > block->size)) {
+		/* move on to the next retained block if it is large enough */
+		link = (block == NULL) ? &knockout_blocks : &block->next;
+		block = *link;
+		if ((block == NULL) || (block->size < size)) {
+			block_size = (size > KNOCKOUT_BLOCK_SIZE) ?
+				size : KNOCKOUT_BLOCK_SIZE;
+			block = malloc(sizeof(*block) + block_size);
+			if (block == NULL) {
+				return NULL;
+			}
+			block->size = block_size;
+			block->next = *link;
+			*link = block;
+		}
+		knockout_block_cur = block;
+		knockout_block_used = 0;
+	}
+
+	ptr = (char *)block->data + knockout_block_used;
+	knockout_block_used += size;
+
+	return ptr;
+}
+
+
+/**
+ * Commit the plot entry at the current position
+ *
+ * Ensures there is always space for the next entry, growing the
+ * buffer as required.
+ *
+ * \param ctx The current redraw context.
+ * \return NSERROR_OK on success else error code.
+ */
+static nserror knockout_entry_commit(const struct redraw_context *ctx)
+{
+	struct knockout_entry *entries;
+	int size;
+
+	if (++knockout_entry_cur < knockout_entry_size) {
+		return NSERROR_OK;
+	}
+
+	size = knockout_entry_size * 2;
+	if (knockout_entries == knockout_entry_initial) {
+		entries = malloc(size * sizeof(struct knockout_entry));
+		if (entries != NULL) {
+			memcpy(entries, knockout_entry_initial,
+			       sizeof(knockout_entry_initial));
+		}
+	} else {
+		entries = realloc(knockout_entries,
+				  size * sizeof(struct knockout_entry));
+	}
+	if (entries == NULL) {
+		/* unable to grow the buffer, plot what is held so far */
+		return knockout_plot_flush(ctx);
+	}
+
+	knockout_entries = entries;
+	knockout_entry_size = size;
+
+	return NSERROR_OK;
+}
+
+
+/**
+ * Get the spatial grid bucket of a cell
+ */
+static inline unsigned int knockout_grid_bucket(int cx, int cy)
+{
+	return (((unsigned int)cx * 73856093u) ^
+		((unsigned int)cy * 19349663u)) & (KNOCKOUT_GRID_SIZE - 1);
+}
+
+
+/**
+ * Initialise a knockout box
+ */
+static inline void
+knockout_box_init(struct knockout_box *box,
+		  int x0, int y0, int x1, int y1,
+		  struct knockout_box *next)
+{
+	box->bbox.x0 = x0;
+	box->bbox.y0 = y0;
+	box->bbox.x1 = x1;
+	box->bbox.y1 = y1;
+	box->deleted = false;
+	box->visit = 0;
+	box->child = NULL;
+	box->next = next;
+}
+
+
+/**
+ * Add a top level box which may be knocked out by later plots
+ *
+ * \param bbox The area of the box
+ * \return The box or NULL on memory exhaustion
+ */
+static struct knockout_box *knockout_box_add(const struct rect *bbox)
+{
+	struct knockout_box *box;
+	struct knockout_cell *cell;
+	int cx0, cy0, cx1, cy1;
+	int cx, cy;
+
+	box = knockout_alloc(sizeof(struct knockout_box));
+	if (box == NULL) {
+		return NULL;
+	}
+	knockout_box_init(box, bbox->x0, bbox->y0, bbox->x1, bbox->y1, NULL);
+
+	if ((bbox->x0 >= bbox->x1) || (bbox->y0 >= bbox->y1)) {
+		/* empty boxes are never knocked out */
+		return box;
+	}
+
+	cx0 = bbox->x0 >> KNOCKOUT_GRID_SHIFT;
+	cy0 = bbox->y0 >> KNOCKOUT_GRID_SHIFT;
+	cx1 = (bbox->x1 - 1) >> KNOCKOUT_GRID_SHIFT;
+	cy1 = (bbox->y1 - 1) >> KNOCKOUT_GRID_SHIFT;
+
+	if ((cx1 - cx0 >= KNOCKOUT_GRID_SPAN) ||
+	    (cy1 - cy0 >= KNOCKOUT_GRID_SPAN) ||
+	    ((cx1 - cx0 + 1) * (cy1 - cy0 + 1) > KNOCKOUT_GRID_SPAN)) {
+		box->next = knockout_large;
+		knockout_large = box;
+		return box;
+	}
+
+	for (cy = cy0; cy <= cy1; cy++) {
+		for (cx = cx0; cx <= cx1; cx++) {
+			cell = knockout_alloc(sizeof(struct knockout_cell));
+			if (cell == NULL) {
+				/* the box is still found through the
+				 * large list, repeat visits are ignored */
+				box->next = knockout_large;
+				knockout_large = box;
+				return box;
+			}
+			cell->box = box;
+			cell->next = knockout_grid[knockout_grid_bucket(cx, cy)];
+			knockout_grid[knockout_grid_bucket(cx, cy)] = cell;
+		}
+	}
+
+	return box;
+}
+
+
+/**
+ * Account for the area of a plot which was knocked out
+ *
+ * \param box The box to account for
+ * \return The number of pixels in the box which remain to be plotted
+ */
+static int64_t knockout_box_remaining(struct knockout_box *box)
+{
+	struct knockout_box *child;
+	int64_t remaining = 0;
+
+	if (box->deleted) {
+		return 0;
+	}
+	if (box->child == NULL) {
+		if ((box->bbox.x0 >= box->bbox.x1) ||
+		    (box->bbox.y0 >= box->bbox.y1)) {
+			return 0;
+		}
+		return (int64_t)(box->bbox.x1 - box->bbox.x0) *
+			(box->bbox.y1 - box->bbox.y0);
+	}
+	for (child = box->child; child != NULL; child = child->next) {
+		remaining += knockout_box_remaining(child);
+	}
+	return remaining;
+}
+
+
+/**
+ * Update the knockout counts for a plot which may have been knocked out
+ *
+ * \param box The top level box of the plot
+ */
+static void knockout_account(struct knockout_box *box)
+{
+	int64_t area;
+	int64_t remaining;
+
+	if ((box->bbox.x0 >= box->bbox.x1) || (box->bbox.y0 >= box->bbox.y1)) {
+		return;
+	}
+	area = (int64_t)(box->bbox.x1 - box->bbox.x0) *
+		(box->bbox.y1 - box->bbox.y0);
+
+	remaining = knockout_box_remaining(box);
+	if (remaining == 0) {
+		knockout_frame_plots++;
+	}
+	knockout_frame_pixels += area - remaining;
+}
+
 
 /**
  * fill an area recursively
@@ -267,9 +546,14 @@ static nserror knockout_plot_flush(const struct redraw_context *ctx)
 
 	/* debugging information */
 #ifdef KNOCKOUT_DEBUG
-	NSLOG(netsurf, INFO, "Entries are %i/%i, %i/%i, %i/%i",
-	      knockout_entry_cur, KNOCKOUT_ENTRIES, knockout_box_cur,
-	      KNOCKOUT_BOXES, knockout_polygon_cur, KNOCKOUT_POLYGONS);
+	struct knockout_block *block;
+	size_t arena_size = 0;
+
+	for (block = knockout_blocks; block != NULL; block = block->next) {
+		arena_size += block->size;
+	}
+	NSLOG(netsurf, INFO, "Entries are %i/%i, arena %"PRIsizet" bytes",
+	      knockout_entry_cur, knockout_entry_size, arena_size);
 #endif
 
 	for (i = 0; i < knockout_entry_cur; i++) {
@@ -294,12 +578,15 @@ static nserror knockout_plot_flush(const struct redraw_context *ctx)
 			break;
 
 		case KNOCKOUT_PLOT_FILL:
-			box = knockout_entries[i].box->child;
-			if (box) {
+			knockout_account(knockout_entries[i].box);
+			box = knockout_entries[i].box;
+			if (box->deleted) {
+				/* entirely knocked out */
+			} else if (box->child) {
 				res = knockout_plot_fill_recursive(ctx,
-								   box,
+								   box->child,
 				      &knockout_entries[i].data.fill.plot_style);
-			} else if (!knockout_entries[i].box->deleted) {
+			} else {
 				res = real_plot.rectangle(ctx,
 				       &knockout_entries[i].data.fill.plot_style,
 				       &knockout_entries[i].data.fill.r);
@@ -338,12 +625,15 @@ static nserror knockout_plot_flush(const struct redraw_context *ctx)
 			break;
 
 		case KNOCKOUT_PLOT_BITMAP:
-			box = knockout_entries[i].box->child;
-			if (box) {
+			knockout_account(knockout_entries[i].box);
+			box = knockout_entries[i].box;
+			if (box->deleted) {
+				/* entirely knocked out */
+			} else if (box->child) {
 				res = knockout_plot_bitmap_recursive(ctx,
-						box,
+						box->child,
 						&knockout_entries[i]);
-			} else if (!knockout_entries[i].box->deleted) {
+			} else {
 				res = real_plot.bitmap(ctx,
 					knockout_entries[i].data.bitmap.bitmap,
 					knockout_entries[i].data.bitmap.x,
@@ -372,137 +662,251 @@ static nserror knockout_plot_flush(const struct redraw_context *ctx)
 	}
 
 	knockout_entry_cur = 0;
-	knockout_box_cur = 0;
-	knockout_polygon_cur = 0;
-	knockout_list = NULL;
+	knockout_block_cur = NULL;
+	knockout_block_used = 0;
+	memset(knockout_grid, 0, sizeof(knockout_grid));
+	knockout_large = NULL;
+	knockout_visit = 0;
 
 	return ffres;
 }
 
 
+static bool
+knockout_calculate_list(const struct redraw_context *ctx,
+			int x0, int y0, int x1, int y1,
+			struct knockout_box *owner,
+			struct knockout_box **list);
+
+
 /**
- * Knockout a section of previous rendering
+ * Knockout a section of previous rendering from a box
  *
  * \param ctx The current redraw context.
  * \param x0    The left edge of the removal box
  * \param y0    The bottom edge of the removal box
  * \param x1    The right edge of the removal box
  * \param y1    The top edge of the removal box
- * \param owner The parent box set to consider, or NULL for top level
+ * \param parent The box to consider
+ * \return false if the buffers were flushed else true
  */
-static void
-knockout_calculate(const struct redraw_context *ctx,
-		   int x0, int y0, int x1, int y1,
-		   struct knockout_box *owner)
+static bool
+knockout_calculate_box(const struct redraw_context *ctx,
+		       int x0, int y0, int x1, int y1,
+		       struct knockout_box *parent)
 {
-	struct knockout_box *box;
-	struct knockout_box *parent;
-	struct knockout_box *prev = NULL;
+	struct knockout_box *boxes;
 	int nx0, ny0, nx1, ny1;
 
-	if (owner == NULL)
-		box = knockout_list;
-	else
-		box = owner->child;
+	/* top level boxes may be reached through several grid cells */
+	if (parent->visit == knockout_visit) {
+		return true;
+	}
+	parent->visit = knockout_visit;
 
-	for (parent = box; parent; parent = parent->next) {
+	/* get the parent dimensions */
+	nx0 = parent->bbox.x0;
+	ny0 = parent->bbox.y0;
+	nx1 = parent->bbox.x1;
+	ny1 = parent->bbox.y1;
+
+	/* reject non-overlapping boxes */
+	if ((nx0 >= x1) || (nx1 <= x0) || (ny0 >= y1) || (ny1 <= y0))
+		return true;
+
+	/* check for a total knockout */
+	if ((x0 <= nx0) && (x1 >= nx1) && (y0 <= ny0) && (y1 >= ny1)) {
+		parent->deleted = true;
+		return true;
+	}
+
+	/* has the box been replaced by children? */
+	if (parent->child) {
+		return knockout_calculate_list(ctx, x0, y0, x1, y1,
+					       parent, &parent->child);
+	}
+
+	/* we need a maximum of 4 child boxes */
+	boxes = knockout_alloc(4 * sizeof(struct knockout_box));
+	if (boxes == NULL) {
+		knockout_plot_flush(ctx);
+		return false;
+	}
+
+	/* clip top */
+	if (y1 < ny1) {
+		knockout_box_init(boxes, nx0, y1, nx1, ny1, parent->child);
+		parent->child = boxes++;
+		ny1 = y1;
+	}
+	/* clip bottom */
+	if (y0 > ny0) {
+		knockout_box_init(boxes, nx0, ny0, nx1, y0, parent->child);
+		parent->child = boxes++;
+		ny0 = y0;
+	}
+	/* clip right */
+	if (x1 < nx1) {
+		knockout_box_init(boxes, x1, ny0, nx1, ny1, parent->child);
+		parent->child = boxes++;
+		/* nx1 isn't used again, but if it was it would
+		 * need to be updated to x1 here. */
+	}
+	/* clip left */
+	if (x0 > nx0) {
+		knockout_box_init(boxes, nx0, ny0, x0, ny1, parent->child);
+		parent->child = boxes++;
+		/* nx0 isn't used again, but if it was it would
+		 * need to be updated to x0 here. */
+	}
+
+	return true;
+}
+
+
+/**
+ * Knockout a section of previous rendering from a list of boxes
+ *
+ * \param ctx The current redraw context.
+ * \param x0    The left edge of the removal box
+ * \param y0    The bottom edge of the removal box
+ * \param x1    The right edge of the removal box
+ * \param y1    The top edge of the removal box
+ * \param owner The parent of the list, or NULL for top level
+ * \param list The list of boxes
+ * \return false if the buffers were flushed else true
+ */
+static bool
+knockout_calculate_list(const struct redraw_context *ctx,
+			int x0, int y0, int x1, int y1,
+			struct knockout_box *owner,
+			struct knockout_box **list)
+{
+	struct knockout_box *parent;
+	struct knockout_box *prev = NULL;
+
+	for (parent = *list; parent; parent = parent->next) {
 		/* permanently delink deleted nodes */
 		if (parent->deleted) {
 			if (prev) {
 				/* not the first valid element: just skip future */
 				prev->next = parent->next;
 			} else {
-				if (owner) {
-					/* first valid element: update child reference */
-					owner->child = parent->next;
-					/* have we deleted all child nodes? */
-					if (!owner->child)
-						owner->deleted = true;
-				} else {
-					/* we are the head of the list */
-					knockout_list = parent->next;
-				}
+				/* first valid element: update list head */
+				*list = parent->next;
+				/* have we deleted all child nodes? */
+				if ((owner != NULL) && (*list == NULL))
+					owner->deleted = true;
 			}
 			continue;
 		} else {
 			prev = parent;
 		}
 
-		/* get the parent dimensions */
-		nx0 = parent->bbox.x0;
-		ny0 = parent->bbox.y0;
-		nx1 = parent->bbox.x1;
-		ny1 = parent->bbox.y1;
+		if (!knockout_calculate_box(ctx, x0, y0, x1, y1, parent)) {
+			return false;
+		}
+	}
 
-		/* reject non-overlapping boxes */
-		if ((nx0 >= x1) || (nx1 <= x0) || (ny0 >= y1) || (ny1 <= y0))
-			continue;
+	return true;
+}
+
+
+/**
+ * Knockout a section of previous rendering from a spatial grid bucket
+ *
+ * \param ctx The current redraw context.
+ * \param x0    The left edge of the removal box
+ * \param y0    The bottom edge of the removal box
+ * \param x1    The right edge of the removal box
+ * \param y1    The top edge of the removal box
+ * \param bucket The grid bucket
+ * \return false if the buffers were flushed else true
+ */
+static bool
+knockout_calculate_bucket(const struct redraw_context *ctx,
+			  int x0, int y0, int x1, int y1,
+			  struct knockout_cell **bucket)
+{
+	struct knockout_cell *cell;
+	struct knockout_cell *prev = NULL;
 
-		/* check for a total knockout */
-		if ((x0 <= nx0) && (x1 >= nx1) && (y0 <= ny0) && (y1 >= ny1)) {
-			parent->deleted = true;
+	for (cell = *bucket; cell; cell = cell->next) {
+		/* permanently delink deleted boxes */
+		if (cell->box->deleted) {
+			if (prev) {
+				prev->next = cell->next;
+			} else {
+				*bucket = cell->next;
+			}
 			continue;
 		}
+		prev = cell;
 
-		/* has the box been replaced by children? */
-		if (parent->child) {
-			knockout_calculate(ctx, x0, y0, x1, y1, parent);
-		} else {
-			/* we need a maximum of 4 child boxes */
-			if (knockout_box_cur + 4 >= KNOCKOUT_BOXES) {
-				knockout_plot_flush(ctx);
+		if (!knockout_calculate_box(ctx, x0, y0, x1, y1, cell->box)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/**
+ * Knockout a section of previous rendering
+ *
+ * Only the top level boxes in the spatial grid cells the removal box
+ * covers, and those too large to be entered into the grid, are
+ * considered.
+ *
+ * \param ctx The current redraw context.
+ * \param x0    The left edge of the removal box
+ * \param y0    The bottom edge of the removal box
+ * \param x1    The right edge of the removal box
+ * \param y1    The top edge of the removal box
+ */
+static void
+knockout_calculate(const struct redraw_context *ctx,
+		   int x0, int y0, int x1, int y1)
+{
+	int cx0, cy0, cx1, cy1;
+	int cx, cy;
+	unsigned int bucket;
+
+	if ((x0 >= x1) || (y0 >= y1)) {
+		return;
+	}
+
+	knockout_visit++;
+
+	if (!knockout_calculate_list(ctx, x0, y0, x1, y1,
+				     NULL, &knockout_large)) {
+		return;
+	}
+
+	cx0 = x0 >> KNOCKOUT_GRID_SHIFT;
+	cy0 = y0 >> KNOCKOUT_GRID_SHIFT;
+	cx1 = (x1 - 1) >> KNOCKOUT_GRID_SHIFT;
+	cy1 = (y1 - 1) >> KNOCKOUT_GRID_SHIFT;
+
+	if (((int64_t)(cx1 - cx0 + 1) * (cy1 - cy0 + 1)) >
+	    KNOCKOUT_GRID_SIZE) {
+		/* covers more cells than there are buckets */
+		for (bucket = 0; bucket < KNOCKOUT_GRID_SIZE; bucket++) {
+			if (!knockout_calculate_bucket(ctx, x0, y0, x1, y1,
+					&knockout_grid[bucket])) {
 				return;
 			}
+		}
+		return;
+	}
 
-			/* clip top */
-			if (y1 < ny1) {
-				knockout_boxes[knockout_box_cur].bbox.x0 = nx0;
-				knockout_boxes[knockout_box_cur].bbox.y0 = y1;
-				knockout_boxes[knockout_box_cur].bbox.x1 = nx1;
-				knockout_boxes[knockout_box_cur].bbox.y1 = ny1;
-				knockout_boxes[knockout_box_cur].deleted = false;
-				knockout_boxes[knockout_box_cur].child = NULL;
-				knockout_boxes[knockout_box_cur].next = parent->child;
-				parent->child = &knockout_boxes[knockout_box_cur++];
-				ny1 = y1;
-			}
-			/* clip bottom */
-			if (y0 > ny0) {
-				knockout_boxes[knockout_box_cur].bbox.x0 = nx0;
-				knockout_boxes[knockout_box_cur].bbox.y0 = ny0;
-				knockout_boxes[knockout_box_cur].bbox.x1 = nx1;
-				knockout_boxes[knockout_box_cur].bbox.y1 = y0;
-				knockout_boxes[knockout_box_cur].deleted = false;
-				knockout_boxes[knockout_box_cur].child = NULL;
-				knockout_boxes[knockout_box_cur].next = parent->child;
-				parent->child = &knockout_boxes[knockout_box_cur++];
-				ny0 = y0;
-			}
-			/* clip right */
-			if (x1 < nx1) {
-				knockout_boxes[knockout_box_cur].bbox.x0 = x1;
-				knockout_boxes[knockout_box_cur].bbox.y0 = ny0;
-				knockout_boxes[knockout_box_cur].bbox.x1 = nx1;
-				knockout_boxes[knockout_box_cur].bbox.y1 = ny1;
-				knockout_boxes[knockout_box_cur].deleted = false;
-				knockout_boxes[knockout_box_cur].child = NULL;
-				knockout_boxes[knockout_box_cur].next = parent->child;
-				parent->child = &knockout_boxes[knockout_box_cur++];
-				/* nx1 isn't used again, but if it was it would
-				 * need to be updated to x1 here. */
-			}
-			/* clip left */
-			if (x0 > nx0) {
-				knockout_boxes[knockout_box_cur].bbox.x0 = nx0;
-				knockout_boxes[knockout_box_cur].bbox.y0 = ny0;
-				knockout_boxes[knockout_box_cur].bbox.x1 = x0;
-				knockout_boxes[knockout_box_cur].bbox.y1 = ny1;
-				knockout_boxes[knockout_box_cur].deleted = false;
-				knockout_boxes[knockout_box_cur].child = NULL;
-				knockout_boxes[knockout_box_cur].next = parent->child;
-				parent->child = &knockout_boxes[knockout_box_cur++];
-				/* nx0 isn't used again, but if it was it would
-				 * need to be updated to x0 here. */
+	for (cy = cy0; cy <= cy1; cy++) {
+		for (cx = cx0; cx <= cx1; cx++) {
+			bucket = knockout_grid_bucket(cx, cy);
+			if (!knockout_calculate_bucket(ctx, x0, y0, x1, y1,
+					&knockout_grid[bucket])) {
+				return;
 			}
 		}
 	}
@@ -528,6 +932,7 @@ knockout_plot_rectangle(const struct redraw_context *ctx,
 			const struct rect *rect)
 {
 	int kx0, ky0, kx1, ky1;
+	struct knockout_box *box;
 	nserror res = NSERROR_OK;
 
 	if (pstyle->fill_type != PLOT_OP_TYPE_NONE) {
@@ -544,20 +949,24 @@ knockout_plot_rectangle(const struct redraw_context *ctx,
 		}
 
 		/* fills both knock out and get knocked out */
-		knockout_calculate(ctx, kx0, ky0, kx1, ky1, NULL);
-		knockout_boxes[knockout_box_cur].bbox = *rect;
-		knockout_boxes[knockout_box_cur].deleted = false;
-		knockout_boxes[knockout_box_cur].child = NULL;
-		knockout_boxes[knockout_box_cur].next = knockout_list;
-		knockout_list = &knockout_boxes[knockout_box_cur];
-		knockout_entries[knockout_entry_cur].box = &knockout_boxes[knockout_box_cur];
+		knockout_calculate(ctx, kx0, ky0, kx1, ky1);
+		box = knockout_box_add(rect);
+		if (box == NULL) {
+			/* retry with empty buffers */
+			res = knockout_plot_flush(ctx);
+			box = knockout_box_add(rect);
+		}
 		knockout_entries[knockout_entry_cur].data.fill.r = *rect;
 		knockout_entries[knockout_entry_cur].data.fill.plot_style = *pstyle;
 		knockout_entries[knockout_entry_cur].data.fill.plot_style.stroke_type = PLOT_OP_TYPE_NONE; /* ensure we only plot the fill */
-		knockout_entries[knockout_entry_cur].type = KNOCKOUT_PLOT_FILL;
-		if ((++knockout_entry_cur >= KNOCKOUT_ENTRIES) ||
-		    (++knockout_box_cur >= KNOCKOUT_BOXES)) {
-			res = knockout_plot_flush(ctx);
+		if (box == NULL) {
+			res = real_plot.rectangle(ctx,
+				&knockout_entries[knockout_entry_cur].data.fill.plot_style,
+				rect);
+		} else {
+			knockout_entries[knockout_entry_cur].box = box;
+			knockout_entries[knockout_entry_cur].type = KNOCKOUT_PLOT_FILL;
+			res = knockout_entry_commit(ctx);
 		}
 	}
 
@@ -568,9 +977,7 @@ knockout_plot_rectangle(const struct redraw_context *ctx,
 		knockout_entries[knockout_entry_cur].data.fill.plot_style = *pstyle;
 		knockout_entries[knockout_entry_cur].data.fill.plot_style.fill_type = PLOT_OP_TYPE_NONE; /* ensure we only plot the outline */
 		knockout_entries[knockout_entry_cur].type = KNOCKOUT_PLOT_RECTANGLE;
-		if (++knockout_entry_cur >= KNOCKOUT_ENTRIES) {
-			res = knockout_plot_flush(ctx);
-		}
+		res = knockout_entry_commit(ctx);
 	}
 	return res;
 }
@@ -595,10 +1002,7 @@ knockout_plot_line(const struct redraw_context *ctx,
 	knockout_entries[knockout_entry_cur].data.line.l = *line;
 	knockout_entries[knockout_entry_cur].data.line.plot_style = *pstyle;
 	knockout_entries[knockout_entry_cur].type = KNOCKOUT_PLOT_LINE;
-	if (++knockout_entry_cur >= KNOCKOUT_ENTRIES) {
-		return knockout_plot_flush(ctx);
-	}
-	return NSERROR_OK;
+	return knockout_entry_commit(ctx);
 }
 
 
@@ -623,11 +1027,12 @@ knockout_plot_polygon(const struct redraw_context *ctx,
 		      unsigned int n)
 {
 	int *dest;
-	nserror res = NSERROR_OK;
-	nserror ffres = NSERROR_OK;
+	nserror res;
+	nserror ffres;
 
-	/* ensure we have sufficient room even when flushed */
-	if (n * 2 >= KNOCKOUT_POLYGONS) {
+	dest = knockout_alloc(n * 2 * sizeof(int));
+	if (dest == NULL) {
+		/* no room to copy the vertices, plot directly */
 		ffres = knockout_plot_flush(ctx);
 		res = real_plot.polygon(ctx, pstyle, p, n);
 		/* return the first error */
@@ -637,27 +1042,13 @@ knockout_plot_polygon(const struct redraw_context *ctx,
 		return ffres;
 	}
 
-	/* ensure we have enough room right now */
-	if (knockout_polygon_cur + n * 2 >= KNOCKOUT_POLYGONS) {
-		ffres = knockout_plot_flush(ctx);
-	}
-
 	/* copy our data */
-	dest = &(knockout_polygons[knockout_polygon_cur]);
 	memcpy(dest, p, n * 2 * sizeof(int));
-	knockout_polygon_cur += n * 2;
 	knockout_entries[knockout_entry_cur].data.polygon.p = dest;
 	knockout_entries[knockout_entry_cur].data.polygon.n = n;
 	knockout_entries[knockout_entry_cur].data.polygon.plot_style = *pstyle;
 	knockout_entries[knockout_entry_cur].type = KNOCKOUT_PLOT_POLYGON;
-	if (++knockout_entry_cur >= KNOCKOUT_ENTRIES) {
-		res = knockout_plot_flush(ctx);
-	}
-	/* return the first error */
-	if ((res != NSERROR_OK) && (ffres == NSERROR_OK)) {
-		ffres = res;
-	}
-	return ffres;
+	return knockout_entry_commit(ctx);
 }
 
 
@@ -698,8 +1089,6 @@ knockout_plot_path(const struct redraw_context *ctx,
 static nserror
 knockout_plot_clip(const struct redraw_context *ctx, const struct rect *clip)
 {
-	nserror res = NSERROR_OK;
-
 	if (clip->x1 < clip->x0 || clip->y0 > clip->y1) {
 #ifdef KNOCKOUT_DEBUG
 		NSLOG(netsurf, INFO, "bad clip rectangle %i %i %i %i",
@@ -713,10 +1102,7 @@ knockout_plot_clip(const struct redraw_context *ctx, const struct rect *clip)
 
 	knockout_entries[knockout_entry_cur].data.clip = *clip;
 	knockout_entries[knockout_entry_cur].type = KNOCKOUT_PLOT_CLIP;
-	if (++knockout_entry_cur >= KNOCKOUT_ENTRIES) {
-		res = knockout_plot_flush(ctx);
-	}
-	return res;
+	return knockout_entry_commit(ctx);
 }
 
 
@@ -739,18 +1125,13 @@ knockout_plot_text(const struct redraw_context *ctx,
 		   const char *text,
 		   size_t length)
 {
-	nserror res = NSERROR_OK;
-
 	knockout_entries[knockout_entry_cur].data.text.x = x;
 	knockout_entries[knockout_entry_cur].data.text.y = y;
 	knockout_entries[knockout_entry_cur].data.text.text = text;
 	knockout_entries[knockout_entry_cur].data.text.length = length;
 	knockout_entries[knockout_entry_cur].data.text.font_style = *fstyle;
 	knockout_entries[knockout_entry_cur].type = KNOCKOUT_PLOT_TEXT;
-	if (++knockout_entry_cur >= KNOCKOUT_ENTRIES) {
-		res = knockout_plot_flush(ctx);
-	}
-	return res;
+	return knockout_entry_commit(ctx);
 }
 
 
@@ -773,17 +1154,12 @@ knockout_plot_disc(const struct redraw_context *ctx,
 		   int y,
 		   int radius)
 {
-	nserror res = NSERROR_OK;
-
 	knockout_entries[knockout_entry_cur].data.disc.x = x;
 	knockout_entries[knockout_entry_cur].data.disc.y = y;
 	knockout_entries[knockout_entry_cur].data.disc.radius = radius;
 	knockout_entries[knockout_entry_cur].data.disc.plot_style = *pstyle;
 	knockout_entries[knockout_entry_cur].type = KNOCKOUT_PLOT_DISC;
-	if (++knockout_entry_cur >= KNOCKOUT_ENTRIES) {
-		res = knockout_plot_flush(ctx);
-	}
-	return res;
+	return knockout_entry_commit(ctx);
 }
 
 
@@ -812,8 +1188,6 @@ knockout_plot_arc(const struct redraw_context *ctx,
 		  int angle1,
 		  int angle2)
 {
-	nserror res = NSERROR_OK;
-
 	knockout_entries[knockout_entry_cur].data.arc.x = x;
 	knockout_entries[knockout_entry_cur].data.arc.y = y;
 	knockout_entries[knockout_entry_cur].data.arc.radius = radius;
@@ -821,10 +1195,7 @@ knockout_plot_arc(const struct redraw_context *ctx,
 	knockout_entries[knockout_entry_cur].data.arc.angle2 = angle2;
 	knockout_entries[knockout_entry_cur].data.arc.plot_style = *pstyle;
 	knockout_entries[knockout_entry_cur].type = KNOCKOUT_PLOT_ARC;
-	if (++knockout_entry_cur >= KNOCKOUT_ENTRIES) {
-		res = knockout_plot_flush(ctx);
-	}
-	return res;
+	return knockout_entry_commit(ctx);
 }
 
 
@@ -861,6 +1232,8 @@ knockout_plot_bitmap(const struct redraw_context *ctx,
 		     bitmap_flags_t flags)
 {
 	int kx0, ky0, kx1, ky1;
+	struct rect bbox;
+	struct knockout_box *box;
 	nserror res;
 	nserror ffres = NSERROR_OK;
 
@@ -888,17 +1261,28 @@ knockout_plot_bitmap(const struct redraw_context *ctx,
 
 	/* tiled bitmaps both knock out and get knocked out */
 	if (guit->bitmap->get_opaque(bitmap)) {
-		knockout_calculate(ctx, kx0, ky0, kx1, ky1, NULL);
+		knockout_calculate(ctx, kx0, ky0, kx1, ky1);
 	}
-	knockout_boxes[knockout_box_cur].bbox.x0 = kx0;
-	knockout_boxes[knockout_box_cur].bbox.y0 = ky0;
-	knockout_boxes[knockout_box_cur].bbox.x1 = kx1;
-	knockout_boxes[knockout_box_cur].bbox.y1 = ky1;
-	knockout_boxes[knockout_box_cur].deleted = false;
-	knockout_boxes[knockout_box_cur].child = NULL;
-	knockout_boxes[knockout_box_cur].next = knockout_list;
-	knockout_list = &knockout_boxes[knockout_box_cur];
-	knockout_entries[knockout_entry_cur].box = &knockout_boxes[knockout_box_cur];
+	bbox.x0 = kx0;
+	bbox.y0 = ky0;
+	bbox.x1 = kx1;
+	bbox.y1 = ky1;
+	box = knockout_box_add(&bbox);
+	if (box == NULL) {
+		/* retry with empty buffers */
+		ffres = knockout_plot_flush(ctx);
+		box = knockout_box_add(&bbox);
+		if (box == NULL) {
+			res = real_plot.bitmap(ctx, bitmap, x, y,
+					       width, height, bg, flags);
+			/* return the first error */
+			if ((res != NSERROR_OK) && (ffres == NSERROR_OK)) {
+				ffres = res;
+			}
+			return ffres;
+		}
+	}
+	knockout_entries[knockout_entry_cur].box = box;
 	knockout_entries[knockout_entry_cur].data.bitmap.x = x;
 	knockout_entries[knockout_entry_cur].data.bitmap.y = y;
 	knockout_entries[knockout_entry_cur].data.bitmap.width = width;
@@ -908,9 +1292,9 @@ knockout_plot_bitmap(const struct redraw_context *ctx,
 	knockout_entries[knockout_entry_cur].data.bitmap.flags = flags;
 	knockout_entries[knockout_entry_cur].type = KNOCKOUT_PLOT_BITMAP;
 
-	if ((++knockout_entry_cur >= KNOCKOUT_ENTRIES) ||
-	    (++knockout_box_cur >= KNOCKOUT_BOXES)) {
-		ffres = knockout_plot_flush(ctx);
+	res = knockout_entry_commit(ctx);
+	if ((res != NSERROR_OK) && (ffres == NSERROR_OK)) {
+		ffres = res;
 	}
 	res = knockout_plot_clip(ctx, &clip_cur);
 	/* return the first error */
@@ -939,10 +1323,7 @@ knockout_plot_group_start(const struct redraw_context *ctx, const char *name)
 
 	knockout_entries[knockout_entry_cur].data.group_start.name = name;
 	knockout_entries[knockout_entry_cur].type = KNOCKOUT_PLOT_GROUP_START;
-	if (++knockout_entry_cur >= KNOCKOUT_ENTRIES) {
-		return knockout_plot_flush(ctx);
-	}
-	return NSERROR_OK;
+	return knockout_entry_commit(ctx);
 }
 
 
@@ -961,10 +1342,7 @@ static nserror knockout_plot_group_end(const struct redraw_context *ctx)
 	}
 
 	knockout_entries[knockout_entry_cur].type = KNOCKOUT_PLOT_GROUP_END;
-	if (++knockout_entry_cur >= KNOCKOUT_ENTRIES) {
-		return knockout_plot_flush(ctx);
-	}
-	return NSERROR_OK;
+	return knockout_entry_commit(ctx);
 }
 
 /* exported functions documented in desktop/knockout.h */
@@ -983,6 +1361,13 @@ bool knockout_plot_start(const struct redraw_context *ctx,
 	if (knockout_entry_cur > 0)
 		knockout_plot_end(ctx);
 
+	if (knockout_metric_plots == NULL) {
+		nsmetric_register("knockout.plots", NSMETRIC_GAUGE,
+				  &knockout_metric_plots);
+		nsmetric_register("knockout.pixels", NSMETRIC_GAUGE,
+				  &knockout_metric_pixels);
+	}
+
 	/* get copy of real plotter table */
 	real_plot = *(ctx->plot);
 
@@ -996,9 +1381,19 @@ bool knockout_plot_start(const struct redraw_context *ctx,
 /* exported functions documented in desktop/knockout.h */
 bool knockout_plot_end(const struct redraw_context *ctx)
 {
+	nserror res;
+
 	/* only output when we've finished any nesting */
 	if (--nested_depth == 0) {
-		return knockout_plot_flush(ctx);
+		res = knockout_plot_flush(ctx);
+
+		/* record what was knocked out of the frame */
+		nsmetric_set(knockout_metric_plots, knockout_frame_plots);
+		nsmetric_set(knockout_metric_pixels, knockout_frame_pixels);
+		knockout_frame_plots = 0;
+		knockout_frame_pixels = 0;
+
+		return (res == NSERROR_OK);
 	}
 
 	assert(nested_depth > 0);
@@ -1006,6 +1401,31 @@ bool knockout_plot_end(const struct redraw_context *ctx)
 }
 
 
+/* exported functions documented in desktop/knockout.h */
+void knockout_fini(void)
+{
+	struct knockout_block *block;
+
+	while (knockout_blocks != NULL) {
+		block = knockout_blocks;
+		knockout_blocks = block->next;
+		free(block);
+	}
+	knockout_block_cur = NULL;
+	knockout_block_used = 0;
+
+	if (knockout_entries != knockout_entry_initial) {
+		free(knockout_entries);
+		knockout_entries = knockout_entry_initial;
+		knockout_entry_size = KNOCKOUT_ENTRIES;
+	}
+	knockout_entry_cur = 0;
+
+	knockout_metric_plots = NULL;
+	knockout_metric_pixels = NULL;
+}
+
+
 /**
  * knockout plotter operation table
  */
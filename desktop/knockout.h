@@ -42,6 +42,14 @@ bool knockout_plot_start(const struct redraw_context *ctx,
  */
 bool knockout_plot_end(const struct redraw_context *ctx);
 
+/**
+ * Release the memory held by the knockout plotter buffers
+ *
+ * The buffers grow to hold the largest redraw and are retained between
+ * sessions, this frees them.
+ */
+void knockout_fini(void);
+
 extern const struct plotter_table knockout_plotters;
 
 #endif
@@ -159,9 +159,10 @@ redraw_entry(struct history *history,
 	}
 
 	/* Only attempt to plot bitmap if it is present */
-	if (entry->page.bitmap != NULL) {
+	if ((entry->page.thumbnail != NULL) &&
+	    (entry->page.thumbnail->bitmap != NULL)) {
 		res = ctx->plot->bitmap(ctx,
-					entry->page.bitmap,
+					entry->page.thumbnail->bitmap,
 					entry->x + x,
 					entry->y + y,
 					LOCAL_HISTORY_WIDTH,
@@ -556,6 +557,9 @@ local_history_set(struct local_history_session *session,
 		assert(session->bw->history != NULL);
 		session->cursor = bw->history->current;
 
+		/* the current page thumbnail may not have been rendered */
+		browser_window_history_render_thumbnail(bw);
+
 		session->cw_t->update_size(session->core_window_handle,
 					   session->bw->history->width,
 					   session->bw->history->height);
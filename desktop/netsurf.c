@@ -31,8 +31,10 @@
 #include "utils/errors.h"
 #include "utils/nscolour.h"
 #include "utils/nsoption.h"
+#include "utils/nsurl.h"
 #include "utils/corestrings.h"
 #include "utils/log.h"
+#include "utils/metrics.h"
 #include "utils/string.h"
 #include "utils/utf8.h"
 #include "utils/messages.h"
@@ -41,6 +43,7 @@
 #include "content/fetchers.h"
 #include "content/hlcache.h"
 #include "content/mimesniff.h"
+#include "content/prefetch.h"
 #include "content/urldb.h"
 #include "css/css.h"
 #include "image/image.h"
@@ -51,6 +54,7 @@
 
 #include "netsurf/browser_window.h"
 #include "desktop/system_colour.h"
+#include "desktop/knockout.h"
 #include "desktop/page-info.h"
 #include "desktop/searchweb.h"
 #include "netsurf/misc.h"
@@ -97,6 +101,18 @@
 /** default time quantum with which to calculate bandwidth (ms) */
 #define LLCACHE_STORE_TIME_QUANTUM (100)
 
+/** time between writing out deferred log records in ms */
+#define LOG_FLUSH_TIME (500)
+
+/**
+ * Write out deferred log records and reschedule
+ */
+static void netsurf_log_flush(void *p)
+{
+	nslog_flush();
+	guit->misc->schedule(LOG_FLUSH_TIME, netsurf_log_flush, NULL);
+}
+
 static void netsurf_lwc_iterator(lwc_string *str, void *pw)
 {
 	NSLOG(netsurf, WARNING, "[%3u] %.*s", str->refcnt,
@@ -141,6 +157,11 @@ nserror netsurf_init(const char *store_path)
 	if (ret != NSERROR_OK)
 		return ret;
 
+	/* share identical URL objects */
+	ret = nsurl_intern_enable(nsoption_bool(url_interning));
+	if (ret != NSERROR_OK)
+		return ret;
+
 	/* set up cache limits based on the memory cache size option */
 	hlcache_parameters.llcache.limit = nsoption_int(memory_cache_size);
 
@@ -163,12 +184,18 @@ nserror netsurf_init(const char *store_path)
 	/* account for image cache use from total */
 	hlcache_parameters.llcache.limit -= image_cache_parameters.limit;
 
+	/* unused converted contents are retained separately */
+	hlcache_parameters.retain_limit = nsoption_uint(content_cache_size);
+
 	/* set backing store target limit */
 	hlcache_parameters.llcache.store.limit = nsoption_uint(disc_cache_size);
 
 	/* set backing store hysterissi to 20% */
 	hlcache_parameters.llcache.store.hysteresis = hlcache_parameters.llcache.store.limit / 5;
 
+	/* compress textual objects in the backing store */
+	hlcache_parameters.llcache.store.compress = nsoption_bool(disc_cache_compress);
+
 	/* set the path to the backing store */
 	hlcache_parameters.llcache.store.path =
 		nsoption_charp(disc_cache_path) ?
@@ -221,6 +248,10 @@ nserror netsurf_init(const char *store_path)
 		return ret;
 	}
 
+	/* log output is written from the scheduler from now on */
+	nslog_set_deferred(true);
+	guit->misc->schedule(LOG_FLUSH_TIME, netsurf_log_flush, NULL);
+
 	return NSERROR_OK;
 }
 
@@ -231,11 +262,17 @@ nserror netsurf_init(const char *store_path)
 
 void netsurf_exit(void)
 {
+	guit->misc->schedule(-1, netsurf_log_flush, NULL);
+	nslog_set_deferred(false);
+
 	hlcache_stop();
 	
 	NSLOG(netsurf, INFO, "Closing GUI");
 	guit->misc->quit();
 
+	/* no further redraws so the knockout buffers can go */
+	knockout_fini();
+
 	NSLOG(netsurf, INFO, "Finalising page-info module");
 	page_info_fini();
 
@@ -245,6 +282,9 @@ void netsurf_exit(void)
 	NSLOG(netsurf, INFO, "Finalising Web Search");
 	search_web_finalise();
 
+	NSLOG(netsurf, INFO, "Finalising prefetch");
+	prefetch_fini();
+
 	NSLOG(netsurf, INFO, "Finalising high-level cache");
 	hlcache_finalise();
 
@@ -271,6 +311,11 @@ void netsurf_exit(void)
 	NSLOG(netsurf, INFO, "Destroying Messages");
 	messages_destroy();
 
+	NSLOG(netsurf, INFO, "Destroying performance metrics");
+	nsmetric_fini();
+
+	nsurl_intern_enable(false);
+
 	corestrings_fini();
 	if (dom_namespace_finalise() != DOM_NO_ERR) {
 		NSLOG(netsurf, WARNING, "Unable to finalise DOM namespace strings");
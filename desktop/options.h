@@ -89,9 +89,23 @@ NSOPTION_STRING(accept_language, NULL)
 /** Accept-Charset header. */
 NSOPTION_STRING(accept_charset, NULL)
 
+/** Content encodings offered for compressed transfer, separated by
+ * commas. An empty list offers every encoding cURL can decode.
+ */
+NSOPTION_STRING(accept_encoding, NULL)
+
 /** Preferred maximum size of memory cache / bytes. */
 NSOPTION_INTEGER(memory_cache_size, 12 * 1024 * 1024)
 
+/** Preferred maximum size of unused contents retained in memory / bytes. */
+NSOPTION_UINT(content_cache_size, 4 * 1024 * 1024)
+
+/** Number of documents kept for back and forward navigation. */
+NSOPTION_UINT(page_cache_pages, 4)
+
+/** Preferred maximum size of local history thumbnails / bytes. */
+NSOPTION_UINT(history_thumbnail_size, 2 * 1024 * 1024)
+
 /** Preferred location of disc cache, or NULL for system provided location */
 NSOPTION_STRING(disc_cache_path, NULL)
 
@@ -101,6 +115,9 @@ NSOPTION_UINT(disc_cache_size, 1024 * 1024 * 1024)
 /** Preferred expiry age of disc cache / days. */
 NSOPTION_INTEGER(disc_cache_age, 28)
 
+/** Whether to compress textual objects in the disc cache. */
+NSOPTION_BOOL(disc_cache_compress, true)
+
 /** Whether to block advertisements */
 NSOPTION_BOOL(block_advertisements, false)
 
@@ -129,6 +146,9 @@ NSOPTION_INTEGER(script_timeout, 10)
 /** How many days to retain URL data for */
 NSOPTION_INTEGER(expire_url, 28)
 
+/** Whether to share a single object between identical URLs */
+NSOPTION_BOOL(url_interning, true)
+
 /** Default font family */
 NSOPTION_INTEGER(font_default, PLOT_FONT_FAMILY_SANS_SERIF)
 
@@ -217,6 +237,17 @@ NSOPTION_UINT(curl_fetch_timeout, 30)
 /** Suppress debug output from cURL. */
 NSOPTION_BOOL(suppress_curl_debug, true)
 
+/** Speculatively connect to servers of links being pointed at and
+ * those hinted by preconnect and dns-prefetch link relations.
+ */
+NSOPTION_BOOL(preconnect, true)
+
+/** Prefetch documents hinted by prefetch link relations. */
+NSOPTION_BOOL(prefetch, true)
+
+/** Prefetch the targets of links being pointed at. */
+NSOPTION_BOOL(prefetch_hover, false)
+
 /** Whether to allow target="_blank" */
 NSOPTION_BOOL(target_blank, true)
 
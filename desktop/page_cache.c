@@ -0,0 +1,281 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Back/forward page cache implementation.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <nsutils/time.h>
+
+#include "utils/errors.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/nsoption.h"
+#include "netsurf/content.h"
+#include "netsurf/ssl_certs.h"
+#include "content/hlcache.h"
+#include "content/content.h"
+#include "html/html.h"
+
+#include "desktop/browser_private.h"
+#include "desktop/page_cache.h"
+
+/**
+ * Time after which a cached document is no longer restored (ms).
+ */
+#define PAGE_CACHE_EXPIRY (30 * 60 * 1000)
+
+/**
+ * A cached document
+ */
+struct page_cache_entry {
+	struct browser_window *bw; /**< window the document was shown in */
+	struct history_entry *entry; /**< history entry shown for */
+	struct hlcache_handle *content; /**< the closed document */
+	struct browser_fetch_parameters params; /**< fetch parameters */
+	struct cert_chain *chain; /**< certificate chain */
+	uint64_t stored; /**< time stored (ms) */
+	bool failed; /**< document reported an error while cached */
+
+	struct page_cache_entry *prev; /**< previous (older) entry */
+	struct page_cache_entry *next; /**< next (newer) entry */
+};
+
+/** Cached documents, least recently stored first */
+static struct page_cache_entry *page_cache_head = NULL;
+static struct page_cache_entry *page_cache_tail = NULL;
+
+/** Number of cached documents */
+static unsigned int page_cache_count = 0;
+
+static struct nsmetric *page_cache_metric_pages = NULL;
+static struct nsmetric *page_cache_metric_hits = NULL;
+
+
+/**
+ * Callback for messages from a cached document
+ *
+ * The document is closed so only errors are of interest.
+ */
+static nserror
+page_cache_callback(struct hlcache_handle *handle,
+		    const hlcache_event *event,
+		    void *pw)
+{
+	struct page_cache_entry *pce = pw;
+
+	if (event->type == CONTENT_MSG_ERROR) {
+		pce->failed = true;
+	}
+
+	return NSERROR_OK;
+}
+
+
+/**
+ * Unlink and free a cache entry without releasing what it holds
+ *
+ * \param pce The entry
+ */
+static void page_cache_unlink(struct page_cache_entry *pce)
+{
+	if (pce->prev == NULL) {
+		page_cache_head = pce->next;
+	} else {
+		pce->prev->next = pce->next;
+	}
+	if (pce->next == NULL) {
+		page_cache_tail = pce->prev;
+	} else {
+		pce->next->prev = pce->prev;
+	}
+
+	page_cache_count--;
+	nsmetric_set(page_cache_metric_pages, page_cache_count);
+
+	free(pce);
+}
+
+
+/**
+ * Discard a cache entry and the document it holds
+ *
+ * \param pce The entry
+ */
+static void page_cache_evict(struct page_cache_entry *pce)
+{
+	NSLOG(netsurf, DEBUG, "Discarding cached page %s",
+	      nsurl_access(hlcache_handle_get_url(pce->content)));
+
+	hlcache_handle_release(pce->content);
+	browser_window__free_fetch_parameters(&pce->params);
+	cert_chain_free(pce->chain);
+
+	page_cache_unlink(pce);
+}
+
+
+/**
+ * Discard expired documents and those beyond a number of pages
+ *
+ * \param limit The number of pages to keep
+ */
+static void page_cache_trim(unsigned int limit)
+{
+	uint64_t now;
+
+	nsu_getmonotonic_ms(&now);
+
+	while ((page_cache_head != NULL) &&
+	       ((page_cache_count > limit) ||
+		(now - page_cache_head->stored > PAGE_CACHE_EXPIRY))) {
+		page_cache_evict(page_cache_head);
+	}
+}
+
+
+/* exported interface documented in desktop/page_cache.h */
+bool
+page_cache_store(struct browser_window *bw,
+		 struct history_entry *entry,
+		 struct hlcache_handle *content,
+		 struct browser_fetch_parameters *params,
+		 struct cert_chain *chain)
+{
+	unsigned int limit = nsoption_uint(page_cache_pages);
+	struct page_cache_entry *pce;
+
+	if (limit == 0) {
+		return false;
+	}
+
+	/* only documents which can be shown again exactly as they were */
+	if ((content_get_status(content) != CONTENT_STATUS_DONE) ||
+	    (content_get_type(content) != CONTENT_HTML) ||
+	    (params->post_urlenc != NULL) ||
+	    (params->post_multipart != NULL) ||
+	    (html_get_frameset(content) != NULL) ||
+	    (html_get_iframe(content) != NULL) ||
+	    html_get_scripting(content)) {
+		return false;
+	}
+
+	if (page_cache_metric_pages == NULL) {
+		nsmetric_register("page_cache.pages",
+				  NSMETRIC_GAUGE,
+				  &page_cache_metric_pages);
+		nsmetric_register("page_cache.hits",
+				  NSMETRIC_COUNTER,
+				  &page_cache_metric_hits);
+	}
+
+	pce = calloc(1, sizeof(*pce));
+	if (pce == NULL) {
+		return false;
+	}
+
+	if (hlcache_handle_replace_callback(content,
+					    page_cache_callback,
+					    pce) != NSERROR_OK) {
+		free(pce);
+		return false;
+	}
+
+	pce->bw = bw;
+	pce->entry = entry;
+	pce->content = content;
+	pce->params = *params;
+	memset(params, 0, sizeof(*params));
+	pce->chain = chain;
+	nsu_getmonotonic_ms(&pce->stored);
+
+	pce->prev = page_cache_tail;
+	if (page_cache_tail == NULL) {
+		page_cache_head = pce;
+	} else {
+		page_cache_tail->next = pce;
+	}
+	page_cache_tail = pce;
+	page_cache_count++;
+
+	NSLOG(netsurf, DEBUG, "Cached page %s",
+	      nsurl_access(hlcache_handle_get_url(content)));
+
+	page_cache_trim(limit);
+
+	nsmetric_set(page_cache_metric_pages, page_cache_count);
+
+	return true;
+}
+
+
+/* exported interface documented in desktop/page_cache.h */
+struct hlcache_handle *
+page_cache_take(struct browser_window *bw,
+		struct history_entry *entry,
+		struct browser_fetch_parameters *params,
+		struct cert_chain **chain)
+{
+	struct page_cache_entry *pce;
+	struct hlcache_handle *content;
+
+	page_cache_trim(nsoption_uint(page_cache_pages));
+
+	for (pce = page_cache_head; pce != NULL; pce = pce->next) {
+		if ((pce->bw == bw) && (pce->entry == entry)) {
+			break;
+		}
+	}
+
+	if (pce == NULL) {
+		return NULL;
+	}
+
+	if (pce->failed) {
+		page_cache_evict(pce);
+		return NULL;
+	}
+
+	content = pce->content;
+	*params = pce->params;
+	*chain = pce->chain;
+
+	page_cache_unlink(pce);
+
+	nsmetric_add(page_cache_metric_hits, 1);
+
+	return content;
+}
+
+
+/* exported interface documented in desktop/page_cache.h */
+void page_cache_discard(struct browser_window *bw)
+{
+	struct page_cache_entry *pce;
+	struct page_cache_entry *next;
+
+	for (pce = page_cache_head; pce != NULL; pce = next) {
+		next = pce->next;
+		if (pce->bw == bw) {
+			page_cache_evict(pce);
+		}
+	}
+}
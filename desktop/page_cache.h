@@ -0,0 +1,75 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Back/forward page cache interface.
+ *
+ * Documents navigated away from are kept fully constructed, closed and
+ * detached from their browser window, so returning to their history
+ * entry can reopen them without fetching, parsing or styling again.
+ */
+
+#ifndef NETSURF_DESKTOP_PAGE_CACHE_H
+#define NETSURF_DESKTOP_PAGE_CACHE_H
+
+#include <stdbool.h>
+
+struct browser_window;
+struct history_entry;
+struct hlcache_handle;
+struct browser_fetch_parameters;
+struct cert_chain;
+
+/**
+ * Store a closed document in the page cache.
+ *
+ * Only completely loaded HTML documents without frames, iframes or
+ * running scripts are stored. The least recently stored documents are
+ * discarded to keep within the page_cache_pages option.
+ *
+ * \param bw The browser window the document was shown in.
+ * \param entry The history entry the document was shown for.
+ * \param content The closed document.
+ * \param params The fetch parameters of the document.
+ * \param chain The certificate chain of the document or NULL.
+ * \return true if the document was stored and ownership of \a content,
+ *         \a params and \a chain taken, false if the caller retains them.
+ */
+bool page_cache_store(struct browser_window *bw, struct history_entry *entry, struct hlcache_handle *content, struct browser_fetch_parameters *params, struct cert_chain *chain);
+
+/**
+ * Remove a document from the page cache.
+ *
+ * \param bw The browser window to show the document in.
+ * \param entry The history entry being navigated to.
+ * \param params Updated with the fetch parameters of the document.
+ * \param chain Updated with the certificate chain of the document.
+ * \return The closed document, whose handle callback must be replaced
+ *         by the caller, or NULL if there is none.
+ */
+struct hlcache_handle *page_cache_take(struct browser_window *bw, struct history_entry *entry, struct browser_fetch_parameters *params, struct cert_chain **chain);
+
+/**
+ * Discard every document cached for a browser window.
+ *
+ * \param bw The browser window.
+ */
+void page_cache_discard(struct browser_window *bw);
+
+#endif
@@ -0,0 +1,623 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Framebuffer span blending kernel implementations.
+ *
+ * Blending uses the same arithmetic as libnsfb, each channel becomes
+ * (src * a + dst * (256 - a)) >> 8, except that fully opaque pixels
+ * use an alpha of 256 so they are copied exactly. All intermediate
+ * values fit in sixteen bits which allows eight channels to be blended
+ * at once in a 128 bit vector.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "utils/log.h"
+
+#include "framebuffer/blend.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLEND_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BLEND_NEON 1
+#include <arm_neon.h>
+#endif
+
+/**
+ * convert a libnsfb colour to a screen pixel
+ */
+static inline uint32_t blend_swizzle(uint32_t c)
+{
+	return ((c & 0xff) << 16) | (c & 0xff00) | ((c >> 16) & 0xff);
+}
+
+/**
+ * blend a screen pixel over another
+ *
+ * \param s The source pixel as a screen pixel
+ * \param d The destination screen pixel
+ * \param a The source alpha, neither 0 or 255
+ * \return The blended screen pixel
+ */
+static inline uint32_t blend_pixel(uint32_t s, uint32_t d, uint32_t a)
+{
+	uint32_t t = 256 - a;
+	uint32_t rb, g;
+
+	rb = ((s & 0xff00ff) * a + (d & 0xff00ff) * t) >> 8;
+	g = ((s & 0xff00) * a + (d & 0xff00) * t) >> 8;
+
+	return (rb & 0xff00ff) | (g & 0xff00);
+}
+
+
+/* portable implementation */
+
+static void scalar_over(uint32_t *dst, const uint32_t *src, int n)
+{
+	uint32_t a;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		a = src[i] >> 24;
+		if (a == 0xff) {
+			dst[i] = blend_swizzle(src[i]);
+		} else if (a != 0) {
+			dst[i] = blend_pixel(blend_swizzle(src[i]), dst[i], a);
+		}
+	}
+}
+
+static void scalar_copy(uint32_t *dst, const uint32_t *src, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		dst[i] = blend_swizzle(src[i]);
+	}
+}
+
+static void
+scalar_glyph(uint32_t *dst, const uint8_t *mask, int n, uint32_t colour)
+{
+	uint32_t s = blend_swizzle(colour);
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (mask[i] == 0xff) {
+			dst[i] = s;
+		} else if (mask[i] != 0) {
+			dst[i] = blend_pixel(s, dst[i], mask[i]);
+		}
+	}
+}
+
+static void
+scalar_scale(uint32_t *dst, const uint32_t *src, int n, uint32_t x, uint32_t step)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		dst[i] = src[x >> 16];
+		x += step;
+	}
+}
+
+static const struct fb_blend_table blend_scalar = {
+	.name = "scalar",
+	.over = scalar_over,
+	.copy = scalar_copy,
+	.glyph = scalar_glyph,
+	.scale = scalar_scale,
+};
+
+
+#ifdef BLEND_X86
+
+/* SSE2 implementation, four pixels at a time */
+
+#define SSE2 __attribute__((target("sse2")))
+
+/**
+ * blend sixteen bit channels
+ *
+ * \param s The source channels
+ * \param d The destination channels
+ * \param a The alpha of each channel
+ */
+static inline SSE2 __m128i sse2_blend(__m128i s, __m128i d, __m128i a)
+{
+	__m128i t;
+
+	/* opaque pixels use an alpha of 256 */
+	a = _mm_sub_epi16(a, _mm_cmpeq_epi16(a, _mm_set1_epi16(0xff)));
+	t = _mm_sub_epi16(_mm_set1_epi16(0x100), a);
+
+	return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a),
+					    _mm_mullo_epi16(d, t)), 8);
+}
+
+/**
+ * swap the red and blue channels of four pixels
+ */
+static inline SSE2 __m128i sse2_swizzle(__m128i s)
+{
+	return _mm_or_si128(_mm_or_si128(
+		_mm_and_si128(_mm_slli_epi32(s, 16), _mm_set1_epi32(0xff0000)),
+		_mm_and_si128(s, _mm_set1_epi32(0xff00))),
+		_mm_and_si128(_mm_srli_epi32(s, 16), _mm_set1_epi32(0xff)));
+}
+
+static SSE2 void sse2_over(uint32_t *dst, const uint32_t *src, int n)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i amask = _mm_set1_epi32(0xff000000);
+	__m128i s, d, sa, lo, hi;
+	int alpha;
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		s = _mm_loadu_si128((const __m128i *)(src + i));
+
+		sa = _mm_cmpeq_epi32(_mm_and_si128(s, amask), zero);
+		alpha = _mm_movemask_epi8(sa);
+		if (alpha == 0xffff) {
+			/* all transparent */
+			continue;
+		}
+
+		sa = _mm_cmpeq_epi32(_mm_and_si128(s, amask), amask);
+		if (_mm_movemask_epi8(sa) == 0xffff) {
+			/* all opaque */
+			_mm_storeu_si128((__m128i *)(dst + i), sse2_swizzle(s));
+			continue;
+		}
+
+		d = _mm_loadu_si128((const __m128i *)(dst + i));
+
+		lo = _mm_unpacklo_epi8(s, zero);
+		hi = _mm_unpackhi_epi8(s, zero);
+
+		lo = sse2_blend(
+			_mm_shufflehi_epi16(_mm_shufflelo_epi16(lo,
+				_MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2)),
+			_mm_unpacklo_epi8(d, zero),
+			_mm_shufflehi_epi16(_mm_shufflelo_epi16(lo,
+				_MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)));
+		hi = sse2_blend(
+			_mm_shufflehi_epi16(_mm_shufflelo_epi16(hi,
+				_MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2)),
+			_mm_unpackhi_epi8(d, zero),
+			_mm_shufflehi_epi16(_mm_shufflelo_epi16(hi,
+				_MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)));
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+
+	scalar_over(dst + i, src + i, n - i);
+}
+
+static SSE2 void sse2_copy(uint32_t *dst, const uint32_t *src, int n)
+{
+	__m128i s;
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		s = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dst + i), sse2_swizzle(s));
+	}
+
+	scalar_copy(dst + i, src + i, n - i);
+}
+
+static SSE2 void
+sse2_glyph(uint32_t *dst, const uint8_t *mask, int n, uint32_t colour)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i c, d, m, lo, hi;
+	uint32_t m4;
+	int i;
+
+	c = _mm_unpacklo_epi8(_mm_set1_epi32(blend_swizzle(colour)), zero);
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		memcpy(&m4, mask + i, sizeof(m4));
+		if (m4 == 0) {
+			continue;
+		}
+
+		/* spread each coverage value across its pixel's channels */
+		m = _mm_unpacklo_epi8(_mm_cvtsi32_si128(m4), zero);
+		m = _mm_unpacklo_epi16(m, m);
+
+		d = _mm_loadu_si128((const __m128i *)(dst + i));
+
+		lo = sse2_blend(c, _mm_unpacklo_epi8(d, zero),
+				_mm_unpacklo_epi32(m, m));
+		hi = sse2_blend(c, _mm_unpackhi_epi8(d, zero),
+				_mm_unpackhi_epi32(m, m));
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+	}
+
+	scalar_glyph(dst + i, mask + i, n - i, colour);
+}
+
+static const struct fb_blend_table blend_sse2 = {
+	.name = "sse2",
+	.over = sse2_over,
+	.copy = sse2_copy,
+	.glyph = sse2_glyph,
+	.scale = scalar_scale,
+};
+
+
+/* AVX2 implementation, eight pixels at a time */
+
+#define AVX2 __attribute__((target("avx2")))
+
+/**
+ * blend sixteen bit channels
+ *
+ * \param s The source channels
+ * \param d The destination channels
+ * \param a The alpha of each channel
+ */
+static inline AVX2 __m256i avx2_blend(__m256i s, __m256i d, __m256i a)
+{
+	__m256i t;
+
+	/* opaque pixels use an alpha of 256 */
+	a = _mm256_sub_epi16(a, _mm256_cmpeq_epi16(a, _mm256_set1_epi16(0xff)));
+	t = _mm256_sub_epi16(_mm256_set1_epi16(0x100), a);
+
+	return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(s, a),
+						  _mm256_mullo_epi16(d, t)), 8);
+}
+
+/**
+ * swap the red and blue channels of eight pixels
+ */
+static inline AVX2 __m256i avx2_swizzle(__m256i s)
+{
+	return _mm256_or_si256(_mm256_or_si256(
+		_mm256_and_si256(_mm256_slli_epi32(s, 16),
+				 _mm256_set1_epi32(0xff0000)),
+		_mm256_and_si256(s, _mm256_set1_epi32(0xff00))),
+		_mm256_and_si256(_mm256_srli_epi32(s, 16),
+				 _mm256_set1_epi32(0xff)));
+}
+
+static AVX2 void avx2_over(uint32_t *dst, const uint32_t *src, int n)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i amask = _mm256_set1_epi32(0xff000000);
+	__m256i s, d, sa, lo, hi;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		s = _mm256_loadu_si256((const __m256i *)(src + i));
+
+		sa = _mm256_cmpeq_epi32(_mm256_and_si256(s, amask), zero);
+		if (_mm256_movemask_epi8(sa) == -1) {
+			/* all transparent */
+			continue;
+		}
+
+		sa = _mm256_cmpeq_epi32(_mm256_and_si256(s, amask), amask);
+		if (_mm256_movemask_epi8(sa) == -1) {
+			/* all opaque */
+			_mm256_storeu_si256((__m256i *)(dst + i),
+					    avx2_swizzle(s));
+			continue;
+		}
+
+		d = _mm256_loadu_si256((const __m256i *)(dst + i));
+
+		lo = _mm256_unpacklo_epi8(s, zero);
+		hi = _mm256_unpackhi_epi8(s, zero);
+
+		lo = avx2_blend(
+			_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo,
+				_MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2)),
+			_mm256_unpacklo_epi8(d, zero),
+			_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo,
+				_MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)));
+		hi = avx2_blend(
+			_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi,
+				_MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2)),
+			_mm256_unpackhi_epi8(d, zero),
+			_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi,
+				_MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)));
+
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_packus_epi16(lo, hi));
+	}
+
+	scalar_over(dst + i, src + i, n - i);
+}
+
+static AVX2 void avx2_copy(uint32_t *dst, const uint32_t *src, int n)
+{
+	__m256i s;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		s = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dst + i), avx2_swizzle(s));
+	}
+
+	scalar_copy(dst + i, src + i, n - i);
+}
+
+static AVX2 void
+avx2_glyph(uint32_t *dst, const uint8_t *mask, int n, uint32_t colour)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i c, d, m, lo, hi;
+	uint64_t m8;
+	int i;
+
+	c = _mm256_unpacklo_epi8(_mm256_set1_epi32(blend_swizzle(colour)),
+				 zero);
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		memcpy(&m8, mask + i, sizeof(m8));
+		if (m8 == 0) {
+			continue;
+		}
+
+		/* spread each coverage value across its pixel's channels */
+		m = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(mask + i)));
+		m = _mm256_or_si256(m, _mm256_slli_epi32(m, 16));
+
+		d = _mm256_loadu_si256((const __m256i *)(dst + i));
+
+		lo = avx2_blend(c, _mm256_unpacklo_epi8(d, zero),
+				_mm256_unpacklo_epi32(m, m));
+		hi = avx2_blend(c, _mm256_unpackhi_epi8(d, zero),
+				_mm256_unpackhi_epi32(m, m));
+
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_packus_epi16(lo, hi));
+	}
+
+	scalar_glyph(dst + i, mask + i, n - i, colour);
+}
+
+static AVX2 void
+avx2_scale(uint32_t *dst, const uint32_t *src, int n, uint32_t x, uint32_t step)
+{
+	const __m256i steps = _mm256_mullo_epi32(_mm256_set1_epi32(step),
+			_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	__m256i idx;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		idx = _mm256_add_epi32(_mm256_set1_epi32(x), steps);
+		idx = _mm256_srli_epi32(idx, 16);
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_i32gather_epi32((const int *)src, idx, 4));
+		x += step * 8;
+	}
+
+	scalar_scale(dst + i, src, n - i, x, step);
+}
+
+static const struct fb_blend_table blend_avx2 = {
+	.name = "avx2",
+	.over = avx2_over,
+	.copy = avx2_copy,
+	.glyph = avx2_glyph,
+	.scale = avx2_scale,
+};
+
+#endif
+
+
+#ifdef BLEND_NEON
+
+/* NEON implementation, eight pixels at a time */
+
+/**
+ * blend eight channels
+ *
+ * \param s The source channels
+ * \param d The destination channels
+ * \param a The alpha of each channel, 256 for opaque
+ * \param t The inverse alpha of each channel
+ */
+static inline uint8x8_t
+neon_blend(uint8x8_t s, uint8x8_t d, uint16x8_t a, uint16x8_t t)
+{
+	return vshrn_n_u16(vmlaq_u16(vmulq_u16(vmovl_u8(s), a),
+				     vmovl_u8(d), t), 8);
+}
+
+/**
+ * widen eight alpha values, opaque pixels use an alpha of 256
+ */
+static inline uint16x8_t neon_alpha(uint8x8_t a8)
+{
+	uint16x8_t a = vmovl_u8(a8);
+
+	return vsubq_u16(a, vceqq_u16(a, vdupq_n_u16(0xff)));
+}
+
+static void neon_over(uint32_t *dst, const uint32_t *src, int n)
+{
+	uint8x8x4_t s, d;
+	uint16x8_t a, t;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		/* source channels are r, g, b, a and screen b, g, r, x */
+		s = vld4_u8((const uint8_t *)(src + i));
+		d = vld4_u8((const uint8_t *)(dst + i));
+
+		a = neon_alpha(s.val[3]);
+		t = vsubq_u16(vdupq_n_u16(0x100), a);
+
+		d.val[0] = neon_blend(s.val[2], d.val[0], a, t);
+		d.val[1] = neon_blend(s.val[1], d.val[1], a, t);
+		d.val[2] = neon_blend(s.val[0], d.val[2], a, t);
+		d.val[3] = vdup_n_u8(0);
+
+		vst4_u8((uint8_t *)(dst + i), d);
+	}
+
+	scalar_over(dst + i, src + i, n - i);
+}
+
+static void neon_copy(uint32_t *dst, const uint32_t *src, int n)
+{
+	uint8x8x4_t s, d;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		s = vld4_u8((const uint8_t *)(src + i));
+
+		d.val[0] = s.val[2];
+		d.val[1] = s.val[1];
+		d.val[2] = s.val[0];
+		d.val[3] = vdup_n_u8(0);
+
+		vst4_u8((uint8_t *)(dst + i), d);
+	}
+
+	scalar_copy(dst + i, src + i, n - i);
+}
+
+static void
+neon_glyph(uint32_t *dst, const uint8_t *mask, int n, uint32_t colour)
+{
+	uint8x8_t r = vdup_n_u8(colour & 0xff);
+	uint8x8_t g = vdup_n_u8((colour >> 8) & 0xff);
+	uint8x8_t b = vdup_n_u8((colour >> 16) & 0xff);
+	uint8x8x4_t d;
+	uint16x8_t a, t;
+	uint64_t m8;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		memcpy(&m8, mask + i, sizeof(m8));
+		if (m8 == 0) {
+			continue;
+		}
+
+		d = vld4_u8((const uint8_t *)(dst + i));
+
+		a = neon_alpha(vld1_u8(mask + i));
+		t = vsubq_u16(vdupq_n_u16(0x100), a);
+
+		d.val[0] = neon_blend(b, d.val[0], a, t);
+		d.val[1] = neon_blend(g, d.val[1], a, t);
+		d.val[2] = neon_blend(r, d.val[2], a, t);
+		d.val[3] = vdup_n_u8(0);
+
+		vst4_u8((uint8_t *)(dst + i), d);
+	}
+
+	scalar_glyph(dst + i, mask + i, n - i, colour);
+}
+
+static const struct fb_blend_table blend_neon = {
+	.name = "neon",
+	.over = neon_over,
+	.copy = neon_copy,
+	.glyph = neon_glyph,
+	.scale = scalar_scale,
+};
+
+#endif
+
+
+/** available implementations, slowest first */
+static const struct fb_blend_table *blend_tables[] = {
+	&blend_scalar,
+#ifdef BLEND_X86
+	&blend_sse2,
+	&blend_avx2,
+#endif
+#ifdef BLEND_NEON
+	&blend_neon,
+#endif
+};
+
+/* exported interface documented in framebuffer/blend.h */
+const struct fb_blend_table *fb_blend = &blend_scalar;
+
+
+/**
+ * determine if the processor supports an implementation
+ */
+static bool blend_supported(const struct fb_blend_table *table)
+{
+#ifdef BLEND_X86
+	__builtin_cpu_init();
+
+	if (table == &blend_sse2) {
+		return __builtin_cpu_supports("sse2");
+	}
+	if (table == &blend_avx2) {
+		return __builtin_cpu_supports("avx2");
+	}
+#endif
+	/* NEON is only built where the compiler targets it */
+	return true;
+}
+
+
+/* exported interface documented in framebuffer/blend.h */
+const struct fb_blend_table *fb_blend_get(unsigned int idx)
+{
+	unsigned int tidx;
+
+	for (tidx = 0;
+	     tidx < sizeof(blend_tables) / sizeof(blend_tables[0]);
+	     tidx++) {
+		if (blend_supported(blend_tables[tidx])) {
+			if (idx == 0) {
+				return blend_tables[tidx];
+			}
+			idx--;
+		}
+	}
+
+	return NULL;
+}
+
+
+/* exported interface documented in framebuffer/blend.h */
+void fb_blend_init(void)
+{
+	const struct fb_blend_table *table;
+	unsigned int idx = 0;
+
+	while ((table = fb_blend_get(idx++)) != NULL) {
+		fb_blend = table;
+	}
+
+	NSLOG(netsurf, INFO, "Using %s blending kernels", fb_blend->name);
+}
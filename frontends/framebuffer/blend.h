@@ -0,0 +1,110 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Framebuffer span blending kernels.
+ *
+ * The kernels operate on spans of pixels plotted directly into a 32bpp
+ * XRGB8888 screen. Sources are in the libnsfb colour layout (ABGR8888,
+ * 0xAABBGGRR) used by framebuffer bitmaps. The colour channels written
+ * by every kernel match the per pixel blending of the libnsfb plotters,
+ * the unused top byte of the screen pixels is not preserved.
+ *
+ * Several implementations exist, the fastest one the processor supports
+ * is selected at run time by fb_blend_init().
+ */
+
+#ifndef NETSURF_FB_BLEND_H
+#define NETSURF_FB_BLEND_H
+
+#include <stdint.h>
+
+/**
+ * Blending kernel implementation
+ */
+struct fb_blend_table {
+	/** name of the implementation */
+	const char *name;
+
+	/**
+	 * Blend a span of source pixels over the screen.
+	 *
+	 * \param dst The screen pixels to blend into
+	 * \param src The ABGR8888 source pixels
+	 * \param n The number of pixels in the span
+	 */
+	void (*over)(uint32_t *dst, const uint32_t *src, int n);
+
+	/**
+	 * Copy a span of opaque source pixels to the screen.
+	 *
+	 * \param dst The screen pixels to write
+	 * \param src The source pixels, the alpha channel is ignored
+	 * \param n The number of pixels in the span
+	 */
+	void (*copy)(uint32_t *dst, const uint32_t *src, int n);
+
+	/**
+	 * Blend a colour over the screen through an 8 bit coverage mask.
+	 *
+	 * \param dst The screen pixels to blend into
+	 * \param mask The coverage of each pixel
+	 * \param n The number of pixels in the span
+	 * \param colour The ABGR8888 colour, the alpha channel is ignored
+	 */
+	void (*glyph)(uint32_t *dst, const uint8_t *mask, int n, uint32_t colour);
+
+	/**
+	 * Gather a span of source pixels with nearest neighbour scaling.
+	 *
+	 * \param dst The span to fill
+	 * \param src The source row
+	 * \param n The number of pixels in the span
+	 * \param x The 16.16 fixed point source position of the first pixel
+	 * \param step The 16.16 fixed point source step per pixel
+	 */
+	void (*scale)(uint32_t *dst, const uint32_t *src, int n, uint32_t x, uint32_t step);
+};
+
+/**
+ * The selected blending kernels.
+ *
+ * Always valid, the portable implementation is used until fb_blend_init()
+ * is called.
+ */
+extern const struct fb_blend_table *fb_blend;
+
+/**
+ * Select the fastest blending kernels the processor supports.
+ */
+void fb_blend_init(void);
+
+/**
+ * Get a blending implementation.
+ *
+ * Allows the implementations to be tested and compared against each
+ * other. Index zero is always the portable implementation.
+ *
+ * \param idx The index of the implementation
+ * \return The implementation or NULL if there are no more the processor
+ *         supports.
+ */
+const struct fb_blend_table *fb_blend_get(unsigned int idx);
+
+#endif
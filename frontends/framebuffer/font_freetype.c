@@ -27,6 +27,7 @@
 #include "utils/utf8.h"
 #include "utils/log.h"
 #include "utils/nsoption.h"
+#include "utils/metrics.h"
 #include "netsurf/utf8.h"
 #include "netsurf/layout.h"
 #include "netsurf/browser.h"
@@ -39,6 +40,12 @@
 /* glyph cache minimum size */
 #define CACHE_MIN_SIZE (100 * 1024)
 
+/* number of text run cache hash buckets, must be a power of two */
+#define RUN_CACHE_BUCKETS 512
+
+/* longest string, in bytes, which is held in the text run cache */
+#define RUN_CACHE_MAX_LENGTH 256
+
 #define BOLD_WEIGHT 700
 
 static FT_Library library; 
@@ -48,6 +55,45 @@ static FTC_ImageCache ft_image_cache;
 
 int ft_load_type;
 
+/**
+ * text run cache entry
+ */
+struct fb_run_entry {
+	struct fb_run_entry *hash_next; /**< next entry in hash bucket */
+	struct fb_run_entry *prev; /**< previous (more recent) entry in LRU */
+	struct fb_run_entry *next; /**< next (less recent) entry in LRU */
+
+	uint32_t hash; /**< hash of key */
+	FTC_FaceID face_id; /**< face the run was rendered in */
+	FT_UInt size; /**< scaled size the run was rendered at */
+	FT_UInt res; /**< resolution the run was rendered at */
+	size_t length; /**< length of string */
+	char *string; /**< string the run was rendered from */
+
+	size_t bytes; /**< memory used by the entry */
+
+	struct fb_font_run run; /**< the rendered run */
+};
+
+/**
+ * text run cache
+ */
+static struct fb_run_cache {
+	struct fb_run_entry *buckets[RUN_CACHE_BUCKETS]; /**< hash table */
+	struct fb_run_entry *head; /**< most recently used entry */
+	struct fb_run_entry *tail; /**< least recently used entry */
+	size_t budget; /**< maximum bytes to hold, 0 disables cache */
+	size_t bytes; /**< bytes currently held */
+
+	unsigned int hits; /**< lookups satisfied from the cache */
+	unsigned int misses; /**< lookups which rendered a run */
+	unsigned int evictions; /**< entries evicted to meet budget */
+
+	struct nsmetric *metric_hit; /**< hit count metric */
+	struct nsmetric *metric_miss; /**< miss count metric */
+	struct nsmetric *metric_size; /**< bytes held metric */
+} run_cache;
+
 /* cache manager faceID data to create freetype faceid on demand */
 typedef struct fb_faceid_s {
         char *fontfile; /* path to font */
@@ -303,6 +349,15 @@ bool fb_font_init(void)
 	}
 
         
+	/* text run cache */
+	run_cache.budget = nsoption_int(fb_font_runcache) * 1024;
+	nsmetric_register("fb.textrun.hit", NSMETRIC_COUNTER,
+			  &run_cache.metric_hit);
+	nsmetric_register("fb.textrun.miss", NSMETRIC_COUNTER,
+			  &run_cache.metric_miss);
+	nsmetric_register("fb.textrun.size", NSMETRIC_GAUGE,
+			  &run_cache.metric_size);
+
         /* set the default render mode */
         if (nsoption_bool(fb_font_monochrome) == true)
                 ft_load_type = FT_LOAD_MONOCHROME; /* faster but less pretty */
@@ -312,11 +367,48 @@ bool fb_font_init(void)
         return true;
 }
 
+/**
+ * remove an entry from the text run cache and free it
+ */
+static void fb_run_cache_remove(struct fb_run_entry *entry)
+{
+	struct fb_run_entry **link;
+
+	link = &run_cache.buckets[entry->hash & (RUN_CACHE_BUCKETS - 1)];
+	while (*link != entry) {
+		link = &(*link)->hash_next;
+	}
+	*link = entry->hash_next;
+
+	if (entry->prev != NULL) {
+		entry->prev->next = entry->next;
+	} else {
+		run_cache.head = entry->next;
+	}
+	if (entry->next != NULL) {
+		entry->next->prev = entry->prev;
+	} else {
+		run_cache.tail = entry->prev;
+	}
+
+	run_cache.bytes -= entry->bytes;
+
+	free(entry);
+}
+
 /* exported interface documented in framebuffer/font.h */
 bool fb_font_finalise(void)
 {
 	int i, j;
 
+	NSLOG(netsurf, INFO,
+	      "Text run cache hits %u misses %u evictions %u",
+	      run_cache.hits, run_cache.misses, run_cache.evictions);
+
+	while (run_cache.head != NULL) {
+		fb_run_cache_remove(run_cache.head);
+	}
+
         FTC_Manager_Done(ft_cmanager);
         FT_Done_FreeType(library);
 
@@ -429,6 +521,263 @@ FT_Glyph fb_getglyph(const plot_font_style_t *fstyle, uint32_t ucs4)
 }
 
 
+/**
+ * hash a text run cache key
+ */
+static uint32_t
+fb_run_hash(const FTC_ScalerRec *srec, const char *string, size_t length)
+{
+	uint32_t hash = 0x811c9dc5;
+	uintptr_t face = (uintptr_t)srec->face_id;
+	size_t idx;
+
+	hash = (hash ^ (uint32_t)face) * 0x01000193;
+	hash = (hash ^ srec->width) * 0x01000193;
+	hash = (hash ^ srec->x_res) * 0x01000193;
+
+	for (idx = 0; idx < length; idx++) {
+		hash ^= (uint8_t)string[idx];
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
+
+/**
+ * composite a glyph bitmap into a run mask
+ *
+ * Overlapping glyphs are combined as if each had been plotted in turn.
+ *
+ * \param run The run to composite into
+ * \param bglyph The glyph to composite
+ * \param x The offset of the glyph pen position within the mask
+ */
+static void
+fb_run_composite(struct fb_font_run *run, FT_BitmapGlyph bglyph, int x)
+{
+	uint8_t *mask = (uint8_t *)run->mask;
+	const uint8_t *row;
+	uint8_t *dst;
+	int width = bglyph->bitmap.width;
+	int rows = bglyph->bitmap.rows;
+	int gx, gy;
+	int a, b;
+
+	x += bglyph->left - run->x;
+
+	for (gy = 0; gy < rows; gy++) {
+		row = bglyph->bitmap.buffer + gy * bglyph->bitmap.pitch;
+		dst = mask + (gy - bglyph->top - run->y) * run->width + x;
+
+		for (gx = 0; gx < width; gx++) {
+			if (bglyph->bitmap.pixel_mode == FT_PIXEL_MODE_MONO) {
+				a = ((row[gx >> 3] >> (7 - (gx & 7))) & 1) ?
+					0xff : 0;
+			} else {
+				a = row[gx];
+			}
+			b = dst[gx];
+			dst[gx] = a + b - (a * b + 127) / 255;
+		}
+	}
+}
+
+
+/**
+ * render a text run into a new cache entry
+ *
+ * \param fstyle plot style for this text
+ * \param srec The scaler for the style
+ * \param string UTF-8 string to render
+ * \param length length of string, in bytes
+ * \return The new entry or NULL on memory exhaustion
+ */
+static struct fb_run_entry *
+fb_run_render(const plot_font_style_t *fstyle,
+	      const FTC_ScalerRec *srec,
+	      const char *string,
+	      size_t length)
+{
+	struct fb_run_entry *entry;
+	FT_BitmapGlyph bglyph;
+	FT_Glyph glyph;
+	uint32_t ucs4;
+	size_t nxtchr;
+	size_t mask_size;
+	int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+	int pen;
+
+	/* find the bounding box of the run relative to the pen origin */
+	pen = 0;
+	nxtchr = 0;
+	while (nxtchr < length) {
+		ucs4 = utf8_to_ucs4(string + nxtchr, length - nxtchr);
+		nxtchr = utf8_next(string, length, nxtchr);
+
+		glyph = fb_getglyph(fstyle, ucs4);
+		if (glyph == NULL)
+			continue;
+
+		if (glyph->format == FT_GLYPH_FORMAT_BITMAP) {
+			bglyph = (FT_BitmapGlyph)glyph;
+
+			if (bglyph->bitmap.width > 0 &&
+			    bglyph->bitmap.rows > 0) {
+				int gx0 = pen + bglyph->left;
+				int gy0 = -bglyph->top;
+				int gx1 = gx0 + bglyph->bitmap.width;
+				int gy1 = gy0 + bglyph->bitmap.rows;
+
+				if (x0 == x1) {
+					x0 = gx0; y0 = gy0;
+					x1 = gx1; y1 = gy1;
+				} else {
+					if (gx0 < x0) x0 = gx0;
+					if (gy0 < y0) y0 = gy0;
+					if (gx1 > x1) x1 = gx1;
+					if (gy1 > y1) y1 = gy1;
+				}
+			}
+		}
+		pen += glyph->advance.x >> 16;
+	}
+
+	mask_size = (size_t)(x1 - x0) * (y1 - y0);
+
+	entry = calloc(1, sizeof(*entry) + length + mask_size);
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	entry->face_id = srec->face_id;
+	entry->size = srec->width;
+	entry->res = srec->x_res;
+	entry->length = length;
+	entry->string = (char *)(entry + 1);
+	memcpy(entry->string, string, length);
+	entry->bytes = sizeof(*entry) + length + mask_size;
+
+	entry->run.x = x0;
+	entry->run.y = y0;
+	entry->run.width = x1 - x0;
+	entry->run.height = y1 - y0;
+	entry->run.mask = (uint8_t *)entry->string + length;
+
+	/* composite the glyphs; each is looked up again as the
+	 * freetype cache may have discarded it since measuring
+	 */
+	pen = 0;
+	nxtchr = 0;
+	while (nxtchr < length) {
+		ucs4 = utf8_to_ucs4(string + nxtchr, length - nxtchr);
+		nxtchr = utf8_next(string, length, nxtchr);
+
+		glyph = fb_getglyph(fstyle, ucs4);
+		if (glyph == NULL)
+			continue;
+
+		if (glyph->format == FT_GLYPH_FORMAT_BITMAP) {
+			fb_run_composite(&entry->run, (FT_BitmapGlyph)glyph, pen);
+		}
+		pen += glyph->advance.x >> 16;
+	}
+
+	return entry;
+}
+
+
+/* exported interface documented in framebuffer/freetype_font.h */
+const struct fb_font_run *
+fb_font_getrun(const plot_font_style_t *fstyle,
+	       const char *string,
+	       size_t length)
+{
+	struct fb_run_entry *entry;
+	struct fb_run_entry **bucket;
+	FTC_ScalerRec srec;
+	uint32_t hash;
+
+	if (run_cache.budget == 0 || length > RUN_CACHE_MAX_LENGTH) {
+		return NULL;
+	}
+
+	fb_fill_scalar(fstyle, &srec);
+
+	hash = fb_run_hash(&srec, string, length);
+	bucket = &run_cache.buckets[hash & (RUN_CACHE_BUCKETS - 1)];
+
+	for (entry = *bucket; entry != NULL; entry = entry->hash_next) {
+		if (entry->hash == hash &&
+		    entry->face_id == srec.face_id &&
+		    entry->size == srec.width &&
+		    entry->res == srec.x_res &&
+		    entry->length == length &&
+		    memcmp(entry->string, string, length) == 0) {
+			break;
+		}
+	}
+
+	if (entry != NULL) {
+		run_cache.hits++;
+		nsmetric_add(run_cache.metric_hit, 1);
+
+		/* move to head of LRU */
+		if (entry->prev != NULL) {
+			entry->prev->next = entry->next;
+			if (entry->next != NULL) {
+				entry->next->prev = entry->prev;
+			} else {
+				run_cache.tail = entry->prev;
+			}
+			entry->prev = NULL;
+			entry->next = run_cache.head;
+			run_cache.head->prev = entry;
+			run_cache.head = entry;
+		}
+
+		return &entry->run;
+	}
+
+	run_cache.misses++;
+	nsmetric_add(run_cache.metric_miss, 1);
+
+	entry = fb_run_render(fstyle, &srec, string, length);
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	/* runs which would dominate the cache are not worth keeping */
+	if (entry->bytes > run_cache.budget / 4) {
+		free(entry);
+		return NULL;
+	}
+
+	/* evict least recently used entries to make room */
+	while (run_cache.bytes + entry->bytes > run_cache.budget) {
+		run_cache.evictions++;
+		fb_run_cache_remove(run_cache.tail);
+	}
+
+	entry->hash = hash;
+	entry->hash_next = *bucket;
+	*bucket = entry;
+
+	entry->next = run_cache.head;
+	if (run_cache.head != NULL) {
+		run_cache.head->prev = entry;
+	} else {
+		run_cache.tail = entry;
+	}
+	run_cache.head = entry;
+
+	run_cache.bytes += entry->bytes;
+	nsmetric_set(run_cache.metric_size, run_cache.bytes);
+
+	return &entry->run;
+}
+
+
 /* exported interface documented in framebuffer/freetype_font.h */
 nserror
 fb_font_width(const plot_font_style_t *fstyle,
@@ -25,6 +25,31 @@
 
 extern int ft_load_type;
 
+/**
+ * A text run rendered as a single alpha mask
+ */
+struct fb_font_run {
+	int x; /**< offset of mask left edge from pen position */
+	int y; /**< offset of mask top edge from baseline */
+	int width; /**< width of mask, also its pitch */
+	int height; /**< height of mask */
+	const uint8_t *mask; /**< 8 bit alpha values */
+};
+
 FT_Glyph fb_getglyph(const plot_font_style_t *fstyle, uint32_t ucs4);
 
+/**
+ * Get a text run rendered as a single alpha mask.
+ *
+ * Rendered runs are held in a cache, bounded by the fb_font_runcache
+ * option, so redrawing the same text only costs a single plot.
+ *
+ * \param fstyle plot style for this text
+ * \param string UTF-8 string to render
+ * \param length length of string, in bytes
+ * \return The run, valid until the next call, or NULL if the run is
+ *         not cacheable and the glyphs must be plotted individually.
+ */
+const struct fb_font_run *fb_font_getrun(const plot_font_style_t *fstyle, const char *string, size_t length);
+
 #endif /* NETSURF_FB_FONT_FREETYPE_H */
@@ -40,6 +40,10 @@
 #include "framebuffer/framebuffer.h"
 #include "framebuffer/font.h"
 #include "framebuffer/bitmap.h"
+#include "framebuffer/blend.h"
+
+/** Bitmaps at least this wide overflow the 16.16 scale position */
+#define FRAMEBUFFER_SCALE_MAX 65536
 
 /* netsurf framebuffer library handle */
 static nsfb_t *nsfb;
@@ -276,6 +280,187 @@ framebuffer_plot_path(const struct redraw_context *ctx,
 }
 
 
+/**
+ * Get direct access to the screen for the blending kernels.
+ *
+ * \param[out] base Updated with the first screen pixel
+ * \param[out] stride Updated with the number of pixels in a screen row
+ * \param[out] clip Updated with the current clip rectangle
+ * \return true if the kernels may be used, false if the screen format
+ *         is not supported and the libnsfb plotters must be used.
+ */
+static bool
+framebuffer_direct(uint32_t **base, int *stride, nsfb_bbox_t *clip)
+{
+	enum nsfb_format_e format;
+	int width, height;
+	uint8_t *ptr;
+	int linelen;
+
+	nsfb_get_geometry(nsfb, &width, &height, &format);
+	if (format != NSFB_FMT_XRGB8888) {
+		return false;
+	}
+
+	if ((nsfb_get_buffer(nsfb, &ptr, &linelen) != 0) || (ptr == NULL)) {
+		return false;
+	}
+
+	nsfb_plot_get_clip(nsfb, clip);
+	if (clip->x0 < 0) clip->x0 = 0;
+	if (clip->y0 < 0) clip->y0 = 0;
+	if (clip->x1 > width) clip->x1 = width;
+	if (clip->y1 > height) clip->y1 = height;
+
+	*base = (uint32_t *)ptr;
+	*stride = linelen / 4;
+
+	return true;
+}
+
+
+/**
+ * Plot a bitmap tile directly to the screen.
+ *
+ * \param base The first screen pixel
+ * \param stride The number of pixels in a screen row
+ * \param clip The clip rectangle
+ * \param loc Where to plot the tile, the bitmap is scaled to fill it
+ * \param bm The bitmap to plot
+ * \param span Scratch span at least as wide as the clip rectangle
+ */
+static void
+framebuffer_direct_tile(uint32_t *base,
+			int stride,
+			const nsfb_bbox_t *clip,
+			const nsfb_bbox_t *loc,
+			nsfb_t *bm,
+			uint32_t *span)
+{
+	enum nsfb_format_e bmformat;
+	int bmwidth, bmheight;
+	int bmstride;
+	uint8_t *bmptr;
+	const uint32_t *row;
+	uint32_t *dst;
+	uint32_t step;
+	uint32_t xstart;
+	bool scaled;
+	int width = loc->x1 - loc->x0;
+	int height = loc->y1 - loc->y0;
+	int x0, y0, x1, y1;
+	int y;
+
+	x0 = (loc->x0 > clip->x0) ? loc->x0 : clip->x0;
+	y0 = (loc->y0 > clip->y0) ? loc->y0 : clip->y0;
+	x1 = (loc->x1 < clip->x1) ? loc->x1 : clip->x1;
+	y1 = (loc->y1 < clip->y1) ? loc->y1 : clip->y1;
+	if ((x0 >= x1) || (y0 >= y1)) {
+		return;
+	}
+
+	nsfb_get_geometry(bm, &bmwidth, &bmheight, &bmformat);
+	nsfb_get_buffer(bm, &bmptr, &bmstride);
+	bmstride /= 4;
+
+	/* 16.16 fixed point source position, the caller ensures the
+	 * bitmap width fits so the position cannot wrap
+	 */
+	scaled = (width != bmwidth) || (height != bmheight);
+	step = ((uint64_t)bmwidth << 16) / width;
+	xstart = (uint64_t)(x0 - loc->x0) * step;
+
+	for (y = y0; y < y1; y++) {
+		if (scaled) {
+			row = (const uint32_t *)bmptr +
+				(int)(((int64_t)(y - loc->y0) * bmheight) /
+				      height) * bmstride;
+			fb_blend->scale(span, row, x1 - x0, xstart, step);
+			row = span;
+		} else {
+			row = (const uint32_t *)bmptr +
+				(y - loc->y0) * bmstride + (x0 - loc->x0);
+		}
+
+		dst = base + y * stride + x0;
+		if (bmformat == NSFB_FMT_ABGR8888) {
+			fb_blend->over(dst, row, x1 - x0);
+		} else {
+			fb_blend->copy(dst, row, x1 - x0);
+		}
+	}
+}
+
+
+/**
+ * Plot a bitmap directly to the screen.
+ *
+ * \param bm The bitmap to plot
+ * \param loc The location of the first tile
+ * \param repeat_x Whether to tile across the clip rectangle
+ * \param repeat_y Whether to tile down the clip rectangle
+ * \return true if the bitmap was plotted, false if the libnsfb plotters
+ *         must be used.
+ */
+static bool
+framebuffer_direct_bitmap(nsfb_t *bm,
+			  nsfb_bbox_t *loc,
+			  bool repeat_x,
+			  bool repeat_y)
+{
+	nsfb_bbox_t clip;
+	nsfb_bbox_t tile;
+	uint32_t *base;
+	uint32_t *span;
+	int stride;
+	int width = loc->x1 - loc->x0;
+	int height = loc->y1 - loc->y0;
+	int bmwidth;
+
+	if ((width <= 0) || (height <= 0)) {
+		return true;
+	}
+
+	/* the scale kernels step in 16.16 fixed point */
+	nsfb_get_geometry(bm, &bmwidth, NULL, NULL);
+	if (bmwidth >= FRAMEBUFFER_SCALE_MAX) {
+		return false;
+	}
+
+	if (!framebuffer_direct(&base, &stride, &clip)) {
+		return false;
+	}
+
+	if ((clip.x0 >= clip.x1) || (clip.y0 >= clip.y1)) {
+		return true;
+	}
+
+	span = malloc((clip.x1 - clip.x0) * sizeof(*span));
+	if (span == NULL) {
+		return false;
+	}
+
+	for (tile.y0 = loc->y0; tile.y0 < clip.y1; tile.y0 += height) {
+		tile.y1 = tile.y0 + height;
+		for (tile.x0 = loc->x0; tile.x0 < clip.x1; tile.x0 += width) {
+			tile.x1 = tile.x0 + width;
+			framebuffer_direct_tile(base, stride, &clip, &tile,
+						bm, span);
+			if (!repeat_x) {
+				break;
+			}
+		}
+		if (!repeat_y) {
+			break;
+		}
+	}
+
+	free(span);
+
+	return true;
+}
+
+
 /**
  * Plot a bitmap
  *
@@ -333,6 +518,10 @@ framebuffer_plot_bitmap(const struct redraw_context *ctx,
 		loc.x1 = loc.x0 + width;
 		loc.y1 = loc.y0 + height;
 
+		if (framebuffer_direct_bitmap(bm, &loc, false, false)) {
+			return NSERROR_OK;
+		}
+
 		if (!nsfb_plot_copy(bm, NULL, nsfb, &loc)) {
 			return NSERROR_INVALID;
 		}
@@ -387,6 +576,10 @@ framebuffer_plot_bitmap(const struct redraw_context *ctx,
 	loc.y1 = loc.y0 + height;
 
 	/* plot tiling across and down to extents */
+	if (framebuffer_direct_bitmap(bm, &loc, repeat_x, repeat_y)) {
+		return NSERROR_OK;
+	}
+
 	nsfb_plot_bitmap_tiles(nsfb, &loc,
 			repeat_x ? ((clipbox.x1 - x) + width  - 1) / width  : 1,
 			repeat_y ? ((clipbox.y1 - y) + height - 1) / height : 1,
@@ -398,6 +591,48 @@ framebuffer_plot_bitmap(const struct redraw_context *ctx,
 
 
 #ifdef FB_USE_FREETYPE
+/**
+ * Plot an 8 bit coverage mask directly to the screen.
+ *
+ * \param loc Where to plot the mask
+ * \param mask The coverage values
+ * \param pitch The number of values in each row of the mask
+ * \param fg The colour to plot
+ * \return true if the mask was plotted, false if the libnsfb plotters
+ *         must be used.
+ */
+static bool
+framebuffer_direct_glyph(const nsfb_bbox_t *loc,
+			 const uint8_t *mask,
+			 int pitch,
+			 colour fg)
+{
+	nsfb_bbox_t clip;
+	uint32_t *base;
+	int stride;
+	int x0, y0, x1, y1;
+	int y;
+
+	if (!framebuffer_direct(&base, &stride, &clip)) {
+		return false;
+	}
+
+	x0 = (loc->x0 > clip.x0) ? loc->x0 : clip.x0;
+	y0 = (loc->y0 > clip.y0) ? loc->y0 : clip.y0;
+	x1 = (loc->x1 < clip.x1) ? loc->x1 : clip.x1;
+	y1 = (loc->y1 < clip.y1) ? loc->y1 : clip.y1;
+
+	for (y = y0; y < y1 && x0 < x1; y++) {
+		fb_blend->glyph(base + y * stride + x0,
+				mask + (y - loc->y0) * pitch + (x0 - loc->x0),
+				x1 - x0,
+				fg);
+	}
+
+	return true;
+}
+
+
 /**
  * Text plotting.
  *
@@ -417,12 +652,35 @@ framebuffer_plot_text(const struct redraw_context *ctx,
 		const char *text,
 		size_t length)
 {
+	const struct fb_font_run *run;
 	uint32_t ucs4;
 	size_t nxtchr = 0;
 	FT_Glyph glyph;
 	FT_BitmapGlyph bglyph;
 	nsfb_bbox_t loc;
 
+	run = fb_font_getrun(fstyle, text, length);
+	if (run != NULL) {
+		if (run->width > 0) {
+			loc.x0 = x + run->x;
+			loc.y0 = y + run->y;
+			loc.x1 = loc.x0 + run->width;
+			loc.y1 = loc.y0 + run->height;
+
+			if (!framebuffer_direct_glyph(&loc,
+						      run->mask,
+						      run->width,
+						      fstyle->foreground)) {
+				nsfb_plot_glyph8(nsfb,
+						 &loc,
+						 run->mask,
+						 run->width,
+						 fstyle->foreground);
+			}
+		}
+		return NSERROR_OK;
+	}
+
 	while (nxtchr < length) {
 		ucs4 = utf8_to_ucs4(text + nxtchr, length - nxtchr);
 		nxtchr = utf8_next(text, length, nxtchr);
@@ -605,6 +863,8 @@ framebuffer_initialise(const char *fename, int width, int height, int bpp)
 
     nsfb_cursor_init(nsfb);
 
+    fb_blend_init();
+
     if (nsfb_init(nsfb) == -1) {
 	NSLOG(netsurf, INFO, "Unable to initialise nsfb surface\n");
 	nsfb_free(nsfb);
@@ -48,6 +48,8 @@ NSOPTION_BOOL(fb_osk, false)
 NSOPTION_BOOL(fb_font_monochrome, false)
 /** size of font glyph cache in kilobytes. */
 NSOPTION_INTEGER(fb_font_cachesize, 2048)
+/** size of rendered text run cache in kilobytes, 0 to disable. */
+NSOPTION_INTEGER(fb_font_runcache, 1024)
 
 /* Font face paths. These are treated as absolute paths if they start
  * with a / otherwise the compile time resource path is searched. 
@@ -82,6 +82,9 @@ void urldb_delete_cookie(const char *domain, const char *path, const char *name)
 /**
  * Load a cookie file into the database
  *
+ * The file may be either a snapshot written by urldb_save_cookies() or
+ * a text cookie file written by urldb_export_cookies().
+ *
  * \param filename File to load
  */
 void urldb_load_cookies(const char *filename);
@@ -89,10 +92,20 @@ void urldb_load_cookies(const char *filename);
 /**
  * Save persistent cookies to file
  *
+ * The cookies are written as a binary snapshot which replaces any
+ * existing file once it has been completely written.
+ *
  * \param filename Path to save to
  */
 void urldb_save_cookies(const char *filename);
 
+/**
+ * Export persistent cookies to file in the text format
+ *
+ * \param filename Path to export to
+ */
+void urldb_export_cookies(const char *filename);
+
 
 
 #endif
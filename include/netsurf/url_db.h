@@ -44,19 +44,33 @@ struct url_data {
 /**
  * Import an URL database from file, replacing any existing database
  *
+ * The file may be either a snapshot written by urldb_save() or a text
+ * database written by urldb_export().
+ *
  * \param filename Name of file containing data
  */
 nserror urldb_load(const char *filename);
 
 
 /**
- * Export the current database to file
+ * Save the current database to file
  *
- * \param filename Name of file to export to
+ * The database is written as a binary snapshot which replaces any
+ * existing file once it has been completely written.
+ *
+ * \param filename Name of file to save to
  */
 nserror urldb_save(const char *filename);
 
 
+/**
+ * Export the current database to file in the text format
+ *
+ * \param filename Name of file to export to
+ */
+nserror urldb_export(const char *filename);
+
+
 /**
  * Iterate over entries in the database which match the given prefix
  *
@@ -0,0 +1,271 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Test shared image animation clock.
+ *
+ * The scheduler and time source are replaced so the tests run the clock
+ * tick themselves after moving time on for frames to fall due.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+#include "utils/errors.h"
+#include "utils/metrics.h"
+#include "netsurf/misc.h"
+#include "desktop/gui_internal.h"
+#include "image/animation.h"
+
+/** frame delay of the test animations (ms) */
+#define FRAME 50
+
+/** the scheduled clock callback */
+static void (*sched_cb)(void *p);
+/** the delay the clock was last scheduled with, negative if removed */
+static int sched_delay;
+
+static nserror test_schedule(int t, void (*callback)(void *p), void *p)
+{
+	sched_cb = callback;
+	sched_delay = t;
+	return NSERROR_OK;
+}
+
+static struct gui_misc_table test_misc = {
+	.schedule = test_schedule,
+};
+
+static struct netsurf_table test_table = {
+	.misc = &test_misc,
+};
+
+struct netsurf_table *guit = &test_table;
+
+/** test animation */
+struct test_anim {
+	struct image_animation anim;
+	unsigned int advanced; /**< frames advanced */
+	unsigned int redraws; /**< redraws requested */
+	unsigned int last_frames; /**< frames in last redraw */
+	unsigned int remaining; /**< frames left before stopping */
+};
+
+static struct test_anim anims[2];
+
+static unsigned int test_advance(struct content *c)
+{
+	struct test_anim *ta = (struct test_anim *)c;
+
+	ta->advanced++;
+	if (ta->remaining == 0) {
+		return FRAME;
+	}
+	return (--ta->remaining == 0) ? 0 : FRAME;
+}
+
+static bool test_redraw(struct content *c, unsigned int frames)
+{
+	struct test_anim *ta = (struct test_anim *)c;
+
+	ta->redraws++;
+	ta->last_frames = frames;
+	return true;
+}
+
+/** the time reported to the animation clock (ms) */
+static uint64_t test_now;
+
+static uint64_t test_clock(void)
+{
+	return test_now;
+}
+
+static void wait_ms(unsigned int ms)
+{
+	test_now += ms;
+}
+
+/** run the clock as the scheduler would */
+static void run_clock(void)
+{
+	ck_assert(sched_cb != NULL);
+	ck_assert(sched_delay >= 0);
+	sched_cb(NULL);
+}
+
+/* Fixtures */
+
+static void animation_setup(void)
+{
+	int idx;
+
+	memset(anims, 0, sizeof(anims));
+	sched_cb = NULL;
+	sched_delay = -1;
+	test_now = 1000;
+	image_animation_set_clock(test_clock);
+
+	for (idx = 0; idx < 2; idx++) {
+		image_animation_init(&anims[idx].anim,
+				     (struct content *)&anims[idx],
+				     test_advance, test_redraw);
+	}
+}
+
+static void animation_teardown(void)
+{
+	image_animation_stop(&anims[0].anim);
+	image_animation_stop(&anims[1].anim);
+	image_animation_set_clock(NULL);
+}
+
+/* Tests */
+
+/**
+ * animations falling due together are advanced by a single tick
+ */
+START_TEST(animation_coalesce_test)
+{
+	image_animation_start(&anims[0].anim, FRAME);
+	image_animation_start(&anims[1].anim, FRAME + 5);
+	ck_assert_int_le(sched_delay, FRAME);
+
+	wait_ms(FRAME);
+	run_clock();
+
+	ck_assert_int_eq(anims[0].advanced, 1);
+	ck_assert_int_eq(anims[1].advanced, 1);
+	ck_assert_int_eq(anims[0].redraws, 1);
+	ck_assert_int_eq(anims[1].redraws, 1);
+
+	/* both remain scheduled */
+	ck_assert_int_ge(sched_delay, 0);
+}
+END_TEST
+
+/**
+ * an animation which finishes is removed from the clock
+ */
+START_TEST(animation_finish_test)
+{
+	anims[0].remaining = 1;
+	image_animation_start(&anims[0].anim, 0);
+
+	run_clock();
+
+	ck_assert_int_eq(anims[0].advanced, 1);
+	ck_assert(anims[0].anim.running == false);
+	ck_assert_int_lt(sched_delay, 0);
+}
+END_TEST
+
+/**
+ * an animation which is not plotted pauses and catches up when it is
+ */
+START_TEST(animation_pause_test)
+{
+	struct nsmetric_value pauses;
+
+	image_animation_start(&anims[0].anim, 0);
+	run_clock();
+	ck_assert_int_eq(anims[0].advanced, 1);
+
+	/* the redraw is never plotted */
+	wait_ms(600);
+	run_clock();
+	ck_assert_int_eq(anims[0].advanced, 1);
+	ck_assert(anims[0].anim.paused);
+	ck_assert_int_lt(sched_delay, 0);
+	ck_assert(nsmetric_get("image.animation.pauses", &pauses) == NSERROR_OK);
+	ck_assert_int_eq(pauses.value, 1);
+
+	/* plotting resumes and the missed frames are caught up at once */
+	image_animation_plotted(&anims[0].anim);
+	ck_assert(anims[0].anim.paused == false);
+	ck_assert_int_eq(sched_delay, 0);
+
+	run_clock();
+	ck_assert_int_eq(anims[0].advanced, 1 + 600 / FRAME);
+	ck_assert_int_eq(anims[0].redraws, 2);
+	ck_assert_int_eq(anims[0].last_frames, 600 / FRAME);
+	ck_assert_int_eq(sched_delay, FRAME);
+}
+END_TEST
+
+/**
+ * stopping the last animation removes the clock
+ */
+START_TEST(animation_stop_test)
+{
+	image_animation_start(&anims[0].anim, FRAME);
+	ck_assert_int_ge(sched_delay, 0);
+
+	image_animation_stop(&anims[0].anim);
+	ck_assert_int_lt(sched_delay, 0);
+	ck_assert(anims[0].anim.running == false);
+}
+END_TEST
+
+
+static TCase *animation_case_create(void)
+{
+	TCase *tc;
+
+	tc = tcase_create("Clock");
+
+	tcase_add_checked_fixture(tc, animation_setup, animation_teardown);
+
+	tcase_add_test(tc, animation_coalesce_test);
+	tcase_add_test(tc, animation_finish_test);
+	tcase_add_test(tc, animation_pause_test);
+	tcase_add_test(tc, animation_stop_test);
+
+	return tc;
+}
+
+
+static Suite *animation_suite(void)
+{
+	Suite *s;
+	s = suite_create("Animation");
+
+	suite_add_tcase(s, animation_case_create());
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	int number_failed;
+	Suite *s;
+	SRunner *sr;
+
+	s = animation_suite();
+
+	sr = srunner_create(s);
+	srunner_run_all(sr, CK_ENV);
+
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
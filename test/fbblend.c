@@ -0,0 +1,344 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Test framebuffer blending kernels.
+ *
+ * Every implementation the processor supports is checked against the
+ * per pixel blending libnsfb performs, and optionally timed against the
+ * portable implementation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <check.h>
+
+#include "framebuffer/blend.h"
+
+/** pixels in a test span, not a multiple of any vector width */
+#define SPAN 1021
+
+/** number of spans in each benchmark */
+#define BENCH_SPANS 2000
+
+static uint32_t src[SPAN];
+static uint32_t dst[SPAN];
+static uint32_t ref[SPAN];
+static uint8_t mask[SPAN];
+
+/**
+ * libnsfb blend of a colour over a colour
+ */
+static uint32_t nsfb_ablend(uint32_t pixel, uint32_t scrpixel)
+{
+	int opacity = pixel >> 24;
+	int transp = 0x100 - opacity;
+	uint32_t rb, g;
+
+	rb = ((pixel & 0xFF00FF) * opacity +
+	      (scrpixel & 0xFF00FF) * transp) >> 8;
+	g  = ((pixel & 0x00FF00) * opacity +
+	      (scrpixel & 0x00FF00) * transp) >> 8;
+
+	return (rb & 0xFF00FF) | (g & 0xFF00);
+}
+
+/**
+ * libnsfb plot of a colour to an XRGB8888 screen pixel
+ */
+static uint32_t nsfb_plot(uint32_t pixel, uint32_t scrpixel)
+{
+	uint32_t c;
+
+	if ((pixel & 0xff000000) == 0) {
+		return scrpixel;
+	}
+
+	if ((pixel & 0xff000000) != 0xff000000) {
+		/* screen pixel to colour, blend, and back */
+		c = ((scrpixel & 0xff) << 16) | (scrpixel & 0xff00) |
+			((scrpixel >> 16) & 0xff);
+		pixel = nsfb_ablend(pixel, c);
+	}
+
+	return ((pixel & 0xff) << 16) | (pixel & 0xff00) |
+		((pixel >> 16) & 0xff);
+}
+
+/**
+ * fill the test spans with a mix of transparent, opaque and blended
+ * pixels including runs long enough to hit the vector fast paths
+ */
+static void blend_setup(void)
+{
+	int i;
+	uint32_t a;
+
+	srand(42);
+
+	for (i = 0; i < SPAN; i++) {
+		switch ((i / 16) % 4) {
+		case 0:
+			a = 0;
+			break;
+		case 1:
+			a = 0xff;
+			break;
+		default:
+			a = rand() & 0xff;
+			break;
+		}
+
+		src[i] = (a << 24) | (rand() & 0xffffff);
+		dst[i] = rand() & 0xffffff;
+		mask[i] = a;
+	}
+}
+
+/* Tests */
+
+/**
+ * source over blending matches libnsfb for every implementation
+ */
+START_TEST(blend_over_test)
+{
+	const struct fb_blend_table *table;
+	uint32_t out[SPAN];
+	int i;
+
+	table = fb_blend_get(_i);
+	ck_assert(table != NULL);
+
+	for (i = 0; i < SPAN; i++) {
+		ref[i] = nsfb_plot(src[i], dst[i]);
+	}
+
+	memcpy(out, dst, sizeof(out));
+	table->over(out, src, SPAN);
+
+	for (i = 0; i < SPAN; i++) {
+		ck_assert_msg((out[i] & 0xffffff) == ref[i],
+			      "%s pixel %d: 0x%08x != 0x%08x",
+			      table->name, i, out[i], ref[i]);
+	}
+}
+END_TEST
+
+/**
+ * opaque copy matches libnsfb for every implementation
+ */
+START_TEST(blend_copy_test)
+{
+	const struct fb_blend_table *table;
+	uint32_t out[SPAN];
+	int i;
+
+	table = fb_blend_get(_i);
+	ck_assert(table != NULL);
+
+	memcpy(out, dst, sizeof(out));
+	table->copy(out, src, SPAN);
+
+	for (i = 0; i < SPAN; i++) {
+		ck_assert_msg((out[i] & 0xffffff) ==
+			      nsfb_plot(src[i] | 0xff000000, dst[i]),
+			      "%s pixel %d", table->name, i);
+	}
+}
+END_TEST
+
+/**
+ * glyph coverage blending matches libnsfb for every implementation
+ */
+START_TEST(blend_glyph_test)
+{
+	const struct fb_blend_table *table;
+	uint32_t out[SPAN];
+	uint32_t colour = 0x00336699;
+	int i;
+
+	table = fb_blend_get(_i);
+	ck_assert(table != NULL);
+
+	memcpy(out, dst, sizeof(out));
+	table->glyph(out, mask, SPAN, colour);
+
+	for (i = 0; i < SPAN; i++) {
+		ck_assert_msg((out[i] & 0xffffff) ==
+			      nsfb_plot(((uint32_t)mask[i] << 24) | colour, dst[i]),
+			      "%s pixel %d", table->name, i);
+	}
+}
+END_TEST
+
+/**
+ * nearest neighbour scaling matches for every implementation
+ */
+START_TEST(blend_scale_test)
+{
+	const struct fb_blend_table *table;
+	uint32_t out[SPAN];
+	uint32_t step = (300 << 16) / SPAN;
+	int i;
+
+	table = fb_blend_get(_i);
+	ck_assert(table != NULL);
+
+	table->scale(out, src, SPAN, 0x8000, step);
+
+	for (i = 0; i < SPAN; i++) {
+		ck_assert(out[i] == src[(0x8000 + i * step) >> 16]);
+	}
+}
+END_TEST
+
+
+/**
+ * time a number of spans of one kernel
+ *
+ * \return time taken in microseconds
+ */
+static long blend_time(const struct fb_blend_table *table, int kernel)
+{
+	struct timespec start, end;
+	uint32_t out[SPAN];
+	int span;
+
+	memcpy(out, dst, sizeof(out));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (span = 0; span < BENCH_SPANS; span++) {
+		switch (kernel) {
+		case 0:
+			table->over(out, src, SPAN);
+			break;
+		case 1:
+			table->copy(out, src, SPAN);
+			break;
+		case 2:
+			table->glyph(out, mask, SPAN, 0x336699);
+			break;
+		default:
+			table->scale(out, src, SPAN, 0, 0x8000);
+			break;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - start.tv_sec) * 1000000 +
+		(end.tv_nsec - start.tv_nsec) / 1000;
+}
+
+/**
+ * report the throughput of each implementation relative to the
+ * portable one
+ */
+START_TEST(blend_benchmark_test)
+{
+	static const char *kernels[] = { "over", "copy", "glyph", "scale" };
+	const struct fb_blend_table *table;
+	long base, elapsed;
+	unsigned int idx;
+	int kernel;
+
+	for (kernel = 0; kernel < 4; kernel++) {
+		base = blend_time(fb_blend_get(0), kernel);
+		for (idx = 0; (table = fb_blend_get(idx)) != NULL; idx++) {
+			elapsed = blend_time(table, kernel);
+			fprintf(stderr, "%-6s %-6s %8ldus %6.2fx\n",
+				kernels[kernel], table->name, elapsed,
+				(elapsed > 0) ? (double)base / elapsed : 0.0);
+		}
+	}
+}
+END_TEST
+
+
+static TCase *blend_kernel_case_create(void)
+{
+	TCase *tc;
+	int count = 0;
+
+	while (fb_blend_get(count) != NULL) {
+		count++;
+	}
+
+	tc = tcase_create("Kernels");
+
+	tcase_add_unchecked_fixture(tc, blend_setup, NULL);
+
+	tcase_add_loop_test(tc, blend_over_test, 0, count);
+	tcase_add_loop_test(tc, blend_copy_test, 0, count);
+	tcase_add_loop_test(tc, blend_glyph_test, 0, count);
+	tcase_add_loop_test(tc, blend_scale_test, 0, count);
+
+	return tc;
+}
+
+
+/**
+ * test case for benchmarks
+ *
+ * Only added when NETSURF_TEST_BENCHMARK is set in the environment.
+ */
+static TCase *blend_benchmark_case_create(void)
+{
+	TCase *tc;
+
+	tc = tcase_create("Benchmark");
+
+	tcase_add_unchecked_fixture(tc, blend_setup, NULL);
+
+	tcase_add_test(tc, blend_benchmark_test);
+
+	return tc;
+}
+
+
+static Suite *blend_suite(void)
+{
+	Suite *s;
+	s = suite_create("Framebuffer blending");
+
+	suite_add_tcase(s, blend_kernel_case_create());
+	if (getenv("NETSURF_TEST_BENCHMARK") != NULL) {
+		suite_add_tcase(s, blend_benchmark_case_create());
+	}
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	int number_failed;
+	Suite *s;
+	SRunner *sr;
+
+	s = blend_suite();
+
+	sr = srunner_create(s);
+	srunner_run_all(sr, CK_ENV);
+
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,374 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Test filesystem backing store.
+ *
+ * Objects are stored in a temporary directory, their heap copy released
+ * and then read back from disc.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <check.h>
+
+#include "utils/errors.h"
+#include "utils/log.h"
+#include "utils/nsurl.h"
+#include "utils/file.h"
+#include "utils/metrics.h"
+#include "netsurf/misc.h"
+#include "desktop/gui_internal.h"
+#include "content/backing_store.h"
+#include "content/llcache.h"
+
+#define TEST_URL "http://www.netsurf-browser.org/"
+
+/** backing store limit */
+#define TEST_LIMIT (16 * 1024 * 1024)
+
+/** length of data too large for a small block */
+#define LARGE_LEN (256 * 1024)
+
+/** directory holding the backing store under test */
+static char test_path[] = "/tmp/fsstoreXXXXXX";
+
+/* Stubs */
+
+static nserror test_schedule(int t, void (*callback)(void *p), void *p)
+{
+	return NSERROR_OK;
+}
+
+static struct gui_misc_table test_misc = {
+	.schedule = test_schedule,
+};
+
+static struct netsurf_table test_table = {
+	.misc = &test_misc,
+};
+
+struct netsurf_table *guit = &test_table;
+
+/* Helpers */
+
+/**
+ * initialise the store in the test directory
+ */
+static void test_initialise(bool compress)
+{
+	struct llcache_store_parameters params;
+
+	params.path = test_path;
+	params.limit = TEST_LIMIT;
+	params.hysteresis = TEST_LIMIT / 4;
+	params.compress = compress;
+
+	ck_assert(filesystem_llcache_table->initialise(&params) == NSERROR_OK);
+}
+
+/**
+ * get the value of a metric
+ */
+static int64_t test_metric(const char *name)
+{
+	struct nsmetric_value value;
+
+	ck_assert(nsmetric_get(name, &value) == NSERROR_OK);
+	return value.value;
+}
+
+/**
+ * generate test data
+ *
+ * \param len The length of data to generate.
+ * \param range The number of distinct byte values used, one for data
+ *              which compresses very well and 256 for data which does
+ *              not compress.
+ * \return The data on heap.
+ */
+static uint8_t *test_data(size_t len, unsigned int range)
+{
+	uint8_t *data;
+	size_t idx;
+
+	data = malloc(len);
+	ck_assert(data != NULL);
+
+	srand(len);
+	for (idx = 0; idx < len; idx++) {
+		data[idx] = 'a' + (rand() % range);
+	}
+
+	return data;
+}
+
+/**
+ * store data and check it is read back unchanged from disc
+ *
+ * \param bsflags The flags the data is stored with.
+ * \param len The length of data to store.
+ * \param range The number of distinct byte values in the data.
+ */
+static void
+test_round_trip(enum backing_store_flags bsflags, size_t len, unsigned int range)
+{
+	nsurl *url;
+	uint8_t *data;
+	uint8_t *expected;
+	uint8_t *fetched;
+	size_t fetched_len;
+
+	ck_assert(nsurl_create(TEST_URL, &url) == NSERROR_OK);
+
+	data = test_data(len, range);
+	expected = malloc(len);
+	ck_assert(expected != NULL);
+	memcpy(expected, data, len);
+
+	/* the store takes ownership of the data, releasing drops the
+	 * heap copy so the fetch must read it back from disc.
+	 */
+	ck_assert(filesystem_llcache_table->store(url, bsflags,
+						  data, len) == NSERROR_OK);
+	ck_assert(filesystem_llcache_table->release(url,
+						    bsflags) == NSERROR_OK);
+
+	ck_assert(filesystem_llcache_table->fetch(url, bsflags,
+						  &fetched,
+						  &fetched_len) == NSERROR_OK);
+	ck_assert_uint_eq(fetched_len, len);
+	ck_assert(memcmp(fetched, expected, len) == 0);
+	ck_assert(filesystem_llcache_table->release(url,
+						    bsflags) == NSERROR_OK);
+
+	free(expected);
+	nsurl_unref(url);
+}
+
+/**
+ * check if an object data file was written outside the block files
+ */
+static bool test_data_file_exists(void)
+{
+	struct stat sb;
+	char *dname = NULL;
+	bool exists;
+
+	ck_assert(netsurf_mkpath(&dname, NULL, 2,
+				 test_path, "d") == NSERROR_OK);
+	exists = (stat(dname, &sb) == 0);
+	free(dname);
+
+	return exists;
+}
+
+/* Fixtures */
+
+static void fsstore_setup(void)
+{
+	test_table.file = default_file_table;
+
+	strcpy(test_path + strlen(test_path) - 6, "XXXXXX");
+	ck_assert(mkdtemp(test_path) != NULL);
+}
+
+static void fsstore_teardown(void)
+{
+	ck_assert(filesystem_llcache_table->finalise() == NSERROR_OK);
+	ck_assert(netsurf_recursive_rm(test_path) == NSERROR_OK);
+}
+
+/* Tests */
+
+/**
+ * large compressible data is compressed into a separate file
+ */
+START_TEST(fsstore_compressed_file_test)
+{
+	int64_t compress_in;
+	int64_t compress_out;
+
+	test_initialise(true);
+	compress_in = test_metric("fs_store.compress.in");
+	compress_out = test_metric("fs_store.compress.out");
+
+	test_round_trip(BACKING_STORE_COMPRESSIBLE, LARGE_LEN, 4);
+
+	ck_assert(test_data_file_exists());
+	ck_assert_int_eq(test_metric("fs_store.compress.in") - compress_in,
+			 LARGE_LEN);
+	ck_assert(test_metric("fs_store.compress.out") - compress_out <
+		  LARGE_LEN / 2);
+}
+END_TEST
+
+/**
+ * data compressing below the block size is stored in a small block
+ */
+START_TEST(fsstore_compressed_block_test)
+{
+	int64_t compress_in;
+
+	test_initialise(true);
+	compress_in = test_metric("fs_store.compress.in");
+
+	test_round_trip(BACKING_STORE_COMPRESSIBLE, LARGE_LEN, 1);
+
+	ck_assert(test_data_file_exists() == false);
+	ck_assert_int_eq(test_metric("fs_store.compress.in") - compress_in,
+			 LARGE_LEN);
+}
+END_TEST
+
+/**
+ * data which does not compress usefully is stored raw
+ */
+START_TEST(fsstore_incompressible_test)
+{
+	int64_t compress_in;
+
+	test_initialise(true);
+	compress_in = test_metric("fs_store.compress.in");
+
+	test_round_trip(BACKING_STORE_COMPRESSIBLE, LARGE_LEN, 256);
+
+	ck_assert(test_data_file_exists());
+	ck_assert_int_eq(test_metric("fs_store.compress.in"), compress_in);
+}
+END_TEST
+
+/**
+ * data too short to be worth compressing is stored raw
+ */
+START_TEST(fsstore_short_test)
+{
+	int64_t compress_in;
+
+	test_initialise(true);
+	compress_in = test_metric("fs_store.compress.in");
+
+	test_round_trip(BACKING_STORE_COMPRESSIBLE, 100, 1);
+
+	ck_assert(test_data_file_exists() == false);
+	ck_assert_int_eq(test_metric("fs_store.compress.in"), compress_in);
+}
+END_TEST
+
+/**
+ * data not marked compressible or with compression disabled is stored raw
+ */
+START_TEST(fsstore_uncompressed_test)
+{
+	int64_t compress_in;
+
+	test_initialise(true);
+	compress_in = test_metric("fs_store.compress.in");
+	test_round_trip(BACKING_STORE_NONE, LARGE_LEN, 1);
+	ck_assert(filesystem_llcache_table->finalise() == NSERROR_OK);
+
+	test_initialise(false);
+	test_round_trip(BACKING_STORE_COMPRESSIBLE, LARGE_LEN, 1);
+
+	ck_assert(test_data_file_exists());
+	ck_assert_int_eq(test_metric("fs_store.compress.in"), compress_in);
+}
+END_TEST
+
+/**
+ * compressed elements are read back after the store is reopened
+ */
+START_TEST(fsstore_reopen_test)
+{
+	nsurl *url;
+	uint8_t *data;
+	uint8_t *fetched;
+	size_t fetched_len;
+
+	test_initialise(true);
+	test_round_trip(BACKING_STORE_COMPRESSIBLE, LARGE_LEN, 4);
+	ck_assert(filesystem_llcache_table->finalise() == NSERROR_OK);
+
+	test_initialise(true);
+
+	data = test_data(LARGE_LEN, 4);
+	ck_assert(nsurl_create(TEST_URL, &url) == NSERROR_OK);
+	ck_assert(filesystem_llcache_table->fetch(url,
+						  BACKING_STORE_COMPRESSIBLE,
+						  &fetched,
+						  &fetched_len) == NSERROR_OK);
+	ck_assert_uint_eq(fetched_len, LARGE_LEN);
+	ck_assert(memcmp(fetched, data, LARGE_LEN) == 0);
+	ck_assert(filesystem_llcache_table->release(url,
+				BACKING_STORE_COMPRESSIBLE) == NSERROR_OK);
+
+	nsurl_unref(url);
+	free(data);
+}
+END_TEST
+
+
+static TCase *fsstore_case_create(void)
+{
+	TCase *tc;
+
+	tc = tcase_create("Compression");
+
+	tcase_add_checked_fixture(tc, fsstore_setup, fsstore_teardown);
+
+	tcase_add_test(tc, fsstore_compressed_file_test);
+	tcase_add_test(tc, fsstore_compressed_block_test);
+	tcase_add_test(tc, fsstore_incompressible_test);
+	tcase_add_test(tc, fsstore_short_test);
+	tcase_add_test(tc, fsstore_uncompressed_test);
+	tcase_add_test(tc, fsstore_reopen_test);
+
+	return tc;
+}
+
+
+static Suite *fsstore_suite(void)
+{
+	Suite *s;
+	s = suite_create("Filesystem backing store");
+
+	suite_add_tcase(s, fsstore_case_create());
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	int number_failed;
+	Suite *s;
+	SRunner *sr;
+
+	s = fsstore_suite();
+
+	sr = srunner_create(s);
+	srunner_run_all(sr, CK_ENV);
+
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Test knockout plotter.
+ *
+ * Plots are made through the knockout plotter to a plotter which
+ * paints a small canvas and the result compared with painting every
+ * plot in order.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+#include "utils/errors.h"
+#include "utils/metrics.h"
+#include "netsurf/plotters.h"
+#include "desktop/knockout.h"
+
+#define CANVAS 256
+
+/** the gui table is only used by knockout for bitmaps */
+struct netsurf_table *guit = NULL;
+
+static colour canvas[CANVAS][CANVAS];
+static unsigned int writes[CANVAS][CANVAS];
+static colour reference[CANVAS][CANVAS];
+static struct rect canvas_clip;
+
+/**
+ * paint a rectangle into a canvas
+ */
+static void
+paint(colour target[CANVAS][CANVAS], const struct rect *r, colour c, bool count)
+{
+	int x, y;
+	int x0 = r->x0, y0 = r->y0, x1 = r->x1, y1 = r->y1;
+
+	if (x0 < canvas_clip.x0) x0 = canvas_clip.x0;
+	if (y0 < canvas_clip.y0) y0 = canvas_clip.y0;
+	if (x1 > canvas_clip.x1) x1 = canvas_clip.x1;
+	if (y1 > canvas_clip.y1) y1 = canvas_clip.y1;
+
+	for (y = y0; y < y1; y++) {
+		for (x = x0; x < x1; x++) {
+			target[y][x] = c;
+			if (count) {
+				writes[y][x]++;
+			}
+		}
+	}
+}
+
+static nserror
+canvas_clip_fn(const struct redraw_context *ctx, const struct rect *clip)
+{
+	canvas_clip = *clip;
+	return NSERROR_OK;
+}
+
+static nserror
+canvas_rectangle(const struct redraw_context *ctx,
+		 const plot_style_t *style,
+		 const struct rect *r)
+{
+	paint(canvas, r, style->fill_colour, true);
+	return NSERROR_OK;
+}
+
+static const struct plotter_table canvas_plotters = {
+	.clip = canvas_clip_fn,
+	.rectangle = canvas_rectangle,
+	.option_knockout = true,
+};
+
+static const struct redraw_context canvas_ctx = {
+	.interactive = true,
+	.background_images = true,
+	.plot = &canvas_plotters,
+};
+
+/* Fixtures */
+
+static void knockout_setup(void)
+{
+	memset(canvas, 0, sizeof(canvas));
+	memset(writes, 0, sizeof(writes));
+	memset(reference, 0, sizeof(reference));
+}
+
+static void knockout_teardown(void)
+{
+	knockout_fini();
+	nsmetric_fini();
+}
+
+/**
+ * plot a filled rectangle through knockout and into the reference
+ */
+static void
+plot_fill(const struct redraw_context *ctx, int x0, int y0, int x1, int y1, colour c)
+{
+	struct rect r = { x0, y0, x1, y1 };
+	plot_style_t style = {
+		.fill_type = PLOT_OP_TYPE_SOLID,
+		.fill_colour = c,
+	};
+
+	ck_assert(ctx->plot->rectangle(ctx, &style, &r) == NSERROR_OK);
+	paint(reference, &r, c, false);
+}
+
+/* Tests */
+
+/**
+ * many more overlapping fills than the plotter used to hold are each
+ * plotted to every pixel at most once with the same result as painting
+ */
+START_TEST(knockout_many_fills_test)
+{
+	struct redraw_context ctx;
+	struct rect clip = { 0, 0, CANVAS, CANVAS };
+	int i;
+	int x, y, w, h;
+
+	srand(7);
+
+	ck_assert(knockout_plot_start(&canvas_ctx, &ctx));
+	ck_assert(ctx.plot->clip(&ctx, &clip) == NSERROR_OK);
+	canvas_clip = clip;
+
+	for (i = 0; i < 10000; i++) {
+		w = 1 + (rand() % ((i % 50 == 0) ? CANVAS : 24));
+		h = 1 + (rand() % ((i % 50 == 0) ? CANVAS : 24));
+		x = (rand() % (CANVAS + w)) - w;
+		y = (rand() % (CANVAS + h)) - h;
+		plot_fill(&ctx, x, y, x + w, y + h, i + 1);
+	}
+
+	ck_assert(knockout_plot_end(&canvas_ctx));
+
+	for (y = 0; y < CANVAS; y++) {
+		for (x = 0; x < CANVAS; x++) {
+			ck_assert_msg(canvas[y][x] == reference[y][x],
+				      "pixel %d,%d is %x not %x", x, y,
+				      canvas[y][x], reference[y][x]);
+			ck_assert_msg(writes[y][x] <= 1,
+				      "pixel %d,%d plotted %u times",
+				      x, y, writes[y][x]);
+		}
+	}
+}
+END_TEST
+
+/**
+ * nested sessions are only plotted when the outermost one ends
+ */
+START_TEST(knockout_nested_test)
+{
+	struct redraw_context ctx;
+	struct redraw_context nested;
+	struct rect clip = { 0, 0, CANVAS, CANVAS };
+
+	ck_assert(knockout_plot_start(&canvas_ctx, &ctx));
+	ck_assert(ctx.plot->clip(&ctx, &clip) == NSERROR_OK);
+	plot_fill(&ctx, 0, 0, 100, 100, 1);
+
+	ck_assert(knockout_plot_start(&ctx, &nested));
+	plot_fill(&nested, 10, 10, 20, 20, 2);
+	ck_assert(knockout_plot_end(&ctx));
+	ck_assert(writes[15][15] == 0);
+
+	ck_assert(knockout_plot_end(&canvas_ctx));
+	ck_assert(canvas[15][15] == 2);
+	ck_assert(canvas[50][50] == 1);
+	ck_assert(writes[15][15] == 1);
+}
+END_TEST
+
+/**
+ * plots and pixels knocked out are recorded for each frame
+ */
+START_TEST(knockout_metrics_test)
+{
+	struct redraw_context ctx;
+	struct rect clip = { 0, 0, CANVAS, CANVAS };
+	struct nsmetric_value plots;
+	struct nsmetric_value pixels;
+
+	ck_assert(knockout_plot_start(&canvas_ctx, &ctx));
+	ck_assert(ctx.plot->clip(&ctx, &clip) == NSERROR_OK);
+	/* entirely covered by the next fill */
+	plot_fill(&ctx, 10, 10, 20, 20, 1);
+	plot_fill(&ctx, 0, 0, 50, 50, 2);
+	/* half covered by the next fill */
+	plot_fill(&ctx, 100, 100, 200, 200, 3);
+	plot_fill(&ctx, 150, 100, 250, 200, 4);
+	ck_assert(knockout_plot_end(&canvas_ctx));
+
+	ck_assert(nsmetric_get("knockout.plots", &plots) == NSERROR_OK);
+	ck_assert(nsmetric_get("knockout.pixels", &pixels) == NSERROR_OK);
+	ck_assert_int_eq(plots.value, 1);
+	ck_assert_int_eq(pixels.value, 10 * 10 + 50 * 100);
+
+	/* a frame with nothing knocked out */
+	ck_assert(knockout_plot_start(&canvas_ctx, &ctx));
+	ck_assert(ctx.plot->clip(&ctx, &clip) == NSERROR_OK);
+	plot_fill(&ctx, 0, 0, 10, 10, 1);
+	plot_fill(&ctx, 20, 20, 30, 30, 2);
+	ck_assert(knockout_plot_end(&canvas_ctx));
+
+	ck_assert(nsmetric_get("knockout.plots", &plots) == NSERROR_OK);
+	ck_assert(nsmetric_get("knockout.pixels", &pixels) == NSERROR_OK);
+	ck_assert_int_eq(plots.value, 0);
+	ck_assert_int_eq(pixels.value, 0);
+}
+END_TEST
+
+
+static TCase *knockout_case_create(void)
+{
+	TCase *tc;
+
+	tc = tcase_create("Fill");
+
+	tcase_add_checked_fixture(tc, knockout_setup, knockout_teardown);
+
+	tcase_add_test(tc, knockout_many_fills_test);
+	tcase_add_test(tc, knockout_nested_test);
+	tcase_add_test(tc, knockout_metrics_test);
+
+	return tc;
+}
+
+
+static Suite *knockout_suite(void)
+{
+	Suite *s;
+	s = suite_create("Knockout");
+
+	suite_add_tcase(s, knockout_case_create());
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	int number_failed;
+	Suite *s;
+	SRunner *sr;
+
+	s = knockout_suite();
+
+	sr = srunner_create(s);
+	srunner_run_all(sr, CK_ENV);
+
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,5 +1,6 @@
 /*
  * Copyright 2011 John Mark Bell <jmb@netsurf-browser.org>
+ * Copyright 2026 agent <agent@local>
  *
  * This file is part of NetSurf, http://www.netsurf-browser.org/
  *
@@ -16,345 +17,428 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/**
+ * \file
+ * Test low level cache.
+ *
+ * The fetch layer is replaced so the tests deliver the fetch messages
+ * for an object themselves.
+ */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <check.h>
 
-#include "content/fetch.h"
-#include "content/llcache.h"
-#include "utils/ring.h"
+#include "utils/errors.h"
+#include "utils/log.h"
 #include "utils/nsurl.h"
-#include "utils/url.h"
+#include "utils/nsoption.h"
+#include "utils/metrics.h"
 #include "utils/corestrings.h"
-#include "utils/utils.h"
+#include "netsurf/misc.h"
+#include "netsurf/ssl_certs.h"
+#include "desktop/gui_internal.h"
+#include "content/fetch.h"
+#include "content/urldb.h"
+#include "content/backing_store.h"
+#include "content/llcache.h"
 
-/******************************************************************************
- * Things that we'd reasonably expect to have to implement                    *
- ******************************************************************************/
+/** size of each block of data delivered */
+#define DATA_BLOCK (1024 * 1024)
 
-bool verbose_log;
+#define TEST_URL "http://www.netsurf-browser.org/"
 
-/* utils/utils.h */
-char *filename_from_path(char *path)
-{
-	char *leafname;
+/** fetch started by the cache */
+struct fetch {
+	fetch_callback callback; /**< cache callback */
+	void *p; /**< cache callback context */
+	bool speculative; /**< fetch started at speculative priority */
+	bool promoted; /**< fetch raised to normal priority */
+	bool aborted; /**< fetch aborted */
+};
 
-	leafname = strrchr(path, '/');
-	if (!leafname)
-		leafname = path;
-	else
-		leafname += 1;
+/** the most recently started fetch */
+static struct fetch *test_fetch;
 
-	return strdup(leafname);
-}
+/** number of fetches started */
+static unsigned int fetches_started;
 
-/* utils/schedule.h */
-void schedule(int t, schedule_callback_fn cb, void *pw)
-{
-}
+/** data delivered by the test fetches */
+static uint8_t data_block[DATA_BLOCK];
 
-/* utils/schedule.h */
-void schedule_remove(schedule_callback_fn cb, void *pw)
-{
-}
+/** events received by a test handle */
+struct test_events {
+	unsigned int data; /**< data events */
+	unsigned int errors; /**< error events */
+	nserror error; /**< code of the last error */
+};
 
-/* content/fetch.h */
-const char *fetch_filetype(const char *unix_path)
-{
-	return NULL;
-}
+/* Stubs */
 
-/* content/fetch.h */
-char *fetch_mimetype(const char *ro_path)
-{
-	return NULL;
-}
+nserror nslog_set_filter_by_options(void) { return NSERROR_OK; }
 
-/* utils/url.h */
-char *path_to_url(const char *path)
+static nserror test_schedule(int t, void (*callback)(void *p), void *p)
 {
-	int urllen = strlen(path) + FILE_SCHEME_PREFIX_LEN + 1;
-	char *url = malloc(urllen);
-
-	if (url == NULL) {
-		return NULL;
-	}
+	return NSERROR_OK;
+}
 
-	if (*path == '/') {
-		path++; /* file: paths are already absolute */
-	} 
+static struct gui_misc_table test_misc = {
+	.schedule = test_schedule,
+};
 
-	snprintf(url, urllen, "%s%s", FILE_SCHEME_PREFIX, path);
+static struct netsurf_table test_table = {
+	.misc = &test_misc,
+};
 
-	return url;
-}
+struct netsurf_table *guit = &test_table;
 
-/* utils/url.h */
-char *url_to_path(const char *url)
+nserror fetch_start(nsurl *url, nsurl *referer, fetch_callback callback,
+		    void *p, bool only_2xx, const char *post_urlenc,
+		    const struct fetch_multipart_data *post_multipart,
+		    bool verifiable, bool downgrade_tls, bool speculative,
+		    const char *headers[], struct fetch **fetch_out)
 {
-	char *url_path;
-	char *path = NULL;
+	struct fetch *fetch;
 
-	if (url_unescape(url, 0, NULL, &url_path) == NSERROR_OK) {
-		/* return the absolute path including leading / */
-		path = strdup(url_path + (FILE_SCHEME_PREFIX_LEN - 1));
-		free(url_path);
+	fetch = calloc(1, sizeof(*fetch));
+	if (fetch == NULL) {
+		return NSERROR_NOMEM;
 	}
+	fetch->callback = callback;
+	fetch->p = p;
+	fetch->speculative = speculative;
+
+	test_fetch = fetch;
+	fetches_started++;
 
-	return path;
+	*fetch_out = fetch;
+	return NSERROR_OK;
 }
 
-/******************************************************************************
- * Things that are absolutely not reasonable, and should disappear            *
- ******************************************************************************/
+void fetch_promote(struct fetch *fetch)
+{
+	fetch->promoted = true;
+}
 
-#include "desktop/cookie_manager.h"
+void fetch_abort(struct fetch *f)
+{
+	/* the test owns the fetch */
+	f->aborted = true;
+}
 
-/* desktop/cookie_manager.h -- used by urldb 
- *
- * URLdb should have a cookies update event + handler registration
- */
-bool cookie_manager_add(const struct cookie_data *data)
+bool fetch_can_fetch(const nsurl *url)
 {
 	return true;
 }
 
-/* desktop/cookie_manager.h -- used by urldb 
- *
- * URLdb should have a cookies removal handler registration
- */
-void cookie_manager_remove(const struct cookie_data *data)
+long fetch_http_code(struct fetch *fetch)
 {
+	return 200;
 }
 
-/* image/bitmap.h -- used by urldb 
- *
- * URLdb shouldn't care about bitmaps. 
- * This is because the legacy RO thumbnail stuff was hacked in and must die.
- */
-void bitmap_destroy(void *bitmap)
+size_t fetch_transferred(struct fetch *fetch)
 {
+	return 0;
 }
-/* image/image.h -- used by urldb 
- *
- * URLdb shouldn't care about bitmaps. 
- * This is because the legacy RO thumbnail stuff was hacked in and must die.
- */
-bool image_bitmap_plot(struct bitmap *bitmap, struct content_redraw_data *data, 
-		const struct rect *clip, const struct redraw_context *ctx)
+
+struct fetch_multipart_data *
+fetch_multipart_data_clone(const struct fetch_multipart_data *list)
 {
-	return true;
+	return NULL;
 }
 
-/* content/fetchers/fetch_file.h -- used by fetcher core
- *
- * Simpler to stub this than haul in all the file fetcher's dependencies
- */
-void fetch_file_register(void)
+void fetch_multipart_data_destroy(struct fetch_multipart_data *list)
 {
 }
 
+nserror cert_chain_alloc(size_t depth, struct cert_chain **chain_out)
+{
+	return NSERROR_NOMEM;
+}
 
-/******************************************************************************
- * test: protocol handler                                                     *
- ******************************************************************************/
-
-typedef struct test_context {
-	struct fetch *parent;
-
-	bool aborted;
-	bool locked;
+nserror cert_chain_dup(const struct cert_chain *src, struct cert_chain **dst_out)
+{
+	return NSERROR_NOMEM;
+}
 
-	struct test_context *r_prev;
-	struct test_context *r_next;
-} test_context;
+nserror cert_chain_free(struct cert_chain *chain)
+{
+	return NSERROR_OK;
+}
 
-static test_context *ring;
+size_t cert_chain_size(const struct cert_chain *chain)
+{
+	return 0;
+}
 
-bool test_initialise(lwc_string *scheme)
+const char *urldb_get_auth_details(struct nsurl *url, const char *realm)
 {
-	/* Nothing to do */
-	return true;
+	return NULL;
 }
 
-bool test_can_fetch(const nsurl *url)
+bool urldb_set_hsts_policy(struct nsurl *url, const char *header)
 {
-	/* Nothing to do */
 	return true;
 }
 
-void test_finalise(lwc_string *scheme)
+bool urldb_get_hsts_enabled(struct nsurl *url)
 {
-	/* Nothing to do */
+	return false;
 }
 
-void *test_setup_fetch(struct fetch *parent, nsurl *url, bool only_2xx,
-		bool downgrade_tls, const char *post_urlenc,
-		const struct fetch_multipart_data *post_multipart,
-		const char **headers)
+/* Helpers */
+
+static nserror
+test_event_handler(llcache_handle *handle,
+		   const llcache_event *event,
+		   void *pw)
 {
-	test_context *ctx = calloc(1, sizeof(test_context));
+	struct test_events *events = pw;
 
-	if (ctx == NULL)
-		return NULL;
+	switch (event->type) {
+	case LLCACHE_EVENT_HAD_DATA:
+		events->data++;
+		break;
 
-	ctx->parent = parent;
+	case LLCACHE_EVENT_ERROR:
+		events->errors++;
+		events->error = event->data.error.code;
+		break;
 
-	RING_INSERT(ring, ctx);
+	default:
+		break;
+	}
 
-	return ctx;
+	return NSERROR_OK;
 }
 
-bool test_start_fetch(void *handle)
+/**
+ * retrieve the test URL
+ */
+static llcache_handle *
+test_retrieve(uint32_t flags, struct test_events *events)
 {
-	/* Nothing to do */
-	return true;
-}
+	llcache_handle *handle;
+	nsurl *url;
 
-void test_abort_fetch(void *handle)
-{
-	test_context *ctx = handle;
+	ck_assert(nsurl_create(TEST_URL, &url) == NSERROR_OK);
+	ck_assert(llcache_handle_retrieve(url, flags, NULL, NULL,
+					  test_event_handler, events,
+					  &handle) == NSERROR_OK);
+	nsurl_unref(url);
 
-	ctx->aborted = true;
+	return handle;
 }
 
-void test_free_fetch(void *handle)
+/**
+ * deliver a message to the cache from the current fetch
+ */
+static void test_send(fetch_msg_type type, size_t len)
 {
-	test_context *ctx = handle;
+	fetch_msg msg;
 
-	RING_REMOVE(ring, ctx);
+	memset(&msg, 0, sizeof(msg));
+	msg.type = type;
+	msg.data.header_or_data.buf = data_block;
+	msg.data.header_or_data.len = len;
 
-	free(ctx);
+	test_fetch->callback(&msg, test_fetch->p);
 }
 
-void test_process(test_context *ctx)
+/**
+ * get the value of a metric
+ */
+static int64_t test_metric(const char *name)
 {
-	/** \todo Implement */
+	struct nsmetric_value value;
+
+	ck_assert(nsmetric_get(name, &value) == NSERROR_OK);
+	return value.value;
 }
 
-void test_poll(lwc_string *scheme)
+/* Fixtures */
+
+static void llcache_setup(void)
 {
-	test_context *ctx, *next;
+	struct llcache_parameters params;
 
-	if (ring == NULL)
-		return;
+	ck_assert(nsoption_init(NULL, NULL, NULL) == NSERROR_OK);
+	ck_assert(corestrings_init() == NSERROR_OK);
 
-	ctx = ring;
-	do {
-		next = ctx->r_next;
+	test_table.llcache = null_llcache_table;
+	test_fetch = NULL;
+	fetches_started = 0;
 
-		if (ctx->locked)
-			continue;
+	memset(&params, 0, sizeof(params));
+	params.limit = 16 * 1024 * 1024;
+	params.fetch_attempts = 1;
+	ck_assert(llcache_initialise(&params) == NSERROR_OK);
+}
 
-		if (ctx->aborted == false) {
-			test_process(ctx);
-		}
+static void llcache_teardown(void)
+{
+	llcache_finalise();
+	free(test_fetch);
 
-		fetch_remove_from_queues(ctx->parent);
-		fetch_free(ctx->parent);
-	} while ((ctx = next) != ring && ring != NULL);
+	corestrings_fini();
+	ck_assert(nsoption_finalise(NULL, NULL) == NSERROR_OK);
 }
 
-/******************************************************************************
- * The actual test code                                                       *
- ******************************************************************************/
+/* Tests */
 
-nserror query_handler(const llcache_query *query, void *pw,
-		llcache_query_response cb, void *cbpw)
+/**
+ * a second retrieval of an object being fetched shares the fetch
+ */
+START_TEST(llcache_retrieve_shared_test)
 {
-	/* I'm too lazy to actually implement this. It should queue the query, 
-	 * then deliver the response from main(). */
+	struct test_events events1 = { 0 };
+	struct test_events events2 = { 0 };
+	llcache_handle *handle1;
+	llcache_handle *handle2;
 
-	return NSERROR_OK;
+	handle1 = test_retrieve(LLCACHE_RETRIEVE_VERIFIABLE, &events1);
+	ck_assert(test_fetch != NULL);
+	ck_assert(test_fetch->speculative == false);
+
+	handle2 = test_retrieve(LLCACHE_RETRIEVE_VERIFIABLE, &events2);
+	ck_assert_int_eq(fetches_started, 1);
+	ck_assert(llcache_handle_references_same_object(handle1, handle2));
+
+	ck_assert(llcache_handle_release(handle2) == NSERROR_OK);
+	ck_assert(llcache_handle_release(handle1) == NSERROR_OK);
 }
+END_TEST
 
-nserror event_handler(llcache_handle *handle, 
-		const llcache_event *event, void *pw)
+/**
+ * a speculative fetch growing beyond the limit is stopped
+ */
+START_TEST(llcache_speculative_limit_test)
 {
-	static char *event_names[] = {
-		"HAD_HEADERS", "HAD_DATA", "DONE", "ERROR", "PROGRESS"
-	};
-	bool *done = pw;
+	struct test_events events = { 0 };
+	llcache_handle *handle;
 
-	if (event->type != LLCACHE_EVENT_PROGRESS)
-		fprintf(stdout, "%p : %s\n", handle, event_names[event->type]);
+	handle = test_retrieve(LLCACHE_RETRIEVE_SPECULATIVE, &events);
+	ck_assert(test_fetch != NULL);
+	ck_assert(test_fetch->speculative);
+	ck_assert(llcache_handle_is_speculative(handle));
+	ck_assert_int_eq(test_metric("llcache.speculative"), 1);
+
+	/* up to the limit the data is kept */
+	test_send(FETCH_DATA, DATA_BLOCK);
+	test_send(FETCH_DATA, DATA_BLOCK);
+	ck_assert(test_fetch->aborted == false);
+	ck_assert_int_eq(events.errors, 0);
+
+	/* beyond it the fetch is aborted and the users told */
+	test_send(FETCH_DATA, 1);
+	ck_assert(test_fetch->aborted);
+	ck_assert_int_eq(events.errors, 1);
+	ck_assert_int_eq(events.error, NSERROR_NOSPACE);
+
+	ck_assert(llcache_handle_release(handle) == NSERROR_OK);
+}
+END_TEST
 
-	/* Inform main() that the fetch completed */
-	if (event->type == LLCACHE_EVENT_DONE)
-		*done = true;
+/**
+ * a normal fetch is not limited
+ */
+START_TEST(llcache_normal_unlimited_test)
+{
+	struct test_events events = { 0 };
+	llcache_handle *handle;
 
-	return NSERROR_OK;
+	handle = test_retrieve(LLCACHE_RETRIEVE_VERIFIABLE, &events);
+
+	test_send(FETCH_DATA, DATA_BLOCK);
+	test_send(FETCH_DATA, DATA_BLOCK);
+	test_send(FETCH_DATA, DATA_BLOCK);
+	ck_assert(test_fetch->aborted == false);
+	ck_assert_int_eq(events.errors, 0);
+
+	ck_assert(llcache_handle_release(handle) == NSERROR_OK);
 }
+END_TEST
 
-int main(int argc, char **argv)
+/**
+ * a normal retrieval of a speculative object promotes it
+ */
+START_TEST(llcache_speculative_promote_test)
 {
-	nserror error;
+	struct test_events spec_events = { 0 };
+	struct test_events events = { 0 };
+	llcache_handle *spec;
 	llcache_handle *handle;
-	llcache_handle *handle2;
-	lwc_string *scheme;
-	nsurl *url;
-	bool done = false;
 
-	/* Initialise subsystems */
-	fetch_init();
+	spec = test_retrieve(LLCACHE_RETRIEVE_SPECULATIVE, &spec_events);
+	test_send(FETCH_DATA, DATA_BLOCK);
+
+	/* a further speculative retrieval leaves it speculative */
+	handle = test_retrieve(LLCACHE_RETRIEVE_SPECULATIVE, &events);
+	ck_assert(llcache_handle_is_speculative(handle));
+	ck_assert(test_fetch->promoted == false);
+	ck_assert(llcache_handle_release(handle) == NSERROR_OK);
+
+	/* the navigation joins the fetch already in progress */
+	handle = test_retrieve(LLCACHE_RETRIEVE_VERIFIABLE, &events);
+	ck_assert_int_eq(fetches_started, 1);
+	ck_assert(llcache_handle_references_same_object(spec, handle));
+	ck_assert(test_fetch->promoted);
+	ck_assert(llcache_handle_is_speculative(spec) == false);
+	ck_assert_int_eq(test_metric("llcache.speculative.hit"), 1);
+
+	/* and the fetch is no longer limited */
+	test_send(FETCH_DATA, DATA_BLOCK);
+	test_send(FETCH_DATA, DATA_BLOCK);
+	ck_assert(test_fetch->aborted == false);
+	ck_assert_int_eq(events.errors, 0);
+
+	ck_assert(llcache_handle_release(spec) == NSERROR_OK);
+	ck_assert(llcache_handle_release(handle) == NSERROR_OK);
+}
+END_TEST
 
-	if (lwc_intern_string("test", SLEN("test"), &scheme) != lwc_error_ok) {
-		fprintf(stderr, "Failed to intern \"test\"\n");
-		return 1;
-	}
 
-	fetch_add_fetcher(scheme, test_initialise, test_can_fetch,
-			test_setup_fetch, test_start_fetch, test_abort_fetch,
-			test_free_fetch, test_poll, test_finalise);
+static TCase *llcache_case_create(void)
+{
+	TCase *tc;
 
-	/* Initialise low-level cache */
-	error = llcache_initialise(query_handler, NULL, 1024 * 1024);
-	if (error != NSERROR_OK) {
-		fprintf(stderr, "llcache_initialise: %d\n", error);
-		return 1;
-	}
+	tc = tcase_create("Retrieval");
 
-	if (nsurl_create("http://www.netsurf-browser.org", &url) != NSERROR_OK) {
-		fprintf(stderr, "Failed creating url\n");
-		return 1;
-	}
+	tcase_add_checked_fixture(tc, llcache_setup, llcache_teardown);
 
-	/* Retrieve an URL from the low-level cache (may trigger fetch) */
-	error = llcache_handle_retrieve(url, 
-			LLCACHE_RETRIEVE_VERIFIABLE, NULL, NULL,
-			event_handler, &done, &handle);
-	if (error != NSERROR_OK) {
-		fprintf(stderr, "llcache_handle_retrieve: %d\n", error);
-		return 1;
-	}
+	tcase_add_test(tc, llcache_retrieve_shared_test);
+	tcase_add_test(tc, llcache_speculative_limit_test);
+	tcase_add_test(tc, llcache_normal_unlimited_test);
+	tcase_add_test(tc, llcache_speculative_promote_test);
 
-	/* Poll relevant components */
-	while (done == false) {
-		llcache_poll();
-	}
+	return tc;
+}
 
-	done = false;
-	error = llcache_handle_retrieve(url,
-			LLCACHE_RETRIEVE_VERIFIABLE, NULL, NULL,
-			event_handler, &done, &handle2);
-	if (error != NSERROR_OK) {
-		fprintf(stderr, "llcache_handle_retrieve: %d\n", error);
-		return 1;
-	}
 
-	while (done == false) {
-		llcache_poll();
-	}
+static Suite *llcache_suite(void)
+{
+	Suite *s;
+	s = suite_create("Low level cache");
 
-	fprintf(stdout, "%p, %p -> %d\n", handle, handle2,
-			llcache_handle_references_same_object(handle, handle2));
+	suite_add_tcase(s, llcache_case_create());
 
-	/* Cleanup */
-	llcache_handle_release(handle2);
-	llcache_handle_release(handle);
+	return s;
+}
 
-	fetch_quit();
+int main(int argc, char **argv)
+{
+	int number_failed;
+	Suite *s;
+	SRunner *sr;
 
-	return 0;
-}
+	s = llcache_suite();
 
+	sr = srunner_create(s);
+	srunner_run_all(sr, CK_ENV);
+
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
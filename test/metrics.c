@@ -0,0 +1,253 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Test performance metrics registry operations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+#include "utils/metrics.h"
+
+/* Fixtures */
+
+static void metrics_teardown(void)
+{
+	nsmetric_fini();
+}
+
+/* Tests */
+
+/**
+ * registering the same name twice yields the same handle
+ */
+START_TEST(metrics_register_test)
+{
+	struct nsmetric *m1;
+	struct nsmetric *m2;
+	nserror res;
+
+	res = nsmetric_register("test.count", NSMETRIC_COUNTER, &m1);
+	ck_assert(res == NSERROR_OK);
+
+	res = nsmetric_register("test.count", NSMETRIC_COUNTER, &m2);
+	ck_assert(res == NSERROR_OK);
+	ck_assert(m1 == m2);
+
+	/* same name with a different type is an error */
+	res = nsmetric_register("test.count", NSMETRIC_GAUGE, &m2);
+	ck_assert(res == NSERROR_BAD_PARAMETER);
+}
+END_TEST
+
+/**
+ * updates through a NULL handle are ignored
+ */
+START_TEST(metrics_null_test)
+{
+	struct nsmetric_value value;
+
+	nsmetric_add(NULL, 1);
+	nsmetric_set(NULL, 1);
+	nsmetric_sample(NULL, 1);
+
+	ck_assert(nsmetric_get("test.missing", &value) == NSERROR_NOT_FOUND);
+}
+END_TEST
+
+/**
+ * counter accumulates and keeps no history
+ */
+START_TEST(metrics_counter_test)
+{
+	struct nsmetric *m;
+	struct nsmetric_value value;
+
+	ck_assert(nsmetric_register("test.count", NSMETRIC_COUNTER, &m) == NSERROR_OK);
+
+	nsmetric_add(m, 3);
+	nsmetric_add(m, 4);
+
+	ck_assert(nsmetric_get("test.count", &value) == NSERROR_OK);
+	ck_assert_str_eq(value.name, "test.count");
+	ck_assert(value.type == NSMETRIC_COUNTER);
+	ck_assert(value.value == 7);
+	ck_assert(value.count == 2);
+	ck_assert(value.history_len == 0);
+}
+END_TEST
+
+/**
+ * timing samples are totalled and history is kept oldest first
+ */
+START_TEST(metrics_timing_test)
+{
+	struct nsmetric *m;
+	struct nsmetric_value value;
+	int idx;
+
+	ck_assert(nsmetric_register("test.time", NSMETRIC_TIMING, &m) == NSERROR_OK);
+
+	for (idx = 0; idx < NSMETRIC_HISTORY + 5; idx++) {
+		nsmetric_sample(m, idx);
+	}
+
+	ck_assert(nsmetric_get("test.time", &value) == NSERROR_OK);
+	ck_assert(value.count == NSMETRIC_HISTORY + 5);
+	ck_assert(value.value == NSMETRIC_HISTORY + 4);
+	ck_assert(value.max == NSMETRIC_HISTORY + 4);
+	ck_assert(value.total == ((NSMETRIC_HISTORY + 5) * (NSMETRIC_HISTORY + 4)) / 2);
+	ck_assert(value.history_len == NSMETRIC_HISTORY);
+	ck_assert(value.history[0] == 5);
+	ck_assert(value.history[NSMETRIC_HISTORY - 1] == NSMETRIC_HISTORY + 4);
+}
+END_TEST
+
+
+static TCase *metrics_api_case_create(void)
+{
+	TCase *tc;
+
+	tc = tcase_create("API");
+
+	tcase_add_checked_fixture(tc, NULL, metrics_teardown);
+
+	tcase_add_test(tc, metrics_register_test);
+	tcase_add_test(tc, metrics_null_test);
+	tcase_add_test(tc, metrics_counter_test);
+	tcase_add_test(tc, metrics_timing_test);
+
+	return tc;
+}
+
+
+/**
+ * test source emitting two labelled values
+ */
+static nserror
+test_source(nsmetric_enumerate_cb cb, void *cbpw, void *pw)
+{
+	struct nsmetric_value value;
+	nserror res;
+
+	memset(&value, 0, sizeof(value));
+	value.name = "source.value";
+	value.type = NSMETRIC_GAUGE;
+
+	value.label = "a";
+	value.value = 1;
+	res = cb(&value, cbpw);
+	if (res != NSERROR_OK) {
+		return res;
+	}
+
+	value.label = "b";
+	value.value = 2;
+	return cb(&value, cbpw);
+}
+
+/**
+ * sum the values of enumerated metrics
+ */
+static nserror
+sum_cb(const struct nsmetric_value *value, void *pw)
+{
+	int64_t *sum = pw;
+	*sum += value->value;
+	return NSERROR_OK;
+}
+
+/**
+ * enumeration visits registered metrics and sources filtered by prefix
+ */
+START_TEST(metrics_enumerate_test)
+{
+	struct nsmetric *m;
+	int64_t sum;
+
+	ck_assert(nsmetric_register("other.gauge", NSMETRIC_GAUGE, &m) == NSERROR_OK);
+	nsmetric_set(m, 100);
+	ck_assert(nsmetric_source_register(test_source, NULL) == NSERROR_OK);
+
+	sum = 0;
+	ck_assert(nsmetric_enumerate(NULL, sum_cb, &sum) == NSERROR_OK);
+	ck_assert(sum == 103);
+
+	sum = 0;
+	ck_assert(nsmetric_enumerate("source.", sum_cb, &sum) == NSERROR_OK);
+	ck_assert(sum == 3);
+
+	sum = 0;
+	ck_assert(nsmetric_enumerate("other.", sum_cb, &sum) == NSERROR_OK);
+	ck_assert(sum == 100);
+
+	ck_assert(nsmetric_source_unregister(test_source, NULL) == NSERROR_OK);
+	ck_assert(nsmetric_source_unregister(test_source, NULL) == NSERROR_NOT_FOUND);
+
+	sum = 0;
+	ck_assert(nsmetric_enumerate(NULL, sum_cb, &sum) == NSERROR_OK);
+	ck_assert(sum == 100);
+}
+END_TEST
+
+
+static TCase *metrics_enumerate_case_create(void)
+{
+	TCase *tc;
+
+	tc = tcase_create("Enumerate");
+
+	tcase_add_checked_fixture(tc, NULL, metrics_teardown);
+
+	tcase_add_test(tc, metrics_enumerate_test);
+
+	return tc;
+}
+
+
+static Suite *metrics_suite(void)
+{
+	Suite *s;
+	s = suite_create("Metrics");
+
+	suite_add_tcase(s, metrics_api_case_create());
+	suite_add_tcase(s, metrics_enumerate_case_create());
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	int number_failed;
+	Suite *s;
+	SRunner *sr;
+
+	s = metrics_suite();
+
+	sr = srunner_create(s);
+	srunner_run_all(sr, CK_ENV);
+
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <check.h>
 
 #include <libwapcaplet/libwapcaplet.h>
@@ -168,6 +169,18 @@ static const struct test_pairs create_tests[] = {
 	{ "http://www.ns-b.org    ",		"http://www.ns-b.org/" },
 	{ "http://www.ns-b.org/?q   ",		"http://www.ns-b.org/?q" },
 	{ "http://www.ns-b.org/#f    ",		"http://www.ns-b.org/#f" },
+
+	/* sections longer than the vector scan width */
+	{ "http://WWW.EXAMPLE-WITH-A-LONG-NAME.ORG/abcdefghijklmnopqrstuvwxyz0123456789/path with spaces/and%41escapes/end",
+	  "http://www.example-with-a-long-name.org/abcdefghijklmnopqrstuvwxyz0123456789/path%20with%20spaces/andAescapes/end" },
+	{ "http://example.org/aaaaaaaaaaaaaaaa\"bbbbbbbbbbbbbbbb<cccccccccccccccc>dddd?qqqqqqqqqqqqqqqqqqqqqq qqqq#ffffffffffffffffffffff{f}",
+	  "http://example.org/aaaaaaaaaaaaaaaa%22bbbbbbbbbbbbbbbb%3Ccccccccccccccccc%3Edddd?qqqqqqqqqqqqqqqqqqqqqq%20qqqq#ffffffffffffffffffffff%7Bf%7D" },
+	{ "http://example.org/\xc3\xbc" "bersetzung-der-langen-seite-\xc3\xbc" "nd-mehr",
+	  "http://example.org/%C3%BCbersetzung-der-langen-seite-%C3%BCnd-mehr" },
+	{ "http://a/p?0123456789abcdefghijklmnop#0123456789abcdefghijklmnop",
+	  "http://a/p?0123456789abcdefghijklmnop#0123456789abcdefghijklmnop" },
+	{ "http://a/0123456789abcdef%7e0123456789abcdef%2f0123456789abcdef%",
+	  "http://a/0123456789abcdef~0123456789abcdef%2f0123456789abcdef%25" },
 };
 
 /**
@@ -1339,6 +1352,351 @@ static TCase *nsurl_utf8_case_create(void)
 }
 
 
+/* intern test case */
+
+/**
+ * intern tests
+ *
+ * Each pair is created twice and joined with base_str, res indicates
+ * whether test and the join result are expected to be identical.
+ */
+static const struct test_compare intern_tests[] = {
+	{ "http://a/b/c/d;p?q", "d;p?q", NSURL_WITH_FRAGMENT, true },
+	{ "http://a/b/c/d;p?q#f", "d;p?q#f", NSURL_WITH_FRAGMENT, true },
+	{ "http://a/b/c/d;p?q#f", "d;p?q#g", NSURL_WITH_FRAGMENT, false },
+	{ "http://a/b/c/g", "g", NSURL_WITH_FRAGMENT, true },
+	{ "http://a/b/c/g", "h", NSURL_WITH_FRAGMENT, false },
+};
+
+static void intern_create(void)
+{
+	corestring_create();
+	ck_assert(nsurl_intern_enable(true) == NSERROR_OK);
+}
+
+static void intern_teardown(void)
+{
+	ck_assert(nsurl_intern_enable(false) == NSERROR_OK);
+	corestring_teardown();
+}
+
+/**
+ * interned urls share objects
+ */
+START_TEST(nsurl_intern_test)
+{
+	nserror err;
+	nsurl *base;
+	nsurl *url1;
+	nsurl *url2;
+	nsurl *joined;
+	const struct test_compare *tst = &intern_tests[_i];
+
+	err = nsurl_create(base_str, &base);
+	ck_assert(err == NSERROR_OK);
+
+	err = nsurl_create(tst->test1, &url1);
+	ck_assert(err == NSERROR_OK);
+
+	err = nsurl_create(tst->test1, &url2);
+	ck_assert(err == NSERROR_OK);
+
+	/* identical creation must share an object */
+	ck_assert(url1 == url2);
+
+	err = nsurl_join(base, tst->test2, &joined);
+	ck_assert(err == NSERROR_OK);
+
+	ck_assert((url1 == joined) == tst->res);
+	ck_assert(nsurl_compare(url1, joined, tst->parts) == tst->res);
+
+	nsurl_unref(joined);
+	nsurl_unref(url2);
+	nsurl_unref(url1);
+	nsurl_unref(base);
+}
+END_TEST
+
+
+/**
+ * released interned urls are removed from the table
+ */
+START_TEST(nsurl_intern_release_test)
+{
+	nserror err;
+	nsurl *url1;
+	nsurl *url2;
+
+	err = nsurl_create(base_str, &url1);
+	ck_assert(err == NSERROR_OK);
+
+	nsurl_unref(url1);
+
+	err = nsurl_create(base_str, &url2);
+	ck_assert(err == NSERROR_OK);
+
+	/* table must not have kept the released object */
+	ck_assert_str_eq(nsurl_access(url2), base_str);
+
+	err = nsurl_intern_enable(false);
+	ck_assert(err == NSERROR_OK);
+
+	err = nsurl_create(base_str, &url1);
+	ck_assert(err == NSERROR_OK);
+
+	/* no sharing when disabled */
+	ck_assert(url1 != url2);
+	ck_assert(nsurl_compare(url1, url2, NSURL_WITH_FRAGMENT) == true);
+
+	nsurl_unref(url1);
+	nsurl_unref(url2);
+
+	err = nsurl_intern_enable(true);
+	ck_assert(err == NSERROR_OK);
+}
+END_TEST
+
+
+/**
+ * test case for url interning
+ */
+static TCase *nsurl_intern_case_create(void)
+{
+	TCase *tc;
+	tc = tcase_create("Intern");
+
+	tcase_add_unchecked_fixture(tc,
+				    intern_create,
+				    intern_teardown);
+
+	tcase_add_loop_test(tc,
+			    nsurl_intern_test,
+			    0, NELEMS(intern_tests));
+	tcase_add_test(tc, nsurl_intern_release_test);
+
+	return tc;
+}
+
+
+/* hash test case */
+
+/**
+ * hash tests
+ *
+ * Pairs of distinct urls which collided when component hashes were
+ * combined with exclusive or.
+ */
+static const struct test_pairs hash_tests[] = {
+	{ "http://u:u@a/", "http://a/" },
+	{ "http://u:p@a/", "http://p:u@a/" },
+	{ "http://a@b/", "http://b@a/" },
+};
+
+/**
+ * distinct urls do not share trivial hash collisions
+ */
+START_TEST(nsurl_hash_test)
+{
+	nserror err;
+	nsurl *url1;
+	nsurl *url2;
+	const struct test_pairs *tst = &hash_tests[_i];
+
+	err = nsurl_create(tst->test, &url1);
+	ck_assert(err == NSERROR_OK);
+
+	err = nsurl_create(tst->res, &url2);
+	ck_assert(err == NSERROR_OK);
+
+	ck_assert(nsurl_hash(url1) != nsurl_hash(url2));
+
+	nsurl_unref(url1);
+	nsurl_unref(url2);
+}
+END_TEST
+
+
+/**
+ * urls differing only by fragment hash the same
+ */
+START_TEST(nsurl_hash_fragment_test)
+{
+	nserror err;
+	nsurl *url1;
+	nsurl *url2;
+
+	err = nsurl_create("http://a/b/c/d;p?q", &url1);
+	ck_assert(err == NSERROR_OK);
+
+	err = nsurl_create("http://a/b/c/d;p?q#f", &url2);
+	ck_assert(err == NSERROR_OK);
+
+	ck_assert(nsurl_hash(url1) == nsurl_hash(url2));
+
+	nsurl_unref(url1);
+	nsurl_unref(url2);
+}
+END_TEST
+
+
+/**
+ * test case for url hashing
+ */
+static TCase *nsurl_hash_case_create(void)
+{
+	TCase *tc;
+	tc = tcase_create("Hash");
+
+	tcase_add_unchecked_fixture(tc,
+				    corestring_create,
+				    corestring_teardown);
+
+	tcase_add_loop_test(tc,
+			    nsurl_hash_test,
+			    0, NELEMS(hash_tests));
+	tcase_add_test(tc, nsurl_hash_fragment_test);
+
+	return tc;
+}
+
+
+/* benchmark test case */
+
+/** number of iterations of each benchmark */
+#define BENCH_ITERATIONS 100000
+
+/**
+ * report benchmark throughput
+ */
+static void bench_report(const char *name, clock_t start, unsigned int count)
+{
+	double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	if (elapsed <= 0) {
+		elapsed = 1.0 / CLOCKS_PER_SEC;
+	}
+
+	fprintf(stderr, "%s: %u in %.3fs (%.0f per second)\n",
+		name, count, elapsed, count / elapsed);
+}
+
+/**
+ * url creation throughput
+ */
+START_TEST(nsurl_bench_create_test)
+{
+	nserror err;
+	nsurl *url;
+	unsigned int loop;
+	clock_t start;
+	const struct test_pairs *tst;
+
+	start = clock();
+	for (loop = 0; loop < BENCH_ITERATIONS; loop++) {
+		tst = &create_tests[loop % NELEMS(create_tests)];
+		err = nsurl_create(tst->test, &url);
+		if (err == NSERROR_OK) {
+			nsurl_unref(url);
+		}
+	}
+	bench_report("nsurl_create", start, BENCH_ITERATIONS);
+}
+END_TEST
+
+/**
+ * url join throughput
+ */
+START_TEST(nsurl_bench_join_test)
+{
+	nserror err;
+	nsurl *base;
+	nsurl *url;
+	unsigned int loop;
+	clock_t start;
+	const struct test_pairs *tst;
+
+	err = nsurl_create(base_str, &base);
+	ck_assert(err == NSERROR_OK);
+
+	start = clock();
+	for (loop = 0; loop < BENCH_ITERATIONS; loop++) {
+		tst = &join_tests[loop % NELEMS(join_tests)];
+		err = nsurl_join(base, tst->test, &url);
+		if (err == NSERROR_OK) {
+			nsurl_unref(url);
+		}
+	}
+	bench_report("nsurl_join", start, BENCH_ITERATIONS);
+
+	nsurl_unref(base);
+}
+END_TEST
+
+/**
+ * url compare throughput
+ */
+START_TEST(nsurl_bench_compare_test)
+{
+	nserror err;
+	nsurl *url1[NELEMS(compare_tests)];
+	nsurl *url2[NELEMS(compare_tests)];
+	unsigned int loop;
+	unsigned int idx;
+	unsigned int mismatched = 0;
+	clock_t start;
+
+	for (idx = 0; idx < NELEMS(compare_tests); idx++) {
+		err = nsurl_create(compare_tests[idx].test1, &url1[idx]);
+		ck_assert(err == NSERROR_OK);
+		err = nsurl_create(compare_tests[idx].test2, &url2[idx]);
+		ck_assert(err == NSERROR_OK);
+	}
+
+	start = clock();
+	for (loop = 0; loop < BENCH_ITERATIONS * 10; loop++) {
+		idx = loop % NELEMS(compare_tests);
+		if (nsurl_compare(url1[idx], url2[idx],
+				  compare_tests[idx].parts) !=
+		    compare_tests[idx].res) {
+			mismatched++;
+		}
+	}
+	bench_report("nsurl_compare", start, BENCH_ITERATIONS * 10);
+
+	ck_assert(mismatched == 0);
+
+	for (idx = 0; idx < NELEMS(compare_tests); idx++) {
+		nsurl_unref(url1[idx]);
+		nsurl_unref(url2[idx]);
+	}
+}
+END_TEST
+
+
+/**
+ * test case for benchmarks
+ *
+ * Only added when NETSURF_TEST_BENCHMARK is set in the environment.
+ */
+static TCase *nsurl_bench_case_create(void)
+{
+	TCase *tc;
+	tc = tcase_create("Benchmark");
+
+	tcase_add_unchecked_fixture(tc,
+				    intern_create,
+				    intern_teardown);
+
+	tcase_set_timeout(tc, 60);
+
+	tcase_add_test(tc, nsurl_bench_create_test);
+	tcase_add_test(tc, nsurl_bench_join_test);
+	tcase_add_test(tc, nsurl_bench_compare_test);
+
+	return tc;
+}
+
+
 /* test suite */
 
 /**
@@ -1542,6 +1900,16 @@ static Suite *nsurl_suite(void)
 	/* UTF-8 output */
 	suite_add_tcase(s, nsurl_utf8_case_create());
 
+	/* interning */
+	suite_add_tcase(s, nsurl_intern_case_create());
+
+	/* hashing */
+	suite_add_tcase(s, nsurl_hash_case_create());
+
+	/* benchmarks */
+	if (getenv("NETSURF_TEST_BENCHMARK") != NULL) {
+		suite_add_tcase(s, nsurl_bench_case_create());
+	}
 
 	return s;
 }
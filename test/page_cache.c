@@ -0,0 +1,375 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * Test back/forward page cache.
+ *
+ * The content handles, the functions the cache uses on them and the
+ * monotonic clock are replaced so documents can be stored, expired and
+ * discarded without fetching anything.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include <nsutils/time.h>
+
+#include "utils/errors.h"
+#include "utils/log.h"
+#include "utils/nsoption.h"
+#include "utils/metrics.h"
+#include "netsurf/content.h"
+#include "netsurf/ssl_certs.h"
+#include "content/hlcache.h"
+#include "content/content.h"
+#include "html/html.h"
+
+#include "desktop/browser_private.h"
+#include "desktop/page_cache.h"
+
+/** number of test documents */
+#define DOCS 4
+
+/** test document */
+struct hlcache_handle {
+	content_status status; /**< document status */
+	content_type type; /**< document type */
+	bool scripting; /**< document is running scripts */
+	bool released; /**< handle has been released */
+	hlcache_handle_callback cb; /**< current callback */
+	void *pw; /**< current callback context */
+};
+
+static struct hlcache_handle docs[DOCS];
+
+/* the browser windows and history entries are only compared */
+static struct browser_window *bw1 = (struct browser_window *)&docs[0];
+static struct browser_window *bw2 = (struct browser_window *)&docs[1];
+static struct history_entry *he1 = (struct history_entry *)&docs[0];
+static struct history_entry *he2 = (struct history_entry *)&docs[1];
+
+/** parameters freed by the cache */
+static unsigned int params_freed;
+
+/** time reported by the monotonic clock (ms) */
+static uint64_t test_now;
+
+/* Stubs */
+
+nserror nslog_set_filter_by_options(void) { return NSERROR_OK; }
+
+nsuerror nsu_getmonotonic_ms(uint64_t *current_out)
+{
+	*current_out = test_now;
+	return NSUERROR_OK;
+}
+
+content_status content_get_status(struct hlcache_handle *h)
+{
+	return h->status;
+}
+
+content_type content_get_type(struct hlcache_handle *h)
+{
+	return h->type;
+}
+
+struct content_html_frames *html_get_frameset(struct hlcache_handle *h)
+{
+	return NULL;
+}
+
+struct content_html_iframe *html_get_iframe(struct hlcache_handle *h)
+{
+	return NULL;
+}
+
+bool html_get_scripting(struct hlcache_handle *h)
+{
+	return h->scripting;
+}
+
+nserror hlcache_handle_replace_callback(hlcache_handle *handle,
+		hlcache_handle_callback cb, void *pw)
+{
+	handle->cb = cb;
+	handle->pw = pw;
+	return NSERROR_OK;
+}
+
+nserror hlcache_handle_release(hlcache_handle *handle)
+{
+	handle->released = true;
+	return NSERROR_OK;
+}
+
+struct nsurl *hlcache_handle_get_url(const struct hlcache_handle *handle)
+{
+	return NULL;
+}
+
+const char *nsurl_access(const struct nsurl *url)
+{
+	return "http://www.example.com/";
+}
+
+void browser_window__free_fetch_parameters(struct browser_fetch_parameters *params)
+{
+	params_freed++;
+	memset(params, 0, sizeof(*params));
+}
+
+nserror cert_chain_free(struct cert_chain *chain)
+{
+	return NSERROR_OK;
+}
+
+/**
+ * store a test document
+ */
+static bool
+store_doc(struct browser_window *bw,
+	  struct history_entry *entry,
+	  struct hlcache_handle *doc)
+{
+	struct browser_fetch_parameters params;
+
+	memset(&params, 0, sizeof(params));
+	params.parent_charset = (char *)"utf-8";
+
+	return page_cache_store(bw, entry, doc, &params, NULL);
+}
+
+/* Fixtures */
+
+static void page_cache_setup(void)
+{
+	int idx;
+
+	ck_assert(nsoption_init(NULL, NULL, NULL) == NSERROR_OK);
+
+	memset(docs, 0, sizeof(docs));
+	for (idx = 0; idx < DOCS; idx++) {
+		docs[idx].status = CONTENT_STATUS_DONE;
+		docs[idx].type = CONTENT_HTML;
+	}
+	params_freed = 0;
+	test_now = 1000;
+}
+
+static void page_cache_teardown(void)
+{
+	page_cache_discard(bw1);
+	page_cache_discard(bw2);
+
+	ck_assert(nsoption_finalise(NULL, NULL) == NSERROR_OK);
+}
+
+/* Tests */
+
+/**
+ * a stored document is taken back with its fetch parameters
+ */
+START_TEST(page_cache_store_take_test)
+{
+	struct browser_fetch_parameters params;
+	struct cert_chain *chain;
+	struct nsmetric_value hits;
+
+	ck_assert(store_doc(bw1, he1, &docs[0]));
+	ck_assert(docs[0].cb != NULL);
+
+	/* only the matching window and entry */
+	ck_assert(page_cache_take(bw2, he1, &params, &chain) == NULL);
+	ck_assert(page_cache_take(bw1, he2, &params, &chain) == NULL);
+
+	ck_assert(page_cache_take(bw1, he1, &params, &chain) == &docs[0]);
+	ck_assert_str_eq(params.parent_charset, "utf-8");
+	ck_assert(chain == NULL);
+	ck_assert(docs[0].released == false);
+
+	/* taken documents are no longer cached */
+	ck_assert(page_cache_take(bw1, he1, &params, &chain) == NULL);
+
+	ck_assert(nsmetric_get("page_cache.hits", &hits) == NSERROR_OK);
+	ck_assert_int_eq(hits.value, 1);
+}
+END_TEST
+
+/**
+ * documents which cannot be shown again as they were are not stored
+ */
+START_TEST(page_cache_reject_test)
+{
+	docs[0].status = CONTENT_STATUS_READY;
+	ck_assert(store_doc(bw1, he1, &docs[0]) == false);
+
+	docs[1].type = CONTENT_IMAGE;
+	ck_assert(store_doc(bw1, he1, &docs[1]) == false);
+
+	docs[2].scripting = true;
+	ck_assert(store_doc(bw1, he1, &docs[2]) == false);
+
+	nsoption_set_uint(page_cache_pages, 0);
+	ck_assert(store_doc(bw1, he1, &docs[3]) == false);
+
+	ck_assert(docs[3].cb == NULL);
+	ck_assert_int_eq(params_freed, 0);
+}
+END_TEST
+
+/**
+ * documents stored longer than the expiry time are discarded
+ */
+START_TEST(page_cache_expiry_test)
+{
+	struct browser_fetch_parameters params;
+	struct cert_chain *chain;
+
+	ck_assert(store_doc(bw1, he1, &docs[0]));
+	test_now += 20 * 60 * 1000;
+	ck_assert(store_doc(bw1, he2, &docs[1]));
+
+	/* the first document expires, the second has not */
+	test_now += 11 * 60 * 1000;
+	ck_assert(page_cache_take(bw1, he1, &params, &chain) == NULL);
+	ck_assert(docs[0].released);
+	ck_assert_int_eq(params_freed, 1);
+
+	ck_assert(page_cache_take(bw1, he2, &params, &chain) == &docs[1]);
+	ck_assert(docs[1].released == false);
+}
+END_TEST
+
+/**
+ * the least recently stored documents are discarded over the page limit
+ */
+START_TEST(page_cache_limit_test)
+{
+	struct browser_fetch_parameters params;
+	struct cert_chain *chain;
+	struct nsmetric_value pages;
+
+	nsoption_set_uint(page_cache_pages, 2);
+
+	ck_assert(store_doc(bw1, he1, &docs[0]));
+	ck_assert(store_doc(bw1, he2, &docs[1]));
+	ck_assert(store_doc(bw2, he1, &docs[2]));
+
+	ck_assert(docs[0].released);
+	ck_assert(docs[1].released == false);
+	ck_assert(docs[2].released == false);
+
+	ck_assert(nsmetric_get("page_cache.pages", &pages) == NSERROR_OK);
+	ck_assert_int_eq(pages.value, 2);
+
+	ck_assert(page_cache_take(bw1, he1, &params, &chain) == NULL);
+}
+END_TEST
+
+/**
+ * a document reporting an error while cached is not restored
+ */
+START_TEST(page_cache_failed_test)
+{
+	struct browser_fetch_parameters params;
+	struct cert_chain *chain;
+	hlcache_event event;
+
+	ck_assert(store_doc(bw1, he1, &docs[0]));
+
+	memset(&event, 0, sizeof(event));
+	event.type = CONTENT_MSG_ERROR;
+	ck_assert(docs[0].cb(&docs[0], &event, docs[0].pw) == NSERROR_OK);
+
+	ck_assert(page_cache_take(bw1, he1, &params, &chain) == NULL);
+	ck_assert(docs[0].released);
+}
+END_TEST
+
+/**
+ * discarding a window releases only its documents
+ */
+START_TEST(page_cache_discard_test)
+{
+	struct browser_fetch_parameters params;
+	struct cert_chain *chain;
+
+	ck_assert(store_doc(bw1, he1, &docs[0]));
+	ck_assert(store_doc(bw2, he1, &docs[1]));
+	ck_assert(store_doc(bw1, he2, &docs[2]));
+
+	page_cache_discard(bw1);
+
+	ck_assert(docs[0].released);
+	ck_assert(docs[1].released == false);
+	ck_assert(docs[2].released);
+	ck_assert_int_eq(params_freed, 2);
+
+	ck_assert(page_cache_take(bw2, he1, &params, &chain) == &docs[1]);
+}
+END_TEST
+
+
+static TCase *page_cache_case_create(void)
+{
+	TCase *tc;
+
+	tc = tcase_create("Page cache");
+
+	tcase_add_checked_fixture(tc, page_cache_setup, page_cache_teardown);
+
+	tcase_add_test(tc, page_cache_store_take_test);
+	tcase_add_test(tc, page_cache_reject_test);
+	tcase_add_test(tc, page_cache_expiry_test);
+	tcase_add_test(tc, page_cache_limit_test);
+	tcase_add_test(tc, page_cache_failed_test);
+	tcase_add_test(tc, page_cache_discard_test);
+
+	return tc;
+}
+
+
+static Suite *page_cache_suite(void)
+{
+	Suite *s;
+	s = suite_create("Page cache");
+
+	suite_add_tcase(s, page_cache_case_create());
+
+	return s;
+}
+
+int main(int argc, char **argv)
+{
+	int number_failed;
+	Suite *s;
+	SRunner *sr;
+
+	s = page_cache_suite();
+
+	sr = srunner_create(s);
+	srunner_run_all(sr, CK_ENV);
+
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
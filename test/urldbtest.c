@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <check.h>
 
@@ -131,6 +132,83 @@ static int cmp(const char *f1, const char *f2)
 	return res;
 }
 
+/**
+ * qsort comparison of lines
+ */
+static int cmp_line(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/**
+ * read the lines of a file sorted into order
+ */
+static char **sorted_lines(const char *f, unsigned int *count)
+{
+	char line[16 * 1024];
+	char **lines = NULL;
+	char **tmp;
+	FILE *fp;
+
+	*count = 0;
+
+	fp = fopen(f, "r");
+	if (fp == NULL) {
+		return NULL;
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		tmp = realloc(lines, sizeof(*lines) * (*count + 1));
+		if (tmp == NULL) {
+			break;
+		}
+		lines = tmp;
+		lines[(*count)++] = strdup(line);
+	}
+	fclose(fp);
+
+	qsort(lines, *count, sizeof(*lines), cmp_line);
+
+	return lines;
+}
+
+/**
+ * compare two files contents ignoring the order of lines
+ */
+static int cmp_unordered(const char *f1, const char *f2)
+{
+	char **lines1;
+	char **lines2;
+	unsigned int count1;
+	unsigned int count2;
+	unsigned int idx;
+	int res = 0;
+
+	lines1 = sorted_lines(f1, &count1);
+	lines2 = sorted_lines(f2, &count2);
+
+	if ((lines1 == NULL) || (lines2 == NULL) || (count1 != count2)) {
+		res = -1;
+	}
+
+	for (idx = 0; (res == 0) && (idx < count1); idx++) {
+		if (strcmp(lines1[idx], lines2[idx]) != 0) {
+			res = 1;
+		}
+	}
+
+	for (idx = 0; idx < count1; idx++) {
+		free(lines1[idx]);
+	}
+	free(lines1);
+	for (idx = 0; idx < count2; idx++) {
+		free(lines2[idx]);
+	}
+	free(lines2);
+
+	return res;
+}
+
 /*************** original test helpers ************/
 
 bool cookie_manager_add(const struct cookie_data *data)
@@ -591,9 +669,9 @@ START_TEST(urldb_session_test)
 
 	urldb_load_cookies(test_cookies_path);
 
-	/* write database out */
+	/* export database */
 	outnam = testnam(NULL);
-	res = urldb_save(outnam);
+	res = urldb_export(outnam);
 	ck_assert_int_eq(res, NSERROR_OK);
 
 	/* check the url database file written and the test file match */
@@ -602,9 +680,9 @@ START_TEST(urldb_session_test)
 	/* remove test output */
 	unlink(outnam);
 
-	/* write cookies out */
+	/* export cookies */
 	outnam = testnam(NULL);
-	urldb_save_cookies(outnam);
+	urldb_export_cookies(outnam);
 
 	/* check the cookies file written and the test file match */
 	ck_assert_int_eq(cmp(outnam, test_cookies_out_path), 0);
@@ -619,6 +697,75 @@ START_TEST(urldb_session_test)
 }
 END_TEST
 
+/**
+ * Session snapshot test case
+ *
+ * The databases are loaded, saved as snapshots and the snapshots
+ * loaded into a fresh database which must export the same data.
+ */
+START_TEST(urldb_session_snapshot_test)
+{
+	nserror res;
+	char urlnam[64];
+	char cookienam[64];
+	char *outnam;
+	nsurl *url;
+
+	/* writing output requires options initialising */
+	res = nsoption_init(NULL, NULL, NULL);
+	ck_assert_int_eq(res, NSERROR_OK);
+
+	res = urldb_load(test_urldb_path);
+	ck_assert_int_eq(res, NSERROR_OK);
+
+	urldb_load_cookies(test_cookies_path);
+
+	/* save snapshots */
+	strcpy(urlnam, testnam(NULL));
+	res = urldb_save(urlnam);
+	ck_assert_int_eq(res, NSERROR_OK);
+
+	strcpy(cookienam, testnam(NULL));
+	urldb_save_cookies(cookienam);
+
+	/* reload from snapshots */
+	urldb_destroy();
+
+	res = urldb_load(urlnam);
+	ck_assert_int_eq(res, NSERROR_OK);
+
+	urldb_load_cookies(cookienam);
+
+	unlink(urlnam);
+	unlink(cookienam);
+
+	/* looking up an entry adds its hosts paths from the snapshot */
+	res = nsurl_create("https://en.wikipedia.org/wiki/Main_Page", &url);
+	ck_assert_int_eq(res, NSERROR_OK);
+	ck_assert(urldb_get_url_data(url) != NULL);
+	nsurl_unref(url);
+
+	/* export must match the original data */
+	outnam = testnam(NULL);
+	res = urldb_export(outnam);
+	ck_assert_int_eq(res, NSERROR_OK);
+	ck_assert_int_eq(cmp(outnam, test_urldb_out_path), 0);
+	unlink(outnam);
+
+	/* cookies are exported in host tree order which depends on the
+	 * order hosts were loaded in.
+	 */
+	outnam = testnam(NULL);
+	urldb_export_cookies(outnam);
+	ck_assert_int_eq(cmp_unordered(outnam, test_cookies_out_path), 0);
+	unlink(outnam);
+
+	/* finalise options */
+	res = nsoption_finalise(NULL, NULL);
+	ck_assert_int_eq(res, NSERROR_OK);
+}
+END_TEST
+
 /**
  * Session more extensive test case
  *
@@ -706,6 +853,7 @@ static TCase *urldb_session_case_create(void)
 
 	tcase_add_test(tc, urldb_session_test);
 	tcase_add_test(tc, urldb_session_add_test);
+	tcase_add_test(tc, urldb_session_snapshot_test);
 
 	return tc;
 }
@@ -1019,6 +1167,62 @@ START_TEST(urldb_cookie_delete_test)
 }
 END_TEST
 
+/**
+ * cached cookie headers are reused and invalidated by changes on the
+ * host or a parent domain
+ */
+START_TEST(urldb_cookie_cache_test)
+{
+	const char *url = "http://www.cache.example.org/dir/page.html";
+	char *cdata; /* cookie data */
+
+	ck_assert(test_urldb_get_cookie(url) == NULL);
+
+	ck_assert(test_urldb_set_cookie("a=b; Path=/\r\n", url, NULL));
+	cdata = test_urldb_get_cookie(url);
+	ck_assert_str_eq(cdata, "a=b");
+	free(cdata);
+
+	/* unchanged cookies give the same header */
+	cdata = test_urldb_get_cookie(url);
+	ck_assert_str_eq(cdata, "a=b");
+	free(cdata);
+
+	/* a domain cookie set on a parent host applies */
+	ck_assert(test_urldb_set_cookie("c=d; Domain=.cache.example.org; Path=/\r\n",
+					"http://cache.example.org/", NULL));
+	cdata = test_urldb_get_cookie(url);
+	ck_assert_str_eq(cdata, "a=b; c=d");
+	free(cdata);
+
+	/* HttpOnly cookies are cached separately */
+	ck_assert(test_urldb_set_cookie("e=f; Path=/dir/page.html; HttpOnly\r\n", url, NULL));
+	cdata = test_urldb_get_cookie(url);
+	ck_assert_str_eq(cdata, "e=f; a=b; c=d");
+	free(cdata);
+	{
+		nsurl *nsurl = make_url(url);
+		cdata = urldb_get_cookie(nsurl, false);
+		nsurl_unref(nsurl);
+	}
+	ck_assert_str_eq(cdata, "a=b; c=d");
+	free(cdata);
+
+	/* deletion on the parent domain is seen */
+	urldb_delete_cookie(".cache.example.org", "/", "c");
+	cdata = test_urldb_get_cookie(url);
+	ck_assert_str_eq(cdata, "e=f; a=b");
+	free(cdata);
+
+	/* changes on an unrelated host leave the header alone */
+	ck_assert(test_urldb_set_cookie("g=h; Path=/\r\n",
+					"http://other.example.org/", NULL));
+	cdata = test_urldb_get_cookie(url);
+	ck_assert_str_eq(cdata, "e=f; a=b");
+	free(cdata);
+}
+END_TEST
+
 /**
  * Test case for urldb cookie management
  */
@@ -1035,6 +1239,7 @@ static TCase *urldb_cookie_case_create(void)
 	tcase_add_test(tc, urldb_cookie_create_test);
 	tcase_add_test(tc, urldb_iterate_cookies_test);
 	tcase_add_test(tc, urldb_cookie_delete_test);
+	tcase_add_test(tc, urldb_cookie_cache_test);
 
 	return tc;
 }
@@ -1103,6 +1308,106 @@ START_TEST(urldb_api_destroy_no_init_test)
 END_TEST
 
 
+/** number of hosts in the benchmark database */
+#define BENCH_HOSTS 16
+
+/** number of pages under each host in the benchmark database */
+#define BENCH_PAGES 512
+
+/** number of lookups made by the benchmark */
+#define BENCH_LOOKUPS 1000000
+
+/**
+ * report benchmark throughput
+ */
+static void bench_report(const char *name, clock_t start, unsigned int count)
+{
+	double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	if (elapsed <= 0) {
+		elapsed = 1.0 / CLOCKS_PER_SEC;
+	}
+
+	fprintf(stderr, "%s: %u in %.3fs (%.0f per second)\n",
+		name, count, elapsed, count / elapsed);
+}
+
+/**
+ * url lookup throughput in a large database
+ *
+ * The test database is loaded and extended with many sibling paths
+ * under a set of hosts so path lookups exercise wide directories.
+ */
+START_TEST(urldb_bench_lookup_test)
+{
+	nserror res;
+	nsurl **urls;
+	char buf[128];
+	unsigned int host;
+	unsigned int page;
+	unsigned int nurls = 0;
+	unsigned int loop;
+	unsigned int missing = 0;
+	clock_t start;
+
+	res = urldb_load(test_urldb_path);
+	ck_assert_int_eq(res, NSERROR_OK);
+
+	urls = malloc(sizeof(*urls) * BENCH_HOSTS * BENCH_PAGES);
+	ck_assert(urls != NULL);
+
+	for (host = 0; host < BENCH_HOSTS; host++) {
+		for (page = 0; page < BENCH_PAGES; page++) {
+			snprintf(buf, sizeof(buf),
+				 "http://www%u.example.com/dir/page%u.html?q=%u",
+				 host, page, page & 7);
+			res = nsurl_create(buf, &urls[nurls]);
+			ck_assert_int_eq(res, NSERROR_OK);
+			ck_assert(urldb_add_url(urls[nurls]) == true);
+			nurls++;
+		}
+	}
+
+	start = clock();
+	for (loop = 0; loop < BENCH_LOOKUPS; loop++) {
+		if (urldb_get_url_data(urls[loop % nurls]) == NULL) {
+			missing++;
+		}
+	}
+	bench_report("urldb_get_url_data", start, BENCH_LOOKUPS);
+
+	ck_assert(missing == 0);
+
+	for (loop = 0; loop < nurls; loop++) {
+		nsurl_unref(urls[loop]);
+	}
+	free(urls);
+}
+END_TEST
+
+
+/**
+ * test case for benchmarks
+ *
+ * Only added when NETSURF_TEST_BENCHMARK is set in the environment.
+ */
+static TCase *urldb_bench_case_create(void)
+{
+	TCase *tc;
+	tc = tcase_create("Benchmark");
+
+	tcase_add_checked_fixture(tc,
+				  urldb_create,
+				  urldb_teardown);
+
+	tcase_set_timeout(tc, 60);
+
+	tcase_add_test(tc, urldb_bench_lookup_test);
+
+	return tc;
+}
+
+
 /**
  * test case for urldb API including error returns and asserts
  */
@@ -1137,6 +1442,9 @@ static Suite *urldb_suite_create(void)
 	suite_add_tcase(s, urldb_case_create());
 	suite_add_tcase(s, urldb_cookie_case_create());
 	suite_add_tcase(s, urldb_original_case_create());
+	if (getenv("NETSURF_TEST_BENCHMARK") != NULL) {
+		suite_add_tcase(s, urldb_bench_case_create());
+	}
 
 	return s;
 }
@@ -130,6 +130,11 @@ char *realpath(const char *path, char *resolved_path);
 #undef HAVE_SIGPIPE
 #endif
 
+#define HAVE_SIGACTION
+#if (defined(_WIN32) || defined(__riscos__) || defined(__amigaos4__) || defined(__AMIGA__) || defined(__MINT__))
+#undef HAVE_SIGACTION
+#endif
+
 #define HAVE_STDOUT
 #if (defined(_WIN32))
 #undef HAVE_STDOUT
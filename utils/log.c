@@ -16,10 +16,43 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/**
+ * \file
+ * NetSurf logging implementation.
+ *
+ * Log entries are formatted into records held in a ring on the
+ * calling thread and written to the log stream later. Only the
+ * message itself is formatted when the entry is made, the timestamp
+ * and source location are stored raw and only rendered as the record
+ * is written out.
+ *
+ * Until deferred output is enabled with nslog_set_deferred() each
+ * record is written out immediately after it is made and no ring is
+ * allocated. Once enabled
+ * the owner must call nslog_flush() regularly, records are also
+ * written immediately when the ring is nearly full or the entry is an
+ * error.
+ *
+ * The ring always holds the most recent records, whether or not they
+ * have been written out, so they can be dumped for diagnosis. Where
+ * the platform supports it records not yet written are output if the
+ * browser crashes and the ring is dumped on SIGUSR1.
+ */
+
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #include "utils/config.h"
+
+#ifdef HAVE_SIGACTION
+#include <signal.h>
+#include <unistd.h>
+#endif
+
 #include "utils/nsoption.h"
 #include "utils/sys_time.h"
 #include "utils/utsname.h"
@@ -27,67 +60,548 @@
 
 #include "utils/log.h"
 
+/** Number of records retained in the log ring */
+#define NSLOG_RING_RECORDS 4096
+
+/** Length of message retained in a log record */
+#define NSLOG_RING_MSGLEN 200
+
+/**
+ * Number of records which may be outstanding before they are written
+ * out even when output is deferred.
+ */
+#define NSLOG_RING_HIGHWATER ((NSLOG_RING_RECORDS * 3) / 4)
+
+/**
+ * A log record
+ *
+ * All the strings apart from the message are static data from the
+ * logging call site.
+ */
+struct nslog_record {
+	uint64_t time; /**< monotonic time of entry in microseconds */
+	const char *level; /**< short level name or NULL if unknown */
+	const char *category; /**< category name or NULL if unknown */
+	int categorylen; /**< length of category name */
+	const char *filename; /**< source file name */
+	int filenamelen; /**< length of source file name */
+	const char *funcname; /**< function name */
+	int funcnamelen; /**< length of function name */
+	int lineno; /**< source line number */
+	unsigned int msglen; /**< length of message in msg */
+	char msg[NSLOG_RING_MSGLEN]; /**< formatted message, may be truncated */
+};
+
 /** flag to enable verbose logging */
 bool verbose_log = false;
 
 /** The stream to which logging is sent */
 static FILE *logfile;
 
-/** Subtract the `struct timeval' values X and Y
+/** Log record ring */
+static struct nslog_record *log_ring;
+
+/**
+ * Sequence number of next record to be made.
+ *
+ * There is only ever one thread making entries, this is only updated
+ * once the record it covers is complete so a signal handler may
+ * safely read every record before it.
+ */
+static volatile uint64_t log_ring_head;
+
+/** Sequence number of next record to be written to the log stream */
+static uint64_t log_ring_tail;
+
+/** Whether writing records to the log stream is deferred */
+static bool log_deferred = false;
+
+/** Monotonic time of first log entry */
+static uint64_t log_start_time;
+
+/**
+ * Get the current monotonic time.
+ *
+ * \return time in microseconds
+ */
+static uint64_t nslog_time(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+		return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+	}
+#endif
+	{
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+	}
+}
+
+/**
+ * Format a record for output.
  *
- * \param result The timeval structure to store the result in
- * \param x The first value
- * \param y The second value
- * \return 1 if the difference is negative, otherwise 0.
+ * \param rec The record to format
+ * \param buf The buffer to format into
+ * \param len The length of \a buf
+ * \return The length of the formatted record, which may exceed \a len
  */
 static int
-timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y)
+nslog_format_record(const struct nslog_record *rec, char *buf, size_t len)
+{
+	uint64_t elapsed = rec->time - log_start_time;
+
+	if (rec->category == NULL) {
+		return snprintf(buf, len,
+				"(%ld.%06ld) %.*s:%i %.*s: %.*s",
+				(long)(elapsed / 1000000),
+				(long)(elapsed % 1000000),
+				rec->filenamelen, rec->filename,
+				rec->lineno,
+				rec->funcnamelen, rec->funcname,
+				(int)rec->msglen, rec->msg);
+	}
+
+	return snprintf(buf, len,
+			"(%ld.%06ld) [%s %.*s] %.*s:%i %.*s: %.*s",
+			(long)(elapsed / 1000000),
+			(long)(elapsed % 1000000),
+			rec->level,
+			rec->categorylen, rec->category,
+			rec->filenamelen, rec->filename,
+			rec->lineno,
+			rec->funcnamelen, rec->funcname,
+			(int)rec->msglen, rec->msg);
+}
+
+/**
+ * Write a record to the log stream.
+ *
+ * \param rec The record to write
+ * \param msg The full message or NULL to use the record message
+ */
+static void nslog_write_record(const struct nslog_record *rec, const char *msg)
+{
+	uint64_t elapsed = rec->time - log_start_time;
+
+	fprintf(logfile, "(%ld.%06ld) ",
+		(long)(elapsed / 1000000),
+		(long)(elapsed % 1000000));
+
+	if (rec->category != NULL) {
+		fprintf(logfile, "[%s %.*s] ",
+			rec->level,
+			rec->categorylen,
+			rec->category);
+	}
+
+	fprintf(logfile, "%.*s:%i %.*s: ",
+		rec->filenamelen,
+		rec->filename,
+		rec->lineno,
+		rec->funcnamelen,
+		rec->funcname);
+
+	if (msg != NULL) {
+		fputs(msg, logfile);
+	} else {
+		fwrite(rec->msg, 1, rec->msglen, logfile);
+	}
+
+	/* Log entries aren't newline terminated add one for clarity */
+	fputc('\n', logfile);
+}
+
+/* exported interface documented in utils/log.h */
+void nslog_flush(void)
+{
+	uint64_t head = log_ring_head;
+
+	if (log_ring_tail == head) {
+		return;
+	}
+
+	while (log_ring_tail != head) {
+		nslog_write_record(
+			&log_ring[log_ring_tail % NSLOG_RING_RECORDS], NULL);
+		log_ring_tail++;
+	}
+
+	fflush(logfile);
+}
+
+/**
+ * Make a log entry.
+ *
+ * \param level The short name of the entry level or NULL if unknown
+ * \param error true if the entry is an error and must be output promptly
+ * \param category The category name or NULL if unknown
+ * \param categorylen The length of the category name
+ * \param filename The source file name
+ * \param filenamelen The length of the source file name
+ * \param funcname The function name
+ * \param funcnamelen The length of the function name
+ * \param lineno The source line number
+ * \param fmt The message format
+ * \param args The message arguments
+ */
+static void
+nslog_entry(const char *level,
+	    bool error,
+	    const char *category,
+	    int categorylen,
+	    const char *filename,
+	    int filenamelen,
+	    const char *funcname,
+	    int funcnamelen,
+	    int lineno,
+	    const char *fmt,
+	    va_list args)
+{
+	struct nslog_record fallback;
+	struct nslog_record *rec;
+	va_list full_args;
+	int msglen;
+
+	if (log_ring == NULL) {
+		rec = &fallback;
+	} else {
+		if (log_ring_head - log_ring_tail >= NSLOG_RING_RECORDS) {
+			/* never overwrite records not yet written */
+			nslog_flush();
+		}
+		rec = &log_ring[log_ring_head % NSLOG_RING_RECORDS];
+	}
+
+	rec->time = nslog_time();
+	if (log_start_time == 0) {
+		log_start_time = rec->time;
+	}
+	rec->level = level;
+	rec->category = category;
+	rec->categorylen = categorylen;
+	rec->filename = filename;
+	rec->filenamelen = filenamelen;
+	rec->funcname = funcname;
+	rec->funcnamelen = funcnamelen;
+	rec->lineno = lineno;
+
+	va_copy(full_args, args);
+	msglen = vsnprintf(rec->msg, sizeof(rec->msg), fmt, args);
+	if (msglen < 0) {
+		msglen = 0;
+	}
+
+	if ((size_t)msglen < sizeof(rec->msg)) {
+		rec->msglen = msglen;
+	} else {
+		/* message truncated in the record so write it out in
+		 * full now, after anything still outstanding.
+		 */
+		char *msg;
+
+		rec->msglen = sizeof(rec->msg) - 1;
+
+		msg = malloc(msglen + 1);
+		if (msg != NULL) {
+			vsnprintf(msg, msglen + 1, fmt, full_args);
+
+			nslog_flush();
+			nslog_write_record(rec, msg);
+			free(msg);
+			if (rec != &fallback) {
+				log_ring_head++;
+				log_ring_tail = log_ring_head;
+			}
+			va_end(full_args);
+			return;
+		}
+	}
+	va_end(full_args);
+
+	if (rec == &fallback) {
+		nslog_write_record(rec, NULL);
+		return;
+	}
+
+	log_ring_head++;
+
+	if ((log_deferred == false) ||
+	    (error == true) ||
+	    (log_ring_head - log_ring_tail >= NSLOG_RING_HIGHWATER)) {
+		nslog_flush();
+	}
+}
+
+/* exported interface documented in utils/log.h */
+nserror
+nslog_enumerate(unsigned int count, nslog_enumerate_cb *cb, void *pw)
 {
-	/* Perform the carry for the later subtraction by updating y. */
-	if (x->tv_usec < y->tv_usec) {
-		int nsec = (int)(y->tv_usec - x->tv_usec) / 1000000 + 1;
-		y->tv_usec -= 1000000 * nsec;
-		y->tv_sec += nsec;
+	char line[NSLOG_RING_MSGLEN + 512];
+	uint64_t head = log_ring_head;
+	uint64_t seq;
+	int len;
+	nserror res;
+
+	if (log_ring == NULL) {
+		return NSERROR_OK;
+	}
+
+	if (count > NSLOG_RING_RECORDS) {
+		count = NSLOG_RING_RECORDS;
+	}
+	seq = (head > count) ? head - count : 0;
+
+	for (; seq != head; seq++) {
+		len = nslog_format_record(&log_ring[seq % NSLOG_RING_RECORDS],
+					  line, sizeof(line));
+		if (len < 0) {
+			continue;
+		}
+		if ((size_t)len >= sizeof(line)) {
+			len = sizeof(line) - 1;
+		}
+		res = cb(line, len, pw);
+		if (res != NSERROR_OK) {
+			return res;
+		}
 	}
-	if ((int)(x->tv_usec - y->tv_usec) > 1000000) {
-		int nsec = (int)(x->tv_usec - y->tv_usec) / 1000000;
-		y->tv_usec += 1000000 * nsec;
-		y->tv_sec -= nsec;
+
+	return NSERROR_OK;
+}
+
+#ifdef HAVE_SIGACTION
+
+/** Signals on which outstanding records are written before terminating */
+static const int nslog_crash_signals[] = {
+	SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT
+};
+
+/** Handlers in place before the crash handlers were installed */
+static struct sigaction nslog_crash_old[sizeof(nslog_crash_signals) /
+					sizeof(nslog_crash_signals[0])];
+
+/** Handler in place before the dump handler was installed */
+static struct sigaction nslog_dump_old;
+
+/**
+ * Format an unsigned number for output from a signal handler.
+ *
+ * \param buf The buffer to format into, at least 21 bytes
+ * \param value The value to format
+ * \param width The minimum width, zero padded
+ * \return The length of the formatted value
+ */
+static size_t nslog_sig_number(char *buf, uint64_t value, unsigned int width)
+{
+	char tmp[21];
+	size_t len = 0;
+	size_t idx;
+
+	do {
+		tmp[len++] = '0' + (value % 10);
+		value /= 10;
+	} while ((value != 0) || (len < width));
+
+	for (idx = 0; idx < len; idx++) {
+		buf[idx] = tmp[len - idx - 1];
 	}
+	return len;
+}
 
-	/* Compute the time remaining to wait.
-	   tv_usec is certainly positive. */
-	result->tv_sec = x->tv_sec - y->tv_sec;
-	result->tv_usec = x->tv_usec - y->tv_usec;
+/**
+ * Append a string for output from a signal handler.
+ */
+static size_t
+nslog_sig_string(char *buf, size_t used, size_t size, const char *str, int len)
+{
+	if (len < 0) {
+		len = strlen(str);
+	}
+	if ((size_t)len > size - used) {
+		len = size - used;
+	}
+	memcpy(buf + used, str, len);
+	return used + len;
+}
 
-	/* Return 1 if result is negative. */
-	return x->tv_sec < y->tv_sec;
+/**
+ * Write log records from a signal handler.
+ *
+ * Only async signal safe calls are made, the records are written
+ * directly to the log stream file descriptor bypassing stdio.
+ *
+ * \param from The sequence number of the first record to write
+ * \param to The sequence number after the last record to write
+ */
+static void nslog_sig_write(uint64_t from, uint64_t to)
+{
+	char line[NSLOG_RING_MSGLEN + 512];
+	const struct nslog_record *rec;
+	uint64_t elapsed;
+	size_t used;
+	int fd = fileno(logfile);
+
+	for (; from != to; from++) {
+		rec = &log_ring[from % NSLOG_RING_RECORDS];
+		elapsed = rec->time - log_start_time;
+
+		used = 0;
+		line[used++] = '(';
+		used += nslog_sig_number(line + used, elapsed / 1000000, 1);
+		line[used++] = '.';
+		used += nslog_sig_number(line + used, elapsed % 1000000, 6);
+		line[used++] = ')';
+		line[used++] = ' ';
+		if (rec->category != NULL) {
+			line[used++] = '[';
+			used = nslog_sig_string(line, used, sizeof(line),
+						rec->level, -1);
+			line[used++] = ' ';
+			used = nslog_sig_string(line, used, sizeof(line),
+						rec->category,
+						rec->categorylen);
+			line[used++] = ']';
+			line[used++] = ' ';
+		}
+		used = nslog_sig_string(line, used, sizeof(line) - 32,
+					rec->filename, rec->filenamelen);
+		line[used++] = ':';
+		used += nslog_sig_number(line + used, rec->lineno, 1);
+		line[used++] = ' ';
+		used = nslog_sig_string(line, used, sizeof(line) - 2,
+					rec->funcname, rec->funcnamelen);
+		used = nslog_sig_string(line, used, sizeof(line) - 1,
+					": ", 2);
+		used = nslog_sig_string(line, used, sizeof(line) - 1,
+					rec->msg, rec->msglen);
+		line[used++] = '\n';
+
+		if (write(fd, line, used) < 0) {
+			return;
+		}
+	}
 }
 
 /**
- * Obtain a formatted string suitable for prepending to a log message
+ * Write outstanding records when the browser crashes.
  *
- * \return formatted string of the time since first log call
+ * The previous handler is restored and the signal raised again.
+ */
+static void nslog_crash_handler(int sig)
+{
+	unsigned int idx;
+
+	nslog_sig_write(log_ring_tail, log_ring_head);
+	log_ring_tail = log_ring_head;
+
+	for (idx = 0;
+	     idx < sizeof(nslog_crash_signals) / sizeof(nslog_crash_signals[0]);
+	     idx++) {
+		if (nslog_crash_signals[idx] == sig) {
+			sigaction(sig, &nslog_crash_old[idx], NULL);
+			break;
+		}
+	}
+	raise(sig);
+}
+
+/**
+ * Dump the record ring on request.
+ */
+static void nslog_dump_handler(int sig)
+{
+	static const char marker[] = "---- log ring dump ----\n";
+	uint64_t head = log_ring_head;
+	uint64_t first;
+
+	/* the slot at the head may be part way through being written
+	 * by the interrupted code so it is not dumped.
+	 */
+	first = (head >= NSLOG_RING_RECORDS) ? head - NSLOG_RING_RECORDS + 1 : 0;
+
+	if (write(fileno(logfile), marker, sizeof(marker) - 1) > 0) {
+		nslog_sig_write(first, head);
+	}
+}
+
+/**
+ * Install the signal handlers.
+ */
+static void nslog_signal_init(void)
+{
+	struct sigaction sa;
+	unsigned int idx;
+
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+
+	sa.sa_handler = nslog_crash_handler;
+	for (idx = 0;
+	     idx < sizeof(nslog_crash_signals) / sizeof(nslog_crash_signals[0]);
+	     idx++) {
+		sigaction(nslog_crash_signals[idx], &sa, &nslog_crash_old[idx]);
+	}
+
+	/* only take over SIGUSR1 if nothing else has */
+	if ((sigaction(SIGUSR1, NULL, &nslog_dump_old) == 0) &&
+	    (nslog_dump_old.sa_handler == SIG_DFL)) {
+		sa.sa_handler = nslog_dump_handler;
+		sa.sa_flags = SA_RESTART;
+		sigaction(SIGUSR1, &sa, NULL);
+	}
+}
+
+/**
+ * Restore the signal handlers in place before initialisation.
  */
-static const char *nslog_gettime(void)
+static void nslog_signal_fini(void)
 {
-	static struct timeval start_tv;
-	static char buff[32];
+	struct sigaction sa;
+	unsigned int idx;
 
-	struct timeval tv;
-	struct timeval now_tv;
+	for (idx = 0;
+	     idx < sizeof(nslog_crash_signals) / sizeof(nslog_crash_signals[0]);
+	     idx++) {
+		sigaction(nslog_crash_signals[idx], &nslog_crash_old[idx], NULL);
+	}
 
-	if (!timerisset(&start_tv)) {
-		gettimeofday(&start_tv, NULL);
+	if ((sigaction(SIGUSR1, NULL, &sa) == 0) &&
+	    (sa.sa_handler == nslog_dump_handler)) {
+		sigaction(SIGUSR1, &nslog_dump_old, NULL);
 	}
-	gettimeofday(&now_tv, NULL);
+}
 
-	timeval_subtract(&tv, &now_tv, &start_tv);
+#else
+
+static inline void nslog_signal_init(void) { }
+static inline void nslog_signal_fini(void) { }
 
-	snprintf(buff, sizeof(buff),"(%ld.%06ld)",
-		 (long)tv.tv_sec, (long)tv.tv_usec);
+#endif
+
+/* exported interface documented in utils/log.h */
+void nslog_set_deferred(bool deferred)
+{
+	if ((deferred == true) && (log_ring == NULL)) {
+#ifndef WITH_NSLOG
+		/* nothing is logged without verbose logging */
+		if (verbose_log == false) {
+			return;
+		}
+#endif
+		/* a failure to allocate the ring leaves output synchronous */
+		log_ring = malloc(NSLOG_RING_RECORDS * sizeof(*log_ring));
+		if (log_ring != NULL) {
+			nslog_signal_init();
+		}
+	}
 
-	return buff;
+	log_deferred = deferred;
+	if (deferred == false) {
+		nslog_flush();
+	}
 }
 
 #ifdef WITH_NSLOG
@@ -108,22 +622,17 @@ netsurf_render_log(void *_ctx,
 		   const char *fmt,
 		   va_list args)
 {
-	fprintf(logfile,
-		"%s [%s %.*s] %.*s:%i %.*s: ",
-		nslog_gettime(),
-		nslog_short_level_name(ctx->level),
-		ctx->category->namelen,
-		ctx->category->name,
-		ctx->filenamelen,
-		ctx->filename,
-		ctx->lineno,
-		ctx->funcnamelen,
-		ctx->funcname);
-
-	vfprintf(logfile, fmt, args);
-
-	/* Log entries aren't newline terminated add one for clarity */
-	fputc('\n', logfile);
+	nslog_entry(nslog_short_level_name(ctx->level),
+		    ctx->level >= NSLOG_LEVEL_ERROR,
+		    ctx->category->name,
+		    ctx->category->namelen,
+		    ctx->filename,
+		    ctx->filenamelen,
+		    ctx->funcname,
+		    ctx->funcnamelen,
+		    ctx->lineno,
+		    fmt,
+		    args);
 }
 
 /* exported interface documented in utils/log.h */
@@ -158,20 +667,16 @@ nslog_log(const char *file, const char *func, int ln, const char *format, ...)
 	va_list ap;
 
 	if (verbose_log) {
-		fprintf(logfile,
-			"%s %s:%i %s: ",
-			nslog_gettime(),
-			file,
-			ln,
-			func);
-
 		va_start(ap, format);
 
-		vfprintf(logfile, format, ap);
+		nslog_entry(NULL, false, NULL, 0,
+			    file, strlen(file),
+			    func, strlen(func),
+			    ln,
+			    format,
+			    ap);
 
 		va_end(ap);
-
-		fputc('\n', logfile);
 	}
 }
 
@@ -300,6 +805,16 @@ nslog_finalise()
 	NSLOG(netsurf, INFO,
 	      "Finalising logging, please report any further messages");
 	verbose_log = true;
+
+	log_deferred = false;
+	if (log_ring != NULL) {
+		nslog_flush();
+		nslog_signal_fini();
+		free(log_ring);
+		log_ring = NULL;
+		log_ring_head = log_ring_tail = 0;
+	}
+
 	if (logfile != stderr) {
 		fclose(logfile);
 		logfile = stderr;
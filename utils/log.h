@@ -64,6 +64,48 @@ extern nserror nslog_set_filter(const char *filter);
  */
 extern nserror nslog_set_filter_by_options(void);
 
+/**
+ * Write any outstanding log records to the log output.
+ */
+extern void nslog_flush(void);
+
+/**
+ * Set whether log output is deferred.
+ *
+ * When deferred, log records are held in memory and only written to
+ * the log output when nslog_flush() is called, when too many are
+ * outstanding or an error is logged. The caller enabling deferred
+ * output is responsible for calling nslog_flush() regularly.
+ *
+ * \param deferred true to defer output, false to write each record as
+ *                 it is logged.
+ */
+extern void nslog_set_deferred(bool deferred);
+
+/**
+ * Callback for log record enumeration
+ *
+ * \param line The formatted log record, not NUL terminated
+ * \param len The length of \a line
+ * \param pw The context passed to nslog_enumerate()
+ * \return NSERROR_OK to continue enumerating, any other value stops
+ *          enumeration and is returned to the caller.
+ */
+typedef nserror (nslog_enumerate_cb)(const char *line, size_t len, void *pw);
+
+/**
+ * Enumerate the most recent log records.
+ *
+ * Records are retained whether or not they have been written to the
+ * log output so the recent history is always available.
+ *
+ * \param count The maximum number of records to enumerate
+ * \param cb The callback for each record, oldest first
+ * \param pw The context passed to \a cb
+ * \return NSERROR_OK on success or the first error returned by \a cb
+ */
+extern nserror nslog_enumerate(unsigned int count, nslog_enumerate_cb *cb, void *pw);
+
 /* ensure a logging level is defined */
 #ifndef NETSURF_LOG_LEVEL
 #define NETSURF_LOG_LEVEL INFO
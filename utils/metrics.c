@@ -0,0 +1,349 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * In process performance metrics registry implementation.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/metrics.h"
+
+/**
+ * A registered metric
+ */
+struct nsmetric {
+	struct nsmetric *next; /**< next metric in registration order */
+	char *name; /**< metric name */
+	enum nsmetric_type type; /**< type of metric */
+
+	int64_t value; /**< current value or last sample */
+	uint64_t count; /**< number of updates */
+	int64_t total; /**< sum of samples */
+	int64_t max; /**< maximum value seen */
+
+	unsigned int history_next; /**< next history slot to write */
+	int64_t history[NSMETRIC_HISTORY]; /**< ring of recent values */
+};
+
+/**
+ * A registered metric source
+ */
+struct nsmetric_source {
+	struct nsmetric_source *next; /**< next source */
+	nsmetric_source_fn fn; /**< source function */
+	void *pw; /**< source context */
+};
+
+/** registered metrics, head and tail to keep registration order */
+static struct nsmetric *metrics_head;
+static struct nsmetric *metrics_tail;
+
+/** registered sources */
+static struct nsmetric_source *metric_sources;
+
+
+/**
+ * Append a value to a metrics history ring
+ */
+static inline void metric_record(struct nsmetric *metric, int64_t value)
+{
+	metric->history[metric->history_next % NSMETRIC_HISTORY] = value;
+	metric->history_next++;
+}
+
+
+/**
+ * Fill a value snapshot from a registered metric
+ */
+static void
+metric_snapshot(const struct nsmetric *metric, struct nsmetric_value *value)
+{
+	unsigned int idx;
+	unsigned int first;
+
+	value->name = metric->name;
+	value->label = NULL;
+	value->type = metric->type;
+	value->value = metric->value;
+	value->count = metric->count;
+	value->total = metric->total;
+	value->max = metric->max;
+
+	if (metric->history_next < NSMETRIC_HISTORY) {
+		value->history_len = metric->history_next;
+		first = 0;
+	} else {
+		value->history_len = NSMETRIC_HISTORY;
+		first = metric->history_next;
+	}
+	for (idx = 0; idx < value->history_len; idx++) {
+		value->history[idx] =
+			metric->history[(first + idx) % NSMETRIC_HISTORY];
+	}
+}
+
+
+/**
+ * find a registered metric by name
+ */
+static struct nsmetric *metric_find(const char *name)
+{
+	struct nsmetric *metric;
+
+	for (metric = metrics_head; metric != NULL; metric = metric->next) {
+		if (strcmp(metric->name, name) == 0) {
+			break;
+		}
+	}
+	return metric;
+}
+
+
+/* exported interface documented in utils/metrics.h */
+nserror
+nsmetric_register(const char *name,
+		  enum nsmetric_type type,
+		  struct nsmetric **metric_out)
+{
+	struct nsmetric *metric;
+
+	metric = metric_find(name);
+	if (metric != NULL) {
+		if (metric->type != type) {
+			return NSERROR_BAD_PARAMETER;
+		}
+		*metric_out = metric;
+		return NSERROR_OK;
+	}
+
+	metric = calloc(1, sizeof(*metric));
+	if (metric == NULL) {
+		return NSERROR_NOMEM;
+	}
+
+	metric->name = strdup(name);
+	if (metric->name == NULL) {
+		free(metric);
+		return NSERROR_NOMEM;
+	}
+	metric->type = type;
+
+	if (metrics_tail == NULL) {
+		metrics_head = metric;
+	} else {
+		metrics_tail->next = metric;
+	}
+	metrics_tail = metric;
+
+	*metric_out = metric;
+
+	return NSERROR_OK;
+}
+
+
+/* exported interface documented in utils/metrics.h */
+void nsmetric_add(struct nsmetric *metric, int64_t delta)
+{
+	if (metric == NULL) {
+		return;
+	}
+
+	metric->value += delta;
+	metric->count++;
+	if (metric->value > metric->max) {
+		metric->max = metric->value;
+	}
+	if (metric->type == NSMETRIC_GAUGE) {
+		metric_record(metric, metric->value);
+	}
+}
+
+
+/* exported interface documented in utils/metrics.h */
+void nsmetric_set(struct nsmetric *metric, int64_t value)
+{
+	if (metric == NULL) {
+		return;
+	}
+
+	metric->value = value;
+	metric->count++;
+	if (value > metric->max) {
+		metric->max = value;
+	}
+	metric_record(metric, value);
+}
+
+
+/* exported interface documented in utils/metrics.h */
+void nsmetric_sample(struct nsmetric *metric, int64_t ms)
+{
+	if (metric == NULL) {
+		return;
+	}
+
+	metric->value = ms;
+	metric->count++;
+	metric->total += ms;
+	if (ms > metric->max) {
+		metric->max = ms;
+	}
+	metric_record(metric, ms);
+}
+
+
+/* exported interface documented in utils/metrics.h */
+nserror nsmetric_source_register(nsmetric_source_fn fn, void *pw)
+{
+	struct nsmetric_source *source;
+
+	source = malloc(sizeof(*source));
+	if (source == NULL) {
+		return NSERROR_NOMEM;
+	}
+
+	source->fn = fn;
+	source->pw = pw;
+	source->next = metric_sources;
+	metric_sources = source;
+
+	return NSERROR_OK;
+}
+
+
+/* exported interface documented in utils/metrics.h */
+nserror nsmetric_source_unregister(nsmetric_source_fn fn, void *pw)
+{
+	struct nsmetric_source **prev;
+	struct nsmetric_source *source;
+
+	for (prev = &metric_sources; *prev != NULL; prev = &(*prev)->next) {
+		source = *prev;
+		if ((source->fn == fn) && (source->pw == pw)) {
+			*prev = source->next;
+			free(source);
+			return NSERROR_OK;
+		}
+	}
+
+	return NSERROR_NOT_FOUND;
+}
+
+
+/* exported interface documented in utils/metrics.h */
+nserror nsmetric_get(const char *name, struct nsmetric_value *value)
+{
+	struct nsmetric *metric;
+
+	metric = metric_find(name);
+	if (metric == NULL) {
+		return NSERROR_NOT_FOUND;
+	}
+
+	metric_snapshot(metric, value);
+
+	return NSERROR_OK;
+}
+
+
+/**
+ * context for filtering source generated values by prefix
+ */
+struct metric_filter_ctx {
+	const char *prefix;
+	size_t prefix_len;
+	nsmetric_enumerate_cb cb;
+	void *pw;
+};
+
+
+/**
+ * filter source generated values by prefix
+ */
+static nserror
+metric_filter_cb(const struct nsmetric_value *value, void *pw)
+{
+	struct metric_filter_ctx *ctx = pw;
+
+	if (strncmp(value->name, ctx->prefix, ctx->prefix_len) != 0) {
+		return NSERROR_OK;
+	}
+	return ctx->cb(value, ctx->pw);
+}
+
+
+/* exported interface documented in utils/metrics.h */
+nserror
+nsmetric_enumerate(const char *prefix, nsmetric_enumerate_cb cb, void *pw)
+{
+	struct metric_filter_ctx ctx;
+	struct nsmetric *metric;
+	struct nsmetric_source *source;
+	struct nsmetric_value value;
+	nserror res;
+
+	ctx.prefix = (prefix == NULL) ? "" : prefix;
+	ctx.prefix_len = strlen(ctx.prefix);
+	ctx.cb = cb;
+	ctx.pw = pw;
+
+	for (metric = metrics_head; metric != NULL; metric = metric->next) {
+		if (strncmp(metric->name, ctx.prefix, ctx.prefix_len) != 0) {
+			continue;
+		}
+		metric_snapshot(metric, &value);
+		res = cb(&value, pw);
+		if (res != NSERROR_OK) {
+			return res;
+		}
+	}
+
+	for (source = metric_sources; source != NULL; source = source->next) {
+		res = source->fn(metric_filter_cb, &ctx, source->pw);
+		if (res != NSERROR_OK) {
+			return res;
+		}
+	}
+
+	return NSERROR_OK;
+}
+
+
+/* exported interface documented in utils/metrics.h */
+void nsmetric_fini(void)
+{
+	struct nsmetric *metric;
+	struct nsmetric_source *source;
+
+	while (metrics_head != NULL) {
+		metric = metrics_head;
+		metrics_head = metric->next;
+		free(metric->name);
+		free(metric);
+	}
+	metrics_tail = NULL;
+
+	while (metric_sources != NULL) {
+		source = metric_sources;
+		metric_sources = source->next;
+		free(source);
+	}
+}
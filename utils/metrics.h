@@ -0,0 +1,179 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This file is part of NetSurf, http://www.netsurf-browser.org/
+ *
+ * NetSurf is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * NetSurf is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * \file
+ * In process performance metrics registry.
+ *
+ * Modules publish values either by registering a named metric and
+ * updating it as events occur or, for values which are cheaper to
+ * compute on demand (such as per host fetch counts), by registering a
+ * source which is called when the metrics are enumerated.
+ *
+ * Updates are a handful of arithmetic operations on a handle obtained
+ * at registration time so they may be made from hot paths. All update
+ * functions accept a NULL handle so a failed registration need not be
+ * checked for at each update site.
+ */
+
+#ifndef NETSURF_UTILS_METRICS_H
+#define NETSURF_UTILS_METRICS_H
+
+#include <stdint.h>
+
+#include "utils/errors.h"
+
+/** Number of samples retained in a metric history */
+#define NSMETRIC_HISTORY 32
+
+/**
+ * Type of a metric
+ */
+enum nsmetric_type {
+	NSMETRIC_COUNTER, /**< monotonically increasing count */
+	NSMETRIC_GAUGE, /**< instantaneous level, history of values kept */
+	NSMETRIC_TIMING, /**< duration samples in ms, history of samples kept */
+};
+
+/**
+ * Opaque metric handle
+ */
+struct nsmetric;
+
+/**
+ * Snapshot of a metric value
+ */
+struct nsmetric_value {
+	const char *name; /**< metric name */
+	const char *label; /**< label within name (e.g. host) or NULL */
+	enum nsmetric_type type; /**< type of metric */
+	int64_t value; /**< current value or most recent sample */
+	uint64_t count; /**< number of updates or samples */
+	int64_t total; /**< sum of all timing samples */
+	int64_t max; /**< largest value or sample seen */
+	unsigned int history_len; /**< number of valid history entries */
+	int64_t history[NSMETRIC_HISTORY]; /**< history, oldest first */
+};
+
+/**
+ * Callback for metric enumeration
+ *
+ * \param value The metric value snapshot
+ * \param pw The private context passed to enumeration
+ * \return NSERROR_OK to continue enumerating, any other value stops
+ *          enumeration and is returned to the caller.
+ */
+typedef nserror (*nsmetric_enumerate_cb)(const struct nsmetric_value *value, void *pw);
+
+/**
+ * Metric source function
+ *
+ * Called during enumeration to generate a set of values.
+ *
+ * \param cb The callback to pass each generated value to
+ * \param cbpw The context to pass to \a cb
+ * \param pw The context the source was registered with
+ * \return NSERROR_OK on success or the first error returned by \a cb
+ */
+typedef nserror (*nsmetric_source_fn)(nsmetric_enumerate_cb cb, void *cbpw, void *pw);
+
+/**
+ * Register a metric
+ *
+ * If a metric of the same name is already registered its handle is
+ * returned, allowing several modules to publish to the same metric.
+ *
+ * \param name The metric name, dot separated by module e.g. "llcache.hit"
+ * \param type The type of the metric
+ * \param metric_out The resulting metric handle
+ * \return NSERROR_OK on success else error code
+ */
+nserror nsmetric_register(const char *name, enum nsmetric_type type, struct nsmetric **metric_out);
+
+/**
+ * Add to a counter or gauge metric
+ *
+ * \param metric The metric to update or NULL
+ * \param delta The amount to add
+ */
+void nsmetric_add(struct nsmetric *metric, int64_t delta);
+
+/**
+ * Set a gauge metric
+ *
+ * \param metric The metric to update or NULL
+ * \param value The new value
+ */
+void nsmetric_set(struct nsmetric *metric, int64_t value);
+
+/**
+ * Record a timing sample
+ *
+ * \param metric The metric to update or NULL
+ * \param ms The duration of the sample in milliseconds
+ */
+void nsmetric_sample(struct nsmetric *metric, int64_t ms);
+
+/**
+ * Register a metric source
+ *
+ * \param fn The source function
+ * \param pw The context passed to \a fn
+ * \return NSERROR_OK on success else error code
+ */
+nserror nsmetric_source_register(nsmetric_source_fn fn, void *pw);
+
+/**
+ * Unregister a metric source
+ *
+ * \param fn The source function
+ * \param pw The context \a fn was registered with
+ * \return NSERROR_OK on success or NSERROR_NOT_FOUND if not registered
+ */
+nserror nsmetric_source_unregister(nsmetric_source_fn fn, void *pw);
+
+/**
+ * Get a snapshot of a registered metric by name
+ *
+ * \param name The metric name
+ * \param value The value snapshot to fill
+ * \return NSERROR_OK on success or NSERROR_NOT_FOUND if no such metric
+ */
+nserror nsmetric_get(const char *name, struct nsmetric_value *value);
+
+/**
+ * Enumerate metrics
+ *
+ * Registered metrics are enumerated in registration order followed by
+ * the values generated by each registered source.
+ *
+ * \param prefix Only enumerate metrics whose name starts with this or NULL
+ * \param cb The callback for each metric
+ * \param pw The context passed to \a cb
+ * \return NSERROR_OK on success or the first error returned by \a cb
+ */
+nserror nsmetric_enumerate(const char *prefix, nsmetric_enumerate_cb cb, void *pw);
+
+/**
+ * Finalise the metrics registry
+ *
+ * All metric handles become invalid.
+ */
+void nsmetric_fini(void);
+
+#endif
@@ -155,6 +155,21 @@ nserror nsurl_get(const nsurl *url, nsurl_component parts,
 lwc_string *nsurl_get_component(const nsurl *url, nsurl_component part);
 
 
+/**
+ * Peek at a component of a NetSurf URL object without taking a reference
+ *
+ * \param url	  NetSurf URL object
+ * \param part	  The URL component required
+ * \return the required component as an lwc_string, or NULL
+ *
+ * The returned lwc_string is owned by the NetSurf URL object and is only
+ * valid while the caller holds a reference to the URL.
+ *
+ * The valid values for the part parameter are as for nsurl_get_component.
+ */
+lwc_string *nsurl_peek_component(const nsurl *url, nsurl_component part);
+
+
 /**
  * Get the scheme type from a NetSurf URL object
  *
@@ -199,6 +214,23 @@ bool nsurl_has_component(const nsurl *url, nsurl_component part);
 const char *nsurl_access(const nsurl *url);
 
 
+/**
+ * Access the path and query of a NetSurf URL object in place
+ *
+ * \param url	  NetSurf URL to access the path and query of.
+ * \param pq	  Updated to point at the start of the path.
+ * \param pq_len  Updated with the length of the path and query, including
+ *		  the '?' separator if there is a query.
+ * \return NSERROR_OK on success, NSERROR_NOT_FOUND if the URL has no path.
+ *
+ * This is the same string nsurl_get() would produce for
+ * NSURL_PATH | NSURL_QUERY but without copying it. The returned string
+ * is owned by the NetSurf URL object and is NOT '\0' terminated at
+ * \a pq_len.
+ */
+nserror nsurl_access_path_query(const nsurl *url, const char **pq, size_t *pq_len);
+
+
 /**
  * Variant of \ref nsurl_access for logging.
  *
@@ -398,4 +430,21 @@ nserror nsurl_parent(const nsurl *url, nsurl **new_url);
  */
 void nsurl_dump(const nsurl *url);
 
+/**
+ * Enable or disable sharing of identical NetSurf URL objects
+ *
+ * When enabled, creating a NetSurf URL which is identical (including
+ * the fragment) to one which already exists returns a new reference
+ * to the existing object instead of allocating a new one. The table
+ * of shared objects holds no references, objects are removed from it
+ * when their last reference is released.
+ *
+ * Disabling interning does not affect existing objects other than
+ * removing them from the table.
+ *
+ * \param enable true to enable interning, false to disable it.
+ * \return NSERROR_OK on success, appropriate error otherwise
+ */
+nserror nsurl_intern_enable(bool enable);
+
 #endif
@@ -64,11 +64,192 @@
 	}
 
 
+/** Initial number of buckets in the intern table */
+#define NSURL_INTERN_INITIAL_BUCKETS 256
+
+/**
+ * Weak table of interned NetSurf URL objects
+ *
+ * The table does not hold references to the objects, they are removed
+ * when their reference count drops to zero.
+ */
+static struct nsurl_intern_table {
+	bool enabled; /**< Whether new objects are interned */
+	nsurl **buckets; /**< Hash chains, NULL when not enabled */
+	uint32_t bucket_count; /**< Number of buckets, always a power of 2 */
+	uint32_t count; /**< Number of objects in the table */
+} nsurl__intern_table;
+
+
+/**
+ * Check if two NetSurf URL objects are identical
+ *
+ * Component strings are interned so pointer comparison is sufficient
+ * and the URL string is derived solely from the components.
+ */
+static inline bool nsurl__intern_match(const nsurl *a, const nsurl *b)
+{
+	return ((a->hash == b->hash) &&
+		(a->length == b->length) &&
+		(a->components.scheme == b->components.scheme) &&
+		(a->components.username == b->components.username) &&
+		(a->components.password == b->components.password) &&
+		(a->components.host == b->components.host) &&
+		(a->components.port == b->components.port) &&
+		(a->components.path == b->components.path) &&
+		(a->components.query == b->components.query) &&
+		(a->components.fragment == b->components.fragment));
+}
+
+
+/**
+ * Double the number of buckets in the intern table
+ *
+ * Failure to grow is not an error, the chains just get longer.
+ */
+static void nsurl__intern_grow(void)
+{
+	struct nsurl_intern_table *t = &nsurl__intern_table;
+	uint32_t new_count = t->bucket_count * 2;
+	nsurl **new_buckets;
+	uint32_t bucket;
+
+	new_buckets = calloc(new_count, sizeof(nsurl *));
+	if (new_buckets == NULL) {
+		return;
+	}
+
+	for (bucket = 0; bucket < t->bucket_count; bucket++) {
+		nsurl *url = t->buckets[bucket];
+		while (url != NULL) {
+			nsurl *next = url->intern_next;
+			uint32_t idx = url->hash & (new_count - 1);
+
+			url->intern_next = new_buckets[idx];
+			new_buckets[idx] = url;
+			url = next;
+		}
+	}
+
+	free(t->buckets);
+	t->buckets = new_buckets;
+	t->bucket_count = new_count;
+}
+
+
+/**
+ * Remove a NetSurf URL object from the intern table
+ */
+static void nsurl__intern_remove(nsurl *url)
+{
+	struct nsurl_intern_table *t = &nsurl__intern_table;
+	nsurl **prev;
+
+	prev = &t->buckets[url->hash & (t->bucket_count - 1)];
+	while (*prev != NULL) {
+		if (*prev == url) {
+			*prev = url->intern_next;
+			t->count--;
+			break;
+		}
+		prev = &(*prev)->intern_next;
+	}
+
+	url->interned = false;
+	url->intern_next = NULL;
+}
+
+
+/* exported interface, documented in nsurl/private.h */
+nsurl *nsurl__intern(nsurl *url)
+{
+	struct nsurl_intern_table *t = &nsurl__intern_table;
+	uint32_t idx;
+	nsurl *existing;
+
+	url->interned = false;
+	url->intern_next = NULL;
+
+	if (t->enabled == false) {
+		return url;
+	}
+
+	idx = url->hash & (t->bucket_count - 1);
+	for (existing = t->buckets[idx];
+	     existing != NULL;
+	     existing = existing->intern_next) {
+		if (nsurl__intern_match(existing, url)) {
+			/* Discard the new object in favour of the existing */
+			nsurl__components_destroy(&url->components);
+			free(url);
+
+			existing->count++;
+			return existing;
+		}
+	}
+
+	url->intern_next = t->buckets[idx];
+	t->buckets[idx] = url;
+	url->interned = true;
+	t->count++;
+
+	if (t->count > t->bucket_count) {
+		nsurl__intern_grow();
+	}
+
+	return url;
+}
+
 
 /******************************************************************************
  * NetSurf URL Public API                                                     *
  ******************************************************************************/
 
+/* exported interface, documented in nsurl.h */
+nserror nsurl_intern_enable(bool enable)
+{
+	struct nsurl_intern_table *t = &nsurl__intern_table;
+	uint32_t bucket;
+
+	if (enable == t->enabled) {
+		return NSERROR_OK;
+	}
+
+	if (enable) {
+		t->buckets = calloc(NSURL_INTERN_INITIAL_BUCKETS,
+				    sizeof(nsurl *));
+		if (t->buckets == NULL) {
+			return NSERROR_NOMEM;
+		}
+		t->bucket_count = NSURL_INTERN_INITIAL_BUCKETS;
+		t->count = 0;
+		t->enabled = true;
+
+		return NSERROR_OK;
+	}
+
+	/* Release all objects from the table */
+	for (bucket = 0; bucket < t->bucket_count; bucket++) {
+		nsurl *url = t->buckets[bucket];
+		while (url != NULL) {
+			nsurl *next = url->intern_next;
+
+			url->interned = false;
+			url->intern_next = NULL;
+			url = next;
+		}
+	}
+
+	free(t->buckets);
+	t->buckets = NULL;
+	t->bucket_count = 0;
+	t->count = 0;
+	t->enabled = false;
+
+	return NSERROR_OK;
+}
+
+
 /* exported interface, documented in nsurl.h */
 nsurl *nsurl_ref(nsurl *url)
 {
@@ -89,6 +270,10 @@ void nsurl_unref(nsurl *url)
 	if (--url->count > 0)
 		return;
 
+	if (url->interned) {
+		nsurl__intern_remove(url);
+	}
+
 	/* Release lwc strings */
 	nsurl__components_destroy(&url->components);
 
@@ -105,6 +290,14 @@ bool nsurl_compare(const nsurl *url1, const nsurl *url2, nsurl_component parts)
 	assert(url1 != NULL);
 	assert(url2 != NULL);
 
+	/* Identical objects always match */
+	if (url1 == url2)
+		return true;
+
+	/* Distinct interned objects always differ in some component */
+	if (url1->interned && url2->interned && parts == NSURL_WITH_FRAGMENT)
+		return false;
+
 	/* Compare URL components */
 
 	/* Path, host and query first, since they're most likely to differ */
@@ -189,42 +382,34 @@ nserror nsurl_get(const nsurl *url, nsurl_component parts,
 
 
 /* exported interface, documented in nsurl.h */
-lwc_string *nsurl_get_component(const nsurl *url, nsurl_component part)
+lwc_string *nsurl_peek_component(const nsurl *url, nsurl_component part)
 {
 	assert(url != NULL);
 
 	switch (part) {
 	case NSURL_SCHEME:
-		return (url->components.scheme != NULL) ?
-				lwc_string_ref(url->components.scheme) : NULL;
+		return url->components.scheme;
 
 	case NSURL_USERNAME:
-		return (url->components.username != NULL) ?
-				lwc_string_ref(url->components.username) : NULL;
+		return url->components.username;
 
 	case NSURL_PASSWORD:
-		return (url->components.password != NULL) ?
-				lwc_string_ref(url->components.password) : NULL;
+		return url->components.password;
 
 	case NSURL_HOST:
-		return (url->components.host != NULL) ?
-				lwc_string_ref(url->components.host) : NULL;
+		return url->components.host;
 
 	case NSURL_PORT:
-		return (url->components.port != NULL) ?
-				lwc_string_ref(url->components.port) : NULL;
+		return url->components.port;
 
 	case NSURL_PATH:
-		return (url->components.path != NULL) ?
-				lwc_string_ref(url->components.path) : NULL;
+		return url->components.path;
 
 	case NSURL_QUERY:
-		return (url->components.query != NULL) ?
-				lwc_string_ref(url->components.query) : NULL;
+		return url->components.query;
 
 	case NSURL_FRAGMENT:
-		return (url->components.fragment != NULL) ?
-				lwc_string_ref(url->components.fragment) : NULL;
+		return url->components.fragment;
 
 	default:
 		NSLOG(netsurf, INFO,
@@ -236,6 +421,17 @@ lwc_string *nsurl_get_component(const nsurl *url, nsurl_component part)
 }
 
 
+/* exported interface, documented in nsurl.h */
+lwc_string *nsurl_get_component(const nsurl *url, nsurl_component part)
+{
+	lwc_string *component;
+
+	component = nsurl_peek_component(url, part);
+
+	return (component != NULL) ? lwc_string_ref(component) : NULL;
+}
+
+
 /* exported interface, documented in nsurl.h */
 enum nsurl_scheme_type nsurl_get_scheme_type(const nsurl *url)
 {
@@ -321,6 +517,37 @@ const char *nsurl_access(const nsurl *url)
 }
 
 
+/* exported interface, documented in nsurl.h */
+nserror nsurl_access_path_query(const nsurl *url, const char **pq, size_t *pq_len)
+{
+	size_t tail = 0;
+	size_t len;
+
+	assert(url != NULL);
+
+	if (url->components.path == NULL) {
+		return NSERROR_NOT_FOUND;
+	}
+
+	/* The path and query are contiguous in the URL string, ahead
+	 * of any fragment, so work back from the end of the string.
+	 */
+	if (url->components.fragment != NULL) {
+		tail = SLEN("#") + lwc_string_length(url->components.fragment);
+	}
+
+	len = lwc_string_length(url->components.path);
+	if (url->components.query != NULL) {
+		len += SLEN("?") + lwc_string_length(url->components.query);
+	}
+
+	*pq = url->string + url->length - tail - len;
+	*pq_len = len;
+
+	return NSERROR_OK;
+}
+
+
 /* exported interface, documented in nsurl.h */
 const char *nsurl_access_log(const nsurl *url)
 {
@@ -508,6 +735,9 @@ nserror nsurl_defragment(const nsurl *url, nsurl **no_frag)
 	/* Give the URL a reference */
 	(*no_frag)->count = 1;
 
+	/* Share an existing identical URL if there is one */
+	*no_frag = nsurl__intern(*no_frag);
+
 	return NSERROR_OK;
 }
 
@@ -576,6 +806,9 @@ nserror nsurl_refragment(const nsurl *url, lwc_string *frag, nsurl **new_url)
 	/* Give the URL a reference */
 	(*new_url)->count = 1;
 
+	/* Share an existing identical URL if there is one */
+	*new_url = nsurl__intern(*new_url);
+
 	return NSERROR_OK;
 }
 
@@ -673,6 +906,9 @@ nserror nsurl_replace_query(const nsurl *url, const char *query,
 	/* Give the URL a reference */
 	(*new_url)->count = 1;
 
+	/* Share an existing identical URL if there is one */
+	*new_url = nsurl__intern(*new_url);
+
 	return NSERROR_OK;
 }
 
@@ -760,6 +996,9 @@ nserror nsurl_replace_scheme(const nsurl *url, lwc_string *scheme,
 	/* Give the URL a reference */
 	(*new_url)->count = 1;
 
+	/* Share an existing identical URL if there is one */
+	*new_url = nsurl__intern(*new_url);
+
 	return NSERROR_OK;
 }
 
@@ -963,6 +1202,9 @@ nserror nsurl_parent(const nsurl *url, nsurl **new_url)
 	/* Give the URL a reference */
 	(*new_url)->count = 1;
 
+	/* Share an existing identical URL if there is one */
+	*new_url = nsurl__intern(*new_url);
+
 	return NSERROR_OK;
 }
 
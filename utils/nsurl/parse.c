@@ -48,6 +48,23 @@
 #include "utils/nsurl/private.h"
 #include "utils/utils.h"
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define NSURL_SCAN_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define NSURL_SCAN_NEON
+#endif
+
+
+/**
+ * Size of on-stack buffer used for normalising URL sections
+ *
+ * URLs whose normalisation buffer fits in this are parsed without any
+ * temporary heap allocation.
+ */
+#define NSURL_STACK_BUFFER_LEN 1024
+
 
 /** Marker set, indicating positions of sections within a URL string */
 struct url_markers {
@@ -189,6 +206,177 @@ static bool nsurl__is_no_escape(unsigned char c)
 }
 
 
+/**
+ * Find the first occurrence of either of two characters in a string
+ *
+ * Blocks of 16 bytes are tested together where vector instructions
+ * are available. Only bytes before end are ever read.
+ *
+ * \param pos	start of the string to search
+ * \param end	end of the string to search
+ * \param c1	first character to find
+ * \param c2	second character to find
+ * \return pointer to first c1 or c2, or end if neither is present.
+ */
+static inline const char *nsurl__find_either(const char *pos,
+		const char *end, char c1, char c2)
+{
+#if defined(NSURL_SCAN_SSE2)
+	const __m128i v1 = _mm_set1_epi8(c1);
+	const __m128i v2 = _mm_set1_epi8(c2);
+
+	while (end - pos >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(const void *)pos);
+		int mask = _mm_movemask_epi8(_mm_or_si128(
+				_mm_cmpeq_epi8(v, v1), _mm_cmpeq_epi8(v, v2)));
+		if (mask != 0) {
+			return pos + __builtin_ctz(mask);
+		}
+		pos += 16;
+	}
+#elif defined(NSURL_SCAN_NEON)
+	const uint8x16_t v1 = vdupq_n_u8(c1);
+	const uint8x16_t v2 = vdupq_n_u8(c2);
+
+	while (end - pos >= 16) {
+		uint8x16_t v = vld1q_u8((const uint8_t *)pos);
+		uint8x16_t hit = vorrq_u8(vceqq_u8(v, v1), vceqq_u8(v, v2));
+		if (vmaxvq_u8(hit) != 0) {
+			/* located within this block by the scalar loop */
+			break;
+		}
+		pos += 16;
+	}
+#endif
+	while (pos < end && *pos != c1 && *pos != c2) {
+		pos++;
+	}
+
+	return pos;
+}
+
+
+/**
+ * Get the length of the run of characters needing no normalisation
+ *
+ * For the scheme and host sections characters need normalising if they
+ * are upper case or escape sequences. For all other sections
+ * characters need normalising if they must be escaped, including '%'
+ * as escape sequences must be checked.
+ *
+ * \param pos		start of the section to test
+ * \param end		end of the section to test
+ * \param lower_only	true for scheme and host sections
+ * \return number of characters at pos that can be copied unaltered.
+ */
+static inline size_t nsurl__clean_run(const char *pos, const char *end,
+		bool lower_only)
+{
+	const char *start = pos;
+
+#if defined(NSURL_SCAN_SSE2)
+	while (end - pos >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(const void *)pos);
+		__m128i bad;
+		int mask;
+
+		if (lower_only) {
+			bad = _mm_or_si128(
+				_mm_and_si128(
+					_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+					_mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1))),
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('%')));
+			mask = _mm_movemask_epi8(bad);
+		} else {
+			/* Printable ASCII, other than a few exceptions,
+			 * does not need escaping. Bytes with the top bit
+			 * set are negative so fail the range test.
+			 */
+			__m128i ok = _mm_and_si128(
+				_mm_cmpgt_epi8(v, _mm_set1_epi8(0x20)),
+				_mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+			bad = _mm_or_si128(
+				_mm_or_si128(
+					_mm_or_si128(
+						_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+						_mm_cmpeq_epi8(v, _mm_set1_epi8('%'))),
+					_mm_or_si128(
+						_mm_cmpeq_epi8(v, _mm_set1_epi8('<')),
+						_mm_cmpeq_epi8(v, _mm_set1_epi8('>')))),
+				_mm_or_si128(
+					_mm_or_si128(
+						_mm_cmpeq_epi8(v, _mm_set1_epi8('\\')),
+						_mm_cmpeq_epi8(v, _mm_set1_epi8('^'))),
+					_mm_or_si128(
+						_mm_or_si128(
+							_mm_cmpeq_epi8(v, _mm_set1_epi8('`')),
+							_mm_cmpeq_epi8(v, _mm_set1_epi8('{'))),
+						_mm_cmpeq_epi8(v, _mm_set1_epi8('}')))));
+			mask = _mm_movemask_epi8(_mm_andnot_si128(bad, ok)) ^ 0xffff;
+		}
+
+		if (mask != 0) {
+			return pos - start + __builtin_ctz(mask);
+		}
+		pos += 16;
+	}
+#elif defined(NSURL_SCAN_NEON)
+	while (end - pos >= 16) {
+		uint8x16_t v = vld1q_u8((const uint8_t *)pos);
+		uint8x16_t bad;
+
+		if (lower_only) {
+			bad = vorrq_u8(
+				vcltq_u8(vsubq_u8(v, vdupq_n_u8('A')),
+					 vdupq_n_u8(26)),
+				vceqq_u8(v, vdupq_n_u8('%')));
+		} else {
+			/* Bytes outside the printable ASCII range, or one
+			 * of the printable exceptions, must be escaped.
+			 */
+			bad = vorrq_u8(
+				vcgeq_u8(vsubq_u8(v, vdupq_n_u8(0x21)),
+					 vdupq_n_u8(0x7f - 0x21)),
+				vorrq_u8(
+					vorrq_u8(
+						vorrq_u8(
+							vceqq_u8(v, vdupq_n_u8('"')),
+							vceqq_u8(v, vdupq_n_u8('%'))),
+						vorrq_u8(
+							vceqq_u8(v, vdupq_n_u8('<')),
+							vceqq_u8(v, vdupq_n_u8('>')))),
+					vorrq_u8(
+						vorrq_u8(
+							vceqq_u8(v, vdupq_n_u8('\\')),
+							vceqq_u8(v, vdupq_n_u8('^'))),
+						vorrq_u8(
+							vorrq_u8(
+								vceqq_u8(v, vdupq_n_u8('`')),
+								vceqq_u8(v, vdupq_n_u8('{'))),
+							vceqq_u8(v, vdupq_n_u8('}'))))));
+		}
+
+		if (vmaxvq_u8(bad) != 0) {
+			/* located within this block by the scalar loop */
+			break;
+		}
+		pos += 16;
+	}
+#endif
+	if (lower_only) {
+		while (pos < end && *pos != '%' && !ascii_is_alpha_upper(*pos)) {
+			pos++;
+		}
+	} else {
+		while (pos < end && nsurl__is_no_escape(*pos)) {
+			pos++;
+		}
+	}
+
+	return pos - start;
+}
+
+
 /**
  * Obtains a set of markers delimiting sections in a URL string
  *
@@ -200,6 +388,7 @@ static void nsurl__get_string_markers(const char * const url_s,
 		struct url_markers *markers, bool joining)
 {
 	const char *pos = url_s; /** current position in url_s */
+	const char *url_end; /** end of url_s */
 	bool is_http = false;
 	bool trailing_whitespace = false;
 
@@ -214,6 +403,9 @@ static void nsurl__get_string_markers(const char * const url_s,
 	/* Record start point */
 	marker.start = pos - url_s;
 
+	/* Find the end so the remainder can be scanned in blocks */
+	url_end = pos + strlen(pos);
+
 	marker.scheme_end = marker.authority = marker.colon_first = marker.at =
 			marker.colon_last = marker.path = marker.start;
 
@@ -405,32 +597,23 @@ static void nsurl__get_string_markers(const char * const url_s,
 	 */
 	if (*pos == '/' || ((marker.path == marker.authority) &&
 			(*pos != '?') && (*pos != '#') && (*pos != '\0'))) {
-		while (*(++pos) != '\0') {
-			if (*pos == '?' || *pos == '#') {
-				/* End of the path */
-				break;
-			}
-		}
+		/* Path ends at the query or fragment */
+		pos = nsurl__find_either(pos + 1, url_end, '?', '#');
 	}
 
 	marker.query = pos - url_s;
 
 	/* Get query */
 	if (*pos == '?') {
-		while (*(++pos) != '\0') {
-			if (*pos == '#') {
-				/* End of the query */
-				break;
-			}
-		}
+		/* Query ends at the fragment */
+		pos = nsurl__find_either(pos + 1, url_end, '#', '#');
 	}
 
 	marker.fragment = pos - url_s;
 
 	/* Get fragment */
 	if (*pos == '#') {
-		while (*(++pos) != '\0')
-			;
+		pos = url_end;
 	}
 
 	/* We got to the end of url_s.
@@ -695,6 +878,17 @@ static nserror nsurl__create_from_section(const char * const url_s,
 	pos = pos_url_s = url_s + start;
 	copy_len = 0;
 	for (; pos < url_s + end; pos++) {
+		/* Skip over any run of characters needing no change */
+		size_t clean = nsurl__clean_run(pos, url_s + end,
+				(section == URL_SCHEME || section == URL_HOST));
+		if (clean > 0) {
+			copy_len += clean;
+			pos += clean;
+			if (pos >= url_s + end) {
+				break;
+			}
+		}
+
 		if (*pos == '%' && (pos + 2 < url_s + end)) {
 			/* Might be an escaped character needing unescaped */
 
@@ -1224,34 +1418,59 @@ nserror nsurl__components_to_string(
 
 
 /**
- * Calculate hash value
+ * Mix a component hash into a running URL hash
  *
- * \param url		NetSurf URL object to set hash value for
+ * This is the MurmurHash3 block mixing step. Components are mixed in
+ * a fixed order so, unlike combining them with exclusive or, the result
+ * depends on which component a value is in and identical components
+ * do not cancel each other out.
+ *
+ * \param hash		running hash value
+ * \param value		component hash, or zero if component is absent
+ * \return updated running hash value
  */
-void nsurl__calc_hash(nsurl *url)
+static inline uint32_t nsurl__hash_mix(uint32_t hash, uint32_t value)
 {
-	uint32_t hash = 0;
+	value *= 0xcc9e2d51;
+	value = (value << 15) | (value >> 17);
+	value *= 0x1b873593;
 
-	if (url->components.scheme)
-		hash ^= lwc_string_hash_value(url->components.scheme);
+	hash ^= value;
+	hash = (hash << 13) | (hash >> 19);
+	hash = hash * 5 + 0xe6546b64;
 
-	if (url->components.username)
-		hash ^= lwc_string_hash_value(url->components.username);
-
-	if (url->components.password)
-		hash ^= lwc_string_hash_value(url->components.password);
-
-	if (url->components.host)
-		hash ^= lwc_string_hash_value(url->components.host);
+	return hash;
+}
 
-	if (url->components.port)
-		hash ^= lwc_string_hash_value(url->components.port);
+#define nsurl__component_hash(c) ((c == NULL) ? 0 : lwc_string_hash_value(c))
 
-	if (url->components.path)
-		hash ^= lwc_string_hash_value(url->components.path);
+/**
+ * Calculate hash value
+ *
+ * The fragment is not included so URLs differing only in fragment
+ * have the same hash value.
+ *
+ * \param url		NetSurf URL object to set hash value for
+ */
+void nsurl__calc_hash(nsurl *url)
+{
+	const struct nsurl_components *c = &url->components;
+	uint32_t hash = 0;
 
-	if (url->components.query)
-		hash ^= lwc_string_hash_value(url->components.query);
+	hash = nsurl__hash_mix(hash, nsurl__component_hash(c->scheme));
+	hash = nsurl__hash_mix(hash, nsurl__component_hash(c->username));
+	hash = nsurl__hash_mix(hash, nsurl__component_hash(c->password));
+	hash = nsurl__hash_mix(hash, nsurl__component_hash(c->host));
+	hash = nsurl__hash_mix(hash, nsurl__component_hash(c->port));
+	hash = nsurl__hash_mix(hash, nsurl__component_hash(c->path));
+	hash = nsurl__hash_mix(hash, nsurl__component_hash(c->query));
+
+	/* Finalisation mix to avalanche the bits */
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
 
 	url->hash = hash;
 }
@@ -1267,7 +1486,8 @@ nserror nsurl_create(const char * const url_s, nsurl **url)
 	struct url_markers m;
 	struct nsurl_components c;
 	size_t length;
-	char *buff;
+	char stack_buff[NSURL_STACK_BUFFER_LEN];
+	char *buff = stack_buff;
 	nserror e = NSERROR_OK;
 	bool match;
 
@@ -1280,9 +1500,11 @@ nserror nsurl_create(const char * const url_s, nsurl **url)
 	length = nsurl__get_longest_section(&m);
 
 	/* Allocate enough memory to url escape the longest section */
-	buff = malloc(length * 3 + 1);
-	if (buff == NULL)
-		return NSERROR_NOMEM;
+	if (length * 3 + 1 > sizeof(stack_buff)) {
+		buff = malloc(length * 3 + 1);
+		if (buff == NULL)
+			return NSERROR_NOMEM;
+	}
 
 	/* Set scheme type */
 	c.scheme_type = m.scheme_type;
@@ -1296,7 +1518,8 @@ nserror nsurl_create(const char * const url_s, nsurl **url)
 	e |= nsurl__create_from_section(url_s, URL_FRAGMENT, &m, buff, &c);
 
 	/* Finished with buffer */
-	free(buff);
+	if (buff != stack_buff)
+		free(buff);
 
 	if (e != NSERROR_OK) {
 		nsurl__components_destroy(&c);
@@ -1330,6 +1553,9 @@ nserror nsurl_create(const char * const url_s, nsurl **url)
 	/* Give the URL a reference */
 	(*url)->count = 1;
 
+	/* Share an existing identical URL if there is one */
+	*url = nsurl__intern(*url);
+
 	return NSERROR_OK;
 }
 
@@ -1340,7 +1566,8 @@ nserror nsurl_join(const nsurl *base, const char *rel, nsurl **joined)
 	struct url_markers m;
 	struct nsurl_components c;
 	size_t length;
-	char *buff;
+	char stack_buff[NSURL_STACK_BUFFER_LEN];
+	char *buff = stack_buff;
 	char *buff_pos;
 	char *buff_start;
 	nserror error = 0;
@@ -1414,9 +1641,11 @@ nserror nsurl_join(const nsurl *base, const char *rel, nsurl **joined)
 	length += (m.query - m.path) + ((base->components.path != NULL) ?
 			lwc_string_length(base->components.path) : 0);
 
-	buff = malloc(length + 5);
-	if (buff == NULL) {
-		return NSERROR_NOMEM;
+	if (length + 5 > sizeof(stack_buff)) {
+		buff = malloc(length + 5);
+		if (buff == NULL) {
+			return NSERROR_NOMEM;
+		}
 	}
 
 	buff_pos = buff;
@@ -1432,7 +1661,8 @@ nserror nsurl_join(const nsurl *base, const char *rel, nsurl **joined)
 
 		error = nsurl__create_from_section(rel, URL_SCHEME, &m,	buff, &c);
 		if (error != NSERROR_OK) {
-			free(buff);
+			if (buff != stack_buff)
+				free(buff);
 			return error;
 		}
 	}
@@ -1450,7 +1680,8 @@ nserror nsurl_join(const nsurl *base, const char *rel, nsurl **joined)
 							   buff, &c);
 		}
 		if (error != NSERROR_OK) {
-			free(buff);
+			if (buff != stack_buff)
+				free(buff);
 			return error;
 		}
 	}
@@ -1506,7 +1737,8 @@ nserror nsurl_join(const nsurl *base, const char *rel, nsurl **joined)
 		error = nsurl__create_from_section(buff_pos, URL_PATH, &m_path,
 				buff_start, &c);
 		if (error != NSERROR_OK) {
-			free(buff);
+			if (buff != stack_buff)
+				free(buff);
 			return error;
 		}
 
@@ -1528,7 +1760,8 @@ nserror nsurl_join(const nsurl *base, const char *rel, nsurl **joined)
 		error = nsurl__create_from_section(buff_pos, URL_PATH, &m_path,
 				buff_start, &c);
 		if (error != NSERROR_OK) {
-			free(buff);
+			if (buff != stack_buff)
+				free(buff);
 			return error;
 		}
 	}
@@ -1539,7 +1772,8 @@ nserror nsurl_join(const nsurl *base, const char *rel, nsurl **joined)
 		error = nsurl__create_from_section(rel, URL_QUERY, &m,
 				buff, &c);
 		if (error != NSERROR_OK) {
-			free(buff);
+			if (buff != stack_buff)
+				free(buff);
 			return error;
 		}
 	}
@@ -1547,7 +1781,8 @@ nserror nsurl_join(const nsurl *base, const char *rel, nsurl **joined)
 	error = nsurl__create_from_section(rel, URL_FRAGMENT, &m, buff, &c);
 
 	/* Free temporary buffer */
-	free(buff);
+	if (buff != stack_buff)
+		free(buff);
 
 	if (error != NSERROR_OK) {
 		return error;
@@ -1568,5 +1803,8 @@ nserror nsurl_join(const nsurl *base, const char *rel, nsurl **joined)
 	/* Give the URL a reference */
 	(*joined)->count = 1;
 
+	/* Share an existing identical URL if there is one */
+	*joined = nsurl__intern(*joined);
+
 	return NSERROR_OK;
 }
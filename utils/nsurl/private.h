@@ -60,6 +60,9 @@ struct nsurl {
 	int count;	/* Number of references to NetSurf URL object */
 	uint32_t hash;	/* Hash value for nsurl identification */
 
+	bool interned;	/* Object is in the intern table */
+	struct nsurl *intern_next; /* Next object in intern table bucket */
+
 	size_t length;	/* Length of string */
 	char string[FLEX_ARRAY_LEN_DECL];	/* Full URL as a string */
 };
@@ -127,6 +130,18 @@ nserror nsurl__components_to_string(
  */
 void nsurl__calc_hash(nsurl *url);
 
+/**
+ * Share a newly constructed URL with an identical existing one
+ *
+ * If interning is enabled and an identical URL object exists, the
+ * new object is destroyed and a reference to the existing object is
+ * returned. Otherwise the new object is added to the intern table.
+ *
+ * \param url Newly constructed NetSurf URL object with one reference.
+ * \return The NetSurf URL object to use in place of \a url.
+ */
+nsurl *nsurl__intern(nsurl *url);
+
 
 
 